@@ -0,0 +1,13 @@
+Texture2D atlasTexture : register(t0);
+SamplerState atlasSampler : register(s0);
+
+struct PixelShaderInput
+{
+    float4 color : COLOR;
+    float2 texCoord : TEXCOORD;
+};
+
+float4 SpritePixelShader(PixelShaderInput IN) : SV_TARGET
+{
+    return atlasTexture.Sample(atlasSampler, IN.texCoord) * IN.color;
+}
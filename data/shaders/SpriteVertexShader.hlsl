@@ -0,0 +1,25 @@
+struct AppData
+{
+    float2 position : POSITION;
+    float2 texCoord : TEXCOORD;
+    float4 color : COLOR;
+};
+
+struct VertexShaderOutput
+{
+    float4 color : COLOR;
+    float2 texCoord : TEXCOORD;
+    float4 position : SV_POSITION;
+};
+
+//Sprite positions arrive in clip space already; the batcher transforms them on the CPU.
+VertexShaderOutput SpriteVertexShader(AppData IN)
+{
+    VertexShaderOutput OUT;
+
+    OUT.position = float4(IN.position, 0.0f, 1.0f);
+    OUT.texCoord = IN.texCoord;
+    OUT.color = IN.color;
+
+    return OUT;
+}
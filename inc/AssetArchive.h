@@ -0,0 +1,102 @@
+#pragma once
+#include "File.h"
+
+// Packed asset archive.
+// The file starts with an AssetArchiveHeader, the entry table, a hash table
+// of entry indices keyed by the normalized path and the block of entry names.
+// The whole archive is memory mapped, so opening it costs one mapping and a
+// validation pass over the table. Entry data starts on ASSET_ARCHIVE_ALIGNMENT
+// boundaries. Stored entries are used in place; compressed entries are split
+// into independent ASSET_ARCHIVE_CHUNK_SIZE chunks of a simple LZ77 format
+// that decompress in parallel.
+
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4B415045; // "EPAK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint32_t ASSET_ARCHIVE_ALIGNMENT = 4096;
+const uint32_t ASSET_ARCHIVE_CHUNK_SIZE = 64 * 1024;
+const uint32_t ASSET_ARCHIVE_ENTRY_NONE = 0xFFFFFFFF;
+
+enum AssetArchiveCompression : uint32_t {
+    AAC_None,
+    AAC_Lz
+};
+
+struct AssetArchiveHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    // Power of two, at least twice the entry count.
+    uint32_t BucketCount;
+    // Offsets from the start of the file.
+    uint64_t EntriesOffset;
+    uint64_t BucketsOffset;
+    uint64_t NamesOffset;
+    uint64_t NamesSize;
+};
+
+struct AssetArchiveEntry
+{
+    // FNV-1a hash of the normalized path.
+    uint64_t PathHash;
+    uint64_t DataOffset;
+    // Size of the entry once decompressed, and as stored in the file.
+    uint64_t Size;
+    uint64_t StoredSize;
+    // Normalized path, in UTF-8, inside the name block.
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t Compression;
+    uint32_t ChunkCount;
+};
+
+// Compressed entries start with one of these per chunk. A chunk whose stored size equals
+// its decompressed size is stored raw.
+struct AssetArchiveChunk
+{
+    // Offset from the start of the entry's data.
+    uint32_t Offset;
+    uint32_t StoredSize;
+};
+
+struct AssetArchive
+{
+    MappedFile File;
+    const AssetArchiveHeader* Header = nullptr;
+    const AssetArchiveEntry* Entries = nullptr;
+    const uint32_t* Buckets = nullptr;
+    const char* Names = nullptr;
+};
+
+// Map an archive and validate its header and tables.
+bool OpenAssetArchive(AssetArchive& archive, const wchar_t* path);
+void CloseAssetArchive(AssetArchive& archive);
+
+// Paths match case insensitively and with either slash. Returns ASSET_ARCHIVE_ENTRY_NONE when absent.
+UINT FindAssetArchiveEntry(const AssetArchive& archive, const wchar_t* path);
+
+// Bytes of a stored entry, straight from the mapping; nullptr for compressed entries.
+const void* GetAssetArchiveEntryData(const AssetArchive& archive, UINT entry);
+// Copy or decompress an entry. Fails on corrupt chunks.
+bool ReadAssetArchiveEntry(const AssetArchive& archive, UINT entry, std::vector<BYTE>& data);
+
+// In-memory asset to be packed.
+struct AssetArchiveSource
+{
+    const wchar_t* Path;
+    const void* Data;
+    uint64_t Size;
+    // Compressed entries that do not shrink by at least an eighth are stored instead.
+    bool Compress;
+};
+
+struct AssetArchiveWriteStats
+{
+    UINT Entries;
+    UINT CompressedEntries;
+    uint64_t Size;
+    uint64_t StoredSize;
+    double TimeMs;
+};
+
+bool WriteAssetArchive(const wchar_t* path, const AssetArchiveSource* sources, UINT sourceCount, AssetArchiveWriteStats* stats = nullptr);
@@ -0,0 +1,67 @@
+#pragma once
+
+// Asynchronous asset loading.
+// A request goes through three stages: its file is read through the virtual
+// filesystem by a small pool of I/O threads, decoded by a job on the job
+// system, and uploaded on the main thread, where UpdateAssetLoader runs
+// uploads each frame until a time budget is spent. Reads and uploads are served highest priority first; priorities
+// can change and requests can be cancelled until their upload has run.
+// The job system must be running before the loader starts and stop after it.
+
+typedef uint32_t AssetHandle;
+const AssetHandle ASSET_HANDLE_NONE = 0xFFFFFFFF;
+
+// Threads that block on file reads.
+const UINT ASSET_IO_THREADS = 2;
+// Main thread time spent on uploads per frame. At least one upload runs per update.
+const double ASSET_UPLOAD_BUDGET_MS = 2.0;
+
+enum AssetState {
+    AS_Queued,
+    AS_Reading,
+    AS_Decoding,
+    AS_Uploading,
+    AS_Loaded,
+    AS_Failed,
+    AS_Cancelled
+};
+
+// Turn the file's bytes into data ready for upload. Runs on a job system worker.
+typedef std::function<bool(std::vector<BYTE>& data)> AssetDecodeFunction;
+// Create the GPU resources from the decoded data. Runs on the main thread.
+typedef std::function<bool(ID3D11Device* device, ID3D11DeviceContext* deviceContext)> AssetUploadFunction;
+
+void InitAssetLoader(UINT ioThreadCount = ASSET_IO_THREADS);
+// Cancel everything that is still pending and wait for reads and decodes in flight.
+void ShutdownAssetLoader();
+
+// Queue a load. Either function may be empty to skip its stage.
+AssetHandle LoadAsset(const wchar_t* path, int priority, AssetDecodeFunction decode, AssetUploadFunction upload);
+// Queue a load of size bytes at offset instead of the whole file. The read fails if the file is shorter.
+AssetHandle LoadAssetRange(const wchar_t* path, uint64_t offset, uint64_t size, int priority, AssetDecodeFunction decode, AssetUploadFunction upload);
+void SetAssetPriority(AssetHandle asset, int priority);
+// A cancelled asset never reaches its upload. Reads and decodes already running finish and are discarded.
+void CancelAsset(AssetHandle asset);
+AssetState GetAssetState(AssetHandle asset);
+// Forget the asset; a request still in flight is cancelled first. The handle becomes invalid.
+void ReleaseAsset(AssetHandle asset);
+
+// Run pending uploads on the main thread for up to budgetMs. Returns the number of uploads run.
+UINT UpdateAssetLoader(ID3D11Device* device, ID3D11DeviceContext* deviceContext, double budgetMs = ASSET_UPLOAD_BUDGET_MS);
+// Update without a budget until no request is queued, reading or decoding.
+void FlushAssetLoader(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+
+struct AssetLoaderStats
+{
+    UINT Pending;
+    UINT Loaded;
+    UINT Failed;
+    UINT Cancelled;
+    uint64_t BytesRead;
+    double ReadTimeMs;
+    double DecodeTimeMs;
+    double UploadTimeMs;
+};
+
+// Totals since the loader started. Read, decode and upload times are summed over all threads.
+void GetAssetLoaderStats(AssetLoaderStats& stats);
@@ -0,0 +1,58 @@
+#pragma once
+#include "Frustum.h"
+
+// Bounding volume hierarchy over scene object bounds.
+// The tree is built top-down with a binned SAH split and then collapsed into
+// 4-wide nodes, so traversal tests all children of a node at once with
+// DirectXMath vector instructions.
+
+const UINT BVH_WIDTH = 4;
+const UINT BVH_MAX_LEAF_SIZE = 4;
+const UINT BVH_INVALID_INDEX = 0xFFFFFFFF;
+
+struct BVHNode
+{
+    // Child bounds in SoA layout: each XMFLOAT4 holds one axis for all four children.
+    DirectX::XMFLOAT4 MinX, MinY, MinZ;
+    DirectX::XMFLOAT4 MaxX, MaxY, MaxZ;
+    // Index of the child node, or BVH_INVALID_INDEX for a leaf slot.
+    UINT Child[BVH_WIDTH];
+    // Range in BVH::Objects covered by the slot's subtree. Count is 0 for an empty slot.
+    UINT First[BVH_WIDTH];
+    UINT Count[BVH_WIDTH];
+    // Parent node and the slot in it that points at this node.
+    UINT Parent;
+    UINT ParentSlot;
+};
+
+struct BVH
+{
+    // A child node always has a higher index than its parent.
+    std::vector<BVHNode> Nodes;
+    // Object indices ordered so that every subtree covers a contiguous range.
+    std::vector<UINT> Objects;
+    // Leaf node holding each object, used by incremental refits.
+    std::vector<UINT> ObjectNode;
+
+    // Scratch space reused by RefitBVH so per frame refits do not allocate.
+    std::vector<UINT> DirtyNodes;
+    std::vector<BYTE> DirtyFlags;
+};
+
+// Build the hierarchy over count object bounds. Object i is referred to by index i in query results.
+void BuildBVH(BVH& bvh, const DirectX::BoundingBox* bounds, UINT count);
+
+// Recompute every node's bounds after objects moved. The topology is left unchanged.
+void RefitBVH(BVH& bvh, const DirectX::BoundingBox* bounds);
+
+// Recompute only the nodes above the moved objects.
+void RefitBVH(BVH& bvh, const DirectX::BoundingBox* bounds, const UINT* movedObjects, UINT movedCount);
+
+// Append the indices of all objects whose bounds intersect the frustum.
+void CullBVH(const BVH& bvh, const DirectX::BoundingBox* bounds, const Frustum& frustum, std::vector<UINT>& visibleObjects);
+
+// Find the closest object whose bounds are hit by the ray. The direction must be normalized.
+bool RaycastBVH(const BVH& bvh, const DirectX::BoundingBox* bounds, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, UINT& hitObject, float& hitDistance);
+
+// Append the indices of all objects whose bounds contain the point.
+void QueryBVHPoint(const BVH& bvh, const DirectX::BoundingBox* bounds, DirectX::FXMVECTOR point, std::vector<UINT>& results);
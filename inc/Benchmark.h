@@ -0,0 +1,69 @@
+#pragma once
+#include "FrameStats.h"
+#include "RenderCounters.h"
+
+// Headless performance benchmarks.
+// A benchmark scene runs its CPU work and counts what it would submit with
+// RenderCounters.h, so it needs neither a GPU nor a window, and times its
+// frames on the GPU timer's software backend in place of a device. Frame
+// times go into an HdrHistogram and the counters of the last frame are kept,
+// since a scene submits the same work every frame. The results are compared
+// metric by metric with a baseline JSON file: a median time regresses when it
+// is slower than the baseline by more than both the threshold and a small
+// absolute floor, below which a scene that takes microseconds only measures
+// the timer, and a counter regresses whenever it exceeds the baseline, as
+// counters do not vary from run to run. Tail times are recorded alongside but
+// are too noisy on shared machines to fail a run. Times only compare on the
+// machine that recorded them, so each machine keeps its own baseline; the
+// EchoEngineBenchmark executable writes one only with --update, the first
+// time and after an intended change. With --counts-only it compares and
+// writes the counters alone, which is what the shared baseline holds. A baseline metric the run no longer
+// produces fails the comparison, so a scene cannot drop out unnoticed.
+
+const float BENCHMARK_DEFAULT_THRESHOLD_PERCENT = 15.0f;
+const double BENCHMARK_MIN_REGRESSION_MS = 0.001;
+
+enum BenchmarkMetricKind {
+    BMK_Time, //milliseconds, compared against the threshold
+    BMK_Count, //exact, any increase regresses
+    BMK_Info //recorded only
+};
+
+struct BenchmarkMetric
+{
+    // "scene.metric".
+    std::string Name;
+    BenchmarkMetricKind Kind;
+    double Value;
+};
+
+// Scene of a metric named "scene.name".
+std::string GetBenchmarkScene(const BenchmarkMetric& metric);
+// Append one metric named "scene.name".
+void AddBenchmarkMetric(std::vector<BenchmarkMetric>& metrics, const char* scene, const char* name, double value, BenchmarkMetricKind kind = BMK_Count);
+// Append the median, 95th percentile and maximum of frame times recorded in nanoseconds.
+void AddBenchmarkTimes(std::vector<BenchmarkMetric>& metrics, const char* scene, const HdrHistogram& nanoseconds);
+// Append the draw, triangle, bind and upload counters.
+void AddBenchmarkCounters(std::vector<BenchmarkMetric>& metrics, const char* scene, const RenderCounters& counters);
+
+// Baselines are a flat JSON object of metric names to values. Read metrics are BMK_Info; comparisons go by the kind of
+// the metric just measured.
+bool WriteBenchmarkBaseline(const wchar_t* path, const std::vector<BenchmarkMetric>& metrics);
+bool ReadBenchmarkBaseline(const wchar_t* path, std::vector<BenchmarkMetric>& metrics);
+
+struct BenchmarkComparison
+{
+    // Null for baseline metrics the run did not produce, which count as regressed.
+    const BenchmarkMetric* Metric;
+    // Null for metrics the baseline does not have yet.
+    const BenchmarkMetric* Baseline;
+    // Relative to the baseline, positive when slower or more.
+    double ChangePercent;
+    bool Regressed;
+};
+
+// Compare every metric with the baseline's metric of the same name, then list the baseline metrics that are missing.
+// Returns the number that regressed or are missing.
+UINT CompareBenchmarkMetrics(const std::vector<BenchmarkMetric>& baseline, const std::vector<BenchmarkMetric>& metrics, float thresholdPercent,
+    std::vector<BenchmarkComparison>& comparisons);
+void PrintBenchmarkComparisons(FILE* file, const std::vector<BenchmarkComparison>& comparisons);
@@ -0,0 +1,88 @@
+#pragma once
+
+// Immediate mode debug drawing.
+// Lines, boxes, spheres and frusta are queued from any thread during the
+// frame. Every thread appends to a buffer of its own, registered the first
+// time it draws, so queuing takes no lock. FlushDebugDraw copies all the
+// buffers into one transient vertex buffer, mapped with discard, and draws
+// the frame's primitives as a single line list through SimpleVertexShader:
+// world space positions with an identity world matrix, and the color read
+// from packed bytes by the debug input layout. Drawing can be switched off
+// at run time, which costs one branch per call, or compiled out by building
+// with DEBUG_DRAW_ENABLED set to 0, which leaves empty inline functions
+// that the compiler removes entirely.
+
+#ifndef DEBUG_DRAW_ENABLED
+#define DEBUG_DRAW_ENABLED 1
+#endif
+
+// Segments of the circles that make up a sphere.
+const UINT DEBUG_DRAW_CIRCLE_SEGMENTS = 32;
+
+struct DebugVertex
+{
+    DirectX::XMFLOAT3 Position;
+    // RGBA8, red in the low byte.
+    uint32_t Color;
+};
+
+struct DebugDrawStats
+{
+    UINT Lines;
+    // Threads that queued anything this frame.
+    UINT Threads;
+    UINT Draws;
+    double MergeTimeMs;
+};
+
+#if DEBUG_DRAW_ENABLED
+
+// Create the input layout for the vertex shader's bytecode.
+bool InitDebugDraw(ID3D11Device* device, const void* vertexShaderBytecode, size_t vertexShaderSize);
+// Release the vertex buffer and every thread's buffer. Nothing may be drawing.
+void ShutdownDebugDraw();
+
+void SetDebugDrawEnabled(bool enabled);
+bool IsDebugDrawEnabled();
+
+void DebugDrawLine(DirectX::FXMVECTOR from, DirectX::FXMVECTOR to, DirectX::FXMVECTOR color);
+void DebugDrawBox(const DirectX::BoundingBox& box, DirectX::FXMVECTOR color);
+// The cube from -1 to 1 transformed by the matrix, which covers oriented boxes.
+void DebugDrawBox(DirectX::FXMMATRIX matrix, DirectX::FXMVECTOR color);
+// Three circles around the center, one in each axis plane.
+void DebugDrawSphere(const DirectX::BoundingSphere& sphere, DirectX::FXMVECTOR color);
+// The volume the view projection matrix maps to the clip space cube.
+void DebugDrawFrustum(DirectX::FXMMATRIX viewProjection, DirectX::FXMVECTOR color);
+// The matrix's X, Y and Z axes in red, green and blue, size units long.
+void DebugDrawAxes(DirectX::FXMMATRIX matrix, float size);
+
+// Draw everything queued since the last flush and empty the buffers. Call from the main thread with no other
+// thread drawing, with the simple shaders bound and the identity in the object constant buffer.
+bool FlushDebugDraw(ID3D11Device* device, ID3D11DeviceContext* deviceContext, DebugDrawStats& stats);
+
+// Vertices queued since the last merge, two per line, and how many threads queued them.
+UINT GetDebugDrawVertexCount(UINT& threads);
+// Copy every thread's vertices, in the order the threads registered, to vertices, which has room for
+// GetDebugDrawVertexCount of them, and empty the buffers. A null destination drops the lines.
+void MergeDebugDraw(DebugVertex* vertices);
+// Drop every thread's buffer; each thread registers a new one the next time it draws.
+void ReleaseDebugDrawBuffers();
+
+#else
+
+inline bool InitDebugDraw(ID3D11Device*, const void*, size_t) { return true; }
+inline void ShutdownDebugDraw() {}
+inline void SetDebugDrawEnabled(bool) {}
+inline bool IsDebugDrawEnabled() { return false; }
+inline void DebugDrawLine(DirectX::FXMVECTOR, DirectX::FXMVECTOR, DirectX::FXMVECTOR) {}
+inline void DebugDrawBox(const DirectX::BoundingBox&, DirectX::FXMVECTOR) {}
+inline void DebugDrawBox(DirectX::FXMMATRIX, DirectX::FXMVECTOR) {}
+inline void DebugDrawSphere(const DirectX::BoundingSphere&, DirectX::FXMVECTOR) {}
+inline void DebugDrawFrustum(DirectX::FXMMATRIX, DirectX::FXMVECTOR) {}
+inline void DebugDrawAxes(DirectX::FXMMATRIX, float) {}
+inline bool FlushDebugDraw(ID3D11Device*, ID3D11DeviceContext*, DebugDrawStats& stats) { stats = DebugDrawStats(); return true; }
+inline UINT GetDebugDrawVertexCount(UINT& threads) { threads = 0; return 0; }
+inline void MergeDebugDraw(DebugVertex*) {}
+inline void ReleaseDebugDrawBuffers() {}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+// Platform-neutral includes and types.
+// Modules that only do CPU work include this header instead of the
+// precompiled EchoEnginePCH.h, which adds Windows and Direct3D 11 on top of
+// it, so they build on every platform DirectXMath supports: the engine on
+// Windows, and the headless benchmark and tests anywhere else. The Direct3D
+// objects they pass through without using are only declared.
+
+// System includes
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdint>
+typedef unsigned int UINT;
+typedef int INT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef float FLOAT;
+typedef uint64_t UINT64;
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#endif
+
+// DirectX math includes
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <DirectXColors.h>
+#include <DirectXCollision.h>
+
+// STL includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// Milliseconds on the steady clock since start.
+inline double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A color saturated and packed to RGBA8, red in the low byte, as vertex colors store it.
+inline uint32_t PackColor(DirectX::FXMVECTOR color) {
+    DirectX::XMFLOAT4 bytes;
+    DirectX::XMStoreFloat4(&bytes, DirectX::XMVectorRound(DirectX::XMVectorScale(DirectX::XMVectorSaturate(color), 255.0f)));
+    return static_cast<uint32_t>(bytes.x) | static_cast<uint32_t>(bytes.y) << 8 | static_cast<uint32_t>(bytes.z) << 16 |
+        static_cast<uint32_t>(bytes.w) << 24;
+}
+
+// Direct3D 11 objects, defined by d3d11.h
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Buffer;
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
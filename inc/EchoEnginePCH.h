@@ -5,12 +5,9 @@
 // DirectX includes
 #include <d3d11.h>
 #include <d3dcompiler.h>
-#include <DirectXMath.h>
-#include <DirectXColors.h>
 
-// STL includes
-#include <iostream>
-#include <string>
+// DirectX math and STL includes
+#include "EchoEngineCore.h"
 
 // Link library dependencies
 #pragma comment(lib, "d3d11.lib")
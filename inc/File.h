@@ -0,0 +1,74 @@
+#pragma once
+
+// Read-only memory mapping of a whole file.
+struct MappedFile
+{
+    const BYTE* Data = nullptr;
+    uint64_t Size = 0;
+    // Owns the bytes instead of a mapping when the file was read into memory.
+    std::vector<BYTE> Memory;
+#ifdef _WIN32
+    HANDLE File = INVALID_HANDLE_VALUE;
+    HANDLE Mapping = nullptr;
+#else
+    int Descriptor = -1;
+#endif
+};
+
+bool OpenMappedFile(MappedFile& file, const wchar_t* path);
+// Wrap bytes that were already read into memory. The contents of data move into the file.
+bool OpenMemoryFile(MappedFile& file, std::vector<BYTE>& data);
+void CloseMappedFile(MappedFile& file);
+
+// How a file is going to be read, passed on to the OS so it can size its read-ahead.
+enum FileAccess {
+    FA_Normal,
+    // Front to back once; the OS reads further ahead.
+    FA_Sequential,
+    // Scattered reads; the OS skips read-ahead.
+    FA_Random
+};
+
+// File opened for blocking reads at any offset.
+struct ReadOnlyFile
+{
+    uint64_t Size = 0;
+#ifdef _WIN32
+    HANDLE File = INVALID_HANDLE_VALUE;
+#else
+    int Descriptor = -1;
+#endif
+};
+
+bool OpenReadOnlyFile(ReadOnlyFile& file, const wchar_t* path, FileAccess access = FA_Normal);
+void CloseReadOnlyFile(ReadOnlyFile& file);
+// Fails unless all size bytes are read.
+bool ReadFileAt(const ReadOnlyFile& file, uint64_t offset, void* data, uint64_t size);
+
+// Read a whole file with plain blocking reads.
+bool ReadWholeFile(const wchar_t* path, std::vector<BYTE>& data);
+
+bool FileExists(const wchar_t* path);
+bool RemoveFile(const wchar_t* path);
+// Have the OS start reading the file into its cache without waiting for it. Windows has no such hint for
+// unopened files, so there it only checks the file exists. Returns false when it does not.
+bool PrefetchFile(const wchar_t* path);
+
+// Pass the access pattern of a range of a mapping on to the OS, or have it start paging the range in.
+void AdviseMappedFile(const MappedFile& file, uint64_t offset, uint64_t size, FileAccess access);
+void PrefetchMappedFile(const MappedFile& file, uint64_t offset, uint64_t size);
+
+// fopen with a wide path on every platform.
+FILE* OpenFile(const wchar_t* path, const char* mode);
+
+// Whether path ends in extension, given in lower case with its dot; ASCII letters in path match either case.
+bool HasExtension(const wchar_t* path, const wchar_t* extension);
+
+// Offset rounded up to the next multiple of alignment, a power of two.
+inline uint64_t AlignFileOffset(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+// Whether size bytes at offset lie inside a file of fileSize bytes, with offset a multiple of alignment.
+bool IsFileRangeValid(uint64_t fileSize, uint64_t offset, uint64_t size, uint64_t alignment = 1);
+// Write zeros up to the next multiple of alignment and move offset there.
+bool WriteFilePadding(FILE* file, uint64_t& offset, uint64_t alignment);
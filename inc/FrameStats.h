@@ -0,0 +1,99 @@
+#pragma once
+
+// Frame statistics.
+// Every frame's time, its CPU split between update, render and present, its
+// draw count and the bytes it uploaded are recorded into high dynamic range
+// histograms, so percentiles come out of a fixed amount of memory however
+// long the run. Values are binned like small floats, HDR_HISTOGRAM_MANTISSA_BITS
+// of mantissa below an exponent, which keeps every bin within 1% of the
+// values it holds from a microsecond up to hours. A frame stutters when it
+// takes FRAME_STATS_STUTTER_FACTOR times the median of the
+// FRAME_STATS_STUTTER_WINDOW frames before it and at least
+// FRAME_STATS_STUTTER_MIN_MS longer. Summaries can be written as CSV, one
+// row per metric, or as JSON with the stutters listed as well.
+
+const UINT HDR_HISTOGRAM_MANTISSA_BITS = 7;
+// Frames the stutter median is taken over.
+const UINT FRAME_STATS_STUTTER_WINDOW = 64;
+const float FRAME_STATS_STUTTER_FACTOR = 2.0f;
+const float FRAME_STATS_STUTTER_MIN_MS = 4.0f;
+// Stutters kept for export. Any past this are counted but not listed.
+const UINT FRAME_STATS_MAX_STUTTERS = 1024;
+
+struct HdrHistogram
+{
+    std::vector<uint32_t> Counts;
+    uint64_t TotalCount = 0;
+    uint64_t Min = 0;
+    uint64_t Max = 0;
+    double Sum = 0.0;
+};
+
+void RecordHdrValue(HdrHistogram& histogram, uint64_t value);
+void ResetHdrHistogram(HdrHistogram& histogram);
+// Smallest recorded value that percent of the values are at or below, to within its bin. 0 when empty.
+uint64_t GetHdrPercentile(const HdrHistogram& histogram, double percent);
+
+enum FrameMetric {
+    FM_FrameTime,
+    FM_UpdateTime,
+    FM_RenderTime,
+    FM_PresentTime,
+    FM_Draws,
+    FM_UploadBytes,
+    NumFrameMetrics
+};
+
+struct FrameSample
+{
+    // Wall time from the start of this frame to the start of the next.
+    double FrameMs;
+    double UpdateMs;
+    // Render without present.
+    double RenderMs;
+    double PresentMs;
+    UINT Draws;
+    uint64_t UploadBytes;
+};
+
+struct FrameStutter
+{
+    UINT Frame;
+    double FrameMs;
+    // Median of the frames before it.
+    double MedianMs;
+};
+
+struct FrameStats
+{
+    // Times are held in microseconds.
+    HdrHistogram Metrics[NumFrameMetrics];
+    UINT Frames = 0;
+    // Times of the latest frames, oldest overwritten first.
+    float RecentFrameMs[FRAME_STATS_STUTTER_WINDOW] = {};
+    UINT Stutters = 0;
+    std::vector<FrameStutter> StutterList;
+};
+
+struct FrameMetricSummary
+{
+    const char* Name;
+    // "ms", "draws" or "bytes".
+    const char* Unit;
+    uint64_t Count;
+    double Min;
+    double Mean;
+    double P50;
+    double P95;
+    double P99;
+    double Max;
+};
+
+void ResetFrameStats(FrameStats& stats);
+// Returns true if the frame stuttered.
+bool RecordFrame(FrameStats& stats, const FrameSample& sample);
+
+void GetFrameMetricSummary(const FrameStats& stats, FrameMetric metric, FrameMetricSummary& summary);
+
+bool WriteFrameStatsCsv(const FrameStats& stats, const wchar_t* path);
+bool WriteFrameStatsJson(const FrameStats& stats, const wchar_t* path);
@@ -0,0 +1,29 @@
+#pragma once
+
+// View frustum as six world space planes (ax + by + cz + d >= 0 is inside).
+enum FrustumPlane {
+    FP_Left,
+    FP_Right,
+    FP_Bottom,
+    FP_Top,
+    FP_Near,
+    FP_Far,
+    NumFrustumPlanes
+};
+
+struct Frustum
+{
+    DirectX::XMFLOAT4 Planes[NumFrustumPlanes];
+};
+
+// Extract the planes of a (row vector) view * projection matrix.
+void ExtractFrustum(Frustum& frustum, DirectX::FXMMATRIX viewProjection);
+
+// Returns DISJOINT, INTERSECTS or CONTAINS for an axis aligned box.
+DirectX::ContainmentType TestFrustumBox(const Frustum& frustum, const DirectX::BoundingBox& box);
+
+// Returns DISJOINT, INTERSECTS or CONTAINS for a sphere.
+DirectX::ContainmentType TestFrustumSphere(const Frustum& frustum, const DirectX::BoundingSphere& sphere);
+
+// World space axis aligned box around the frustum's eight corners.
+void ComputeFrustumBounds(const Frustum& frustum, DirectX::BoundingBox& bounds);
@@ -0,0 +1,75 @@
+#pragma once
+#include "MeshFile.h"
+#include "OffsetAllocator.h"
+
+// Shared vertex and index arenas for all meshes.
+// Every vertex format and index size has one large buffer whose ranges are
+// suballocated, in elements, by an OffsetAllocator. Meshes keep allocation
+// handles and draw with baseVertexLocation and startIndexLocation pointing into
+// the arena, so meshes of the same format share one binding. A full arena is
+// grown by copying it into a larger buffer; defragmentation packs the live
+// ranges into a fresh buffer.
+
+// Initial arena sizes, in elements.
+const UINT GEOMETRY_VERTEX_ARENA_SIZE = 1 << 20;
+const UINT GEOMETRY_INDEX_ARENA_SIZE = 1 << 22;
+// 16-bit and 32-bit index arenas.
+const UINT GEOMETRY_INDEX_SIZE_COUNT = 2;
+// Arenas with more of their free space outside the largest free range than this percentage get defragmented.
+const float GEOMETRY_DEFRAGMENT_THRESHOLD = 25.0f;
+
+struct GeometryArena
+{
+    ID3D11Buffer* Buffer = nullptr;
+    OffsetAllocator Allocator;
+    UINT ElementSize = 0;
+    UINT BindFlags = 0;
+};
+
+struct GeometryBuffer
+{
+    GeometryArena VertexArenas[NumMeshVertexFormats];
+    GeometryArena IndexArenas[GEOMETRY_INDEX_SIZE_COUNT];
+};
+
+// Vertex and index ranges of one mesh.
+struct GeometryAllocation
+{
+    MeshVertexFormat VertexFormat = MVF_PositionColor;
+    // Bytes per index: 2 or 4.
+    UINT IndexSize = 0;
+    uint32_t VertexAllocation = OFFSET_ALLOCATION_NONE;
+    uint32_t IndexAllocation = OFFSET_ALLOCATION_NONE;
+};
+
+void InitGeometryBuffer(GeometryBuffer& geometry);
+void ReleaseGeometryBuffer(GeometryBuffer& geometry);
+
+// Allocate ranges for the vertices and indices and upload them. Arenas are created or grown as needed.
+// Fails for zero vertices or indices.
+bool AllocateGeometry(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, MeshVertexFormat vertexFormat, UINT vertexCount,
+    const void* vertices, UINT indexSize, UINT indexCount, const void* indices, GeometryAllocation& allocation);
+void FreeGeometry(GeometryBuffer& geometry, GeometryAllocation& allocation);
+
+// Where the allocation starts in its arenas. Both can change when the arenas are defragmented.
+UINT GetGeometryBaseVertex(const GeometryBuffer& geometry, const GeometryAllocation& allocation);
+UINT GetGeometryStartIndex(const GeometryBuffer& geometry, const GeometryAllocation& allocation);
+
+// Bind the arena of a vertex format to slot 0, or the arena of an index size.
+void BindGeometryVertexBuffer(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, MeshVertexFormat vertexFormat);
+void BindGeometryIndexBuffer(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, UINT indexSize);
+
+struct GeometryDefragmentStats
+{
+    UINT ArenasDefragmented;
+    UINT AllocationsMoved;
+    uint64_t BytesCopied;
+    double TimeMs;
+};
+
+// Pack every arena whose fragmentation exceeds thresholdPercent. Arena buffers are replaced, so bind them again afterwards.
+bool DefragmentGeometryBuffer(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, float thresholdPercent,
+    GeometryDefragmentStats* stats = nullptr);
+
+// Size, usage and fragmentation of every arena that has a buffer.
+void PrintGeometryBufferReport(FILE* file, const GeometryBuffer& geometry);
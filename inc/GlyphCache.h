@@ -0,0 +1,116 @@
+#pragma once
+#include "RectPacker.h"
+#include "Sprite.h"
+#include "Texture.h"
+
+// Glyph cache and text layout.
+// Glyphs are rasterized the first time a string uses them and packed into
+// one atlas texture with the skyline packer. The atlas is RGBA8, white with
+// the glyph's coverage in alpha, so text draws through the sprite batch with
+// the sprite shaders and a page of text is a single draw. Glyphs already
+// laid out in a frame must not move, so when a new glyph no longer fits it
+// is skipped for that frame and the next BeginGlyphCacheFrame evicts the
+// least recently used glyphs and repacks the rest. Layout is shaping free:
+// UTF-8 is decoded to code points, ASCII goes through a direct table and
+// everything else through a hash map, and the pen advances by each glyph's
+// advance with no kerning. Rasterizing goes through a GlyphRasterizer, so
+// the cache and layout also run without a device or a font.
+
+const UINT GLYPH_NONE = 0xFFFFFFFF;
+const UINT GLYPH_CACHE_DEFAULT_SIZE = 512;
+const uint32_t GLYPH_REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Coverage of one glyph, rows of one byte per texel with no padding. Offsets go from the pen
+// position on the baseline to the bitmap's top left, y down.
+struct GlyphBitmap
+{
+    UINT Width;
+    UINT Height;
+    int OffsetX;
+    int OffsetY;
+    float Advance;
+    std::vector<BYTE> Coverage;
+};
+
+struct GlyphFontMetrics
+{
+    // Distance from the top of a line to its baseline, and from one line's top to the next.
+    float Ascent;
+    float LineHeight;
+};
+
+// Fill in a glyph's bitmap. Returns false if the font has nothing for the code point.
+typedef std::function<bool(uint32_t codepoint, GlyphBitmap& glyph)> GlyphRasterizer;
+
+struct CachedGlyph
+{
+    uint32_t Codepoint;
+    // Bitmap in the atlas, without its padding.
+    UINT X;
+    UINT Y;
+    UINT Width;
+    UINT Height;
+    int OffsetX;
+    int OffsetY;
+    float Advance;
+    DirectX::XMFLOAT4 TexCoords;
+    UINT LastUsedFrame;
+};
+
+struct GlyphCacheStats
+{
+    UINT Glyphs;
+    UINT Hits;
+    UINT Misses;
+    // Glyphs left out of a frame because the atlas was full.
+    UINT DroppedGlyphs;
+    UINT Evictions;
+    UINT Repacks;
+    double RasterizeTimeMs;
+};
+
+struct GlyphCache
+{
+    UINT Size = 0;
+    GlyphRasterizer Rasterize;
+    GlyphFontMetrics Metrics = {};
+    RectPacker Packer;
+    std::vector<CachedGlyph> Glyphs;
+    UINT AsciiGlyphs[128];
+    std::unordered_map<uint32_t, UINT> Lookup;
+    // Coverage of the whole atlas, kept to repack and to upload changed areas.
+    std::vector<BYTE> Coverage;
+    // Area changed since the last upload.
+    UINT DirtyLeft = 0;
+    UINT DirtyTop = 0;
+    UINT DirtyRight = 0;
+    UINT DirtyBottom = 0;
+    bool RepackPending = false;
+    UINT Frame = 0;
+    // Null without a device.
+    Texture Atlas;
+    GlyphBitmap Bitmap;
+    std::vector<BYTE> UploadTexels;
+    GlyphCacheStats Stats = {};
+};
+
+// Set up an empty cache of size texels a side, without touching its atlas texture.
+void InitGlyphCache(GlyphCache& cache, UINT size, const GlyphRasterizer& rasterizer, const GlyphFontMetrics& metrics);
+// Forget every glyph and the rasterizer, leaving the atlas texture alone.
+void ResetGlyphCache(GlyphCache& cache);
+
+// Start a frame: evict and repack if a glyph did not fit during the last one. Call before any layout.
+void BeginGlyphCacheFrame(GlyphCache& cache);
+
+// Cached glyph of the code point, rasterizing it on a miss. GLYPH_NONE if it does not fit this frame.
+UINT FindGlyph(GlyphCache& cache, uint32_t codepoint);
+
+// Lay out UTF-8 text with (x, y) the top left of its first line; '\n' starts a new line. Writes at most
+// maxSprites sprites and returns how many the text needs. extent receives the width and height of the text.
+UINT LayoutText(GlyphCache& cache, const char* text, float x, float y, uint32_t color, UINT atlas, Sprite* sprites, UINT maxSprites,
+    DirectX::XMFLOAT2* extent = nullptr);
+
+void GetGlyphCacheStats(const GlyphCache& cache, GlyphCacheStats& stats);
+
+// Share of glyph lookups that found the glyph cached, from 0 to 100.
+float GetGlyphCacheHitPercent(const GlyphCacheStats& stats);
@@ -0,0 +1,21 @@
+#pragma once
+#include "GlyphCache.h"
+#include "SpriteBatch.h"
+
+// Glyph cache atlas texture, GDI rasterizer and text drawing.
+// The cache keeps its coverage on the CPU; the atlas texture is created with
+// it and receives the area that changed once per frame.
+
+// Rasterizer backed by a GDI font of the given face and height in pixels. Returns an empty function on failure.
+GlyphRasterizer CreateGdiGlyphRasterizer(const wchar_t* faceName, int pixelHeight, GlyphFontMetrics& metrics);
+
+// Create an empty cache with an atlas of size texels a side. The device may be null, in which case
+// only layout runs.
+bool CreateGlyphCache(ID3D11Device* device, UINT size, const GlyphRasterizer& rasterizer, const GlyphFontMetrics& metrics, GlyphCache& cache);
+void ReleaseGlyphCache(GlyphCache& cache);
+
+// Copy the part of the atlas that changed to the texture. Call after layout and before the sprites draw.
+void UploadGlyphCache(ID3D11DeviceContext* deviceContext, GlyphCache& cache);
+
+// Queue text with the cache's atlas bound to the given atlas slot of the batch.
+void DrawString(SpriteBatch& batch, GlyphCache& cache, UINT atlas, float x, float y, const char* text, uint32_t color);
@@ -0,0 +1,132 @@
+#pragma once
+#include "Profiler.h"
+
+// GPU timing of render passes.
+// Each frame brackets itself and its passes with timestamps written through a
+// GpuTimerBackend, a table of functions, so the timer itself knows nothing of
+// the API underneath. The D3D11 backend issues timestamp queries inside a
+// disjoint query per frame. Results are read back GPU_TIMER_FRAME_LATENCY
+// frames later without flushing or waiting: a frame whose queries are not
+// ready yet is polled again on the next one, and if its slot is still busy
+// when the ring comes round the new frame goes untimed rather than stalling.
+// The software backend reads the CPU clock as timestamps are written, which
+// is exact for backends that execute work as it is submitted and lets the
+// readback, aggregation and export run without a GPU. Resolved passes go to
+// the timer's Timings and, during a profiler capture, to a GPU track placed
+// at the CPU time their frame began.
+
+const UINT GPU_TIMER_FRAME_LATENCY = 4;
+const UINT GPU_TIMER_MAX_PASSES = 32;
+// Timestamps of one frame: its begin and end, then the begin and end of every pass.
+const UINT GPU_TIMER_MAX_TIMESTAMPS = 2 + GPU_TIMER_MAX_PASSES * 2;
+const UINT GPU_TIMER_NO_PASS = 0xFFFFFFFF;
+
+enum GpuTimestampResult {
+    GTR_Ready,
+    // The GPU has not reached the frame's last timestamp yet.
+    GTR_Pending,
+    // The clock changed frequency or was interrupted during the frame, so its timestamps are unusable.
+    GTR_Disjoint
+};
+
+struct GpuTimerBackend
+{
+    // Open and close the frame timed in a slot of the ring.
+    std::function<void(UINT slot)> BeginFrame;
+    std::function<void(UINT slot)> EndFrame;
+    // Take timestamp index of the slot when the GPU gets to this point.
+    std::function<void(UINT slot, UINT index)> WriteTimestamp;
+    // Read the slot's first count timestamps and their ticks per second without waiting.
+    std::function<GpuTimestampResult(UINT slot, UINT count, uint64_t* timestamps, uint64_t& frequency)> ReadTimestamps;
+};
+
+// Backend of D3D11 timestamp and disjoint queries. Returns an empty backend on failure.
+GpuTimerBackend CreateD3D11GpuTimerBackend(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+// Backend that reads the CPU clock when a timestamp is written, for headless and software rendering.
+GpuTimerBackend CreateSoftwareGpuTimerBackend();
+
+struct GpuPassTiming
+{
+    const char* Name;
+    // Passes open around this one.
+    UINT Depth;
+    // From the start of the frame.
+    double StartMs;
+    double DurationMs;
+};
+
+struct GpuTimerStats
+{
+    UINT ResolvedFrames;
+    // Frames left untimed because their slot was still waiting on the GPU.
+    UINT SkippedFrames;
+    UINT DisjointFrames;
+    // Passes past GPU_TIMER_MAX_PASSES in a frame.
+    UINT DroppedPasses;
+    // GPU time of the most recently resolved frame.
+    double FrameMs;
+};
+
+struct GpuTimerPass
+{
+    const char* Name;
+    UINT Depth;
+    bool Ended;
+};
+
+struct GpuTimerSlot
+{
+    std::vector<GpuTimerPass> Passes;
+    // Profiler clock reading when the frame began.
+    uint64_t CpuStart = 0;
+    bool Pending = false;
+};
+
+struct GpuTimer
+{
+    GpuTimerBackend Backend;
+    GpuTimerSlot Slots[GPU_TIMER_FRAME_LATENCY];
+    UINT Frame = 0;
+    // Slot of the frame being recorded, GPU_TIMER_NO_PASS if it is not timed.
+    UINT CurrentSlot = GPU_TIMER_NO_PASS;
+    UINT Depth = 0;
+    UINT ProfilerTrack = 0;
+    // Passes of the most recently resolved frame in the order they began.
+    std::vector<GpuPassTiming> Timings;
+    std::vector<uint64_t> Timestamps;
+    GpuTimerStats Stats = {};
+};
+
+void InitGpuTimer(GpuTimer& timer, const GpuTimerBackend& backend);
+// Release the backend. Its queries are dropped unread.
+void ReleaseGpuTimer(GpuTimer& timer);
+
+// Read back every finished frame, then start timing this one. Call once per frame before any pass.
+void BeginGpuTimerFrame(GpuTimer& timer);
+// Close the frame, and any pass left open, before Present.
+void EndGpuTimerFrame(GpuTimer& timer);
+
+// Returns GPU_TIMER_NO_PASS if the frame is not timed or has no room for another pass.
+UINT BeginGpuPass(GpuTimer& timer, const char* name);
+void EndGpuPass(GpuTimer& timer, UINT pass);
+
+// Time of the named pass in the most recently resolved frame, 0 if it had none.
+double GetGpuPassMs(const GpuTimer& timer, const char* name);
+
+struct GpuPassZone
+{
+    GpuPassZone(GpuTimer& timer, const char* name)
+        : Timer(timer), Pass(BeginGpuPass(timer, name)) {
+    }
+    ~GpuPassZone() {
+        EndGpuPass(Timer, Pass);
+    }
+    GpuPassZone(const GpuPassZone&) = delete;
+    GpuPassZone& operator=(const GpuPassZone&) = delete;
+
+    GpuTimer& Timer;
+    UINT Pass;
+};
+
+// Time the rest of the scope on the GPU and, as a CPU zone of the same name, the commands that submit it.
+#define PROFILE_GPU_ZONE(timer, name) PROFILE_ZONE(name); GpuPassZone PROFILE_ZONE_CONCAT(gpuPassZone, __LINE__)(timer, name)
@@ -0,0 +1,24 @@
+#pragma once
+
+// Fixed pool of worker threads that run jobs pushed from any thread.
+
+// Tracks a group of jobs so the caller can wait for all of them.
+struct JobCounter
+{
+    std::atomic<UINT> Pending{ 0 };
+};
+
+// Start the workers. A thread count of 0 uses one thread per hardware core minus the main thread.
+void InitJobSystem(UINT threadCount = 0);
+void ShutdownJobSystem();
+UINT GetWorkerCount();
+
+// Queue a job; the counter is incremented now and decremented when the job finishes.
+void RunJob(JobCounter& counter, std::function<void()> job);
+
+// Block until the counter reaches zero, running queued jobs on this thread meanwhile.
+void WaitForCounter(JobCounter& counter);
+
+// Split [0, count) into batches of batchSize and run body(begin, end) for each on the workers.
+// The calling thread takes part and the call returns once every batch is done.
+void ParallelFor(UINT count, UINT batchSize, const std::function<void(UINT, UINT)>& body);
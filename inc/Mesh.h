@@ -0,0 +1,34 @@
+#pragma once
+#include "MeshFile.h"
+#include "GeometryBuffer.h"
+
+// One mesh of a MeshFile, resident in the shared geometry arenas.
+struct Mesh
+{
+    GeometryAllocation Geometry;
+    MeshVertexFormat VertexFormat = MVF_PositionColor;
+    UINT VertexStride = 0;
+    UINT VertexCount = 0;
+    UINT IndexCount = 0;
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_UNKNOWN;
+    std::vector<MeshFileSubmesh> Submeshes;
+    DirectX::BoundingBox Bounds;
+    DirectX::XMFLOAT3 PositionScale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+    DirectX::XMFLOAT3 PositionBias = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+};
+
+// Upload the mapped vertex and index payloads into the geometry arenas.
+bool CreateMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, const MeshFile& meshFile, UINT meshIndex, Mesh& mesh);
+void ReleaseMesh(GeometryBuffer& geometry, Mesh& mesh);
+
+// Bind the arenas holding the mesh.
+void BindMeshBuffers(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const Mesh& mesh);
+
+// Issue one DrawIndexed per submesh. The mesh's arenas must already be bound.
+void DrawMesh(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const Mesh& mesh);
+
+// Matrix that turns vertex buffer positions into mesh space. Prepend it to the world matrix.
+DirectX::XMMATRIX GetMeshDequantizeMatrix(const Mesh& mesh);
+
+// Create an input layout matching a vertex format for the given vertex shader.
+bool CreateMeshInputLayout(ID3D11Device* device, MeshVertexFormat format, const void* shaderBytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout);
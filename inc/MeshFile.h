@@ -0,0 +1,145 @@
+#pragma once
+#include "File.h"
+
+// Versioned binary mesh container.
+// The file starts with a MeshFileHeader followed by one MeshFileEntry per mesh.
+// Vertex and index payloads are stored exactly as the GPU buffers expect them,
+// aligned to MESH_FILE_ALIGNMENT, so a memory mapped file can be handed to
+// CreateBuffer without parsing or copying. Each mesh is drawn as one or more
+// submeshes whose indices are relative to their base vertex, which lets meshes
+// of any size use 16-bit indices.
+
+const uint32_t MESH_FILE_MAGIC = 0x48534D45; // "EMSH"
+const uint32_t MESH_FILE_VERSION = 3;
+const uint32_t MESH_FILE_ALIGNMENT = 16;
+// Vertices a submesh with 16-bit indices can address.
+const uint32_t MESH_INDEX16_VERTEX_LIMIT = 0x10000;
+
+// Vertex layouts that can be stored in a mesh file.
+// The compact layouts store positions as 16-bit UNORM inside the mesh's
+// PositionScale/PositionBias box, normals octahedral encoded in two 16-bit
+// SNORM values, texcoords as half floats and colors as RGBA8 UNORM.
+enum MeshVertexFormat : uint32_t {
+    MVF_PositionColor,
+    MVF_CompactPositionColor,
+    MVF_CompactPositionNormalColor,
+    MVF_CompactPositionNormalTexCoordColor,
+    NumMeshVertexFormats
+};
+
+// Vertex layout for MVF_PositionColor. 24 bytes.
+struct VertexPosColor
+{
+    DirectX::XMFLOAT3 Position;
+    DirectX::XMFLOAT3 Color;
+};
+
+// Vertex layout for MVF_CompactPositionColor. 12 bytes.
+struct VertexCompactPosColor
+{
+    DirectX::PackedVector::XMUSHORTN4 Position;
+    DirectX::PackedVector::XMUBYTEN4 Color;
+};
+
+// Vertex layout for MVF_CompactPositionNormalColor. 16 bytes.
+struct VertexCompactPosNormalColor
+{
+    DirectX::PackedVector::XMUSHORTN4 Position;
+    DirectX::PackedVector::XMSHORTN2 Normal;
+    DirectX::PackedVector::XMUBYTEN4 Color;
+};
+
+// Vertex layout for MVF_CompactPositionNormalTexCoordColor. 20 bytes.
+struct VertexCompactPosNormalTexColor
+{
+    DirectX::PackedVector::XMUSHORTN4 Position;
+    DirectX::PackedVector::XMSHORTN2 Normal;
+    DirectX::PackedVector::XMHALF2 TexCoord;
+    DirectX::PackedVector::XMUBYTEN4 Color;
+};
+
+UINT GetVertexFormatStride(MeshVertexFormat format);
+
+struct MeshFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t MeshCount;
+    uint32_t Reserved;
+};
+
+struct MeshFileEntry
+{
+    uint32_t VertexFormat;
+    uint32_t VertexStride;
+    uint32_t VertexCount;
+    // Bytes per index: 2 or 4.
+    uint32_t IndexSize;
+    uint32_t IndexCount;
+    uint32_t SubmeshCount;
+    // Offsets from the start of the file.
+    uint64_t VertexDataOffset;
+    uint64_t IndexDataOffset;
+    uint64_t SubmeshDataOffset;
+    float BoundsCenter[3];
+    float BoundsExtents[3];
+    // Mesh space position = PositionScale * p + PositionBias, where p is the position
+    // as read by the input assembler (0..1 for the compact formats).
+    float PositionScale[3];
+    float PositionBias[3];
+};
+
+// Range of a mesh drawn with one DrawIndexed call.
+struct MeshFileSubmesh
+{
+    uint32_t StartIndex;
+    uint32_t IndexCount;
+    // Added to every index of the submesh.
+    uint32_t BaseVertex;
+    uint32_t VertexCount;
+};
+
+struct MeshFile
+{
+    MappedFile File;
+    const MeshFileHeader* Header = nullptr;
+    const MeshFileEntry* Entries = nullptr;
+};
+
+// Map a mesh file and validate its header and table. Payloads are paged in on first access.
+bool OpenMeshFile(MeshFile& meshFile, const wchar_t* path);
+// Validate a mesh file that was read into memory. The contents of data move into the mesh file.
+bool OpenMeshFileFromMemory(MeshFile& meshFile, std::vector<BYTE>& data);
+void CloseMeshFile(MeshFile& meshFile);
+
+const void* GetMeshVertexData(const MeshFile& meshFile, UINT mesh);
+const void* GetMeshIndexData(const MeshFile& meshFile, UINT mesh);
+const MeshFileSubmesh* GetMeshSubmeshes(const MeshFile& meshFile, UINT mesh);
+DirectX::BoundingBox GetMeshBounds(const MeshFile& meshFile, UINT mesh);
+
+// Decode the mesh's vertex positions, in any format, to VertexCount full precision positions.
+void DecodeMeshPositions(const MeshFile& meshFile, UINT mesh, DirectX::XMFLOAT3* positions);
+// Decode the mesh's vertex colors, in any format, to VertexCount RGBA colors.
+void DecodeMeshColors(const MeshFile& meshFile, UINT mesh, DirectX::XMFLOAT4* colors);
+// Decode the mesh's IndexCount indices to 32-bit, with every submesh's base vertex added.
+void DecodeMeshIndices(const MeshFile& meshFile, UINT mesh, uint32_t* indices);
+
+// In-memory mesh to be written out.
+struct MeshSource
+{
+    MeshVertexFormat VertexFormat;
+    UINT VertexStride;
+    UINT VertexCount;
+    const void* Vertices;
+    UINT IndexSize;
+    UINT IndexCount;
+    const void* Indices;
+    // Without submeshes the whole mesh is written as a single submesh.
+    UINT SubmeshCount;
+    const MeshFileSubmesh* Submeshes;
+    DirectX::BoundingBox Bounds;
+    DirectX::XMFLOAT3 PositionScale;
+    DirectX::XMFLOAT3 PositionBias;
+};
+
+bool WriteMeshFile(const wchar_t* path, const MeshSource* meshes, UINT meshCount);
@@ -0,0 +1,127 @@
+#pragma once
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+
+// OBJ and glTF 2.0 importer.
+// OBJ text is split into line aligned chunks that are parsed in parallel on the
+// job system; face corners are then welded into unique vertices through a hash
+// of their position/texcoord/normal indices. glTF (.gltf with external or data
+// URI buffers, or .glb) accessors are decoded in parallel and identical vertices
+// are welded by hashing their contents. Everything is converted to the engine's
+// left handed space with clockwise front faces.
+
+// Attributes present in the source. Missing ones are left at their defaults.
+enum ImportAttribute {
+    IA_Normal = 1 << 0,
+    IA_TexCoord = 1 << 1,
+    IA_Color = 1 << 2
+};
+
+// Full precision vertex produced by the importers.
+struct ImportVertex
+{
+    DirectX::XMFLOAT3 Position;
+    DirectX::XMFLOAT3 Normal;
+    DirectX::XMFLOAT2 TexCoord;
+    DirectX::XMFLOAT4 Color;
+};
+
+struct ImportedMesh
+{
+    std::vector<ImportVertex> Vertices;
+    // Triangle list.
+    std::vector<uint32_t> Indices;
+    UINT Attributes = 0;
+    DirectX::BoundingBox Bounds;
+};
+
+struct ImportStats
+{
+    uint64_t SourceBytes;
+    UINT VertexCount;
+    UINT TriangleCount;
+    double ParseTimeMs;
+    double WeldTimeMs;
+    double TotalTimeMs;
+};
+
+// Parse OBJ text already in memory.
+bool ParseObj(const char* text, size_t size, ImportedMesh& mesh, ImportStats* stats = nullptr);
+// Parse a .glb container already in memory. Only embedded and data URI buffers are available.
+bool ParseGlb(const BYTE* data, size_t size, ImportedMesh& mesh, ImportStats* stats = nullptr);
+
+// Import a .obj, .gltf or .glb file, picked by extension.
+bool ImportMesh(const wchar_t* path, ImportedMesh& mesh, ImportStats* stats = nullptr);
+
+// Merge vertices with identical contents and remap the indices.
+void WeldImportedVertices(ImportedMesh& mesh);
+
+// Reorder triangles for the vertex cache and overdraw, then vertices for fetch locality.
+// Vertices no triangle uses are dropped.
+void OptimizeImportedMesh(ImportedMesh& mesh, MeshOptimizeStats* stats = nullptr);
+
+// Source megabytes parsed per second of total import time.
+double GetImportThroughputMBs(const ImportStats& stats);
+
+// How a cooked mesh addresses its vertices.
+enum MeshIndexLayout {
+    // One submesh with 16-bit indices. Needs at most MESH_INDEX16_VERTEX_LIMIT vertices.
+    MIL_Index16,
+    // One submesh with 32-bit indices.
+    MIL_Index32,
+    // Runs of triangles touching at most MESH_INDEX16_VERTEX_LIMIT vertices, each drawn as a
+    // submesh with 16-bit indices. Vertices shared across a cut are duplicated.
+    MIL_Split16
+};
+
+// Most submeshes a split mesh may be cut into before 32-bit indices are used instead.
+const UINT MESH_MAX_SPLIT_SUBMESHES = 64;
+
+// Engine-native vertex and index buffers built from an imported mesh.
+struct CookedMesh
+{
+    MeshVertexFormat VertexFormat;
+    UINT VertexStride;
+    UINT VertexCount;
+    std::vector<BYTE> Vertices;
+    MeshIndexLayout IndexLayout;
+    UINT IndexSize;
+    UINT IndexCount;
+    std::vector<BYTE> Indices;
+    std::vector<MeshFileSubmesh> Submeshes;
+    DirectX::BoundingBox Bounds;
+    DirectX::XMFLOAT3 PositionScale;
+    DirectX::XMFLOAT3 PositionBias;
+};
+
+// Most compact vertex format that keeps every attribute the mesh has.
+MeshVertexFormat ChooseVertexFormat(const ImportedMesh& mesh);
+
+// 16-bit indices whenever the mesh fits, otherwise the smaller of a split and 32-bit indices.
+MeshIndexLayout ChooseIndexLayout(const ImportedMesh& mesh, MeshVertexFormat format);
+
+void CookImportedMesh(const ImportedMesh& mesh, MeshVertexFormat format, MeshIndexLayout indexLayout, CookedMesh& cooked);
+
+// View of a cooked mesh for WriteMeshFile.
+MeshSource GetCookedMeshSource(const CookedMesh& cooked);
+
+// GPU memory of a cooked mesh against the same data at full precision.
+struct MeshMemoryReport
+{
+    UINT VertexCount;
+    UINT IndexCount;
+    MeshIndexLayout IndexLayout;
+    UINT SubmeshCount;
+    // Every present attribute as 32-bit floats (colors as float3, like VertexPosColor) and 32-bit indices.
+    uint64_t FullVertexBytes;
+    uint64_t FullIndexBytes;
+    uint64_t VertexBytes;
+    uint64_t IndexBytes;
+};
+
+void GetMeshMemoryReport(const ImportedMesh& mesh, const CookedMesh& cooked, MeshMemoryReport& report);
+void PrintMeshMemoryReport(FILE* file, const char* name, const MeshMemoryReport& report);
+
+// Offline path: import a source asset, optimize it and write it out as a single mesh file in the
+// formats picked by ChooseVertexFormat and ChooseIndexLayout.
+bool CookMeshFile(const wchar_t* sourcePath, const wchar_t* outputPath, ImportStats* stats = nullptr, MeshMemoryReport* report = nullptr, MeshOptimizeStats* optimizeStats = nullptr);
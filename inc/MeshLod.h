@@ -0,0 +1,64 @@
+#pragma once
+
+// Quadric error mesh simplification and LOD selection.
+// Edges are collapsed in order of the error they add, measured with quadrics
+// over position and vertex color (Garland and Heckbert, "Simplifying Surfaces
+// with Color and Texture using Quadric Error Metrics"). Collapses only move a
+// vertex onto a neighbor, so every level indexes the original vertex buffer.
+// Vertices on open borders and on attribute seams stay where they are.
+
+const UINT MESH_MAX_LODS = 8;
+// Each level targets this fraction of the previous level's triangles.
+const float MESH_LOD_REDUCTION = 0.5f;
+// The chain ends once a level keeps more than this fraction of the previous one.
+const float MESH_LOD_MIN_REDUCTION = 0.85f;
+// Weight of a full RGB color change relative to the size of the mesh.
+const float MESH_LOD_COLOR_WEIGHT = 0.1f;
+// Largest error in pixels the selector lets through.
+const float MESH_LOD_MAX_PIXEL_ERROR = 1.0f;
+
+// Vertex attributes the simplifier measures error on.
+struct SimplifyVertices
+{
+    const DirectX::XMFLOAT3* Positions;
+    size_t PositionStride;
+    // Optional.
+    const DirectX::XMFLOAT4* Colors;
+    size_t ColorStride;
+    float ColorWeight;
+    UINT Count;
+};
+
+// Simplify a triangle list towards targetIndexCount indices. destination needs room for indexCount
+// indices and may not alias indices. Returns the index count written; error receives the largest
+// deviation introduced, in mesh space units.
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const SimplifyVertices& vertices, size_t targetIndexCount, float* error = nullptr);
+
+struct MeshLod
+{
+    std::vector<uint32_t> Indices;
+    // Deviation from the full detail mesh, in mesh space units.
+    float Error;
+};
+
+// Level 0 is the input; every further level simplifies the previous one and is cache optimized.
+void BuildMeshLods(std::vector<MeshLod>& lods, const uint32_t* indices, size_t indexCount, const SimplifyVertices& vertices);
+
+// Pixels covered by one world unit at distance 1 for a viewport of the given height.
+float GetLodProjectionScale(DirectX::CXMMATRIX projection, float viewportHeight);
+
+// Coarsest level whose error, projected at the point of the sphere around worldBounds nearest to the eye,
+// stays within maxPixelError. Level 0 when the eye is inside that sphere.
+UINT SelectMeshLod(const float* lodErrors, UINT lodCount, DirectX::FXMMATRIX world, const DirectX::BoundingBox& worldBounds, DirectX::FXMVECTOR eyePosition,
+    float projectionScale, float maxPixelError);
+
+// Triangles of the objects drawn in a frame at full detail and at their selected levels, before cluster culling.
+struct MeshLodStats
+{
+    UINT Objects;
+    UINT FullDetailTriangles;
+    UINT LodTriangles;
+    UINT ObjectsPerLod[MESH_MAX_LODS];
+};
+
+float GetLodTriangleReductionPercent(const MeshLodStats& stats);
@@ -0,0 +1,48 @@
+#pragma once
+
+// Triangle and vertex reordering for GPU friendly index buffers.
+// Triangles are first sorted with Forsyth's linear-speed vertex cache optimization.
+// The result is then cut into clusters that cost little extra cache misses and the
+// clusters are sorted so outward facing parts of the mesh draw first (Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). Finally the
+// vertices are renumbered in the order the index buffer first uses them.
+
+// Size of the simulated FIFO post-transform cache used for the statistics and the cluster cuts.
+const UINT VERTEX_CACHE_SIZE = 16;
+// Clusters may cost up to this multiple of the cache optimized miss ratio in exchange for a better draw order.
+const float OVERDRAW_THRESHOLD = 1.05f;
+const UINT MESH_OPTIMIZER_INVALID_INDEX = 0xFFFFFFFF;
+
+struct VertexCacheStats
+{
+    UINT TriangleCount;
+    // Vertices used by the index buffer.
+    UINT VertexCount;
+    UINT CacheMisses;
+    // Average cache miss ratio: transformed vertices per triangle, 0.5 for an ideal grid and 3 at worst.
+    float ACMR;
+    // Average transform to vertex ratio: transformed vertices per used vertex, 1 at best.
+    float ATVR;
+};
+
+// Simulate a FIFO cache of cacheSize entries over a triangle list.
+void AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, UINT vertexCount, UINT cacheSize, VertexCacheStats& stats);
+
+// Reorder the triangles of a triangle list in place.
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, UINT vertexCount);
+// Reorder the clusters of a cache optimized triangle list in place. Front faces are clockwise.
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount, float threshold);
+// Renumber the vertices in order of first use and rewrite the indices. remap[old] receives the new
+// index, or MESH_OPTIMIZER_INVALID_INDEX for vertices no triangle uses. Returns the used vertex count.
+UINT OptimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, UINT vertexCount, uint32_t* remap);
+
+struct MeshOptimizeStats
+{
+    VertexCacheStats Before;
+    VertexCacheStats After;
+    double VertexCacheTimeMs;
+    double OverdrawTimeMs;
+    double VertexFetchTimeMs;
+};
+
+void PrintMeshOptimizeStats(FILE* file, const char* name, const MeshOptimizeStats& stats);
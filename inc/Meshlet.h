@@ -0,0 +1,77 @@
+#pragma once
+#include "Frustum.h"
+
+// Meshlet clustering and CPU cluster culling.
+// A triangle list is cut into small clusters, in order, each with a bounding
+// sphere and a cone bounding its triangle normals. Every frame the clusters of
+// a visible object are tested against the frustum and the cone, and the
+// triangles of the survivors are packed into a dynamic index buffer that is
+// drawn in place of the mesh's static one.
+
+const UINT MESHLET_MAX_VERTICES = 64;
+const UINT MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+    // First entry in MeshletMesh::Vertices.
+    UINT VertexOffset;
+    // First byte in MeshletMesh::Triangles; every triangle is three local vertex indices.
+    UINT TriangleOffset;
+    UINT VertexCount;
+    UINT TriangleCount;
+    // Bounding sphere in mesh space.
+    DirectX::XMFLOAT3 Center;
+    float Radius;
+    // The whole cluster faces away from a viewer at p when
+    // dot(Center - p, ConeAxis) >= ConeCutoff * length(Center - p) + Radius.
+    // ConeCutoff is 1 when the normals are too spread out for this to ever hold.
+    DirectX::XMFLOAT3 ConeAxis;
+    float ConeCutoff;
+};
+
+// Meshlets of one level of detail.
+struct MeshletLod
+{
+    UINT FirstMeshlet;
+    UINT MeshletCount;
+    UINT TriangleCount;
+};
+
+struct MeshletMesh
+{
+    std::vector<Meshlet> Meshlets;
+    // Mesh vertex index of every meshlet vertex.
+    std::vector<uint32_t> Vertices;
+    std::vector<BYTE> Triangles;
+    // Finest level first; all levels address the same vertices.
+    std::vector<MeshletLod> Lods;
+    // Vertices addressed by the mesh; picks the size of the index stream.
+    UINT MeshVertexCount = 0;
+};
+
+// Cluster a triangle list in its current order as the only level. Front faces are clockwise.
+void BuildMeshlets(MeshletMesh& meshlets, const uint32_t* indices, size_t indexCount, const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount);
+// Cluster a triangle list as the next coarser level. positions must hold MeshVertexCount vertices.
+void AddMeshletLod(MeshletMesh& meshlets, const uint32_t* indices, size_t indexCount, const DirectX::XMFLOAT3* positions, size_t positionStride);
+
+struct MeshletCullStats
+{
+    UINT MeshletsTested;
+    UINT MeshletsVisible;
+    UINT FrustumCulled;
+    UINT BackfaceCulled;
+    UINT TrianglesTested;
+    UINT TrianglesVisible;
+    double CullTimeMs;
+    double WriteTimeMs;
+};
+
+// Append the visible meshlets of one instance drawn at the given level. eyePosition is in world space.
+// Returns the number of indices they need.
+UINT CullMeshlets(const MeshletMesh& meshlets, UINT lod, DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProjection, DirectX::FXMVECTOR eyePosition, std::vector<UINT>& visibleMeshlets, MeshletCullStats& stats);
+
+// Write the triangles of the given meshlets as 2 or 4 byte indices.
+void WriteMeshletIndices(const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, UINT indexSize, void* indices);
+
+// Percentage of tested triangles that were culled.
+float GetMeshletCulledTrianglePercent(const MeshletCullStats& stats);
@@ -0,0 +1,20 @@
+#pragma once
+#include "Meshlet.h"
+
+// Meshlet index stream.
+// The triangles of the meshlets that pass culling are written every frame
+// into one dynamic Direct3D 11 index buffer and drawn from there.
+
+// Per-frame index buffer refilled with WRITE_DISCARD; it grows as needed.
+struct MeshletIndexStream
+{
+    ID3D11Buffer* IndexBuffer = nullptr;
+    UINT Capacity = 0;
+    UINT IndexSize = 0;
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_UNKNOWN;
+};
+
+// Replace the stream's contents with the triangles of the given meshlets.
+bool UpdateMeshletIndexStream(ID3D11Device* device, ID3D11DeviceContext* deviceContext, MeshletIndexStream& stream, const MeshletMesh& meshlets,
+    const UINT* visibleMeshlets, UINT visibleCount, MeshletCullStats& stats);
+void ReleaseMeshletIndexStream(MeshletIndexStream& stream);
@@ -0,0 +1,60 @@
+#pragma once
+
+// Software occlusion culling against a coarse CPU depth buffer.
+// Designated occluder meshes are rasterized at low resolution on the job system,
+// a per-tile max depth is built on top of it, and object bounds are tested
+// against both levels before they reach the draw queue.
+
+const UINT OCCLUSION_BUFFER_WIDTH = 256;
+const UINT OCCLUSION_BUFFER_HEIGHT = 144;
+const UINT OCCLUSION_TILE_SIZE = 8;
+
+struct OcclusionBuffer
+{
+    UINT Width;
+    UINT Height;
+    // Post-projection depth in [0, 1], cleared to 1 (far).
+    std::vector<float> Depth;
+    // Farthest depth in each OCCLUSION_TILE_SIZE square tile.
+    UINT TilesX;
+    UINT TilesY;
+    std::vector<float> TileMaxDepth;
+    DirectX::XMFLOAT4X4 ViewProjection;
+};
+
+// A triangle mesh drawn into the occlusion buffer.
+struct Occluder
+{
+    const DirectX::XMFLOAT3* Positions;
+    UINT PositionStride;
+    UINT VertexCount;
+    const void* Indices;
+    // Bytes per index: 2 or 4.
+    UINT IndexSize;
+    UINT IndexCount;
+    DirectX::XMFLOAT4X4 WorldMatrix;
+};
+
+struct OcclusionStats
+{
+    double RasterTimeMs;
+    double TestTimeMs;
+    UINT OccluderTriangles;
+    UINT ObjectsTested;
+    UINT ObjectsRejected;
+};
+
+// Width and height must be multiples of OCCLUSION_TILE_SIZE.
+void InitOcclusionBuffer(OcclusionBuffer& buffer, UINT width, UINT height);
+
+// Clear the buffer and draw the occluders as seen through viewProjection.
+void RasterizeOccluders(OcclusionBuffer& buffer, DirectX::FXMMATRIX viewProjection, const Occluder* occluders, UINT occluderCount, OcclusionStats& stats);
+
+// True if the box is completely hidden behind the rasterized occluders.
+bool IsOccluded(const OcclusionBuffer& buffer, const DirectX::BoundingBox& worldBounds);
+
+// Remove hidden objects from visibleObjects, preserving order. bounds is indexed by object.
+void CullOccludedObjects(const OcclusionBuffer& buffer, const DirectX::BoundingBox* bounds, std::vector<UINT>& visibleObjects, OcclusionStats& stats);
+
+// Percentage of tested objects that were rejected.
+float GetOcclusionRejectedPercent(const OcclusionStats& stats);
@@ -0,0 +1,99 @@
+#pragma once
+
+// Two level segregated fit allocator for ranges of an abstract address space.
+// It hands out offsets into something it does not own, such as a GPU buffer,
+// so it never touches the memory itself and is plain portable C++. Free
+// ranges are kept in 256 size classes: 32 powers of two split into 8 linear
+// steps each, with a bitmask per level so finding a fitting class is a couple
+// of bit scans. Allocation and free are O(1); freed ranges merge with free
+// neighbors immediately. Allocations are handles rather than offsets so that
+// defragmentation can move them.
+
+const uint32_t OFFSET_ALLOCATOR_BIN_COUNT = 256;
+const uint32_t OFFSET_ALLOCATION_NONE = 0xFFFFFFFF;
+
+struct OffsetAllocator
+{
+    struct Node
+    {
+        uint32_t Offset;
+        uint32_t Size;
+        // Neighbors in address order.
+        uint32_t Previous;
+        uint32_t Next;
+        // Neighbors in the free list of the node's size class.
+        uint32_t BinPrevious;
+        uint32_t BinNext;
+        bool Used;
+    };
+
+    uint32_t Size = 0;
+    uint32_t FreeSize = 0;
+    uint32_t AllocationCount = 0;
+    // Bit t is set when any of the 8 classes of level t has a free range; UsedBins[t] says which.
+    uint32_t UsedBinLevels = 0;
+    uint8_t UsedBins[OFFSET_ALLOCATOR_BIN_COUNT / 8];
+    uint32_t BinHeads[OFFSET_ALLOCATOR_BIN_COUNT];
+    // Last node in address order.
+    uint32_t Tail = OFFSET_ALLOCATION_NONE;
+    std::vector<Node> Nodes;
+    // Indices of Nodes entries that are not in use.
+    std::vector<uint32_t> FreeNodes;
+};
+
+// Manage [0, size).
+void InitOffsetAllocator(OffsetAllocator& allocator, uint32_t size);
+
+// Returns OFFSET_ALLOCATION_NONE only when no free range is large enough.
+uint32_t AllocateOffset(OffsetAllocator& allocator, uint32_t size);
+void FreeOffset(OffsetAllocator& allocator, uint32_t allocation);
+
+uint32_t GetAllocationOffset(const OffsetAllocator& allocator, uint32_t allocation);
+uint32_t GetAllocationSize(const OffsetAllocator& allocator, uint32_t allocation);
+
+// Extend the managed range to [0, size). Existing allocations keep their offsets.
+void GrowOffsetAllocator(OffsetAllocator& allocator, uint32_t size);
+
+// One allocation moved by defragmentation.
+struct OffsetAllocatorMove
+{
+    uint32_t Allocation;
+    uint32_t SourceOffset;
+    uint32_t DestinationOffset;
+    uint32_t Size;
+};
+
+// Pack every allocation to the start of the range, in address order, leaving one free range at the end.
+// Handles stay valid; moves lists the allocations whose offsets changed, lowest first.
+void DefragmentOffsetAllocator(OffsetAllocator& allocator, std::vector<OffsetAllocatorMove>& moves);
+
+// Range of the old memory to copy into new memory after defragmentation.
+struct OffsetAllocatorCopy
+{
+    uint32_t SourceOffset;
+    uint32_t DestinationOffset;
+    uint32_t Size;
+};
+
+// Copies that carry every allocation from the memory before DefragmentOffsetAllocator to fresh memory. usedSize is the
+// allocated size; moves must be in the order defragmentation listed them. Everything below the first move is one copy,
+// and allocations that were adjacent before moving share one copy.
+void GetDefragmentCopies(const std::vector<OffsetAllocatorMove>& moves, uint32_t usedSize, std::vector<OffsetAllocatorCopy>& copies);
+
+struct OffsetAllocatorReport
+{
+    uint32_t Size;
+    uint32_t FreeSize;
+    uint32_t LargestFreeRange;
+    uint32_t FreeRangeCount;
+    uint32_t AllocationCount;
+};
+
+void GetOffsetAllocatorReport(const OffsetAllocator& allocator, OffsetAllocatorReport& report);
+
+// Share of the free space that is not in the largest free range, from 0 to 100.
+float GetOffsetAllocatorFragmentationPercent(const OffsetAllocatorReport& report);
+
+// Check the allocator's internal state: the address order list covers the whole range, no two free ranges are
+// adjacent, the sizes add up and the size classes hold exactly the free ranges. For tests.
+bool ValidateOffsetAllocator(const OffsetAllocator& allocator);
@@ -0,0 +1,132 @@
+#pragma once
+
+// CPU profiler of scoped zones.
+// PROFILE_ZONE times the rest of the enclosing scope. A zone reads the time
+// stamp counter when it opens and closes, or the steady clock where there is
+// no counter, and on closing writes its name and both times to a ring of the
+// calling thread's own. Each ring has that thread as its only writer and the
+// frame mark as its only reader, so recording takes no lock; a thread
+// registers its ring the first time it records or names itself. Zones are
+// only recorded during a capture, which starts at the frame mark after
+// StartProfilerCapture and collects every thread's zones at each following
+// mark until it holds the requested number of frames. WriteChromeTrace then
+// writes the capture as Chrome trace JSON, which chrome://tracing and
+// Perfetto open, with one track per thread, one for the frames and any made
+// with CreateProfilerTrack for zones timed elsewhere. Outside a capture a
+// zone costs one call and a branch, and building with PROFILER_ENABLED set
+// to 0 removes zones and leaves empty inline functions.
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Zones a thread can record between two frame marks. Must be a power of two.
+const UINT PROFILER_RING_SIZE = 16384;
+
+#define PROFILE_ZONE_CONCAT_INNER(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_INNER(a, b)
+
+struct ProfilerStats
+{
+    UINT Frames;
+    UINT Zones;
+    // Zones lost because a thread's ring was full.
+    UINT DroppedZones;
+    // Threads and tracks that recorded anything in the capture.
+    UINT Threads;
+    double ExportTimeMs;
+};
+
+#if PROFILER_ENABLED
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROFILER_USE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define PROFILER_USE_TSC 0
+#endif
+
+// Time stamp counter ticks, or steady clock nanoseconds without one.
+inline uint64_t ReadProfilerClock() {
+#if PROFILER_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Take the clock reference the trace's times are converted with.
+void InitProfiler();
+// Release every thread's ring and any capture. No thread may be recording.
+void ShutdownProfiler();
+
+// Name the calling thread's track in traces.
+void SetProfilerThreadName(const char* name);
+
+// Capture the frameCount frames that follow the next frame mark. Returns false if a capture is running.
+bool StartProfilerCapture(UINT frameCount);
+bool IsProfilerRecording();
+
+// Mark the start of a frame. Call once per frame from the main thread. Returns true when the mark
+// completes a capture, which is then ready to write.
+bool ProfilerFrameMark();
+
+// Write the last completed capture as Chrome trace JSON.
+bool WriteChromeTrace(const wchar_t* path, ProfilerStats* stats = nullptr);
+
+void GetProfilerStats(ProfilerStats& stats);
+
+// Profiler clock ticks per second.
+double GetProfilerTicksPerSecond();
+
+// Name must outlive the capture, which string literals do.
+void RecordProfileZone(const char* name, uint64_t start, uint64_t end);
+
+// A track of its own for zones timed somewhere other than the recording thread, such as on the GPU. Valid
+// until ShutdownProfiler; only one thread may record to a track at a time.
+UINT CreateProfilerTrack(const char* name);
+// Record a zone to the track with times already on the profiler clock. Takes a lock, so it suits zones
+// gathered in bulk rather than hot code.
+void RecordProfileTrackZone(UINT track, const char* name, uint64_t start, uint64_t end);
+
+struct ProfileZone
+{
+    explicit ProfileZone(const char* name)
+        : Name(name), Start(IsProfilerRecording() ? ReadProfilerClock() : 0) {
+    }
+    ~ProfileZone() {
+        if (Start != 0) {
+            RecordProfileZone(Name, Start, ReadProfilerClock());
+        }
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    const char* Name;
+    uint64_t Start;
+};
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+
+#else
+
+inline uint64_t ReadProfilerClock() { return 0; }
+inline void InitProfiler() {}
+inline void ShutdownProfiler() {}
+inline void SetProfilerThreadName(const char*) {}
+inline bool StartProfilerCapture(UINT) { return false; }
+inline bool IsProfilerRecording() { return false; }
+inline bool ProfilerFrameMark() { return false; }
+inline bool WriteChromeTrace(const wchar_t*, ProfilerStats* stats = nullptr) { if (stats) { *stats = ProfilerStats(); } return false; }
+inline void GetProfilerStats(ProfilerStats& stats) { stats = ProfilerStats(); }
+inline double GetProfilerTicksPerSecond() { return 1.0; }
+inline UINT CreateProfilerTrack(const char*) { return 0; }
+inline void RecordProfileTrackZone(UINT, const char*, uint64_t, uint64_t) {}
+
+#define PROFILE_ZONE(name) ((void)0)
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+// Rectangle packer.
+// Skyline bottom-left packing: the packer keeps the top edge of everything
+// placed so far as a list of horizontal segments and puts each rectangle
+// where its top ends lowest, breaking ties by the area it would leave
+// unusable underneath it. That stays within a few percent of the tighter
+// maximal-rectangles packers on sprite and glyph sets for a fraction of their
+// time and memory, and rectangles can be added one at a time, which lets
+// caches that fill up while the app runs share the packer with atlases
+// built at load time.
+
+struct SkylineSegment
+{
+    UINT X;
+    UINT Y;
+    UINT Width;
+};
+
+struct RectPacker
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    std::vector<SkylineSegment> Skyline;
+    uint64_t UsedArea = 0;
+};
+
+// A rectangle for PackRects. X and Y are only meaningful once Packed is set.
+struct PackedRect
+{
+    UINT Width;
+    UINT Height;
+    UINT X;
+    UINT Y;
+    bool Packed;
+};
+
+void InitRectPacker(RectPacker& packer, UINT width, UINT height);
+// Forget everything placed so far.
+void ResetRectPacker(RectPacker& packer);
+
+// Place a single rectangle. Fails if no space is left for it.
+bool PackRect(RectPacker& packer, UINT width, UINT height, UINT& x, UINT& y);
+
+// Place as many of the rectangles as fit, the tallest first, which packs tighter than
+// placing them in the order given. Returns the number placed.
+UINT PackRects(RectPacker& packer, PackedRect* rects, UINT count);
+
+// Share of the packer's area covered by rectangles, from 0 to 100.
+float GetRectPackerOccupancyPercent(const RectPacker& packer);
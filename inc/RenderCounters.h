@@ -0,0 +1,101 @@
+#pragma once
+
+// Per-frame render counters.
+// Draws, state binds, uploads and resource creations are counted here, by
+// what is submitted rather than by which API submits it: the Direct3D 11
+// wrappers in RenderCountersD3D11.h forward each call to the context and
+// count it, and headless runs count what a frame would submit with no
+// device at all. Binds are compared with a key of what was bound last at
+// the same bind point and slot: a bind of what is already bound is still
+// issued, so rendering does not change, and is counted as redundant. Draws,
+// binds and uploads are counted for the immediate context, from the thread
+// that renders; creations may come from any thread. Every frame starts with
+// BeginRenderCountersFrame, which hands back the finished frame's counts as
+// one snapshot for the HUD, frame statistics and benchmarks.
+
+// Vertex buffer, constant buffer, resource and sampler slots whose bindings are compared.
+const UINT RENDER_COUNTERS_TRACKED_SLOTS = 16;
+
+// Pipeline state a bind sets. Bind points without slots bind slot 0.
+enum RenderBindPoint {
+    RBP_InputLayout,
+    RBP_Topology,
+    RBP_VertexBuffers,
+    RBP_IndexBuffer,
+    RBP_VertexShader,
+    RBP_VSConstantBuffers,
+    RBP_PixelShader,
+    RBP_PSShaderResources,
+    RBP_PSSamplers,
+    RBP_Rasterizer,
+    RBP_Viewports,
+    RBP_RenderTargets,
+    RBP_Blend,
+    RBP_DepthStencil,
+    RBP_Count
+};
+
+// How draws assemble primitives, for counting triangles.
+enum RenderPrimitive {
+    RP_Other,
+    RP_TriangleList,
+    RP_TriangleStrip
+};
+
+struct RenderCounters
+{
+    UINT Draws;
+    // Indices of indexed draws and vertices of the others.
+    uint64_t Indices;
+    uint64_t Vertices;
+    // Triangles of list and strip topologies.
+    uint64_t Triangles;
+    UINT StateBinds;
+    // Binds that set exactly what was bound already.
+    UINT RedundantStateBinds;
+    // Binds that changed the vertex or pixel shader.
+    UINT ShaderSwitches;
+    UINT Updates;
+    UINT Maps;
+    UINT Copies;
+    // Bytes written by updates and through maps.
+    uint64_t UploadBytes;
+    UINT BufferCreations;
+    UINT TextureCreations;
+};
+
+// Start counting a new frame. The counts since the last call are copied to lastFrame if given.
+void BeginRenderCountersFrame(RenderCounters* lastFrame = nullptr);
+// Counts so far this frame.
+void GetRenderCounters(RenderCounters& counters);
+// Forget what is bound, after the context's state changed without going through the wrappers.
+void InvalidateRenderStateCache();
+
+// Share of state binds that were redundant, from 0 to 100.
+float GetRedundantStateBindPercent(const RenderCounters& counters);
+
+// Key of a bound value that is not a single object, such as a viewport or a blend state with its factor. Values of
+// several parts chain the key of one part into the next.
+uint64_t HashRenderState(const void* data, size_t size, uint64_t key = 14695981039346656037ull);
+// Key of a bound object.
+template<class T>
+inline uint64_t GetRenderStateKey(T* object) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object));
+}
+
+// Count a bind of count slots from startSlot, one key for each, and return whether all of them were bound already.
+// Slots past the tracked ones are never taken as redundant and need no key. Binds of a vertex or pixel shader that was
+// not bound are counted as shader switches.
+bool CountStateBind(RenderBindPoint point, UINT startSlot, UINT count, const uint64_t* keys);
+// Count a bind of a primitive topology, whose key is the API's own value for it.
+bool CountTopologyBind(RenderPrimitive primitive, uint64_t key);
+// Count a draw of count indices if indexed, or count vertices if not.
+void CountDraw(UINT count, bool indexed);
+// Count an update of bytes.
+void CountUpdate(uint64_t bytes);
+// Count a successful map; the bytes written through it are counted when it is unmapped.
+void CountMap();
+void CountUnmap(uint64_t bytesWritten);
+void CountCopy();
+void CountBufferCreation();
+void CountTextureCreation();
@@ -0,0 +1,39 @@
+#pragma once
+#include "RenderCounters.h"
+
+// Direct3D 11 render counter wrappers.
+// Draws, state binds, uploads and resource creations go through these thin
+// wrappers instead of straight to the device context or device; each one
+// forwards the call and counts it with RenderCounters.h. Objects are keyed
+// by their pointers and state passed by value by its bytes.
+
+void ContextDraw(ID3D11DeviceContext* deviceContext, UINT vertexCount, UINT startVertex);
+void ContextDrawIndexed(ID3D11DeviceContext* deviceContext, UINT indexCount, UINT startIndex, INT baseVertex);
+
+void ContextIASetInputLayout(ID3D11DeviceContext* deviceContext, ID3D11InputLayout* inputLayout);
+void ContextIASetPrimitiveTopology(ID3D11DeviceContext* deviceContext, D3D11_PRIMITIVE_TOPOLOGY topology);
+void ContextIASetVertexBuffers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides,
+    const UINT* offsets);
+void ContextIASetIndexBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+void ContextVSSetShader(ID3D11DeviceContext* deviceContext, ID3D11VertexShader* shader);
+void ContextVSSetConstantBuffers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+void ContextPSSetShader(ID3D11DeviceContext* deviceContext, ID3D11PixelShader* shader);
+void ContextPSSetShaderResources(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+void ContextPSSetSamplers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+void ContextRSSetState(ID3D11DeviceContext* deviceContext, ID3D11RasterizerState* state);
+void ContextRSSetViewports(ID3D11DeviceContext* deviceContext, UINT count, const D3D11_VIEWPORT* viewports);
+void ContextOMSetRenderTargets(ID3D11DeviceContext* deviceContext, UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+void ContextOMSetBlendState(ID3D11DeviceContext* deviceContext, ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask);
+void ContextOMSetDepthStencilState(ID3D11DeviceContext* deviceContext, ID3D11DepthStencilState* state, UINT stencilRef);
+
+// Upload wrappers take the number of bytes the call writes, which the context cannot tell.
+void ContextUpdateSubresource(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data,
+    UINT rowPitch, UINT depthPitch, uint64_t bytes);
+HRESULT ContextMap(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT flags,
+    D3D11_MAPPED_SUBRESOURCE* mappedResource);
+void ContextUnmap(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, uint64_t bytesWritten);
+void ContextCopySubresourceRegion(ID3D11DeviceContext* deviceContext, ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y,
+    UINT z, ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox);
+
+HRESULT DeviceCreateBuffer(ID3D11Device* device, const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer);
+HRESULT DeviceCreateTexture2D(ID3D11Device* device, const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture);
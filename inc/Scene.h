@@ -0,0 +1,46 @@
+#pragma once
+#include "BVH.h"
+#include "SpatialHash.h"
+
+// An object placed in the scene.
+struct SceneObject
+{
+    DirectX::XMFLOAT4X4 WorldMatrix;
+    // Object space bounds, transformed into Scene::WorldBounds whenever the object moves.
+    DirectX::BoundingBox LocalBounds;
+};
+
+// Spatial index used for the scene's culling queries.
+enum SceneIndexType {
+    SI_BVH, //best when most objects are static or move little; moves refit the tree
+    SI_SpatialHash //best for very many moving objects; moves are O(1) cell relinks
+};
+
+// Flat store of scene objects with a spatial index over their world bounds.
+struct Scene
+{
+    std::vector<SceneObject> Objects;
+    std::vector<DirectX::BoundingBox> WorldBounds;
+
+    SceneIndexType IndexType = SI_BVH;
+    BVH Hierarchy;
+    SpatialHash Grid;
+
+    // Objects moved since the last UpdateScene, and scratch space for their new bounds.
+    std::vector<UINT> MovedObjects;
+    std::vector<DirectX::BoundingBox> MovedBounds;
+    // Number of objects already in the spatial index; later ones were added since the last UpdateScene.
+    UINT IndexedObjects = 0;
+};
+
+// Choose the spatial index. Must be called before objects are added.
+void InitScene(Scene& scene, SceneIndexType indexType, float gridCellSize = 1.0f);
+
+UINT AddSceneObject(Scene& scene, DirectX::FXMMATRIX worldMatrix, const DirectX::BoundingBox& localBounds);
+void SetSceneObjectTransform(Scene& scene, UINT object, DirectX::FXMMATRIX worldMatrix);
+
+// Bring the spatial index up to date with additions and moves.
+void UpdateScene(Scene& scene);
+
+void CullScene(const Scene& scene, const Frustum& frustum, std::vector<UINT>& visibleObjects);
+bool PickScene(const Scene& scene, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, UINT& object, float& distance);
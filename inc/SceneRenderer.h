@@ -0,0 +1,78 @@
+#pragma once
+#include "Scene.h"
+#include "OcclusionCulling.h"
+#include "Meshlet.h"
+#include "MeshLod.h"
+#include "StaticBatch.h"
+#include "GpuTimer.h"
+#include "RenderCounters.h"
+
+// Scene submission.
+// The part of a frame that culls the scene and draws its meshes, shared by
+// the demo and the headless benchmark. Objects are culled against the view
+// frustum and then the occluders; every visible object picks its detail
+// level, culls that level's meshlets and draws the survivors from one index
+// stream written for the frame, and the static batch chunks in view are
+// drawn after them. Each bind, upload and draw is one call of a
+// SceneRenderDevice: the demo's makes the Direct3D 11 call through
+// RenderCountersD3D11.h, and the headless one counts it with
+// RenderCounters.h alone, so both count the submission made here.
+
+// The context calls scene submission makes.
+struct SceneRenderDevice
+{
+    // Bind the device's state for a bind point: the mesh's vertex buffer and input layout, a triangle list, the shaders and
+    // their constant buffers, the rasterizer state and viewport, the render targets and the depth stencil state.
+    std::function<void(RenderBindPoint point)> BindState;
+    // Bind the geometry arena of indices of the given size, for the mesh or the static batch.
+    std::function<void(UINT indexSize)> BindGeometryIndices;
+    // Write the triangles of the visible meshlets into the frame's index stream and bind it. False if the stream
+    // could not be written, in which case objects draw their whole mesh.
+    std::function<bool(const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, MeshletCullStats& stats)> WriteMeshletIndices;
+    // Update the frame and object constant buffers.
+    std::function<void(DirectX::FXMMATRIX viewMatrix)> UpdateViewMatrix;
+    std::function<void(DirectX::FXMMATRIX objectMatrix)> UpdateObjectMatrix;
+    // Draw indexCount indices of the meshlet index stream from startIndex, relative to the mesh's vertices.
+    std::function<void(UINT indexCount, UINT startIndex)> DrawMeshlets;
+    // Draw the whole mesh from its own indices.
+    std::function<void()> DrawMesh;
+    std::function<void(const StaticBatchChunk& chunk)> DrawStaticChunk;
+};
+
+// Device that counts every call with RenderCounters.h and draws nothing, for headless runs. DrawMesh counts
+// meshIndexCount indices.
+SceneRenderDevice CreateHeadlessSceneRenderDevice(UINT meshIndexCount);
+
+// What SubmitScene culls and draws, and what it found in the latest frame. Every scene object draws the same mesh.
+struct SceneRenderer
+{
+    const Scene* Objects = nullptr;
+    // Optional occluders, rasterized into OcclusionTarget every frame.
+    OcclusionBuffer* OcclusionTarget = nullptr;
+    const Occluder* Occluders = nullptr;
+    UINT OccluderCount = 0;
+    // Optional meshlets of the mesh, with the error of every level in Meshlets->Lods; without errors objects draw
+    // the finest level, and without meshlets the whole mesh.
+    const MeshletMesh* Meshlets = nullptr;
+    const float* LodErrors = nullptr;
+    // Bytes per index of the mesh's own indices.
+    UINT MeshIndexSize = sizeof(uint16_t);
+    // Mesh space from the mesh's vertex buffer positions, as Mesh keeps it.
+    DirectX::XMFLOAT3 PositionScale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+    DirectX::XMFLOAT3 PositionBias = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    const StaticBatch* Batch = nullptr;
+    // Optional timer of the draws' GPU pass.
+    GpuTimer* Timer = nullptr;
+
+    std::vector<UINT> VisibleObjects;
+    std::vector<UINT> VisibleMeshlets;
+    // Indices each visible object takes up in the meshlet index stream.
+    std::vector<UINT> DrawIndexCounts;
+    std::vector<UINT> VisibleChunks;
+    OcclusionStats OcclusionCulling;
+    MeshLodStats LevelOfDetail;
+    MeshletCullStats MeshletCulling;
+};
+
+// Cull the scene as seen through view and projection for a viewport of the given height and draw what is left.
+void SubmitScene(SceneRenderer& renderer, const SceneRenderDevice& device, DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection, float viewportHeight);
@@ -0,0 +1,64 @@
+#pragma once
+#include "Frustum.h"
+
+// Hierarchical loose grid stored as a spatial hash.
+// Each object lives in exactly one cell: the level is picked from the object's
+// size and the cell from its center, so insert, move and remove are O(1).
+// Cells are keyed by level and the Morton code of their coordinates. Queries
+// visit the cells of each populated level that can overlap the query volume.
+
+const UINT SPATIAL_HASH_LEVELS = 16;
+const UINT SPATIAL_HASH_INVALID_INDEX = 0xFFFFFFFF;
+
+struct SpatialCell
+{
+    UINT Level;
+    int X, Y, Z;
+    std::vector<UINT> Objects;
+};
+
+struct SpatialHashObject
+{
+    DirectX::BoundingBox Bounds;
+    UINT Cell;
+    // Position of the object in its cell's object list.
+    UINT Slot;
+};
+
+struct SpatialHash
+{
+    // Size of a level 0 cell; every level doubles it. Cell coordinates are
+    // limited to +-2^19 cells per axis on each level.
+    float BaseCellSize;
+
+    std::unordered_map<uint64_t, UINT> CellLookup;
+    std::vector<SpatialCell> Cells;
+    std::vector<UINT> FreeCells;
+
+    // Indexed by object id. Cell is SPATIAL_HASH_INVALID_INDEX for ids not in the hash.
+    std::vector<SpatialHashObject> Objects;
+
+    UINT LevelObjectCount[SPATIAL_HASH_LEVELS];
+    UINT LevelCellCount[SPATIAL_HASH_LEVELS];
+    // Largest half size stored on each level; widens the cells' loose bounds.
+    float LevelMaxExtent[SPATIAL_HASH_LEVELS];
+
+    // Scratch space for batch moves.
+    std::vector<uint64_t> BatchKeys;
+};
+
+void InitSpatialHash(SpatialHash& hash, float baseCellSize);
+
+void InsertSpatialHashObject(SpatialHash& hash, UINT object, const DirectX::BoundingBox& bounds);
+void MoveSpatialHashObject(SpatialHash& hash, UINT object, const DirectX::BoundingBox& bounds);
+void RemoveSpatialHashObject(SpatialHash& hash, UINT object);
+
+// Move many distinct objects at once. objects[i] gets bounds[i]. Cell keys are computed in
+// parallel and objects that stay in their cell are updated in place; only the
+// objects that change cells are relinked on the calling thread.
+void MoveSpatialHashObjects(SpatialHash& hash, const UINT* objects, const DirectX::BoundingBox* bounds, UINT count);
+
+// Append the objects whose bounds intersect the query volume.
+void QuerySpatialHashBox(const SpatialHash& hash, const DirectX::BoundingBox& box, std::vector<UINT>& results);
+void QuerySpatialHashSphere(const SpatialHash& hash, const DirectX::BoundingSphere& sphere, std::vector<UINT>& results);
+void QuerySpatialHashFrustum(const SpatialHash& hash, const Frustum& frustum, std::vector<UINT>& results);
@@ -0,0 +1,32 @@
+#pragma once
+
+// Sprite vertices.
+// The quads a SpriteBatch draws, and the generation of their vertices: corners
+// are moved from pixels to clip space and paired with their texture
+// coordinates four lanes at a time with DirectXMath, and every corner is
+// written with a single four-float store.
+
+const UINT SPRITE_VERTICES = 4;
+
+struct SpriteVertex
+{
+    // Clip space.
+    DirectX::XMFLOAT2 Position;
+    DirectX::XMFLOAT2 TexCoord;
+    // RGBA8, red in the low byte.
+    uint32_t Color;
+};
+
+// An axis-aligned quad. Rect is left, top, right and bottom in pixels from the top left of the
+// viewport; TexCoords is the same corners in the atlas, as AtlasRegion gives them. Color is
+// packed with PackColor.
+struct Sprite
+{
+    DirectX::XMFLOAT4 Rect;
+    DirectX::XMFLOAT4 TexCoords;
+    uint32_t Color;
+    UINT Atlas;
+};
+
+// Four vertices per sprite, top left, top right, bottom left and bottom right, for a viewport of the given size.
+void GenerateSpriteVertices(const Sprite* sprites, UINT count, float viewportWidth, float viewportHeight, SpriteVertex* vertices);
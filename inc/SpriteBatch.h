@@ -0,0 +1,64 @@
+#pragma once
+#include "Sprite.h"
+
+// Sprite batching.
+// 2D quads for HUDs and overlays are queued during the frame and drawn at
+// the end of it in one pass. The queue is grouped by atlas with a counting
+// sort, so sprites of one atlas keep the order they were queued in and every
+// atlas costs a single indexed draw. Vertices are generated straight into one
+// dynamic vertex buffer, mapped with discard once per flush: corners are
+// moved from pixels to clip space and paired with their texture coordinates
+// four lanes at a time with DirectXMath, and large batches are split across
+// the job system. The indices never change, so they are written once when the
+// batch is created.
+
+const UINT SPRITE_BATCH_MAX_ATLASES = 16;
+const UINT SPRITE_BATCH_DEFAULT_CAPACITY = 65536;
+
+struct SpriteBatchStats
+{
+    UINT Sprites;
+    UINT Draws;
+    // Sprites queued past the batch's capacity, or for an atlas without a view.
+    UINT DroppedSprites;
+    double GenerateTimeMs;
+};
+
+struct SpriteBatch
+{
+    ID3D11Buffer* VertexBuffer = nullptr;
+    ID3D11Buffer* IndexBuffer = nullptr;
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_UNKNOWN;
+    ID3D11InputLayout* InputLayout = nullptr;
+    ID3D11VertexShader* VertexShader = nullptr;
+    ID3D11PixelShader* PixelShader = nullptr;
+    ID3D11BlendState* BlendState = nullptr;
+    ID3D11DepthStencilState* DepthStencilState = nullptr;
+    ID3D11RasterizerState* RasterizerState = nullptr;
+    ID3D11SamplerState* SamplerState = nullptr;
+    // Sprites the vertex buffer holds.
+    UINT Capacity = 0;
+    ID3D11ShaderResourceView* Atlases[SPRITE_BATCH_MAX_ATLASES] = {};
+    std::vector<Sprite> Sprites;
+    // Sprites of the flush grouped by atlas, and where each atlas's group starts.
+    std::vector<Sprite> SortedSprites;
+    UINT AtlasStarts[SPRITE_BATCH_MAX_ATLASES + 1] = {};
+    UINT DroppedSprites = 0;
+};
+
+bool CreateSpriteBatch(ID3D11Device* device, const void* vertexShaderBytecode, size_t vertexShaderSize, const void* pixelShaderBytecode,
+    size_t pixelShaderSize, SpriteBatch& batch, UINT capacity = SPRITE_BATCH_DEFAULT_CAPACITY);
+void ReleaseSpriteBatch(SpriteBatch& batch);
+
+// Bind a view to an atlas slot. The batch does not hold a reference to it.
+void SetSpriteAtlas(SpriteBatch& batch, UINT atlas, ID3D11ShaderResourceView* view);
+
+// Queue a sprite for the next flush.
+void DrawSprite(SpriteBatch& batch, const Sprite& sprite);
+
+// Draw every queued sprite over the current render target and empty the queue. The default blend state is
+// restored afterwards; the other states it sets are left for the next pass to replace.
+bool FlushSprites(ID3D11DeviceContext* deviceContext, SpriteBatch& batch, const D3D11_VIEWPORT& viewport, SpriteBatchStats& stats);
+
+// Sprites generated per second of generation time, in millions.
+double GetSpriteThroughputMQuads(const SpriteBatchStats& stats);
@@ -0,0 +1,94 @@
+#pragma once
+#include "GeometryBuffer.h"
+#include "Frustum.h"
+
+// Static batching of objects that never move.
+// A build step transforms every static object's mesh into world space and
+// merges the objects into chunks: each chunk holds objects of one material,
+// close together in Morton order of their centers, and no more vertices than
+// a budget within what 16-bit indices address. Chunks are uploaded into the shared geometry arenas
+// and culled by their world bounds, so a field of thousands of objects costs
+// one constant buffer update and one DrawIndexed per visible chunk.
+
+// Vertices one chunk may hold; every chunk uses 16-bit indices.
+const UINT STATIC_BATCH_MAX_CHUNK_VERTICES = MESH_INDEX16_VERTEX_LIMIT;
+// Default vertex budget of a chunk. Smaller chunks cull tighter at the cost of more draws.
+const UINT STATIC_BATCH_CHUNK_VERTICES = 0x2000;
+
+// Mesh data, decoded to full precision and in mesh space, that static objects instance.
+struct StaticMeshSource
+{
+    const DirectX::XMFLOAT3* Positions;
+    // Optional; white when null.
+    const DirectX::XMFLOAT4* Colors;
+    UINT VertexCount;
+    // Triangle list indexing the whole vertex range.
+    const uint32_t* Indices;
+    UINT IndexCount;
+};
+
+struct StaticObject
+{
+    // Index of the object's StaticMeshSource.
+    UINT Source;
+    // Objects only share chunks with objects of the same material.
+    UINT Material;
+    DirectX::XMFLOAT4X4 WorldMatrix;
+};
+
+struct StaticBatchChunk
+{
+    UINT Material;
+    DirectX::BoundingBox Bounds;
+    UINT ObjectCount;
+    // Ranges of StaticBatch::Vertices and StaticBatch::Indices until the batch is uploaded.
+    UINT FirstVertex;
+    UINT VertexCount;
+    UINT FirstIndex;
+    UINT IndexCount;
+    // Compact positions are quantized inside the chunk's bounds.
+    DirectX::XMFLOAT3 PositionScale;
+    DirectX::XMFLOAT3 PositionBias;
+    GeometryAllocation Geometry;
+};
+
+struct StaticBatch
+{
+    MeshVertexFormat VertexFormat = MVF_PositionColor;
+    // Chunks sorted by material.
+    std::vector<StaticBatchChunk> Chunks;
+    std::vector<BYTE> Vertices;
+    std::vector<uint16_t> Indices;
+};
+
+struct StaticBatchStats
+{
+    UINT Objects;
+    UINT Materials;
+    UINT Chunks;
+    UINT Vertices;
+    UINT Triangles;
+    double TimeMs;
+};
+
+// Merge the objects into world space chunks of vertexFormat, which must be MVF_PositionColor or
+// MVF_CompactPositionColor. A chunk takes objects until the next one would exceed chunkVertices, up to
+// STATIC_BATCH_MAX_CHUNK_VERTICES. Fails for objects whose mesh alone has more vertices than a chunk holds.
+bool BuildStaticBatch(StaticBatch& batch, MeshVertexFormat vertexFormat, const StaticMeshSource* sources, UINT sourceCount,
+    const StaticObject* objects, UINT objectCount, UINT chunkVertices = STATIC_BATCH_CHUNK_VERTICES, StaticBatchStats* stats = nullptr);
+
+// Upload every chunk into the geometry arenas and drop the CPU copies of the vertices and indices.
+bool UploadStaticBatch(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, StaticBatch& batch);
+void ReleaseStaticBatch(GeometryBuffer& geometry, StaticBatch& batch);
+
+// Append the chunks that intersect the frustum. They stay sorted by material.
+void CullStaticBatch(const StaticBatch& batch, const Frustum& frustum, std::vector<UINT>& visibleChunks);
+
+// Matrix that turns the chunk's vertex buffer positions into world space; the object matrix of the chunk.
+DirectX::XMMATRIX GetStaticChunkMatrix(const StaticBatchChunk& chunk);
+
+// Issue the chunk's DrawIndexed. The arenas of the batch's vertex format and of 16-bit indices must be bound.
+void DrawStaticBatchChunk(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const StaticBatchChunk& chunk);
+
+// Share of per-object draw calls the chunks save, from 0 to 100.
+float GetStaticBatchDrawReductionPercent(const StaticBatchStats& stats);
@@ -0,0 +1,19 @@
+#pragma once
+#include "TextureFile.h"
+
+// A texture resident on the GPU and the view shaders sample it through.
+struct Texture
+{
+    ID3D11Texture2D* Resource = nullptr;
+    ID3D11ShaderResourceView* View = nullptr;
+    TextureFormat Format = TF_RGBA8;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT MipCount = 0;
+};
+
+// Create an immutable texture holding every level of the source, uploaded straight from its memory.
+bool CreateTexture(ID3D11Device* device, const TextureSource& source, Texture& texture);
+// Create a texture whose levels are filled in later by UpdateSubresource or copies from other textures.
+bool CreateEmptyTexture(ID3D11Device* device, TextureFormat format, bool srgb, UINT width, UINT height, UINT mipCount, Texture& texture);
+void ReleaseTexture(Texture& texture);
@@ -0,0 +1,47 @@
+#pragma once
+#include "RectPacker.h"
+#include "TextureCooker.h"
+
+// Texture atlas.
+// Packs many small RGBA8 images into a few square pages at load time so
+// sprites that use any of them draw with one texture bound. Every image is
+// surrounded by a border that repeats its edge texels, so bilinear filtering
+// and the coarser mips of a cooked page do not bleed neighbours into it.
+
+// Where an image ended up. TexCoords are left, top, right and bottom in page UV space.
+struct AtlasRegion
+{
+    UINT Page;
+    UINT X;
+    UINT Y;
+    UINT Width;
+    UINT Height;
+    DirectX::XMFLOAT4 TexCoords;
+};
+
+struct TextureAtlas
+{
+    UINT PageSize = 0;
+    std::vector<TextureImage> Pages;
+    // One region per image, in the order the images were given.
+    std::vector<AtlasRegion> Regions;
+};
+
+struct TextureAtlasStats
+{
+    UINT Images;
+    UINT Pages;
+    // Texels of the images, without their borders, against the texels of the pages.
+    uint64_t ImageTexels;
+    uint64_t PageTexels;
+    double PackTimeMs;
+    double CopyTimeMs;
+};
+
+// Pack the images onto as few pages of pageSize texels a side as they fit on. Fails if an
+// image with its border is larger than a page.
+bool BuildTextureAtlas(const TextureImage* images, UINT imageCount, UINT pageSize, UINT border, TextureAtlas& atlas,
+    TextureAtlasStats* stats = nullptr);
+
+// Share of the page texels the images cover, from 0 to 100.
+float GetTextureAtlasOccupancyPercent(const TextureAtlasStats& stats);
@@ -0,0 +1,96 @@
+#pragma once
+#include "TextureFile.h"
+
+// Texture cooker.
+// Source images are RGBA8. Mip chains are box filtered in linear space: sRGB
+// color is converted to linear floats before texels are averaged and back
+// after, so distant mips keep their brightness, and normal maps are
+// renormalized at every level. Levels are then encoded to BC1, BC3, BC5 or
+// BC7 by block encoders written against DirectXMath vectors: endpoints come
+// from the principal axis of the block's colors, are refined by a least
+// squares fit to the chosen indices, and blocks are encoded in parallel on the
+// job system, one row of blocks per batch. BC7 uses mode 6 only, a single
+// RGBA line with 4-bit indices, which trades the last bit of quality of a full
+// mode search for an encoder fast enough to run at load time.
+
+// Source image, rows of RGBA8 texels with no padding.
+struct TextureImage
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    std::vector<BYTE> Pixels;
+};
+
+// What the texels mean, which decides how mips are filtered.
+enum TextureUsage {
+    // sRGB color, filtered in linear space.
+    TU_Color,
+    // Data filtered as stored, like masks or roughness.
+    TU_Linear,
+    // Tangent space normals in RGB, renormalized after filtering.
+    TU_NormalMap
+};
+
+struct TextureCookSettings
+{
+    TextureFormat Format = TF_BC7;
+    TextureUsage Usage = TU_Color;
+    bool GenerateMips = true;
+};
+
+// Engine-native texture levels built from an image.
+struct CookedTexture
+{
+    TextureFormat Format = TF_RGBA8;
+    bool Srgb = false;
+    UINT Width = 0;
+    UINT Height = 0;
+    std::vector<std::vector<BYTE>> Mips;
+};
+
+struct TextureCookStats
+{
+    UINT MipCount;
+    // Texels of every level.
+    uint64_t Pixels;
+    // The same levels as RGBA8, and as cooked.
+    uint64_t UncompressedBytes;
+    uint64_t CookedBytes;
+    double MipTimeMs;
+    double EncodeTimeMs;
+};
+
+// Read an uncompressed or RLE .tga of 8, 24 or 32 bits per texel already in memory.
+bool ParseTga(const BYTE* data, size_t size, TextureImage& image);
+bool ImportTexture(const wchar_t* path, TextureImage& image);
+
+// Every level of the image down to 1x1, the image itself first.
+void GenerateTextureMips(const TextureImage& image, TextureUsage usage, std::vector<TextureImage>& mips);
+
+// Encode one level. Partial blocks at the right and bottom edges repeat the last texels.
+void EncodeTextureLevel(const TextureImage& level, TextureFormat format, std::vector<BYTE>& encoded);
+
+bool CookTexture(const TextureImage& image, const TextureCookSettings& settings, CookedTexture& cooked, TextureCookStats* stats = nullptr);
+
+// View of a cooked texture for BuildTextureFile and WriteTextureFile.
+TextureSource GetCookedTextureSource(const CookedTexture& cooked);
+
+// Level megapixels encoded per second of encode time.
+double GetTextureEncodeThroughputMPixels(const TextureCookStats& stats);
+// Share of the RGBA8 chain the cooked levels save, from 0 to 100.
+float GetTextureMemorySavedPercent(const TextureCookStats& stats);
+
+// Offline path: import an image and write it out as a single texture file.
+bool CookTextureFile(const wchar_t* sourcePath, const wchar_t* outputPath, const TextureCookSettings& settings, TextureCookStats* stats = nullptr);
+
+// Image to cook into an archive, under its virtual path.
+struct TextureArchiveSource
+{
+    const wchar_t* SourcePath;
+    const wchar_t* ArchivePath;
+    TextureCookSettings Settings;
+};
+
+// Offline path: import and cook every image, then pack the texture files into one asset archive.
+// Stats are summed over the textures.
+bool CookTextureArchive(const wchar_t* archivePath, const TextureArchiveSource* sources, UINT sourceCount, TextureCookStats* stats = nullptr);
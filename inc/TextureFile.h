@@ -0,0 +1,100 @@
+#pragma once
+#include "File.h"
+
+// Versioned binary texture container.
+// The file starts with a TextureFileHeader followed by one TextureFileMip per
+// mip level, most detailed first. Every level is stored exactly as
+// D3D11_SUBRESOURCE_DATA expects it, rows of 4x4 blocks for the block
+// compressed formats, aligned to TEXTURE_FILE_ALIGNMENT, so levels can be
+// uploaded straight from a mapping or an archive entry.
+
+const uint32_t TEXTURE_FILE_MAGIC = 0x58455445; // "ETEX"
+const uint32_t TEXTURE_FILE_VERSION = 1;
+const uint32_t TEXTURE_FILE_ALIGNMENT = 16;
+const UINT TEXTURE_MAX_SIZE = 16384;
+// Mip levels of a TEXTURE_MAX_SIZE texture.
+const UINT TEXTURE_MAX_MIPS = 15;
+
+enum TextureFormat : uint32_t {
+    TF_RGBA8,
+    // RGB in 4 bits per texel, no alpha.
+    TF_BC1,
+    // BC1 color plus interpolated alpha, 8 bits per texel.
+    TF_BC3,
+    // Two independent channels, 8 bits per texel. Used for tangent space normal maps.
+    TF_BC5,
+    // RGBA in 8 bits per texel at higher quality than BC3.
+    TF_BC7,
+    NumTextureFormats
+};
+
+enum TextureFileFlags : uint32_t {
+    // Color is sRGB encoded; sampled through an _SRGB view.
+    TFF_Srgb = 1
+};
+
+bool IsBlockCompressed(TextureFormat format);
+// Bytes per 4x4 block, or per texel for uncompressed formats.
+UINT GetTextureFormatBlockBytes(TextureFormat format);
+UINT GetTextureMipCount(UINT width, UINT height);
+// Bytes per row of texels, or of blocks, and the number of such rows in a level.
+UINT GetTextureRowPitch(TextureFormat format, UINT width);
+UINT GetTextureRowCount(TextureFormat format, UINT height);
+
+struct TextureFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Format;
+    uint32_t Flags;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t MipCount;
+    uint32_t Reserved;
+};
+
+struct TextureFileMip
+{
+    // Offset from the start of the file.
+    uint64_t DataOffset;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t RowPitch;
+    uint32_t RowCount;
+};
+
+struct TextureFile
+{
+    MappedFile File;
+    const TextureFileHeader* Header = nullptr;
+    const TextureFileMip* Mips = nullptr;
+};
+
+// Check a header, then the mip table that follows it, for readers that do not load the whole file.
+bool IsTextureFileHeaderValid(const TextureFileHeader& header, uint64_t fileSize);
+bool IsTextureFileMipTableValid(const TextureFileHeader& header, const TextureFileMip* mips, uint64_t fileSize);
+
+// Map a texture file and validate its header and mip table.
+bool OpenTextureFile(TextureFile& textureFile, const wchar_t* path);
+// Validate a texture file that was read into memory. The contents of data move into the texture file.
+bool OpenTextureFileFromMemory(TextureFile& textureFile, std::vector<BYTE>& data);
+void CloseTextureFile(TextureFile& textureFile);
+
+const void* GetTextureMipData(const TextureFile& textureFile, UINT mip);
+uint64_t GetTextureMipSize(const TextureFile& textureFile, UINT mip);
+
+// In-memory texture to be written out.
+struct TextureSource
+{
+    TextureFormat Format;
+    bool Srgb;
+    UINT Width;
+    UINT Height;
+    UINT MipCount;
+    // Levels laid out as GetTextureRowPitch and GetTextureRowCount describe.
+    const void* Mips[TEXTURE_MAX_MIPS];
+};
+
+// Lay out a texture file in memory, for instance to pack it into an asset archive.
+bool BuildTextureFile(const TextureSource& texture, std::vector<BYTE>& data);
+bool WriteTextureFile(const wchar_t* path, const TextureSource& texture);
@@ -0,0 +1,101 @@
+#pragma once
+#include "Texture.h"
+
+// Texture streaming.
+// Only the mip tail of a streamed texture, its levels of at most
+// TEXTURE_STREAMING_TAIL_SIZE texels a side, stays resident for good. Every
+// frame the renderer requests the finest level each visible object needs,
+// estimated on the CPU from the texel density the texture has on screen at the
+// object's distance. The update trims the requests to the memory budget by
+// dropping the largest wanted level of any texture until they fit, evicts
+// levels nobody wants once keeping them would break the budget, least recently
+// requested textures first, and reads the missing levels through the asset
+// loader, one byte range per texture. Direct3D 11 textures cannot change their
+// mip count, so a texture changes residency by creating a texture of the new
+// range, copying the levels it keeps on the GPU and uploading the new ones.
+// Device work goes through a TextureStreamingDevice, so the residency logic
+// also runs against a mock device without a GPU. Call everything from the main
+// thread, with the asset loader running.
+
+typedef uint32_t StreamedTexture;
+const StreamedTexture STREAMED_TEXTURE_NONE = 0xFFFFFFFF;
+
+// Largest side of the levels that are always resident.
+const UINT TEXTURE_STREAMING_TAIL_SIZE = 64;
+const uint64_t TEXTURE_STREAMING_BUDGET = 256 * 1024 * 1024;
+// Frames a texture still wants its last requested level after its last request.
+const UINT TEXTURE_STREAMING_KEEP_FRAMES = 30;
+
+// The device operations the streamer needs. Mip indices are relative to the texture passed in.
+struct TextureStreamingDevice
+{
+    // Create a texture of mipCount levels, the first width by height, with undefined contents.
+    std::function<bool(TextureFormat format, bool srgb, UINT width, UINT height, UINT mipCount, Texture& texture)> CreateTexture;
+    // Fill a level from memory laid out as in a texture file.
+    std::function<void(Texture& texture, UINT mip, const void* data, UINT rowPitch)> UploadMip;
+    // Copy a level between two textures where the levels have the same size and format.
+    std::function<void(Texture& destination, UINT destinationMip, const Texture& source, UINT sourceMip)> CopyMip;
+    std::function<void(Texture& texture)> ReleaseTexture;
+};
+
+// Streaming device backed by Direct3D 11.
+TextureStreamingDevice GetD3D11TextureStreamingDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+
+void InitTextureStreaming(const TextureStreamingDevice& device, uint64_t budgetBytes = TEXTURE_STREAMING_BUDGET);
+// Cancel pending loads and release every streamed texture.
+void ShutdownTextureStreaming();
+void SetTextureStreamingBudget(uint64_t budgetBytes);
+
+// Read the texture file's header and mip table now and queue a load of its mip tail.
+// Fails if the file is missing or not a valid texture file.
+StreamedTexture RegisterStreamedTexture(const wchar_t* path);
+void UnregisterStreamedTexture(StreamedTexture texture);
+
+// View of the resident levels, or null until the mip tail has loaded.
+ID3D11ShaderResourceView* GetStreamedTextureView(StreamedTexture texture);
+// Most detailed resident level; the mip count while nothing is resident.
+UINT GetStreamedTextureResidentMip(StreamedTexture texture);
+
+// Finest level a texture of the given size needs when one repeat of it spans textureWorldSize world units
+// on an object, seen at the point of worldBounds nearest to the eye. projectionScale comes from GetLodProjectionScale.
+UINT ComputeTextureMip(UINT textureWidth, UINT textureHeight, float textureWorldSize, const DirectX::BoundingBox& worldBounds,
+    DirectX::FXMVECTOR eyePosition, float projectionScale);
+
+// Ask for the level and every coarser one this frame. The finest of a frame's requests counts.
+void RequestStreamedTextureMip(StreamedTexture texture, UINT mip);
+// Request the level ComputeTextureMip picks for an object.
+void RequestStreamedTexture(StreamedTexture texture, float textureWorldSize, const DirectX::BoundingBox& worldBounds,
+    DirectX::FXMVECTOR eyePosition, float projectionScale);
+
+// Fit the frame's requests to the budget, evict and queue loads. Call once per frame after the requests and
+// before UpdateAssetLoader, whose uploads complete the loads.
+void UpdateTextureStreaming();
+
+struct TextureStreamingStats
+{
+    UINT Textures;
+    // Textures with every level their requests ask for resident.
+    UINT ResidentTextures;
+    // Loads queued or in flight.
+    UINT PendingLoads;
+    uint64_t ResidentBytes;
+    // Bytes the latest requests add up to, and what was left of them after trimming to the budget.
+    uint64_t RequestedBytes;
+    uint64_t TargetBytes;
+    uint64_t BudgetBytes;
+    // Frames whose requests were trimmed to the budget, and frames that ended with more resident than the budget.
+    UINT TrimmedFrames;
+    UINT OverrunFrames;
+    UINT LevelsLoaded;
+    UINT LevelsEvicted;
+    UINT FailedLoads;
+    uint64_t BytesLoaded;
+};
+
+// Current residency and totals since streaming started.
+void GetTextureStreamingStats(TextureStreamingStats& stats);
+
+// Share of the textures that have all requested levels resident, from 0 to 100.
+float GetTextureResidencyPercent(const TextureStreamingStats& stats);
+// Resident bytes against the budget; above 100 while the budget is overrun.
+float GetTextureBudgetUsePercent(const TextureStreamingStats& stats);
@@ -0,0 +1,72 @@
+#pragma once
+#include "File.h"
+
+// Virtual filesystem.
+// Content is addressed by virtual paths such as L"shaders/Simple.cso" instead of
+// paths relative to the working directory. Mounts map a virtual directory onto a
+// loose directory on disk or a packed asset archive, or a single virtual file onto
+// bytes in memory, like shader bytecode compiled into the executable. A path is
+// looked up in every mount that covers it, highest priority first, so a patch
+// mounted above the base content overrides only the files it holds. Mounts may
+// change while other threads read; an unmounted archive stays mapped until the
+// files opened through it are closed.
+
+typedef uint32_t VfsMount;
+const VfsMount VFS_MOUNT_NONE = 0xFFFFFFFF;
+
+struct VfsMountData;
+
+// File opened through the VFS.
+struct VfsFile
+{
+    uint64_t Size = 0;
+    // Archive and memory files are read from here; loose files through Loose.
+    const BYTE* Data = nullptr;
+    // Compressed archive entries are decompressed when opened.
+    std::vector<BYTE> Memory;
+    ReadOnlyFile Loose;
+    std::shared_ptr<VfsMountData> Mount;
+};
+
+// The thread calling Init is the one whose I/O stalls are reported in VfsStats::MainThreadBlockedMs.
+void InitVirtualFileSystem();
+// Unmount everything.
+void ShutdownVirtualFileSystem();
+
+// Mount points are virtual directories; L"" is the root. Among mounts of equal priority the latest wins.
+VfsMount MountDirectory(const wchar_t* mountPoint, const wchar_t* directory, int priority = 0);
+// Fails when the archive does not open.
+VfsMount MountArchive(const wchar_t* mountPoint, const wchar_t* archivePath, int priority = 0);
+// Mount one file over bytes in memory. They are not copied and must outlive the mount.
+VfsMount MountMemoryFile(const wchar_t* path, const void* data, uint64_t size, int priority = 0);
+void Unmount(VfsMount mount);
+
+bool VfsFileExists(const wchar_t* path);
+
+// The access pattern tunes the OS read-ahead of loose files and archive mappings.
+bool VfsOpenFile(VfsFile& file, const wchar_t* path, FileAccess access = FA_Normal);
+void VfsCloseFile(VfsFile& file);
+// Fails unless all size bytes at offset are read.
+bool VfsReadFile(VfsFile& file, uint64_t offset, void* data, uint64_t size);
+
+// Open, read and close a whole file.
+bool VfsReadWholeFile(const wchar_t* path, std::vector<BYTE>& data);
+
+// Hint that the file will be read soon so the OS can start fetching it. Does not wait for the data.
+void VfsPrefetch(const wchar_t* path);
+
+struct VfsStats
+{
+    // Files opened, and lookups no mount could serve.
+    UINT Opens;
+    UINT Misses;
+    uint64_t BytesRead;
+    // Time spent inside opens and reads, summed over every thread, and the part of it the main thread waited.
+    double BlockedMs;
+    double MainThreadBlockedMs;
+};
+
+// Totals since the VFS started.
+void GetVfsStats(VfsStats& stats);
+// Counters since the previous call; call once per frame.
+void EndVfsFrame(VfsStats& frameStats);
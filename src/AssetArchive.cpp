@@ -0,0 +1,477 @@
+#include "EchoEngineCore.h"
+#include "AssetArchive.h"
+#include "JobSystem.h"
+
+namespace {
+
+const UINT LZ_MIN_MATCH = 4;
+const UINT LZ_HASH_BITS = 14;
+const uint32_t LZ_MAX_OFFSET = 0xFFFF;
+
+//Lower case ASCII, forward slashes, no leading "./" or slashes, UTF-8.
+std::string NormalizeArchivePath(const wchar_t* path) {
+    std::string result;
+    for (; *path; ++path) {
+        uint32_t c = static_cast<uint32_t>(*path);
+        if (c == '\\') {
+            c = '/';
+        }
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if (c == '/' && (result.empty() || result.back() == '/' || result == ".")) {
+            result.erase(result == "." ? 0 : result.size());
+            continue;
+        }
+
+        if (c < 0x80) {
+            result.push_back(static_cast<char>(c));
+        }
+        else if (c < 0x800) {
+            result.push_back(static_cast<char>(0xC0 | c >> 6));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000) {
+            result.push_back(static_cast<char>(0xE0 | c >> 12));
+            result.push_back(static_cast<char>(0x80 | (c >> 6 & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else {
+            result.push_back(static_cast<char>(0xF0 | c >> 18));
+            result.push_back(static_cast<char>(0x80 | (c >> 12 & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (c >> 6 & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return result;
+}
+
+inline uint64_t HashArchivePath(const std::string& path) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : path) {
+        hash = (hash ^ static_cast<BYTE>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint32_t Read32(const BYTE* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+//Lengths that do not fit their 4-bit token field continue as bytes, 255 meaning more follow.
+inline bool WriteLength(BYTE*& op, const BYTE* oend, size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (op >= oend) {
+            return false;
+        }
+        *op++ = 255;
+    }
+    if (op >= oend) {
+        return false;
+    }
+    *op++ = static_cast<BYTE>(length);
+    return true;
+}
+
+inline bool ReadLength(const BYTE*& ip, const BYTE* iend, size_t& length) {
+    BYTE value;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        value = *ip++;
+        length += value;
+    } while (value == 255);
+    return true;
+}
+
+//A sequence is a token (literal length, match length - LZ_MIN_MATCH), the literals, then a 16-bit
+//offset back into the output and the match. The last sequence carries only literals.
+bool WriteSequence(BYTE*& op, const BYTE* oend, const BYTE* literals, size_t literalLength, uint32_t offset, size_t matchLength) {
+    if (op >= oend) {
+        return false;
+    }
+    size_t matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    *op++ = static_cast<BYTE>(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(matchCode, 15));
+    if (literalLength >= 15 && !WriteLength(op, oend, literalLength - 15)) {
+        return false;
+    }
+    if (static_cast<size_t>(oend - op) < literalLength) {
+        return false;
+    }
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0) {
+        return true;
+    }
+    if (oend - op < 2) {
+        return false;
+    }
+    *op++ = static_cast<BYTE>(offset);
+    *op++ = static_cast<BYTE>(offset >> 8);
+    return matchCode < 15 || WriteLength(op, oend, matchCode - 15);
+}
+
+//Greedy LZ77 with a single hash table probe per position. Returns 0 when the output does not fit.
+size_t CompressLz(const BYTE* src, size_t size, BYTE* dst, size_t capacity) {
+    std::vector<int32_t> table(static_cast<size_t>(1) << LZ_HASH_BITS, -1);
+    BYTE* op = dst;
+    const BYTE* oend = dst + capacity;
+
+    size_t ip = 0;
+    size_t anchor = 0;
+    while (ip + LZ_MIN_MATCH <= size) {
+        uint32_t sequence = Read32(src + ip);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int32_t candidate = table[hash];
+        table[hash] = static_cast<int32_t>(ip);
+        if (candidate < 0 || ip - candidate > LZ_MAX_OFFSET || Read32(src + candidate) != sequence) {
+            ++ip;
+            continue;
+        }
+
+        size_t length = LZ_MIN_MATCH;
+        while (ip + length < size && src[candidate + length] == src[ip + length]) {
+            ++length;
+        }
+        if (!WriteSequence(op, oend, src + anchor, ip - anchor, static_cast<uint32_t>(ip - candidate), length)) {
+            return 0;
+        }
+        ip += length;
+        anchor = ip;
+    }
+
+    if (!WriteSequence(op, oend, src + anchor, size - anchor, 0, 0)) {
+        return 0;
+    }
+    return static_cast<size_t>(op - dst);
+}
+
+//Every read and write is bounds checked, so corrupt chunks fail instead of overrunning.
+bool DecompressLz(const BYTE* src, size_t size, BYTE* dst, size_t dstSize) {
+    const BYTE* ip = src;
+    const BYTE* iend = src + size;
+    BYTE* op = dst;
+    BYTE* oend = dst + dstSize;
+
+    while (ip < iend) {
+        BYTE token = *ip++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(ip, iend, literalLength)) {
+            return false;
+        }
+        if (static_cast<size_t>(iend - ip) < literalLength || static_cast<size_t>(oend - op) < literalLength) {
+            return false;
+        }
+        memcpy(op, ip, literalLength);
+        op += literalLength;
+        ip += literalLength;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | static_cast<size_t>(ip[1]) << 8;
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(ip, iend, matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst) || static_cast<size_t>(oend - op) < matchLength) {
+            return false;
+        }
+
+        //Overlapping matches repeat the bytes just written, so they are copied forwards one at a time.
+        const BYTE* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+        }
+        else {
+            for (size_t i = 0; i < matchLength; ++i) {
+                op[i] = match[i];
+            }
+        }
+        op += matchLength;
+    }
+    return op == oend;
+}
+
+inline uint32_t GetChunkCount(uint64_t size) {
+    return static_cast<uint32_t>((size + ASSET_ARCHIVE_CHUNK_SIZE - 1) / ASSET_ARCHIVE_CHUNK_SIZE);
+}
+
+inline size_t GetChunkSize(uint64_t size, uint32_t chunk) {
+    return static_cast<size_t>(std::min<uint64_t>(ASSET_ARCHIVE_CHUNK_SIZE, size - static_cast<uint64_t>(chunk) * ASSET_ARCHIVE_CHUNK_SIZE));
+}
+
+bool IsEntryValid(const AssetArchive& archive, const AssetArchiveEntry& entry) {
+    if (static_cast<uint64_t>(entry.NameOffset) + entry.NameLength > archive.Header->NamesSize
+        || !IsFileRangeValid(archive.File.Size, entry.DataOffset, entry.StoredSize, ASSET_ARCHIVE_ALIGNMENT)) {
+        return false;
+    }
+    switch (entry.Compression) {
+    case AAC_None:
+        return entry.StoredSize == entry.Size;
+    case AAC_Lz:
+        return entry.ChunkCount == GetChunkCount(entry.Size) && entry.ChunkCount > 0
+            && sizeof(AssetArchiveChunk) * static_cast<uint64_t>(entry.ChunkCount) <= entry.StoredSize;
+    default:
+        return false;
+    }
+}
+
+//Compress an entry into its chunk table and chunks. Returns false when it is better stored.
+bool CompressEntry(const BYTE* data, uint64_t size, std::vector<BYTE>& stored, uint32_t& chunkCount) {
+    chunkCount = GetChunkCount(size);
+    if (chunkCount == 0) {
+        return false;
+    }
+
+    //Chunks are independent, so they compress in parallel into buffers of their raw size.
+    std::vector<std::vector<BYTE>> chunks(chunkCount);
+    ParallelFor(chunkCount, 1, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            size_t chunkSize = GetChunkSize(size, i);
+            const BYTE* source = data + static_cast<size_t>(i) * ASSET_ARCHIVE_CHUNK_SIZE;
+            chunks[i].resize(chunkSize);
+            size_t compressedSize = CompressLz(source, chunkSize, chunks[i].data(), chunkSize - 1);
+            if (compressedSize == 0) {
+                memcpy(chunks[i].data(), source, chunkSize);
+            }
+            else {
+                chunks[i].resize(compressedSize);
+            }
+        }
+    });
+
+    std::vector<AssetArchiveChunk> table(chunkCount);
+    uint64_t offset = sizeof(AssetArchiveChunk) * static_cast<uint64_t>(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        table[i].Offset = static_cast<uint32_t>(offset);
+        table[i].StoredSize = static_cast<uint32_t>(chunks[i].size());
+        offset += chunks[i].size();
+    }
+    if (offset > size - size / 8 || offset > 0xFFFFFFFF) {
+        return false;
+    }
+
+    stored.resize(static_cast<size_t>(offset));
+    memcpy(stored.data(), table.data(), sizeof(AssetArchiveChunk) * table.size());
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        memcpy(stored.data() + table[i].Offset, chunks[i].data(), chunks[i].size());
+    }
+    return true;
+}
+
+}
+
+bool OpenAssetArchive(AssetArchive& archive, const wchar_t* path) {
+    CloseAssetArchive(archive);
+
+    if (!OpenMappedFile(archive.File, path)) {
+        return false;
+    }
+
+    const MappedFile& file = archive.File;
+    const AssetArchiveHeader* header = reinterpret_cast<const AssetArchiveHeader*>(file.Data);
+    if (file.Size < sizeof(AssetArchiveHeader) || header->Magic != ASSET_ARCHIVE_MAGIC || header->Version != ASSET_ARCHIVE_VERSION
+        || header->BucketCount == 0 || (header->BucketCount & (header->BucketCount - 1)) != 0 || header->BucketCount < header->EntryCount
+        || !IsFileRangeValid(file.Size, header->EntriesOffset, sizeof(AssetArchiveEntry) * static_cast<uint64_t>(header->EntryCount), alignof(AssetArchiveEntry))
+        || !IsFileRangeValid(file.Size, header->BucketsOffset, sizeof(uint32_t) * static_cast<uint64_t>(header->BucketCount), alignof(uint32_t))
+        || !IsFileRangeValid(file.Size, header->NamesOffset, header->NamesSize)) {
+        CloseAssetArchive(archive);
+        return false;
+    }
+
+    archive.Header = header;
+    archive.Entries = reinterpret_cast<const AssetArchiveEntry*>(file.Data + header->EntriesOffset);
+    archive.Buckets = reinterpret_cast<const uint32_t*>(file.Data + header->BucketsOffset);
+    archive.Names = reinterpret_cast<const char*>(file.Data + header->NamesOffset);
+
+    for (UINT i = 0; i < header->BucketCount; ++i) {
+        if (archive.Buckets[i] != ASSET_ARCHIVE_ENTRY_NONE && archive.Buckets[i] >= header->EntryCount) {
+            CloseAssetArchive(archive);
+            return false;
+        }
+    }
+    for (UINT i = 0; i < header->EntryCount; ++i) {
+        if (!IsEntryValid(archive, archive.Entries[i])) {
+            CloseAssetArchive(archive);
+            return false;
+        }
+    }
+    return true;
+}
+
+void CloseAssetArchive(AssetArchive& archive) {
+    CloseMappedFile(archive.File);
+    archive.Header = nullptr;
+    archive.Entries = nullptr;
+    archive.Buckets = nullptr;
+    archive.Names = nullptr;
+}
+
+UINT FindAssetArchiveEntry(const AssetArchive& archive, const wchar_t* path) {
+    if (!archive.Header) {
+        return ASSET_ARCHIVE_ENTRY_NONE;
+    }
+
+    std::string name = NormalizeArchivePath(path);
+    uint64_t hash = HashArchivePath(name);
+
+    //Linear probing from the hash's bucket until the entry or an empty bucket turns up.
+    uint32_t mask = archive.Header->BucketCount - 1;
+    uint32_t bucket = static_cast<uint32_t>(hash) & mask;
+    for (UINT probe = 0; probe < archive.Header->BucketCount; ++probe, bucket = (bucket + 1) & mask) {
+        uint32_t index = archive.Buckets[bucket];
+        if (index == ASSET_ARCHIVE_ENTRY_NONE) {
+            break;
+        }
+        const AssetArchiveEntry& entry = archive.Entries[index];
+        if (entry.PathHash == hash && entry.NameLength == name.size() && memcmp(archive.Names + entry.NameOffset, name.data(), name.size()) == 0) {
+            return index;
+        }
+    }
+    return ASSET_ARCHIVE_ENTRY_NONE;
+}
+
+const void* GetAssetArchiveEntryData(const AssetArchive& archive, UINT entry) {
+    assert(archive.Header && entry < archive.Header->EntryCount);
+    const AssetArchiveEntry& archiveEntry = archive.Entries[entry];
+    return archiveEntry.Compression == AAC_None ? archive.File.Data + archiveEntry.DataOffset : nullptr;
+}
+
+bool ReadAssetArchiveEntry(const AssetArchive& archive, UINT entry, std::vector<BYTE>& data) {
+    assert(archive.Header && entry < archive.Header->EntryCount);
+    const AssetArchiveEntry& archiveEntry = archive.Entries[entry];
+    const BYTE* stored = archive.File.Data + archiveEntry.DataOffset;
+
+    if (archiveEntry.Compression == AAC_None) {
+        data.assign(stored, stored + archiveEntry.Size);
+        return true;
+    }
+
+    data.resize(static_cast<size_t>(archiveEntry.Size));
+    const AssetArchiveChunk* chunks = reinterpret_cast<const AssetArchiveChunk*>(stored);
+    uint64_t tableSize = sizeof(AssetArchiveChunk) * static_cast<uint64_t>(archiveEntry.ChunkCount);
+    std::atomic<bool> valid{ true };
+    ParallelFor(archiveEntry.ChunkCount, 1, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            const AssetArchiveChunk& chunk = chunks[i];
+            size_t chunkSize = GetChunkSize(archiveEntry.Size, i);
+            BYTE* output = data.data() + static_cast<size_t>(i) * ASSET_ARCHIVE_CHUNK_SIZE;
+            if (chunk.Offset < tableSize || static_cast<uint64_t>(chunk.Offset) + chunk.StoredSize > archiveEntry.StoredSize) {
+                valid = false;
+            }
+            else if (chunk.StoredSize == chunkSize) {
+                memcpy(output, stored + chunk.Offset, chunkSize);
+            }
+            else if (!DecompressLz(stored + chunk.Offset, chunk.StoredSize, output, chunkSize)) {
+                valid = false;
+            }
+        }
+    });
+
+    if (!valid) {
+        data.clear();
+    }
+    return valid;
+}
+
+bool WriteAssetArchive(const wchar_t* path, const AssetArchiveSource* sources, UINT sourceCount, AssetArchiveWriteStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //Names and the hash table.
+    std::vector<AssetArchiveEntry> entries(sourceCount);
+    std::string names;
+    uint32_t bucketCount = 2;
+    while (bucketCount < sourceCount * 2) {
+        bucketCount *= 2;
+    }
+    std::vector<uint32_t> buckets(bucketCount, ASSET_ARCHIVE_ENTRY_NONE);
+    for (UINT i = 0; i < sourceCount; ++i) {
+        std::string name = NormalizeArchivePath(sources[i].Path);
+        AssetArchiveEntry& entry = entries[i];
+        entry.PathHash = HashArchivePath(name);
+        entry.NameOffset = static_cast<uint32_t>(names.size());
+        entry.NameLength = static_cast<uint32_t>(name.size());
+        names += name;
+
+        uint32_t bucket = static_cast<uint32_t>(entry.PathHash) & (bucketCount - 1);
+        while (buckets[bucket] != ASSET_ARCHIVE_ENTRY_NONE) {
+            const AssetArchiveEntry& other = entries[buckets[bucket]];
+            if (other.PathHash == entry.PathHash && other.NameLength == entry.NameLength
+                && names.compare(other.NameOffset, other.NameLength, name) == 0) {
+                //Two sources with the same path.
+                return false;
+            }
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+        buckets[bucket] = i;
+    }
+
+    //Compress, then lay the data out after the tables on aligned offsets.
+    std::vector<std::vector<BYTE>> storedData(sourceCount);
+    AssetArchiveWriteStats writeStats = { 0 };
+    writeStats.Entries = sourceCount;
+
+    AssetArchiveHeader header = { 0 };
+    header.Magic = ASSET_ARCHIVE_MAGIC;
+    header.Version = ASSET_ARCHIVE_VERSION;
+    header.EntryCount = sourceCount;
+    header.BucketCount = bucketCount;
+    header.EntriesOffset = sizeof(AssetArchiveHeader);
+    header.BucketsOffset = header.EntriesOffset + sizeof(AssetArchiveEntry) * static_cast<uint64_t>(sourceCount);
+    header.NamesOffset = header.BucketsOffset + sizeof(uint32_t) * static_cast<uint64_t>(bucketCount);
+    header.NamesSize = names.size();
+
+    uint64_t offset = header.NamesOffset + header.NamesSize;
+    for (UINT i = 0; i < sourceCount; ++i) {
+        const AssetArchiveSource& source = sources[i];
+        AssetArchiveEntry& entry = entries[i];
+        entry.Size = source.Size;
+        entry.Compression = AAC_None;
+        entry.ChunkCount = 0;
+        if (source.Compress && CompressEntry(static_cast<const BYTE*>(source.Data), source.Size, storedData[i], entry.ChunkCount)) {
+            entry.Compression = AAC_Lz;
+            ++writeStats.CompressedEntries;
+        }
+        entry.StoredSize = entry.Compression == AAC_Lz ? storedData[i].size() : source.Size;
+        entry.DataOffset = AlignFileOffset(offset, ASSET_ARCHIVE_ALIGNMENT);
+        offset = entry.DataOffset + entry.StoredSize;
+        writeStats.Size += entry.Size;
+        writeStats.StoredSize += entry.StoredSize;
+    }
+
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool result = fwrite(&header, sizeof(header), 1, file) == 1
+        && (sourceCount == 0 || fwrite(entries.data(), sizeof(AssetArchiveEntry), entries.size(), file) == entries.size())
+        && fwrite(buckets.data(), sizeof(uint32_t), buckets.size(), file) == buckets.size()
+        && (names.empty() || fwrite(names.data(), 1, names.size(), file) == names.size());
+
+    offset = header.NamesOffset + header.NamesSize;
+    for (UINT i = 0; i < sourceCount && result; ++i) {
+        const void* data = entries[i].Compression == AAC_Lz ? storedData[i].data() : sources[i].Data;
+        size_t size = static_cast<size_t>(entries[i].StoredSize);
+        result = WriteFilePadding(file, offset, ASSET_ARCHIVE_ALIGNMENT) && (size == 0 || fwrite(data, 1, size, file) == size);
+        offset += size;
+    }
+
+    result = fclose(file) == 0 && result;
+
+    writeStats.TimeMs = ElapsedMs(start);
+    if (stats) {
+        *stats = writeStats;
+    }
+    return result;
+}
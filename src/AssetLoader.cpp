@@ -0,0 +1,447 @@
+#include "EchoEngineCore.h"
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "VirtualFileSystem.h"
+
+namespace {
+
+//Handles are a slot index and the slot's generation, so stale handles of reused slots are rejected.
+const UINT ASSET_HANDLE_INDEX_BITS = 20;
+const uint32_t ASSET_HANDLE_INDEX_MASK = (1u << ASSET_HANDLE_INDEX_BITS) - 1;
+const uint32_t ASSET_HANDLE_GENERATION_MASK = 0xFFFFFFFF >> ASSET_HANDLE_INDEX_BITS;
+
+struct AssetSlot
+{
+    std::wstring Path;
+    //Part of the file to read, unless the whole file is.
+    bool WholeFile = true;
+    uint64_t ReadOffset = 0;
+    uint64_t ReadSize = 0;
+    int Priority = 0;
+    AssetState State = AS_Cancelled;
+    bool CancelRequested = false;
+    bool ReleaseRequested = false;
+    bool InUse = false;
+    uint32_t Generation = 0;
+    std::vector<BYTE> Data;
+    AssetDecodeFunction Decode;
+    AssetUploadFunction Upload;
+};
+
+//Queue entries are not removed when their request changes priority or is cancelled; they are skipped when popped.
+struct AssetQueueEntry
+{
+    int Priority;
+    uint64_t Sequence;
+    uint32_t Slot;
+    uint32_t Generation;
+};
+
+//Highest priority first, then first come first served.
+struct AssetQueueOrder
+{
+    bool operator()(const AssetQueueEntry& a, const AssetQueueEntry& b) const {
+        return a.Priority != b.Priority ? a.Priority < b.Priority : a.Sequence > b.Sequence;
+    }
+};
+
+typedef std::priority_queue<AssetQueueEntry, std::vector<AssetQueueEntry>, AssetQueueOrder> AssetQueue;
+
+//Slots are allocated individually so I/O threads and decode jobs can hold on to them while the table grows.
+std::vector<std::unique_ptr<AssetSlot>> g_AssetSlots;
+std::vector<uint32_t> g_FreeAssetSlots;
+AssetQueue g_ReadQueue;
+AssetQueue g_UploadQueue;
+uint64_t g_AssetSequence = 0;
+AssetLoaderStats g_AssetStats = { 0 };
+
+std::vector<std::thread> g_IoThreads;
+std::mutex g_AssetMutex;
+std::condition_variable g_ReadAvailable;
+JobCounter g_DecodeJobs;
+bool g_AssetLoaderRunning = false;
+
+//Read size bytes at offset, failing unless all of them are there.
+bool ReadFileRange(const wchar_t* path, uint64_t offset, uint64_t size, std::vector<BYTE>& data) {
+    VfsFile file;
+    if (!VfsOpenFile(file, path, FA_Random)) {
+        return false;
+    }
+    bool read = offset <= file.Size && size <= file.Size - offset;
+    if (read) {
+        data.resize(static_cast<size_t>(size));
+        read = VfsReadFile(file, offset, data.data(), size);
+    }
+    VfsCloseFile(file);
+    return read;
+}
+
+inline bool IsAssetFinished(AssetState state) {
+    return state == AS_Loaded || state == AS_Failed || state == AS_Cancelled;
+}
+
+//The functions below expect g_AssetMutex to be held.
+
+//Requests sitting in a queue can be finished right away. A running upload has already taken its function.
+inline bool IsAssetWaiting(const AssetSlot& slot) {
+    return slot.State == AS_Queued || (slot.State == AS_Uploading && slot.Upload);
+}
+
+AssetSlot* GetAssetSlot(AssetHandle asset) {
+    uint32_t index = asset & ASSET_HANDLE_INDEX_MASK;
+    if (asset == ASSET_HANDLE_NONE || index >= g_AssetSlots.size()) {
+        return nullptr;
+    }
+    AssetSlot* slot = g_AssetSlots[index].get();
+    return slot->InUse && slot->Generation == asset >> ASSET_HANDLE_INDEX_BITS ? slot : nullptr;
+}
+
+void PushAssetEntry(AssetQueue& queue, uint32_t index) {
+    const AssetSlot& slot = *g_AssetSlots[index];
+    AssetQueueEntry entry = { slot.Priority, g_AssetSequence++, index, slot.Generation };
+    queue.push(entry);
+}
+
+//Pop entries until one still matches its request, which must be in the given state.
+AssetSlot* PopAssetEntry(AssetQueue& queue, AssetState state, uint32_t& index) {
+    while (!queue.empty()) {
+        AssetQueueEntry entry = queue.top();
+        queue.pop();
+        AssetSlot* slot = g_AssetSlots[entry.Slot].get();
+        if (slot->InUse && slot->Generation == entry.Generation && slot->State == state && slot->Priority == entry.Priority) {
+            index = entry.Slot;
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+void FreeAssetSlot(uint32_t index) {
+    AssetSlot& slot = *g_AssetSlots[index];
+    slot.InUse = false;
+    slot.Generation = (slot.Generation + 1) & ASSET_HANDLE_GENERATION_MASK;
+    slot.Path.clear();
+    g_FreeAssetSlots.push_back(index);
+}
+
+void FinishAsset(uint32_t index, AssetState state) {
+    AssetSlot& slot = *g_AssetSlots[index];
+    slot.State = state;
+    //Drop the file and whatever the functions captured as soon as the request is done.
+    std::vector<BYTE>().swap(slot.Data);
+    slot.Decode = nullptr;
+    slot.Upload = nullptr;
+
+    --g_AssetStats.Pending;
+    switch (state) {
+    case AS_Loaded:
+        ++g_AssetStats.Loaded;
+        break;
+    case AS_Failed:
+        ++g_AssetStats.Failed;
+        break;
+    default:
+        ++g_AssetStats.Cancelled;
+        break;
+    }
+
+    if (slot.ReleaseRequested) {
+        FreeAssetSlot(index);
+    }
+}
+
+void DecodeAsset(AssetSlot* slot, uint32_t index) {
+    bool cancelled;
+    {
+        std::lock_guard<std::mutex> lock(g_AssetMutex);
+        cancelled = slot->CancelRequested;
+    }
+
+    //Only this job touches the data and the decode function until the request leaves AS_Decoding.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool decoded = cancelled || !slot->Decode || slot->Decode(slot->Data);
+    double decodeTime = ElapsedMs(start);
+
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    g_AssetStats.DecodeTimeMs += decodeTime;
+    if (slot->CancelRequested) {
+        FinishAsset(index, AS_Cancelled);
+    }
+    else if (!decoded) {
+        FinishAsset(index, AS_Failed);
+    }
+    else if (!slot->Upload) {
+        FinishAsset(index, AS_Loaded);
+    }
+    else {
+        std::vector<BYTE>().swap(slot->Data);
+        slot->State = AS_Uploading;
+        PushAssetEntry(g_UploadQueue, index);
+    }
+}
+
+void IoThreadMain() {
+    for (;;) {
+        AssetSlot* slot;
+        uint32_t index;
+        std::wstring path;
+        bool wholeFile;
+        uint64_t readOffset;
+        uint64_t readSize;
+        std::wstring nextPath;
+        {
+            std::unique_lock<std::mutex> lock(g_AssetMutex);
+            g_ReadAvailable.wait(lock, [] { return !g_AssetLoaderRunning || !g_ReadQueue.empty(); });
+            if (!g_AssetLoaderRunning) {
+                return;
+            }
+            slot = PopAssetEntry(g_ReadQueue, AS_Queued, index);
+            if (!slot) {
+                continue;
+            }
+            slot->State = AS_Reading;
+            path = slot->Path;
+            wholeFile = slot->WholeFile;
+            readOffset = slot->ReadOffset;
+            readSize = slot->ReadSize;
+
+            //Let the OS fetch the next read while this one runs; a stale entry only costs a wasted hint.
+            //The hint covers the whole file, so it is only given for whole file reads.
+            if (!g_ReadQueue.empty()) {
+                const AssetQueueEntry& next = g_ReadQueue.top();
+                const AssetSlot& nextSlot = *g_AssetSlots[next.Slot];
+                if (nextSlot.InUse && nextSlot.Generation == next.Generation && nextSlot.State == AS_Queued && nextSlot.WholeFile) {
+                    nextPath = nextSlot.Path;
+                }
+            }
+        }
+
+        if (!nextPath.empty()) {
+            VfsPrefetch(nextPath.c_str());
+            nextPath.clear();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<BYTE> data;
+        bool read = wholeFile ? VfsReadWholeFile(path.c_str(), data) : ReadFileRange(path.c_str(), readOffset, readSize, data);
+        double readTime = ElapsedMs(start);
+
+        {
+            std::lock_guard<std::mutex> lock(g_AssetMutex);
+            g_AssetStats.ReadTimeMs += readTime;
+            g_AssetStats.BytesRead += data.size();
+            if (slot->CancelRequested) {
+                FinishAsset(index, AS_Cancelled);
+                continue;
+            }
+            if (!read) {
+                FinishAsset(index, AS_Failed);
+                continue;
+            }
+            slot->Data.swap(data);
+            slot->State = AS_Decoding;
+        }
+
+        //Decoding is CPU work, so it leaves the I/O thread free for the next read.
+        RunJob(g_DecodeJobs, [slot, index] { DecodeAsset(slot, index); });
+    }
+}
+
+}
+
+void InitAssetLoader(UINT ioThreadCount) {
+    assert(g_IoThreads.empty());
+
+    g_AssetStats = AssetLoaderStats();
+    g_AssetLoaderRunning = true;
+    ioThreadCount = std::max<UINT>(ioThreadCount, 1);
+    for (UINT i = 0; i < ioThreadCount; ++i) {
+        g_IoThreads.push_back(std::thread(IoThreadMain));
+    }
+}
+
+void ShutdownAssetLoader() {
+    {
+        std::lock_guard<std::mutex> lock(g_AssetMutex);
+        g_AssetLoaderRunning = false;
+        for (uint32_t i = 0; i < g_AssetSlots.size(); ++i) {
+            AssetSlot& slot = *g_AssetSlots[i];
+            if (!slot.InUse || IsAssetFinished(slot.State)) {
+                continue;
+            }
+            if (IsAssetWaiting(slot)) {
+                FinishAsset(i, AS_Cancelled);
+            }
+            else {
+                slot.CancelRequested = true;
+            }
+        }
+    }
+    g_ReadAvailable.notify_all();
+
+    for (std::thread& ioThread : g_IoThreads) {
+        ioThread.join();
+    }
+    g_IoThreads.clear();
+    WaitForCounter(g_DecodeJobs);
+
+    g_AssetSlots.clear();
+    g_FreeAssetSlots.clear();
+    g_ReadQueue = AssetQueue();
+    g_UploadQueue = AssetQueue();
+}
+
+AssetHandle LoadAsset(const wchar_t* path, int priority, AssetDecodeFunction decode, AssetUploadFunction upload) {
+    return LoadAssetRange(path, 0, UINT64_MAX, priority, std::move(decode), std::move(upload));
+}
+
+AssetHandle LoadAssetRange(const wchar_t* path, uint64_t offset, uint64_t size, int priority, AssetDecodeFunction decode, AssetUploadFunction upload) {
+    AssetHandle asset;
+    {
+        std::lock_guard<std::mutex> lock(g_AssetMutex);
+        assert(g_AssetLoaderRunning);
+
+        uint32_t index;
+        if (!g_FreeAssetSlots.empty()) {
+            index = g_FreeAssetSlots.back();
+            g_FreeAssetSlots.pop_back();
+        }
+        else {
+            index = static_cast<uint32_t>(g_AssetSlots.size());
+            if (index > ASSET_HANDLE_INDEX_MASK) {
+                return ASSET_HANDLE_NONE;
+            }
+            g_AssetSlots.push_back(std::unique_ptr<AssetSlot>(new AssetSlot()));
+        }
+
+        AssetSlot& slot = *g_AssetSlots[index];
+        slot.Path = path;
+        slot.WholeFile = offset == 0 && size == UINT64_MAX;
+        slot.ReadOffset = offset;
+        slot.ReadSize = size;
+        slot.Priority = priority;
+        slot.State = AS_Queued;
+        slot.CancelRequested = false;
+        slot.ReleaseRequested = false;
+        slot.InUse = true;
+        slot.Decode = std::move(decode);
+        slot.Upload = std::move(upload);
+        ++g_AssetStats.Pending;
+        PushAssetEntry(g_ReadQueue, index);
+        asset = slot.Generation << ASSET_HANDLE_INDEX_BITS | index;
+    }
+    g_ReadAvailable.notify_one();
+    return asset;
+}
+
+void SetAssetPriority(AssetHandle asset, int priority) {
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    AssetSlot* slot = GetAssetSlot(asset);
+    if (!slot || slot->Priority == priority) {
+        return;
+    }
+
+    //Requests waiting in a queue get a new entry; the old one no longer matches and is skipped.
+    slot->Priority = priority;
+    if (slot->State == AS_Queued) {
+        PushAssetEntry(g_ReadQueue, asset & ASSET_HANDLE_INDEX_MASK);
+    }
+    else if (slot->State == AS_Uploading) {
+        PushAssetEntry(g_UploadQueue, asset & ASSET_HANDLE_INDEX_MASK);
+    }
+}
+
+void CancelAsset(AssetHandle asset) {
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    AssetSlot* slot = GetAssetSlot(asset);
+    if (!slot || IsAssetFinished(slot->State)) {
+        return;
+    }
+
+    if (IsAssetWaiting(*slot)) {
+        FinishAsset(asset & ASSET_HANDLE_INDEX_MASK, AS_Cancelled);
+    }
+    else {
+        slot->CancelRequested = true;
+    }
+}
+
+AssetState GetAssetState(AssetHandle asset) {
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    AssetSlot* slot = GetAssetSlot(asset);
+    return slot ? slot->State : AS_Failed;
+}
+
+void ReleaseAsset(AssetHandle asset) {
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    AssetSlot* slot = GetAssetSlot(asset);
+    if (!slot) {
+        return;
+    }
+
+    uint32_t index = asset & ASSET_HANDLE_INDEX_MASK;
+    if (IsAssetWaiting(*slot)) {
+        FinishAsset(index, AS_Cancelled);
+    }
+    if (IsAssetFinished(slot->State)) {
+        FreeAssetSlot(index);
+    }
+    else {
+        //The I/O thread, decode job or upload that owns the request frees the slot when it finishes.
+        slot->CancelRequested = true;
+        slot->ReleaseRequested = true;
+    }
+}
+
+UINT UpdateAssetLoader(ID3D11Device* device, ID3D11DeviceContext* deviceContext, double budgetMs) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    UINT uploads = 0;
+
+    for (;;) {
+        uint32_t index;
+        AssetUploadFunction upload;
+        {
+            std::lock_guard<std::mutex> lock(g_AssetMutex);
+            if (uploads > 0 && ElapsedMs(start) >= budgetMs) {
+                break;
+            }
+            AssetSlot* slot = PopAssetEntry(g_UploadQueue, AS_Uploading, index);
+            if (!slot) {
+                break;
+            }
+            //Taking the function marks the upload as running; it can no longer be cancelled.
+            upload = std::move(slot->Upload);
+            slot->Upload = nullptr;
+        }
+
+        std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+        bool uploaded = upload(device, deviceContext);
+        double uploadTime = ElapsedMs(uploadStart);
+        upload = nullptr;
+
+        std::lock_guard<std::mutex> lock(g_AssetMutex);
+        g_AssetStats.UploadTimeMs += uploadTime;
+        FinishAsset(index, uploaded ? AS_Loaded : AS_Failed);
+        ++uploads;
+    }
+
+    return uploads;
+}
+
+void FlushAssetLoader(ID3D11Device* device, ID3D11DeviceContext* deviceContext) {
+    for (;;) {
+        UpdateAssetLoader(device, deviceContext, DBL_MAX);
+        {
+            std::lock_guard<std::mutex> lock(g_AssetMutex);
+            if (g_AssetStats.Pending == 0) {
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void GetAssetLoaderStats(AssetLoaderStats& stats) {
+    std::lock_guard<std::mutex> lock(g_AssetMutex);
+    stats = g_AssetStats;
+}
@@ -0,0 +1,571 @@
+#include "EchoEngineCore.h"
+#include "BVH.h"
+using namespace DirectX;
+
+namespace {
+
+const UINT BVH_BIN_COUNT = 16;
+
+struct AABB
+{
+    XMFLOAT3 Min;
+    XMFLOAT3 Max;
+};
+
+struct Bin
+{
+    AABB Bounds;
+    UINT Count;
+};
+
+//Node of the intermediate binary tree produced by the SAH build.
+struct BuildNode
+{
+    AABB Bounds;
+    UINT Left;
+    UINT Right;
+    UINT First;
+    UINT Count;
+};
+
+inline float Component(const XMFLOAT3& v, int axis) {
+    return (&v.x)[axis];
+}
+
+inline void ResetAABB(AABB& box) {
+    box.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+    box.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+inline void GrowAABB(AABB& box, const XMFLOAT3& point) {
+    box.Min.x = std::min<float>(box.Min.x, point.x);
+    box.Min.y = std::min<float>(box.Min.y, point.y);
+    box.Min.z = std::min<float>(box.Min.z, point.z);
+    box.Max.x = std::max<float>(box.Max.x, point.x);
+    box.Max.y = std::max<float>(box.Max.y, point.y);
+    box.Max.z = std::max<float>(box.Max.z, point.z);
+}
+
+inline void GrowAABB(AABB& box, const AABB& other) {
+    GrowAABB(box, other.Min);
+    GrowAABB(box, other.Max);
+}
+
+inline float SurfaceArea(const AABB& box) {
+    float dx = box.Max.x - box.Min.x;
+    float dy = box.Max.y - box.Min.y;
+    float dz = box.Max.z - box.Min.z;
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+inline AABB ToAABB(const BoundingBox& box) {
+    AABB result;
+    result.Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+    result.Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+    return result;
+}
+
+void InitNode(BVHNode& node, UINT parent, UINT parentSlot) {
+    //Empty slots get inverted bounds so every vector test rejects them.
+    node.MinX = node.MinY = node.MinZ = XMFLOAT4(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+    node.MaxX = node.MaxY = node.MaxZ = XMFLOAT4(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (UINT i = 0; i < BVH_WIDTH; ++i) {
+        node.Child[i] = BVH_INVALID_INDEX;
+        node.First[i] = 0;
+        node.Count[i] = 0;
+    }
+    node.Parent = parent;
+    node.ParentSlot = parentSlot;
+}
+
+inline void SetSlotBounds(BVHNode& node, UINT slot, const AABB& box) {
+    (&node.MinX.x)[slot] = box.Min.x;
+    (&node.MinY.x)[slot] = box.Min.y;
+    (&node.MinZ.x)[slot] = box.Min.z;
+    (&node.MaxX.x)[slot] = box.Max.x;
+    (&node.MaxY.x)[slot] = box.Max.y;
+    (&node.MaxZ.x)[slot] = box.Max.z;
+}
+
+inline AABB GetNodeBounds(const BVHNode& node) {
+    AABB box;
+    box.Min.x = std::min<float>(std::min<float>(node.MinX.x, node.MinX.y), std::min<float>(node.MinX.z, node.MinX.w));
+    box.Min.y = std::min<float>(std::min<float>(node.MinY.x, node.MinY.y), std::min<float>(node.MinY.z, node.MinY.w));
+    box.Min.z = std::min<float>(std::min<float>(node.MinZ.x, node.MinZ.y), std::min<float>(node.MinZ.z, node.MinZ.w));
+    box.Max.x = std::max<float>(std::max<float>(node.MaxX.x, node.MaxX.y), std::max<float>(node.MaxX.z, node.MaxX.w));
+    box.Max.y = std::max<float>(std::max<float>(node.MaxY.x, node.MaxY.y), std::max<float>(node.MaxY.z, node.MaxY.w));
+    box.Max.z = std::max<float>(std::max<float>(node.MaxZ.x, node.MaxZ.y), std::max<float>(node.MaxZ.z, node.MaxZ.w));
+    return box;
+}
+
+//Traversal stack shared by all queries issued from one thread.
+std::vector<UINT>& TraversalStack() {
+    static thread_local std::vector<UINT> stack;
+    stack.clear();
+    return stack;
+}
+
+//Build a binary tree with a binned surface area heuristic. objects is partitioned in place.
+void BuildBinaryTree(std::vector<BuildNode>& nodes, std::vector<UINT>& objects, const std::vector<AABB>& boxes, const std::vector<XMFLOAT3>& centroids) {
+    UINT count = static_cast<UINT>(objects.size());
+    nodes.clear();
+    nodes.reserve(2 * count);
+
+    BuildNode root;
+    root.Left = root.Right = BVH_INVALID_INDEX;
+    root.First = 0;
+    root.Count = count;
+    nodes.push_back(root);
+
+    std::vector<UINT> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        UINT nodeIndex = stack.back();
+        stack.pop_back();
+
+        UINT first = nodes[nodeIndex].First;
+        UINT nodeCount = nodes[nodeIndex].Count;
+
+        AABB bounds, centroidBounds;
+        ResetAABB(bounds);
+        ResetAABB(centroidBounds);
+        for (UINT i = first; i < first + nodeCount; ++i) {
+            GrowAABB(bounds, boxes[objects[i]]);
+            GrowAABB(centroidBounds, centroids[objects[i]]);
+        }
+        nodes[nodeIndex].Bounds = bounds;
+
+        if (nodeCount <= 1) {
+            continue;
+        }
+
+        //Evaluate the binned SAH cost on all three axes.
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        UINT bestSplit = 0;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float centroidMin = Component(centroidBounds.Min, axis);
+            float centroidMax = Component(centroidBounds.Max, axis);
+            if (centroidMax - centroidMin <= 1e-6f) {
+                continue;
+            }
+            float binScale = BVH_BIN_COUNT / (centroidMax - centroidMin);
+
+            Bin bins[BVH_BIN_COUNT];
+            for (UINT b = 0; b < BVH_BIN_COUNT; ++b) {
+                ResetAABB(bins[b].Bounds);
+                bins[b].Count = 0;
+            }
+            for (UINT i = first; i < first + nodeCount; ++i) {
+                UINT b = std::min<UINT>(BVH_BIN_COUNT - 1, static_cast<UINT>((Component(centroids[objects[i]], axis) - centroidMin) * binScale));
+                bins[b].Count++;
+                GrowAABB(bins[b].Bounds, boxes[objects[i]]);
+            }
+
+            //Sweep from the right to get the cost of everything above each split plane.
+            float rightArea[BVH_BIN_COUNT - 1];
+            UINT rightCount[BVH_BIN_COUNT - 1];
+            AABB accum;
+            ResetAABB(accum);
+            UINT accumCount = 0;
+            for (UINT b = BVH_BIN_COUNT - 1; b > 0; --b) {
+                GrowAABB(accum, bins[b].Bounds);
+                accumCount += bins[b].Count;
+                rightArea[b - 1] = SurfaceArea(accum);
+                rightCount[b - 1] = accumCount;
+            }
+
+            ResetAABB(accum);
+            accumCount = 0;
+            for (UINT b = 0; b < BVH_BIN_COUNT - 1; ++b) {
+                GrowAABB(accum, bins[b].Bounds);
+                accumCount += bins[b].Count;
+                if (accumCount == 0 || rightCount[b] == 0) {
+                    continue;
+                }
+                float cost = SurfaceArea(accum) * accumCount + rightArea[b] * rightCount[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        //Traversal and intersection are both given unit cost.
+        float leafCost = SurfaceArea(bounds) * nodeCount;
+        float splitCost = SurfaceArea(bounds) + bestCost;
+        if (nodeCount <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || leafCost <= splitCost)) {
+            continue;
+        }
+
+        UINT middle = first + nodeCount / 2;
+        if (bestAxis >= 0) {
+            float centroidMin = Component(centroidBounds.Min, bestAxis);
+            float binScale = BVH_BIN_COUNT / (Component(centroidBounds.Max, bestAxis) - centroidMin);
+            std::vector<UINT>::iterator it = std::partition(objects.begin() + first, objects.begin() + first + nodeCount, [&](UINT object) {
+                UINT b = std::min<UINT>(BVH_BIN_COUNT - 1, static_cast<UINT>((Component(centroids[object], bestAxis) - centroidMin) * binScale));
+                return b <= bestSplit;
+            });
+            middle = static_cast<UINT>(it - objects.begin());
+        }
+        //Coincident centroids leave nothing to split on, so fall back to halving the range.
+        if (middle == first || middle == first + nodeCount) {
+            middle = first + nodeCount / 2;
+        }
+
+        BuildNode left, right;
+        left.Left = left.Right = right.Left = right.Right = BVH_INVALID_INDEX;
+        left.First = first;
+        left.Count = middle - first;
+        right.First = middle;
+        right.Count = first + nodeCount - middle;
+
+        nodes[nodeIndex].Left = static_cast<UINT>(nodes.size());
+        nodes.push_back(left);
+        nodes[nodeIndex].Right = static_cast<UINT>(nodes.size());
+        nodes.push_back(right);
+
+        stack.push_back(nodes[nodeIndex].Left);
+        stack.push_back(nodes[nodeIndex].Right);
+    }
+}
+
+//Recompute the slot bounds of a node from its objects and children.
+void RefitNode(BVH& bvh, UINT nodeIndex, const BoundingBox* bounds) {
+    BVHNode& node = bvh.Nodes[nodeIndex];
+    for (UINT slot = 0; slot < BVH_WIDTH; ++slot) {
+        if (node.Count[slot] == 0) {
+            continue;
+        }
+
+        AABB box;
+        if (node.Child[slot] == BVH_INVALID_INDEX) {
+            ResetAABB(box);
+            for (UINT i = node.First[slot]; i < node.First[slot] + node.Count[slot]; ++i) {
+                GrowAABB(box, ToAABB(bounds[bvh.Objects[i]]));
+            }
+        }
+        else {
+            box = GetNodeBounds(bvh.Nodes[node.Child[slot]]);
+        }
+        SetSlotBounds(node, slot, box);
+    }
+}
+
+inline void AppendRange(const BVH& bvh, UINT first, UINT count, std::vector<UINT>& results) {
+    results.insert(results.end(), bvh.Objects.begin() + first, bvh.Objects.begin() + first + count);
+}
+
+}
+
+void BuildBVH(BVH& bvh, const BoundingBox* bounds, UINT count) {
+    bvh.Nodes.clear();
+    bvh.Objects.resize(count);
+    bvh.ObjectNode.assign(count, BVH_INVALID_INDEX);
+    bvh.DirtyNodes.clear();
+    bvh.DirtyFlags.clear();
+
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<AABB> boxes(count);
+    std::vector<XMFLOAT3> centroids(count);
+    for (UINT i = 0; i < count; ++i) {
+        boxes[i] = ToAABB(bounds[i]);
+        centroids[i] = bounds[i].Center;
+        bvh.Objects[i] = i;
+    }
+
+    std::vector<BuildNode> buildNodes;
+    BuildBinaryTree(buildNodes, bvh.Objects, boxes, centroids);
+
+    //Collapse the binary tree into 4-wide nodes by repeatedly opening the
+    //inner child with the largest surface area until all slots are used.
+    struct CollapseEntry
+    {
+        UINT BuildIndex;
+        UINT NodeIndex;
+    };
+    std::vector<CollapseEntry> stack;
+
+    bvh.Nodes.reserve(buildNodes.size() / 2 + 1);
+    bvh.Nodes.push_back(BVHNode());
+    InitNode(bvh.Nodes[0], BVH_INVALID_INDEX, 0);
+    CollapseEntry rootEntry = { 0, 0 };
+    stack.push_back(rootEntry);
+
+    while (!stack.empty()) {
+        CollapseEntry entry = stack.back();
+        stack.pop_back();
+
+        UINT slots[BVH_WIDTH];
+        UINT slotCount = 0;
+        const BuildNode& buildNode = buildNodes[entry.BuildIndex];
+        if (buildNode.Left == BVH_INVALID_INDEX) {
+            slots[slotCount++] = entry.BuildIndex;
+        }
+        else {
+            slots[slotCount++] = buildNode.Left;
+            slots[slotCount++] = buildNode.Right;
+        }
+
+        while (slotCount < BVH_WIDTH) {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (UINT i = 0; i < slotCount; ++i) {
+                const BuildNode& candidate = buildNodes[slots[i]];
+                if (candidate.Left != BVH_INVALID_INDEX && SurfaceArea(candidate.Bounds) > largestArea) {
+                    largestArea = SurfaceArea(candidate.Bounds);
+                    largest = static_cast<int>(i);
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            UINT opened = slots[largest];
+            slots[largest] = buildNodes[opened].Left;
+            slots[slotCount++] = buildNodes[opened].Right;
+        }
+
+        for (UINT slot = 0; slot < slotCount; ++slot) {
+            const BuildNode& child = buildNodes[slots[slot]];
+            UINT childIndex = BVH_INVALID_INDEX;
+
+            if (child.Left == BVH_INVALID_INDEX) {
+                for (UINT i = child.First; i < child.First + child.Count; ++i) {
+                    bvh.ObjectNode[bvh.Objects[i]] = entry.NodeIndex;
+                }
+            }
+            else {
+                childIndex = static_cast<UINT>(bvh.Nodes.size());
+                bvh.Nodes.push_back(BVHNode());
+                InitNode(bvh.Nodes[childIndex], entry.NodeIndex, slot);
+                CollapseEntry childEntry = { slots[slot], childIndex };
+                stack.push_back(childEntry);
+            }
+
+            BVHNode& node = bvh.Nodes[entry.NodeIndex];
+            node.Child[slot] = childIndex;
+            node.First[slot] = child.First;
+            node.Count[slot] = child.Count;
+            SetSlotBounds(node, slot, child.Bounds);
+        }
+    }
+}
+
+void RefitBVH(BVH& bvh, const BoundingBox* bounds) {
+    //Children always follow their parent, so a reverse sweep visits them first.
+    for (size_t i = bvh.Nodes.size(); i-- > 0;) {
+        RefitNode(bvh, static_cast<UINT>(i), bounds);
+    }
+}
+
+void RefitBVH(BVH& bvh, const BoundingBox* bounds, const UINT* movedObjects, UINT movedCount) {
+    bvh.DirtyFlags.resize(bvh.Nodes.size(), 0);
+    bvh.DirtyNodes.clear();
+
+    //Mark every node on the path from the moved objects to the root once.
+    for (UINT i = 0; i < movedCount; ++i) {
+        UINT nodeIndex = bvh.ObjectNode[movedObjects[i]];
+        while (nodeIndex != BVH_INVALID_INDEX && !bvh.DirtyFlags[nodeIndex]) {
+            bvh.DirtyFlags[nodeIndex] = 1;
+            bvh.DirtyNodes.push_back(nodeIndex);
+            nodeIndex = bvh.Nodes[nodeIndex].Parent;
+        }
+    }
+
+    std::sort(bvh.DirtyNodes.begin(), bvh.DirtyNodes.end(), [](UINT a, UINT b) { return a > b; });
+    for (size_t i = 0; i < bvh.DirtyNodes.size(); ++i) {
+        RefitNode(bvh, bvh.DirtyNodes[i], bounds);
+        bvh.DirtyFlags[bvh.DirtyNodes[i]] = 0;
+    }
+    bvh.DirtyNodes.clear();
+}
+
+void CullBVH(const BVH& bvh, const BoundingBox* bounds, const Frustum& frustum, std::vector<UINT>& visibleObjects) {
+    if (bvh.Nodes.empty()) {
+        return;
+    }
+
+    std::vector<UINT>& stack = TraversalStack();
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.Nodes[stack.back()];
+        stack.pop_back();
+
+        XMVECTOR minX = XMLoadFloat4(&node.MinX);
+        XMVECTOR minY = XMLoadFloat4(&node.MinY);
+        XMVECTOR minZ = XMLoadFloat4(&node.MinZ);
+        XMVECTOR maxX = XMLoadFloat4(&node.MaxX);
+        XMVECTOR maxY = XMLoadFloat4(&node.MaxY);
+        XMVECTOR maxZ = XMLoadFloat4(&node.MaxZ);
+
+        XMVECTOR outside = XMVectorFalseInt();
+        XMVECTOR intersecting = XMVectorFalseInt();
+        XMVECTOR zero = XMVectorZero();
+
+        for (int i = 0; i < NumFrustumPlanes; ++i) {
+            const XMFLOAT4& p = frustum.Planes[i];
+
+            //The corner furthest along the plane normal decides rejection, the nearest one containment.
+            XMVECTOR farDistance = XMVectorReplicate(p.w);
+            farDistance = XMVectorMultiplyAdd(p.x >= 0.0f ? maxX : minX, XMVectorReplicate(p.x), farDistance);
+            farDistance = XMVectorMultiplyAdd(p.y >= 0.0f ? maxY : minY, XMVectorReplicate(p.y), farDistance);
+            farDistance = XMVectorMultiplyAdd(p.z >= 0.0f ? maxZ : minZ, XMVectorReplicate(p.z), farDistance);
+
+            XMVECTOR nearDistance = XMVectorReplicate(p.w);
+            nearDistance = XMVectorMultiplyAdd(p.x >= 0.0f ? minX : maxX, XMVectorReplicate(p.x), nearDistance);
+            nearDistance = XMVectorMultiplyAdd(p.y >= 0.0f ? minY : maxY, XMVectorReplicate(p.y), nearDistance);
+            nearDistance = XMVectorMultiplyAdd(p.z >= 0.0f ? minZ : maxZ, XMVectorReplicate(p.z), nearDistance);
+
+            outside = XMVectorOrInt(outside, XMVectorLess(farDistance, zero));
+            intersecting = XMVectorOrInt(intersecting, XMVectorLess(nearDistance, zero));
+        }
+
+        XMUINT4 outsideMask, intersectingMask;
+        XMStoreUInt4(&outsideMask, outside);
+        XMStoreUInt4(&intersectingMask, intersecting);
+
+        for (UINT slot = 0; slot < BVH_WIDTH; ++slot) {
+            if (node.Count[slot] == 0 || (&outsideMask.x)[slot]) {
+                continue;
+            }
+
+            if (!(&intersectingMask.x)[slot]) {
+                //Fully inside: the whole subtree is visible without further tests.
+                AppendRange(bvh, node.First[slot], node.Count[slot], visibleObjects);
+            }
+            else if (node.Child[slot] != BVH_INVALID_INDEX) {
+                stack.push_back(node.Child[slot]);
+            }
+            else {
+                for (UINT i = node.First[slot]; i < node.First[slot] + node.Count[slot]; ++i) {
+                    if (TestFrustumBox(frustum, bounds[bvh.Objects[i]]) != DISJOINT) {
+                        visibleObjects.push_back(bvh.Objects[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool RaycastBVH(const BVH& bvh, const BoundingBox* bounds, FXMVECTOR origin, FXMVECTOR direction, float maxDistance, UINT& hitObject, float& hitDistance) {
+    hitObject = BVH_INVALID_INDEX;
+    hitDistance = maxDistance;
+
+    if (bvh.Nodes.empty()) {
+        return false;
+    }
+
+    //Avoid infinities (and 0 * inf) for axis aligned rays.
+    XMFLOAT3 dir, invDir;
+    XMStoreFloat3(&dir, direction);
+    invDir.x = 1.0f / (fabsf(dir.x) > 1e-12f ? dir.x : (dir.x < 0.0f ? -1e-12f : 1e-12f));
+    invDir.y = 1.0f / (fabsf(dir.y) > 1e-12f ? dir.y : (dir.y < 0.0f ? -1e-12f : 1e-12f));
+    invDir.z = 1.0f / (fabsf(dir.z) > 1e-12f ? dir.z : (dir.z < 0.0f ? -1e-12f : 1e-12f));
+
+    XMVECTOR originX = XMVectorSplatX(origin);
+    XMVECTOR originY = XMVectorSplatY(origin);
+    XMVECTOR originZ = XMVectorSplatZ(origin);
+    XMVECTOR invDirX = XMVectorReplicate(invDir.x);
+    XMVECTOR invDirY = XMVectorReplicate(invDir.y);
+    XMVECTOR invDirZ = XMVectorReplicate(invDir.z);
+    XMVECTOR zero = XMVectorZero();
+
+    std::vector<UINT>& stack = TraversalStack();
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.Nodes[stack.back()];
+        stack.pop_back();
+
+        XMVECTOR t0x = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MinX), originX), invDirX);
+        XMVECTOR t1x = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MaxX), originX), invDirX);
+        XMVECTOR t0y = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MinY), originY), invDirY);
+        XMVECTOR t1y = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MaxY), originY), invDirY);
+        XMVECTOR t0z = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MinZ), originZ), invDirZ);
+        XMVECTOR t1z = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&node.MaxZ), originZ), invDirZ);
+
+        XMVECTOR tNear = XMVectorMax(XMVectorMax(XMVectorMin(t0x, t1x), XMVectorMin(t0y, t1y)), XMVectorMin(t0z, t1z));
+        XMVECTOR tFar = XMVectorMin(XMVectorMin(XMVectorMax(t0x, t1x), XMVectorMax(t0y, t1y)), XMVectorMax(t0z, t1z));
+
+        XMVECTOR hit = XMVectorAndInt(XMVectorGreaterOrEqual(tFar, XMVectorMax(tNear, zero)), XMVectorLessOrEqual(tNear, XMVectorReplicate(hitDistance)));
+        XMUINT4 hitMask;
+        XMStoreUInt4(&hitMask, hit);
+
+        for (UINT slot = 0; slot < BVH_WIDTH; ++slot) {
+            if (node.Count[slot] == 0 || !(&hitMask.x)[slot]) {
+                continue;
+            }
+
+            if (node.Child[slot] != BVH_INVALID_INDEX) {
+                stack.push_back(node.Child[slot]);
+                continue;
+            }
+
+            for (UINT i = node.First[slot]; i < node.First[slot] + node.Count[slot]; ++i) {
+                float distance;
+                UINT object = bvh.Objects[i];
+                if (bounds[object].Intersects(origin, direction, distance)) {
+                    distance = std::max<float>(distance, 0.0f);
+                    if (distance < hitDistance) {
+                        hitDistance = distance;
+                        hitObject = object;
+                    }
+                }
+            }
+        }
+    }
+
+    return hitObject != BVH_INVALID_INDEX;
+}
+
+void QueryBVHPoint(const BVH& bvh, const BoundingBox* bounds, FXMVECTOR point, std::vector<UINT>& results) {
+    if (bvh.Nodes.empty()) {
+        return;
+    }
+
+    XMVECTOR pointX = XMVectorSplatX(point);
+    XMVECTOR pointY = XMVectorSplatY(point);
+    XMVECTOR pointZ = XMVectorSplatZ(point);
+
+    std::vector<UINT>& stack = TraversalStack();
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.Nodes[stack.back()];
+        stack.pop_back();
+
+        XMVECTOR inside = XMVectorAndInt(XMVectorLessOrEqual(XMLoadFloat4(&node.MinX), pointX), XMVectorLessOrEqual(pointX, XMLoadFloat4(&node.MaxX)));
+        inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorLessOrEqual(XMLoadFloat4(&node.MinY), pointY), XMVectorLessOrEqual(pointY, XMLoadFloat4(&node.MaxY))));
+        inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorLessOrEqual(XMLoadFloat4(&node.MinZ), pointZ), XMVectorLessOrEqual(pointZ, XMLoadFloat4(&node.MaxZ))));
+
+        XMUINT4 insideMask;
+        XMStoreUInt4(&insideMask, inside);
+
+        for (UINT slot = 0; slot < BVH_WIDTH; ++slot) {
+            if (node.Count[slot] == 0 || !(&insideMask.x)[slot]) {
+                continue;
+            }
+
+            if (node.Child[slot] != BVH_INVALID_INDEX) {
+                stack.push_back(node.Child[slot]);
+                continue;
+            }
+
+            for (UINT i = node.First[slot]; i < node.First[slot] + node.Count[slot]; ++i) {
+                if (bounds[bvh.Objects[i]].Contains(point) != DISJOINT) {
+                    results.push_back(bvh.Objects[i]);
+                }
+            }
+        }
+    }
+}
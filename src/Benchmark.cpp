@@ -0,0 +1,171 @@
+#include "EchoEngineCore.h"
+#include "Benchmark.h"
+#include "File.h"
+
+namespace {
+
+//Whole values print without fractions, times in milliseconds and ratios with them.
+inline int GetPrintPrecision(double value) {
+    return value == floor(value) ? 0 : 4;
+}
+
+inline const char* SkipSpaces(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        ++p;
+    }
+    return p;
+}
+
+}
+
+std::string GetBenchmarkScene(const BenchmarkMetric& metric) {
+    return metric.Name.substr(0, metric.Name.find('.'));
+}
+
+void AddBenchmarkMetric(std::vector<BenchmarkMetric>& metrics, const char* scene, const char* name, double value, BenchmarkMetricKind kind) {
+    BenchmarkMetric metric;
+    metric.Name = std::string(scene) + "." + name;
+    metric.Kind = kind;
+    metric.Value = value;
+    metrics.push_back(metric);
+}
+
+void AddBenchmarkTimes(std::vector<BenchmarkMetric>& metrics, const char* scene, const HdrHistogram& nanoseconds) {
+    AddBenchmarkMetric(metrics, scene, "ms_p50", GetHdrPercentile(nanoseconds, 50.0) * 0.000001, BMK_Time);
+    AddBenchmarkMetric(metrics, scene, "ms_p95", GetHdrPercentile(nanoseconds, 95.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, scene, "ms_max", nanoseconds.Max * 0.000001, BMK_Info);
+}
+
+void AddBenchmarkCounters(std::vector<BenchmarkMetric>& metrics, const char* scene, const RenderCounters& counters) {
+    AddBenchmarkMetric(metrics, scene, "draws", counters.Draws);
+    AddBenchmarkMetric(metrics, scene, "triangles", static_cast<double>(counters.Triangles));
+    AddBenchmarkMetric(metrics, scene, "state_binds", counters.StateBinds);
+    AddBenchmarkMetric(metrics, scene, "redundant_state_binds", counters.RedundantStateBinds);
+    AddBenchmarkMetric(metrics, scene, "shader_switches", counters.ShaderSwitches);
+    AddBenchmarkMetric(metrics, scene, "upload_bytes", static_cast<double>(counters.UploadBytes));
+}
+
+bool WriteBenchmarkBaseline(const wchar_t* path, const std::vector<BenchmarkMetric>& metrics) {
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        const BenchmarkMetric& metric = metrics[i];
+        //Enough digits that every value reads back exactly.
+        fprintf(file, "  \"%s\": %.17g%s\n", metric.Name.c_str(), metric.Value, i + 1 < metrics.size() ? "," : "");
+    }
+    fprintf(file, "}\n");
+
+    bool result = !ferror(file);
+    return fclose(file) == 0 && result;
+}
+
+bool ReadBenchmarkBaseline(const wchar_t* path, std::vector<BenchmarkMetric>& metrics) {
+    std::vector<BYTE> data;
+    if (!ReadWholeFile(path, data)) {
+        return false;
+    }
+    data.push_back(0);
+
+    //Names are plain identifiers and dots, so a member is a quoted name, a colon and a number.
+    metrics.clear();
+    const char* p = SkipSpaces(reinterpret_cast<const char*>(data.data()));
+    if (*p != '{') {
+        return false;
+    }
+    p = SkipSpaces(p + 1);
+    while (*p == '"') {
+        const char* nameEnd = strchr(p + 1, '"');
+        if (!nameEnd) {
+            return false;
+        }
+        BenchmarkMetric metric;
+        metric.Name.assign(p + 1, nameEnd);
+        metric.Kind = BMK_Info;
+
+        p = SkipSpaces(nameEnd + 1);
+        if (*p != ':') {
+            return false;
+        }
+        char* valueEnd = nullptr;
+        metric.Value = strtod(p + 1, &valueEnd);
+        if (valueEnd == p + 1) {
+            return false;
+        }
+        metrics.push_back(metric);
+
+        p = SkipSpaces(valueEnd);
+        if (*p == ',') {
+            p = SkipSpaces(p + 1);
+        }
+    }
+    return *p == '}';
+}
+
+UINT CompareBenchmarkMetrics(const std::vector<BenchmarkMetric>& baseline, const std::vector<BenchmarkMetric>& metrics, float thresholdPercent,
+    std::vector<BenchmarkComparison>& comparisons) {
+    std::unordered_map<std::string, const BenchmarkMetric*> baselineMetrics;
+    for (const BenchmarkMetric& metric : baseline) {
+        baselineMetrics[metric.Name] = &metric;
+    }
+    std::unordered_map<std::string, const BenchmarkMetric*> currentMetrics;
+    for (const BenchmarkMetric& metric : metrics) {
+        currentMetrics[metric.Name] = &metric;
+    }
+
+    UINT regressions = 0;
+    comparisons.clear();
+    for (const BenchmarkMetric& metric : metrics) {
+        BenchmarkComparison comparison = { &metric, nullptr, 0.0, false };
+        auto found = baselineMetrics.find(metric.Name);
+        if (found != baselineMetrics.end()) {
+            comparison.Baseline = found->second;
+            double baselineValue = comparison.Baseline->Value;
+            if (baselineValue > 0.0) {
+                comparison.ChangePercent = (metric.Value - baselineValue) / baselineValue * 100.0;
+            }
+            else if (metric.Value > 0.0) {
+                comparison.ChangePercent = 100.0;
+            }
+
+            if (metric.Kind == BMK_Time) {
+                comparison.Regressed = comparison.ChangePercent > thresholdPercent && metric.Value - baselineValue > BENCHMARK_MIN_REGRESSION_MS;
+            }
+            else if (metric.Kind == BMK_Count) {
+                comparison.Regressed = metric.Value > baselineValue;
+            }
+        }
+        if (comparison.Regressed) {
+            ++regressions;
+        }
+        comparisons.push_back(comparison);
+    }
+    for (const BenchmarkMetric& metric : baseline) {
+        if (currentMetrics.find(metric.Name) == currentMetrics.end()) {
+            comparisons.push_back({ nullptr, &metric, 0.0, true });
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+void PrintBenchmarkComparisons(FILE* file, const std::vector<BenchmarkComparison>& comparisons) {
+    fprintf(file, "%-40s %14s %14s %9s\n", "metric", "baseline", "current", "change");
+    for (const BenchmarkComparison& comparison : comparisons) {
+        if (!comparison.Metric) {
+            const BenchmarkMetric& baseline = *comparison.Baseline;
+            fprintf(file, "%-40s %14.*f %14s %9s  MISSING\n", baseline.Name.c_str(), GetPrintPrecision(baseline.Value), baseline.Value, "-", "-");
+            continue;
+        }
+        const BenchmarkMetric& metric = *comparison.Metric;
+        if (!comparison.Baseline) {
+            fprintf(file, "%-40s %14s %14.*f %9s  new\n", metric.Name.c_str(), "-", GetPrintPrecision(metric.Value), metric.Value, "-");
+            continue;
+        }
+        fprintf(file, "%-40s %14.*f %14.*f %+8.1f%%%s\n", metric.Name.c_str(), GetPrintPrecision(comparison.Baseline->Value), comparison.Baseline->Value,
+            GetPrintPrecision(metric.Value), metric.Value, comparison.ChangePercent, comparison.Regressed ? "  REGRESSED" : "");
+    }
+}
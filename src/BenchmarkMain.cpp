@@ -0,0 +1,2420 @@
+#include "EchoEngineCore.h"
+#include "Benchmark.h"
+#include "Scene.h"
+#include "BVH.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+#include "Meshlet.h"
+#include "StaticBatch.h"
+#include "SceneRenderer.h"
+#include "MeshImporter.h"
+#include "GpuTimer.h"
+#include "TextureStreaming.h"
+#include "MeshLod.h"
+#include "TextureCooker.h"
+#include "AssetLoader.h"
+#include "VirtualFileSystem.h"
+#include "OffsetAllocator.h"
+#include "AssetArchive.h"
+#include "RectPacker.h"
+#include "Sprite.h"
+#include "GlyphCache.h"
+#include "DebugDraw.h"
+#include "Profiler.h"
+using namespace DirectX;
+
+namespace {
+
+const wchar_t* BENCHMARK_BASELINE_PATH = L"EchoEngineBenchmark.json";
+//Frames run before timing starts, so caches and the job system's threads are warm.
+const UINT BENCHMARK_WARMUP_FRAMES = 4;
+
+//Scenes that take microseconds a frame time batches of frames, so each sample is well above the clock's resolution.
+const UINT SINGLE_CUBE_SAMPLES = 200;
+const UINT SINGLE_CUBE_FRAMES_PER_SAMPLE = 100;
+const UINT INSTANCED_CUBES_SAMPLES = 200;
+const UINT INSTANCED_CUBES_FRAMES_PER_SAMPLE = 20;
+const UINT INSTANCED_CUBES_SIDE = 100;
+const UINT STATIC_BATCH_SAMPLES = 5;
+const UINT STATIC_BATCH_OBJECTS = 100000;
+const UINT STATIC_BATCH_MATERIALS = 4;
+const float STATIC_BATCH_FIELD_SIZE = 1000.0f;
+//Chunk vertex budgets compared besides the default.
+const UINT STATIC_BATCH_BUDGETS[] = { 0x10000, 0x400 };
+const UINT CULLED_OBJECTS_SAMPLES = 60;
+const UINT CULLED_OBJECTS_SIDE = 317;
+//Every this many objects one moves each frame.
+const UINT CULLED_OBJECTS_MOVE_STRIDE = 100;
+const UINT MESH_IMPORT_SAMPLES = 7;
+const UINT OBJ_IMPORT_SAMPLES = 5;
+//Quads a side of the imported grid, about 62 MB of text.
+const UINT OBJ_IMPORT_GRID_SIDE = 700;
+const UINT MESH_LAYOUT_SAMPLES = 5;
+const UINT MESHLET_CULL_SAMPLES = 50;
+const UINT MESH_LOD_SAMPLES = 1;
+//The level whose color boundary is measured, and the distances the selector is asked about.
+const UINT MESH_LOD_BOUNDARY_LEVEL = 2;
+const float MESH_LOD_DISTANCES[] = { 3.0f, 6.0f, 25.0f };
+//Rings and segments of the clustered sphere, a million triangles.
+const UINT MESHLET_CULL_RINGS = 512;
+const UINT MESHLET_CULL_SEGMENTS = 1024;
+const UINT MESH_LOAD_SAMPLES = 7;
+const UINT MESH_OPTIMIZE_SAMPLES = 3;
+//Quads a side of the optimized sphere, two million triangles.
+const UINT MESH_OPTIMIZE_SIDE = 1024;
+//Files of the mesh_load scenes, written to the working directory and removed after.
+const wchar_t MESH_LOAD_OBJ_PATH[] = L"EchoEngineBenchmark.mesh_load.obj";
+const wchar_t MESH_LOAD_MESH_PATH[] = L"EchoEngineBenchmark.mesh_load.emesh";
+const UINT BVH_OBJECTS = 1000000;
+//Objects are spread over a cube this many units wide.
+const float BVH_FIELD_SIZE = 2000.0f;
+const UINT BVH_BUILD_SAMPLES = 3;
+const UINT BVH_REFIT_SAMPLES = 20;
+//Every this many objects one moves each frame of the incremental refit.
+const UINT BVH_REFIT_MOVE_STRIDE = 16;
+const UINT BVH_CULL_SAMPLES = 20;
+const UINT BVH_RAYCAST_SAMPLES = 10;
+const UINT BVH_RAYS = 2000;
+//Rays checked against a scan of every object before timing.
+const UINT BVH_CHECKED_RAYS = 16;
+const UINT SPATIAL_HASH_OBJECTS = 200000;
+const float SPATIAL_HASH_FIELD_SIZE = 500.0f;
+const float SPATIAL_HASH_CELL_SIZE = 2.0f;
+//Box and sphere queries a frame, besides one frustum.
+const UINT SPATIAL_HASH_QUERIES = 64;
+const UINT SPATIAL_HASH_SAMPLES = 20;
+//Distinct streamed texture files, each registered many times over in the timed part of the scene.
+const UINT TEXTURE_STREAMING_FILES = 20;
+const UINT TEXTURE_STREAMING_TEXTURES = 2000;
+const UINT TEXTURE_STREAMING_SIZE = 1024;
+const uint64_t TEXTURE_STREAMING_TEST_BUDGET = 24ull << 20;
+const UINT TEXTURE_STREAMING_SAMPLES = 200;
+const UINT ASSET_LOADER_SAMPLES = 3;
+const UINT ASSET_LOADER_FILES = 800;
+const UINT ASSET_LOADER_FILE_SIZE = 256 << 10;
+//Hash passes over every file, standing in for transcoding at about 1.6 ms a file.
+const UINT ASSET_LOADER_DECODE_PASSES = 4;
+//I/O thread counts tried besides the default.
+const UINT ASSET_LOADER_IO_THREADS[] = { 1, 4 };
+const wchar_t ASSET_LOADER_MOUNT_POINT[] = L"benchmark";
+const UINT ASSET_ARCHIVE_SAMPLES = 3;
+const UINT ASSET_ARCHIVE_FILES = 2000;
+const wchar_t ASSET_ARCHIVE_PATH[] = L"EchoEngineBenchmark.asset_archive.epak";
+const wchar_t ASSET_ARCHIVE_STORED_PATH[] = L"EchoEngineBenchmark.asset_archive.stored.epak";
+const UINT TEXTURE_COOK_SAMPLES = 2;
+const UINT TEXTURE_COOK_SIZE = 2048;
+const UINT OFFSET_ALLOCATOR_SAMPLES = 20;
+//Ranges allocated and freed per sample, up to OFFSET_ALLOCATOR_MAX_SIZE each, out of a 1 GB allocator.
+const UINT OFFSET_ALLOCATOR_RANGES = 100000;
+const UINT OFFSET_ALLOCATOR_MAX_SIZE = 4096;
+const uint32_t OFFSET_ALLOCATOR_SIZE = 1u << 30;
+const UINT RECT_PACK_SAMPLES = 50;
+//Rects of RECT_PACK_MIN_SIZE to RECT_PACK_MAX_SIZE pixels a side packed into one RECT_PACK_SIZE page.
+const UINT RECT_PACK_RECTS = 2000;
+const UINT RECT_PACK_MIN_SIZE = 4;
+const UINT RECT_PACK_MAX_SIZE = 32;
+const UINT RECT_PACK_SIZE = 1024;
+//More rects of RECT_PACK_SATURATED_MIN_SIZE to RECT_PACK_MAX_SIZE pixels than fit on a RECT_PACK_SATURATED_SIZE page.
+const UINT RECT_PACK_SATURATED_RECTS = 4000;
+const UINT RECT_PACK_SATURATED_MIN_SIZE = 8;
+const UINT RECT_PACK_SATURATED_SIZE = 512;
+const UINT SPRITE_VERTICES_SAMPLES = 20;
+const UINT SPRITE_VERTICES_FRAMES_PER_SAMPLE = 10;
+const UINT SPRITE_VERTICES_SPRITES = 50000;
+const float SPRITE_VERTICES_VIEWPORT_WIDTH = 1920.0f;
+const float SPRITE_VERTICES_VIEWPORT_HEIGHT = 1080.0f;
+const UINT TEXT_LAYOUT_SAMPLES = 50;
+const UINT TEXT_LAYOUT_FRAMES_PER_SAMPLE = 10;
+//Lines of at least TEXT_LAYOUT_LINE_BYTES bytes on the page, about what fills 1920x1080 at 16 pixels a line.
+const UINT TEXT_LAYOUT_LINES = 67;
+const UINT TEXT_LAYOUT_LINE_BYTES = 230;
+const UINT DEBUG_DRAW_SAMPLES = 50;
+const UINT DEBUG_DRAW_LINES = 100000;
+//Twelve lines a box, so the boxes add up to about as many lines.
+const UINT DEBUG_DRAW_BOXES = DEBUG_DRAW_LINES / 12;
+const UINT FRAME_STATS_SAMPLES = 5;
+//Synthetic frames recorded per sample, one in FRAME_STATS_SPIKE_INTERVAL of them a spike.
+const UINT FRAME_STATS_FRAMES = 100000;
+const UINT FRAME_STATS_SPIKE_INTERVAL = 1000;
+//Values spread log-uniformly from 1 to e^20 to check the histogram's percentiles against.
+const UINT HDR_HISTOGRAM_VALUES = 1000000;
+const UINT PROFILER_SAMPLES = 50;
+//Zones a frame opens, fewer than a ring holds so none are dropped between frame marks.
+const UINT PROFILER_ZONES = 10000;
+//Most a zone may cost while recording, besides its two clock reads, which can take tens of nanoseconds each where a
+//virtual machine traps the time stamp counter.
+const double PROFILER_ZONE_BUDGET_NS = 50.0;
+//Rings and segments of the imported sphere, about half a million triangles.
+const UINT MESH_IMPORT_RINGS = 384;
+const UINT MESH_IMPORT_SEGMENTS = 768;
+
+//The demo's cube: eight colored corners, front faces clockwise.
+const XMFLOAT3 CUBE_POSITIONS[] = {
+    XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, -1.0f, -1.0f),
+    XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, -1.0f, 1.0f)
+};
+const XMFLOAT4 CUBE_COLORS[] = {
+    XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f), XMFLOAT4(1.0f, 1.0f, 0.0f, 1.0f), XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f),
+    XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f), XMFLOAT4(0.0f, 1.0f, 1.0f, 1.0f), XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), XMFLOAT4(1.0f, 0.0f, 1.0f, 1.0f)
+};
+const uint32_t CUBE_INDICES[] = {
+    0, 1, 2, 0, 2, 3,
+    4, 6, 5, 4, 7, 6,
+    4, 5, 1, 4, 1, 0,
+    3, 2, 6, 3, 6, 7,
+    1, 5, 6, 1, 6, 2,
+    4, 0, 3, 4, 3, 7
+};
+const UINT CUBE_VERTEX_COUNT = _countof(CUBE_POSITIONS);
+const UINT CUBE_INDEX_COUNT = _countof(CUBE_INDICES);
+
+//Frames are timed as on a device, through the GPU timer's software backend.
+GpuTimer g_GpuTimer;
+HdrHistogram g_GpuNanoseconds;
+
+//Xorshift, so every platform generates the same scenes.
+inline uint32_t NextBenchmarkRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+inline float GetBenchmarkRandom(uint32_t& state, float min, float max) {
+    return min + (max - min) * (NextBenchmarkRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+//Boxes of random size scattered over a cube of the given width around the origin.
+void GenerateBenchmarkBoxes(std::vector<BoundingBox>& boxes, UINT count, float fieldSize, uint32_t seed) {
+    uint32_t state = seed;
+    boxes.resize(count);
+    for (BoundingBox& box : boxes) {
+        float half = fieldSize * 0.5f;
+        box.Center = XMFLOAT3(GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half));
+        box.Extents = XMFLOAT3(GetBenchmarkRandom(state, 0.1f, 3.0f), GetBenchmarkRandom(state, 0.1f, 3.0f), GetBenchmarkRandom(state, 0.1f, 3.0f));
+    }
+}
+
+//The demo's camera and projection at 1280x720.
+const float BENCHMARK_VIEWPORT_HEIGHT = 720.0f;
+
+XMMATRIX GetBenchmarkView(FXMVECTOR eyePosition, FXMVECTOR focusPoint) {
+    return XMMatrixLookAtLH(eyePosition, focusPoint, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+XMMATRIX GetBenchmarkProjection() {
+    return XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 1280.0f / BENCHMARK_VIEWPORT_HEIGHT, 0.1f, 100.0f);
+}
+
+//Run a frame as one frame of the GPU timer, and record the GPU time of the earlier frame it resolves.
+void RunTimedFrame(const std::function<void(UINT)>& frame, UINT frameIndex) {
+    UINT resolvedFrames = g_GpuTimer.Stats.ResolvedFrames;
+    BeginGpuTimerFrame(g_GpuTimer);
+    if (g_GpuTimer.Stats.ResolvedFrames != resolvedFrames) {
+        RecordHdrValue(g_GpuNanoseconds, static_cast<uint64_t>(g_GpuTimer.Stats.FrameMs * 1000000.0 + 0.5));
+    }
+    frame(frameIndex);
+    EndGpuTimerFrame(g_GpuTimer);
+}
+
+//Time samples of framesPerSample frames after the warmup ones, in nanoseconds per frame. The counters are those of the last frame.
+void MeasureFrames(UINT samples, UINT framesPerSample, const std::function<void(UINT)>& frame, HdrHistogram& nanoseconds, RenderCounters& counters,
+    UINT warmupFrames = BENCHMARK_WARMUP_FRAMES) {
+    InvalidateRenderStateCache();
+    for (UINT i = 0; i < warmupFrames; ++i) {
+        RunTimedFrame(frame, i);
+    }
+    ResetHdrHistogram(g_GpuNanoseconds);
+
+    UINT frameIndex = warmupFrames;
+    for (UINT sample = 0; sample < samples; ++sample) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (UINT i = 0; i < framesPerSample; ++i) {
+            BeginRenderCountersFrame();
+            RunTimedFrame(frame, frameIndex++);
+        }
+        RecordHdrValue(nanoseconds, static_cast<uint64_t>(ElapsedMs(start) * 1000000.0 / framesPerSample + 0.5));
+    }
+    GetRenderCounters(counters);
+}
+
+//Add the scene's times, and its counters and GPU time if it submits draws, and print its median.
+void AddSceneMetrics(std::vector<BenchmarkMetric>& metrics, const char* scene, const HdrHistogram& nanoseconds, const RenderCounters* counters) {
+    AddBenchmarkTimes(metrics, scene, nanoseconds);
+    if (counters) {
+        AddBenchmarkCounters(metrics, scene, *counters);
+        AddBenchmarkMetric(metrics, scene, "gpu_ms_p50", GetHdrPercentile(g_GpuNanoseconds, 50.0) * 0.000001, BMK_Info);
+    }
+    printf("%-16s %8llu samples, median %.4f ms\n", scene, static_cast<unsigned long long>(nanoseconds.TotalCount),
+        GetHdrPercentile(nanoseconds, 50.0) * 0.000001);
+}
+
+//One spinning cube: the per-frame cost of the demo with nothing in it, through scene culling and meshlet culling.
+bool RunSingleCube(std::vector<BenchmarkMetric>& metrics) {
+    MeshletMesh meshlets;
+    BuildMeshlets(meshlets, CUBE_INDICES, CUBE_INDEX_COUNT, CUBE_POSITIONS, sizeof(XMFLOAT3), CUBE_VERTEX_COUNT);
+
+    BoundingBox cubeBounds;
+    BoundingBox::CreateFromPoints(cubeBounds, CUBE_VERTEX_COUNT, CUBE_POSITIONS, sizeof(XMFLOAT3));
+    Scene scene;
+    InitScene(scene, SI_BVH);
+    UINT cube = AddSceneObject(scene, XMMatrixIdentity(), cubeBounds);
+
+    XMMATRIX view = GetBenchmarkView(XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f), XMVectorZero());
+    XMMATRIX projection = GetBenchmarkProjection();
+    SceneRenderer renderer;
+    renderer.Objects = &scene;
+    renderer.Meshlets = &meshlets;
+    renderer.Timer = &g_GpuTimer;
+    SceneRenderDevice device = CreateHeadlessSceneRenderDevice(CUBE_INDEX_COUNT);
+
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(SINGLE_CUBE_SAMPLES, SINGLE_CUBE_FRAMES_PER_SAMPLE, [&](UINT frame) {
+        SetSceneObjectTransform(scene, cube, XMMatrixRotationAxis(XMVectorSet(0.0f, 1.0f, 1.0f, 0.0f), XMConvertToRadians(frame * 0.9f)));
+        UpdateScene(scene);
+        SubmitScene(renderer, device, view, projection, BENCHMARK_VIEWPORT_HEIGHT);
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, "single_cube", nanoseconds, &counters);
+    return !renderer.VisibleObjects.empty();
+}
+
+//A field of cubes that never move, merged into static batch chunks and drawn one chunk at a time.
+bool RunInstancedCubes(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<StaticObject> objects;
+    for (UINT z = 0; z < INSTANCED_CUBES_SIDE; ++z) {
+        for (UINT x = 0; x < INSTANCED_CUBES_SIDE; ++x) {
+            StaticObject object;
+            object.Source = 0;
+            object.Material = (x + z) & 1;
+            XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(0.4f, 0.4f, 0.4f),
+                XMMatrixTranslation(x - INSTANCED_CUBES_SIDE * 0.5f, -2.0f, static_cast<float>(z)));
+            XMStoreFloat4x4(&object.WorldMatrix, world);
+            objects.push_back(object);
+        }
+    }
+
+    StaticMeshSource cubeSource = { CUBE_POSITIONS, CUBE_COLORS, CUBE_VERTEX_COUNT, CUBE_INDICES, CUBE_INDEX_COUNT };
+    StaticBatch batch;
+    if (!BuildStaticBatch(batch, MVF_PositionColor, &cubeSource, 1, objects.data(), static_cast<UINT>(objects.size()))) {
+        return false;
+    }
+
+    XMMATRIX view = GetBenchmarkView(XMVectorSet(0.0f, 6.0f, -12.0f, 1.0f), XMVectorSet(0.0f, -2.0f, 20.0f, 1.0f));
+    XMMATRIX projection = GetBenchmarkProjection();
+    SceneRenderer renderer;
+    renderer.Batch = &batch;
+    renderer.Timer = &g_GpuTimer;
+    SceneRenderDevice device = CreateHeadlessSceneRenderDevice(CUBE_INDEX_COUNT);
+
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(INSTANCED_CUBES_SAMPLES, INSTANCED_CUBES_FRAMES_PER_SAMPLE, [&](UINT) {
+        SubmitScene(renderer, device, view, projection, BENCHMARK_VIEWPORT_HEIGHT);
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, "instanced_cubes", nanoseconds, &counters);
+    return !renderer.VisibleChunks.empty();
+}
+
+//The batch build itself: a hundred thousand cubes of four materials scattered with random scales and turns, one in ten
+//of them mirrored, merged at the default chunk budget. Smaller and larger budgets are built once for their chunk counts,
+//and a view counts the chunk draws that replace its visible objects.
+bool RunStaticBatch(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<StaticObject> objects(STATIC_BATCH_OBJECTS);
+    uint32_t state = 1;
+    const float half = STATIC_BATCH_FIELD_SIZE * 0.5f;
+    for (StaticObject& object : objects) {
+        object.Source = 0;
+        object.Material = NextBenchmarkRandom(state) % STATIC_BATCH_MATERIALS;
+        float mirror = NextBenchmarkRandom(state) % 10 == 0 ? -1.0f : 1.0f;
+        XMMATRIX scaling = XMMatrixScaling(mirror * GetBenchmarkRandom(state, 0.2f, 2.0f), GetBenchmarkRandom(state, 0.2f, 2.0f),
+            GetBenchmarkRandom(state, 0.2f, 2.0f));
+        XMMATRIX rotation = XMMatrixRotationAxis(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), GetBenchmarkRandom(state, 0.0f, XM_2PI));
+        XMMATRIX translation = XMMatrixTranslation(GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half) * 0.1f,
+            GetBenchmarkRandom(state, -half, half));
+        XMStoreFloat4x4(&object.WorldMatrix, XMMatrixMultiply(XMMatrixMultiply(scaling, rotation), translation));
+    }
+
+    StaticMeshSource cubeSource = { CUBE_POSITIONS, CUBE_COLORS, CUBE_VERTEX_COUNT, CUBE_INDICES, CUBE_INDEX_COUNT };
+    StaticBatch batch;
+    StaticBatchStats stats = {};
+    bool built = true;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(STATIC_BATCH_SAMPLES, 1, [&](UINT) {
+        built = BuildStaticBatch(batch, MVF_CompactPositionColor, &cubeSource, 1, objects.data(), STATIC_BATCH_OBJECTS,
+            STATIC_BATCH_CHUNK_VERTICES, &stats) && built;
+    }, nanoseconds, counters);
+    if (!built) {
+        return false;
+    }
+
+    XMMATRIX viewProjection = XMMatrixMultiply(XMMatrixLookAtLH(XMVectorSet(0.0f, 20.0f, -500.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+        XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f));
+    Frustum frustum;
+    ExtractFrustum(frustum, viewProjection);
+    std::vector<UINT> visibleChunks;
+    CullStaticBatch(batch, frustum, visibleChunks);
+    BoundingBox cubeBounds;
+    BoundingBox::CreateFromPoints(cubeBounds, CUBE_VERTEX_COUNT, CUBE_POSITIONS, sizeof(XMFLOAT3));
+    UINT visibleObjects = 0;
+    for (const StaticObject& object : objects) {
+        BoundingBox bounds;
+        cubeBounds.Transform(bounds, XMLoadFloat4x4(&object.WorldMatrix));
+        visibleObjects += TestFrustumBox(frustum, bounds) != DISJOINT;
+    }
+
+    AddSceneMetrics(metrics, "static_batch", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "static_batch", "chunks", stats.Chunks);
+    AddBenchmarkMetric(metrics, "static_batch", "draw_reduction_percent", GetStaticBatchDrawReductionPercent(stats));
+    AddBenchmarkMetric(metrics, "static_batch", "view_objects", visibleObjects);
+    AddBenchmarkMetric(metrics, "static_batch", "view_chunks", static_cast<double>(visibleChunks.size()));
+    for (UINT budget : STATIC_BATCH_BUDGETS) {
+        if (!BuildStaticBatch(batch, MVF_CompactPositionColor, &cubeSource, 1, objects.data(), STATIC_BATCH_OBJECTS, budget, &stats)) {
+            return false;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "chunks_at_%u", budget);
+        AddBenchmarkMetric(metrics, "static_batch", name, stats.Chunks);
+    }
+    return true;
+}
+
+//A hundred thousand cubes, a few of them moving, culled by the frustum and by walls rasterized as occluders. The scene
+//is indexed by a hierarchy or by the spatial hash.
+bool RunCulledObjects(std::vector<BenchmarkMetric>& metrics, SceneIndexType indexType) {
+    const char* sceneName = indexType == SI_BVH ? "culled_objects" : "culled_objects_grid";
+    BoundingBox cubeBounds;
+    BoundingBox::CreateFromPoints(cubeBounds, CUBE_VERTEX_COUNT, CUBE_POSITIONS, sizeof(XMFLOAT3));
+
+    Scene scene;
+    InitScene(scene, indexType);
+    std::vector<XMFLOAT3> origins;
+    for (UINT z = 0; z < CULLED_OBJECTS_SIDE; ++z) {
+        for (UINT x = 0; x < CULLED_OBJECTS_SIDE; ++x) {
+            XMFLOAT3 origin((x - CULLED_OBJECTS_SIDE * 0.5f) * 1.5f, 0.0f, z * 1.5f);
+            AddSceneObject(scene, XMMatrixMultiply(XMMatrixScaling(0.3f, 0.3f, 0.3f), XMMatrixTranslationFromVector(XMLoadFloat3(&origin))), cubeBounds);
+            origins.push_back(origin);
+        }
+    }
+    UpdateScene(scene);
+
+    //Two walls that hide part of the field behind them.
+    std::vector<Occluder> occluders;
+    const float wallOffsets[] = { -8.0f, 8.0f };
+    for (float offset : wallOffsets) {
+        Occluder wall = { CUBE_POSITIONS, sizeof(XMFLOAT3), CUBE_VERTEX_COUNT, CUBE_INDICES, sizeof(uint32_t), CUBE_INDEX_COUNT };
+        XMStoreFloat4x4(&wall.WorldMatrix, XMMatrixMultiply(XMMatrixScaling(6.0f, 4.0f, 0.2f), XMMatrixTranslation(offset, 0.0f, 20.0f)));
+        occluders.push_back(wall);
+    }
+    OcclusionBuffer occlusionBuffer;
+    InitOcclusionBuffer(occlusionBuffer, OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+
+    XMMATRIX view = GetBenchmarkView(XMVectorSet(0.0f, 3.0f, -4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 40.0f, 1.0f));
+    XMMATRIX projection = GetBenchmarkProjection();
+    SceneRenderer renderer;
+    renderer.Objects = &scene;
+    renderer.OcclusionTarget = &occlusionBuffer;
+    renderer.Occluders = occluders.data();
+    renderer.OccluderCount = static_cast<UINT>(occluders.size());
+    renderer.Timer = &g_GpuTimer;
+    SceneRenderDevice device = CreateHeadlessSceneRenderDevice(CUBE_INDEX_COUNT);
+
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(CULLED_OBJECTS_SAMPLES, 1, [&](UINT frame) {
+        for (UINT object = frame % CULLED_OBJECTS_MOVE_STRIDE; object < origins.size(); object += CULLED_OBJECTS_MOVE_STRIDE) {
+            XMVECTOR origin = XMVectorAdd(XMLoadFloat3(&origins[object]), XMVectorSet(0.0f, 0.5f * sinf(frame * 0.1f), 0.0f, 0.0f));
+            SetSceneObjectTransform(scene, object, XMMatrixMultiply(XMMatrixScaling(0.3f, 0.3f, 0.3f), XMMatrixTranslationFromVector(origin)));
+        }
+        UpdateScene(scene);
+        SubmitScene(renderer, device, view, projection, BENCHMARK_VIEWPORT_HEIGHT);
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, sceneName, nanoseconds, &counters);
+    return !renderer.VisibleObjects.empty();
+}
+
+bool RunCulledObjectsBVH(std::vector<BenchmarkMetric>& metrics) {
+    return RunCulledObjects(metrics, SI_BVH);
+}
+
+bool RunCulledObjectsGrid(std::vector<BenchmarkMetric>& metrics) {
+    return RunCulledObjects(metrics, SI_SpatialHash);
+}
+
+//Box, sphere and frustum queries over the moving objects.
+struct SpatialQueries
+{
+    std::vector<BoundingBox> Boxes;
+    std::vector<BoundingSphere> Spheres;
+    Frustum View;
+};
+
+void GenerateSpatialQueries(SpatialQueries& queries) {
+    uint32_t state = 3;
+    float half = SPATIAL_HASH_FIELD_SIZE * 0.5f;
+    for (UINT i = 0; i < SPATIAL_HASH_QUERIES; ++i) {
+        XMFLOAT3 center(GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half));
+        float size = GetBenchmarkRandom(state, 2.0f, 20.0f);
+        queries.Boxes.push_back(BoundingBox(center, XMFLOAT3(size, size * 0.5f, size)));
+        queries.Spheres.push_back(BoundingSphere(center, size));
+    }
+    XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -half, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(30.0f), 1280.0f / 720.0f, 0.1f, SPATIAL_HASH_FIELD_SIZE);
+    ExtractFrustum(queries.View, XMMatrixMultiply(view, projection));
+}
+
+//Run every query through the hash, or through a scan of every object's bounds, and append the results of each query
+//sorted, so the two can be compared.
+void RunSpatialQueries(const SpatialQueries& queries, const SpatialHash* hash, const std::vector<BoundingBox>& bounds, std::vector<UINT>& results) {
+    auto query = [&](const std::function<void(std::vector<UINT>&)>& hashQuery, const std::function<bool(const BoundingBox&)>& test) {
+        size_t first = results.size();
+        if (hash) {
+            hashQuery(results);
+        }
+        else {
+            for (UINT object = 0; object < static_cast<UINT>(bounds.size()); ++object) {
+                if (test(bounds[object])) {
+                    results.push_back(object);
+                }
+            }
+        }
+        std::sort(results.begin() + first, results.end());
+        results.push_back(SPATIAL_HASH_INVALID_INDEX);
+    };
+    for (UINT i = 0; i < SPATIAL_HASH_QUERIES; ++i) {
+        const BoundingBox& box = queries.Boxes[i];
+        const BoundingSphere& sphere = queries.Spheres[i];
+        query([&](std::vector<UINT>& out) { QuerySpatialHashBox(*hash, box, out); }, [&](const BoundingBox& b) { return b.Intersects(box); });
+        query([&](std::vector<UINT>& out) { QuerySpatialHashSphere(*hash, sphere, out); }, [&](const BoundingBox& b) { return b.Intersects(sphere); });
+    }
+    query([&](std::vector<UINT>& out) { QuerySpatialHashFrustum(*hash, queries.View, out); },
+        [&](const BoundingBox& b) { return TestFrustumBox(queries.View, b) != DISJOINT; });
+}
+
+//Objects drifting through a field, moved in one batch every frame and queried through the spatial hash, or found by a
+//scan of every object. Before timing, the hash's results are checked against the scan's after the inserts and again
+//after a batch of moves.
+bool RunSpatialHash(std::vector<BenchmarkMetric>& metrics, bool scan) {
+    const char* sceneName = scan ? "spatial_scan" : "spatial_hash";
+    std::vector<BoundingBox> bounds;
+    GenerateBenchmarkBoxes(bounds, SPATIAL_HASH_OBJECTS, SPATIAL_HASH_FIELD_SIZE, 4);
+    std::vector<XMFLOAT3> velocities(SPATIAL_HASH_OBJECTS);
+    uint32_t state = 5;
+    for (XMFLOAT3& velocity : velocities) {
+        velocity = XMFLOAT3(GetBenchmarkRandom(state, -1.0f, 1.0f), GetBenchmarkRandom(state, -1.0f, 1.0f), GetBenchmarkRandom(state, -1.0f, 1.0f));
+    }
+    std::vector<UINT> objects(SPATIAL_HASH_OBJECTS);
+    for (UINT object = 0; object < SPATIAL_HASH_OBJECTS; ++object) {
+        objects[object] = object;
+    }
+    auto moveObjects = [&](UINT frame) {
+        //Objects drift one way for a while and then back, so the field keeps its size.
+        float direction = (frame / 8) & 1 ? -1.0f : 1.0f;
+        for (UINT object = 0; object < SPATIAL_HASH_OBJECTS; ++object) {
+            bounds[object].Center.x += velocities[object].x * direction;
+            bounds[object].Center.y += velocities[object].y * direction;
+            bounds[object].Center.z += velocities[object].z * direction;
+        }
+    };
+
+    SpatialQueries queries;
+    GenerateSpatialQueries(queries);
+    SpatialHash hash;
+    InitSpatialHash(hash, SPATIAL_HASH_CELL_SIZE);
+    std::vector<UINT> results;
+    std::vector<UINT> expected;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (UINT object = 0; object < SPATIAL_HASH_OBJECTS; ++object) {
+        InsertSpatialHashObject(hash, object, bounds[object]);
+    }
+    double insertMs = ElapsedMs(start);
+    for (UINT check = 0; check < 2; ++check) {
+        results.clear();
+        expected.clear();
+        RunSpatialQueries(queries, &hash, bounds, results);
+        RunSpatialQueries(queries, nullptr, bounds, expected);
+        if (results != expected) {
+            fprintf(stderr, "%s: the spatial hash and a scan of every object disagree %s.\n", sceneName, check == 0 ? "after inserting" : "after moving");
+            return false;
+        }
+        moveObjects(0);
+        MoveSpatialHashObjects(hash, objects.data(), bounds.data(), SPATIAL_HASH_OBJECTS);
+    }
+
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(SPATIAL_HASH_SAMPLES, 1, [&](UINT frame) {
+        moveObjects(frame + 1);
+        if (!scan) {
+            MoveSpatialHashObjects(hash, objects.data(), bounds.data(), SPATIAL_HASH_OBJECTS);
+        }
+        results.clear();
+        RunSpatialQueries(queries, scan ? nullptr : &hash, bounds, results);
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, sceneName, nanoseconds, nullptr);
+    if (!scan) {
+        AddBenchmarkMetric(metrics, sceneName, "insert_ms", insertMs, BMK_Info);
+    }
+    AddBenchmarkMetric(metrics, sceneName, "results", static_cast<double>(results.size() - (2 * SPATIAL_HASH_QUERIES + 1)));
+    return true;
+}
+
+bool RunSpatialHashQueries(std::vector<BenchmarkMetric>& metrics) {
+    return RunSpatialHash(metrics, false);
+}
+
+bool RunSpatialScanQueries(std::vector<BenchmarkMetric>& metrics) {
+    return RunSpatialHash(metrics, true);
+}
+
+//A million objects in one hierarchy, rebuilt from scratch every frame.
+bool RunBVHBuild(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<BoundingBox> boxes;
+    GenerateBenchmarkBoxes(boxes, BVH_OBJECTS, BVH_FIELD_SIZE, 1);
+
+    BVH bvh;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(BVH_BUILD_SAMPLES, 1, [&](UINT) {
+        BuildBVH(bvh, boxes.data(), BVH_OBJECTS);
+    }, nanoseconds, counters, 1);
+    AddSceneMetrics(metrics, "bvh_build", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "bvh_build", "nodes", static_cast<double>(bvh.Nodes.size()));
+    return bvh.Objects.size() == BVH_OBJECTS;
+}
+
+//Every object moves every frame and the whole hierarchy is refit, or one in BVH_REFIT_MOVE_STRIDE moves and only the
+//nodes above them are.
+bool RunBVHRefit(std::vector<BenchmarkMetric>& metrics, bool incremental) {
+    const char* scene = incremental ? "bvh_refit_moved" : "bvh_refit";
+    std::vector<BoundingBox> boxes;
+    GenerateBenchmarkBoxes(boxes, BVH_OBJECTS, BVH_FIELD_SIZE, 1);
+    BVH bvh;
+    BuildBVH(bvh, boxes.data(), BVH_OBJECTS);
+
+    std::vector<UINT> moved;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(BVH_REFIT_SAMPLES, 1, [&](UINT frame) {
+        //Objects sway back and forth, so the tree stays as tight as it was built.
+        float offset = (frame & 1) ? -0.5f : 0.5f;
+        UINT stride = incremental ? BVH_REFIT_MOVE_STRIDE : 1;
+        moved.clear();
+        for (UINT object = frame % stride; object < BVH_OBJECTS; object += stride) {
+            boxes[object].Center.x += offset;
+            moved.push_back(object);
+        }
+        if (incremental) {
+            RefitBVH(bvh, boxes.data(), moved.data(), static_cast<UINT>(moved.size()));
+        }
+        else {
+            RefitBVH(bvh, boxes.data());
+        }
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, scene, nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, scene, "moved_objects", static_cast<double>(moved.size()));
+    return true;
+}
+
+bool RunBVHRefitAll(std::vector<BenchmarkMetric>& metrics) {
+    return RunBVHRefit(metrics, false);
+}
+
+bool RunBVHRefitMoved(std::vector<BenchmarkMetric>& metrics) {
+    return RunBVHRefit(metrics, true);
+}
+
+//A camera turning in the middle of a million objects. The first view is checked against a scan of every object.
+bool RunBVHCull(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<BoundingBox> boxes;
+    GenerateBenchmarkBoxes(boxes, BVH_OBJECTS, BVH_FIELD_SIZE, 1);
+    BVH bvh;
+    BuildBVH(bvh, boxes.data(), BVH_OBJECTS);
+
+    auto getFrustum = [](UINT frame, Frustum& frustum) {
+        float angle = XMConvertToRadians(frame * 7.0f);
+        XMMATRIX view = XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(sinf(angle), 0.2f, cosf(angle), 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 1280.0f / 720.0f, 0.1f, BVH_FIELD_SIZE * 0.5f);
+        ExtractFrustum(frustum, XMMatrixMultiply(view, projection));
+    };
+
+    Frustum frustum;
+    getFrustum(0, frustum);
+    std::vector<UINT> visibleObjects;
+    CullBVH(bvh, boxes.data(), frustum, visibleObjects);
+    std::sort(visibleObjects.begin(), visibleObjects.end());
+    std::vector<UINT> expected;
+    for (UINT object = 0; object < BVH_OBJECTS; ++object) {
+        if (TestFrustumBox(frustum, boxes[object]) != DISJOINT) {
+            expected.push_back(object);
+        }
+    }
+    if (visibleObjects != expected) {
+        fprintf(stderr, "bvh_cull: the hierarchy found %u visible objects, a scan %u.\n", static_cast<UINT>(visibleObjects.size()),
+            static_cast<UINT>(expected.size()));
+        return false;
+    }
+
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(BVH_CULL_SAMPLES, 1, [&](UINT frame) {
+        getFrustum(frame, frustum);
+        visibleObjects.clear();
+        CullBVH(bvh, boxes.data(), frustum, visibleObjects);
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, "bvh_cull", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "bvh_cull", "visible_objects", static_cast<double>(visibleObjects.size()));
+    return true;
+}
+
+//Picking rays from the edge of the field into it. The first few are checked against a scan of every object.
+bool RunBVHRaycast(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<BoundingBox> boxes;
+    GenerateBenchmarkBoxes(boxes, BVH_OBJECTS, BVH_FIELD_SIZE, 1);
+    BVH bvh;
+    BuildBVH(bvh, boxes.data(), BVH_OBJECTS);
+
+    std::vector<XMFLOAT3> origins(BVH_RAYS);
+    std::vector<XMFLOAT3> directions(BVH_RAYS);
+    uint32_t state = 2;
+    float half = BVH_FIELD_SIZE * 0.5f;
+    for (UINT i = 0; i < BVH_RAYS; ++i) {
+        origins[i] = XMFLOAT3(GetBenchmarkRandom(state, -half, half), GetBenchmarkRandom(state, -half, half), -half);
+        XMVECTOR direction = XMVectorSet(GetBenchmarkRandom(state, -0.2f, 0.2f), GetBenchmarkRandom(state, -0.2f, 0.2f), 1.0f, 0.0f);
+        XMStoreFloat3(&directions[i], XMVector3Normalize(direction));
+    }
+
+    for (UINT i = 0; i < BVH_CHECKED_RAYS; ++i) {
+        XMVECTOR origin = XMLoadFloat3(&origins[i]);
+        XMVECTOR direction = XMLoadFloat3(&directions[i]);
+        UINT hitObject = BVH_INVALID_INDEX;
+        float hitDistance = 0.0f;
+        bool hit = RaycastBVH(bvh, boxes.data(), origin, direction, BVH_FIELD_SIZE * 2.0f, hitObject, hitDistance);
+
+        float closest = BVH_FIELD_SIZE * 2.0f;
+        bool expected = false;
+        for (UINT object = 0; object < BVH_OBJECTS; ++object) {
+            float distance;
+            if (boxes[object].Intersects(origin, direction, distance) && std::max<float>(distance, 0.0f) < closest) {
+                closest = std::max<float>(distance, 0.0f);
+                expected = true;
+            }
+        }
+        if (hit != expected || (hit && fabsf(hitDistance - closest) > 0.001f)) {
+            fprintf(stderr, "bvh_raycast: ray %u hits at %f in the hierarchy and at %f in a scan.\n", i, hit ? hitDistance : -1.0f,
+                expected ? closest : -1.0f);
+            return false;
+        }
+    }
+
+    UINT hits = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(BVH_RAYCAST_SAMPLES, 1, [&](UINT) {
+        hits = 0;
+        for (UINT i = 0; i < BVH_RAYS; ++i) {
+            UINT hitObject;
+            float hitDistance;
+            if (RaycastBVH(bvh, boxes.data(), XMLoadFloat3(&origins[i]), XMLoadFloat3(&directions[i]), BVH_FIELD_SIZE * 2.0f, hitObject, hitDistance)) {
+                ++hits;
+            }
+        }
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, "bvh_raycast", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "bvh_raycast", "rays", BVH_RAYS);
+    AddBenchmarkMetric(metrics, "bvh_raycast", "hits", hits, BMK_Info);
+    return true;
+}
+
+//OBJ text of a UV sphere with positions, texture coordinates and normals.
+void WriteSphereObj(std::string& text, UINT rings, UINT segments) {
+    char line[128];
+    for (UINT ring = 0; ring <= rings; ++ring) {
+        float theta = XM_PI * ring / rings;
+        for (UINT segment = 0; segment <= segments; ++segment) {
+            float phi = XM_2PI * segment / segments;
+            float x = sinf(theta) * cosf(phi);
+            float y = cosf(theta);
+            float z = sinf(theta) * sinf(phi);
+            text.append(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", x, y, z,
+                static_cast<float>(segment) / segments, static_cast<float>(ring) / rings, x, y, z));
+        }
+    }
+    for (UINT ring = 0; ring < rings; ++ring) {
+        for (UINT segment = 0; segment < segments; ++segment) {
+            UINT a = ring * (segments + 1) + segment + 1;
+            UINT b = a + segments + 1;
+            text.append(line, snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, a + 1, a + 1, a + 1));
+            text.append(line, snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1));
+        }
+    }
+}
+
+//A UV sphere of unit radius as an imported mesh, its triangles in scanline order with the same winding as
+//WriteSphereObj. Positions are always set; normals, texture coordinates and colors as attributes asks.
+void GenerateSphereMesh(ImportedMesh& mesh, UINT rings, UINT segments, UINT attributes) {
+    mesh = ImportedMesh();
+    mesh.Attributes = attributes;
+    mesh.Vertices.reserve((rings + 1) * (segments + 1));
+    for (UINT ring = 0; ring <= rings; ++ring) {
+        float theta = XM_PI * ring / rings;
+        for (UINT segment = 0; segment <= segments; ++segment) {
+            float phi = XM_2PI * segment / segments;
+            ImportVertex vertex = {};
+            vertex.Position = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            if (attributes & IA_Normal) {
+                vertex.Normal = vertex.Position;
+            }
+            if (attributes & IA_TexCoord) {
+                vertex.TexCoord = XMFLOAT2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings);
+            }
+            vertex.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            mesh.Vertices.push_back(vertex);
+        }
+    }
+    mesh.Indices.reserve(6 * rings * segments);
+    for (UINT ring = 0; ring < rings; ++ring) {
+        for (UINT segment = 0; segment < segments; ++segment) {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            const uint32_t quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+            mesh.Indices.insert(mesh.Indices.end(), quad, quad + _countof(quad));
+        }
+    }
+    BoundingBox::CreateFromPoints(mesh.Bounds, mesh.Vertices.size(), &mesh.Vertices[0].Position, sizeof(ImportVertex));
+}
+
+//A grid of colored quads with texcoords and normals. Every other quad has no normals and uses indices relative to the
+//end of the vertex list, and positions use CRLF line ends, so every path of the parser runs.
+void WriteGridObj(std::string& text, UINT side) {
+    char line[256];
+    text += "# grid\nmtllib grid.mtl\n";
+    for (UINT y = 0; y <= side; ++y) {
+        for (UINT x = 0; x <= side; ++x) {
+            text.append(line, snprintf(line, sizeof(line), "v %u.5 %.3f -%u 0.5 0.25 1\r\nvt %f %f\nvn 0 0 1\n", x, y * 0.5, y,
+                static_cast<float>(x) / side, static_cast<float>(y) / side));
+        }
+    }
+    int vertexCount = static_cast<int>((side + 1) * (side + 1));
+    for (UINT y = 0; y < side; ++y) {
+        for (UINT x = 0; x < side; ++x) {
+            int a = static_cast<int>(y * (side + 1) + x + 1);
+            int b = a + 1;
+            int c = a + static_cast<int>(side) + 2;
+            int d = a + static_cast<int>(side) + 1;
+            if ((x + y) & 1) {
+                text.append(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d));
+            }
+            else {
+                text.append(line, snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d %d/%d\n", a - vertexCount - 1, a, b - vertexCount - 1, b,
+                    c - vertexCount - 1, c, d - vertexCount - 1, d));
+            }
+        }
+    }
+}
+
+//Parsing and welding a large OBJ on the job system, without the optimization and cooking mesh_import adds.
+bool RunObjImport(std::vector<BenchmarkMetric>& metrics) {
+    std::string text;
+    WriteGridObj(text, OBJ_IMPORT_GRID_SIDE);
+
+    bool imported = true;
+    ImportStats importStats = { 0 };
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(OBJ_IMPORT_SAMPLES, 1, [&](UINT) {
+        ImportedMesh mesh;
+        imported = ParseObj(text.data(), text.size(), mesh, &importStats) && imported;
+    }, nanoseconds, counters);
+    if (!imported || importStats.TriangleCount != 2 * OBJ_IMPORT_GRID_SIDE * OBJ_IMPORT_GRID_SIDE) {
+        fprintf(stderr, "obj_import: the grid did not import to %u triangles.\n", 2 * OBJ_IMPORT_GRID_SIDE * OBJ_IMPORT_GRID_SIDE);
+        return false;
+    }
+    AddSceneMetrics(metrics, "obj_import", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "obj_import", "source_bytes", static_cast<double>(text.size()));
+    AddBenchmarkMetric(metrics, "obj_import", "vertices", importStats.VertexCount);
+    AddBenchmarkMetric(metrics, "obj_import", "mb_per_s",
+        text.size() / (1024.0 * 1024.0) / (GetHdrPercentile(nanoseconds, 50.0) * 0.000000001), BMK_Info);
+    return true;
+}
+
+//The offline path for a large source mesh: parse, weld, optimize and cook.
+bool RunMeshImport(std::vector<BenchmarkMetric>& metrics) {
+    std::string text;
+    WriteSphereObj(text, MESH_IMPORT_RINGS, MESH_IMPORT_SEGMENTS);
+
+    bool imported = true;
+    ImportStats importStats = { 0 };
+    UINT vertexCount = 0;
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(MESH_IMPORT_SAMPLES, 1, [&](UINT) {
+        //Every sample imports from scratch, as loading a file would.
+        ImportedMesh mesh;
+        CookedMesh cooked;
+        if (!ParseObj(text.data(), text.size(), mesh, &importStats)) {
+            imported = false;
+            return;
+        }
+        OptimizeImportedMesh(mesh);
+        MeshVertexFormat format = ChooseVertexFormat(mesh);
+        CookImportedMesh(mesh, format, ChooseIndexLayout(mesh, format), cooked);
+        vertexCount = cooked.VertexCount;
+        vertexBytes = cooked.Vertices.size();
+        indexBytes = cooked.Indices.size();
+    }, nanoseconds, counters);
+    AddSceneMetrics(metrics, "mesh_import", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "mesh_import", "vertices", vertexCount);
+    AddBenchmarkMetric(metrics, "mesh_import", "vertex_bytes", static_cast<double>(vertexBytes));
+    AddBenchmarkMetric(metrics, "mesh_import", "index_bytes", static_cast<double>(indexBytes));
+    return imported;
+}
+
+//The three reordering passes over a two million triangle sphere whose triangles come in random order, the worst case
+//for the vertex cache pass. Each sample also copies the mesh, which the per-pass times leave out.
+bool RunMeshOptimize(std::vector<BenchmarkMetric>& metrics) {
+    ImportedMesh shuffled;
+    GenerateSphereMesh(shuffled, MESH_OPTIMIZE_SIDE, MESH_OPTIMIZE_SIDE, IA_Color);
+    uint32_t state = 7;
+    for (size_t triangle = shuffled.Indices.size() / 3; triangle > 1; --triangle) {
+        size_t other = NextBenchmarkRandom(state) % triangle;
+        std::swap_ranges(&shuffled.Indices[3 * (triangle - 1)], &shuffled.Indices[3 * triangle], &shuffled.Indices[3 * other]);
+    }
+
+    MeshOptimizeStats stats = {};
+    HdrHistogram vertexCacheNanoseconds;
+    HdrHistogram overdrawNanoseconds;
+    HdrHistogram vertexFetchNanoseconds;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(MESH_OPTIMIZE_SAMPLES, 1, [&](UINT) {
+        ImportedMesh mesh = shuffled;
+        OptimizeImportedMesh(mesh, &stats);
+        RecordHdrValue(vertexCacheNanoseconds, static_cast<uint64_t>(stats.VertexCacheTimeMs * 1000000.0));
+        RecordHdrValue(overdrawNanoseconds, static_cast<uint64_t>(stats.OverdrawTimeMs * 1000000.0));
+        RecordHdrValue(vertexFetchNanoseconds, static_cast<uint64_t>(stats.VertexFetchTimeMs * 1000000.0));
+    }, nanoseconds, counters);
+
+    //The same sphere in scanline order, which already suits a cache and leaves less to gain.
+    ImportedMesh scanline;
+    MeshOptimizeStats scanlineStats = {};
+    GenerateSphereMesh(scanline, MESH_OPTIMIZE_SIDE, MESH_OPTIMIZE_SIDE, IA_Color);
+    OptimizeImportedMesh(scanline, &scanlineStats);
+
+    AddSceneMetrics(metrics, "mesh_optimize", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "vertex_cache_ms_p50", GetHdrPercentile(vertexCacheNanoseconds, 50.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "overdraw_ms_p50", GetHdrPercentile(overdrawNanoseconds, 50.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "vertex_fetch_ms_p50", GetHdrPercentile(vertexFetchNanoseconds, 50.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "triangles", stats.After.TriangleCount);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "acmr_before", stats.Before.ACMR);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "acmr_after", stats.After.ACMR);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "atvr_before", stats.Before.ATVR);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "atvr_after", stats.After.ATVR);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "scanline_acmr_before", scanlineStats.Before.ACMR);
+    AddBenchmarkMetric(metrics, "mesh_optimize", "scanline_acmr_after", scanlineStats.After.ACMR);
+    return stats.After.TriangleCount == 2 * MESH_OPTIMIZE_SIDE * MESH_OPTIMIZE_SIDE;
+}
+
+struct MeshLayoutCase
+{
+    UINT Rings;
+    UINT Segments;
+    UINT Attributes;
+};
+
+//Six spheres from 30 thousand to 8.4 million vertices, around and past the 16-bit index limit.
+const MeshLayoutCase MESH_LAYOUT_CASES[] = {
+    { 150, 200, IA_Color },
+    { 255, 255, IA_Color },
+    { 300, 300, IA_Normal | IA_TexCoord | IA_Color },
+    { 1024, 1024, IA_Normal | IA_TexCoord | IA_Color },
+    { 1024, 2048, IA_Color },
+    { 2048, 4096, IA_Color }
+};
+//The case that splits into 16-bit submeshes, whose cook is timed.
+const UINT MESH_LAYOUT_SPLIT_CASE = 3;
+
+//Cooked sizes with full precision vertices, with compact vertices and 32-bit indices, and with compact vertices in the
+//index layout the importer picks, over the whole set.
+bool RunMeshLayout(std::vector<BenchmarkMetric>& metrics) {
+    uint64_t fullBytes = 0;
+    uint64_t index32Bytes = 0;
+    uint64_t chosenBytes = 0;
+    MeshMemoryReport splitReport = {};
+    uint64_t splitIndex32Bytes = 0;
+    UINT splitVertexCount = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    for (UINT i = 0; i < _countof(MESH_LAYOUT_CASES); ++i) {
+        const MeshLayoutCase& layoutCase = MESH_LAYOUT_CASES[i];
+        ImportedMesh mesh;
+        GenerateSphereMesh(mesh, layoutCase.Rings, layoutCase.Segments, layoutCase.Attributes);
+        OptimizeImportedMesh(mesh);
+        MeshVertexFormat format = ChooseVertexFormat(mesh);
+        CookedMesh cooked;
+        HdrHistogram caseNanoseconds;
+        MeasureFrames(i == MESH_LAYOUT_SPLIT_CASE ? MESH_LAYOUT_SAMPLES : 1, 1, [&](UINT) {
+            CookImportedMesh(mesh, format, ChooseIndexLayout(mesh, format), cooked);
+        }, i == MESH_LAYOUT_SPLIT_CASE ? nanoseconds : caseNanoseconds, counters);
+
+        MeshMemoryReport report;
+        GetMeshMemoryReport(mesh, cooked, report);
+        uint64_t bytes32 = static_cast<uint64_t>(cooked.VertexStride) * mesh.Vertices.size() + sizeof(uint32_t) * mesh.Indices.size();
+        fullBytes += report.FullVertexBytes + report.FullIndexBytes;
+        index32Bytes += bytes32;
+        chosenBytes += report.VertexBytes + report.IndexBytes;
+        if (i == MESH_LAYOUT_SPLIT_CASE) {
+            splitReport = report;
+            splitIndex32Bytes = bytes32;
+            splitVertexCount = static_cast<UINT>(mesh.Vertices.size());
+        }
+    }
+    if (splitReport.IndexLayout != MIL_Split16) {
+        fprintf(stderr, "mesh_layout: the %u vertex sphere was not split into 16-bit submeshes.\n", splitVertexCount);
+        return false;
+    }
+    AddSceneMetrics(metrics, "mesh_layout", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "mesh_layout", "full_bytes", static_cast<double>(fullBytes));
+    AddBenchmarkMetric(metrics, "mesh_layout", "index32_bytes", static_cast<double>(index32Bytes));
+    AddBenchmarkMetric(metrics, "mesh_layout", "chosen_bytes", static_cast<double>(chosenBytes));
+    AddBenchmarkMetric(metrics, "mesh_layout", "split_submeshes", splitReport.SubmeshCount);
+    AddBenchmarkMetric(metrics, "mesh_layout", "split_duplicated_vertices", splitReport.VertexCount - splitVertexCount);
+    AddBenchmarkMetric(metrics, "mesh_layout", "split_bytes", static_cast<double>(splitReport.VertexBytes + splitReport.IndexBytes));
+    AddBenchmarkMetric(metrics, "mesh_layout", "split_index32_bytes", static_cast<double>(splitIndex32Bytes));
+    return true;
+}
+
+struct MeshletCullView
+{
+    const char* Name;
+    XMFLOAT3 Eye;
+    XMFLOAT3 Focus;
+};
+
+const MeshletCullView MESHLET_CULL_VIEWS[] = {
+    { "whole", XMFLOAT3(0.0f, 0.0f, -4.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+    { "close", XMFLOAT3(0.3f, 0.2f, -1.6f), XMFLOAT3(0.3f, 0.2f, 0.0f) },
+    { "away", XMFLOAT3(0.0f, 0.0f, -4.0f), XMFLOAT3(0.0f, 0.0f, -8.0f) }
+};
+
+//Cluster culling of a million triangle sphere seen whole, close up and partly off-screen, and from behind the camera.
+//The scene times the whole view; the others report their cost per million triangles tested.
+bool RunMeshletCull(std::vector<BenchmarkMetric>& metrics) {
+    ImportedMesh mesh;
+    GenerateSphereMesh(mesh, MESHLET_CULL_RINGS, MESHLET_CULL_SEGMENTS, IA_Color);
+    //The sphere is wound like WriteSphereObj, counterclockwise from outside; the overdraw pass and the meshlet cones
+    //expect clockwise front faces.
+    for (size_t i = 0; i < mesh.Indices.size(); i += 3) {
+        std::swap(mesh.Indices[i + 1], mesh.Indices[i + 2]);
+    }
+    OptimizeImportedMesh(mesh);
+
+    MeshletMesh meshlets;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BuildMeshlets(meshlets, mesh.Indices.data(), mesh.Indices.size(), &mesh.Vertices[0].Position, sizeof(ImportVertex),
+        static_cast<UINT>(mesh.Vertices.size()));
+    double buildMs = ElapsedMs(start);
+
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    XMMATRIX world = XMMatrixRotationAxis(XMVectorSet(0.0f, 1.0f, 1.0f, 0.0f), 0.7f);
+    bool complete = true;
+    for (UINT v = 0; v < _countof(MESHLET_CULL_VIEWS); ++v) {
+        const MeshletCullView& view = MESHLET_CULL_VIEWS[v];
+        XMVECTOR eye = XMLoadFloat3(&view.Eye);
+        XMMATRIX viewProjection = XMMatrixLookAtLH(eye, XMLoadFloat3(&view.Focus), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projection;
+        std::vector<UINT> visible;
+        MeshletCullStats stats = {};
+        UINT indexCount = 0;
+        HdrHistogram nanoseconds;
+        RenderCounters counters;
+        MeasureFrames(MESHLET_CULL_SAMPLES, 1, [&](UINT) {
+            visible.clear();
+            stats = MeshletCullStats();
+            indexCount = CullMeshlets(meshlets, 0, world, viewProjection, eye, visible, stats);
+        }, nanoseconds, counters);
+        complete = stats.TrianglesTested == meshlets.Lods[0].TriangleCount && complete;
+
+        char name[64];
+        double cullMs = GetHdrPercentile(nanoseconds, 50.0) * 0.000001;
+        if (v == 0) {
+            AddSceneMetrics(metrics, "meshlet_cull", nanoseconds, nullptr);
+            AddBenchmarkMetric(metrics, "meshlet_cull", "meshlets", static_cast<double>(meshlets.Meshlets.size()));
+            AddBenchmarkMetric(metrics, "meshlet_cull", "build_ms", buildMs, BMK_Info);
+
+            //Writing the survivors' triangles, as the stream upload does each frame.
+            std::vector<uint32_t> indices(indexCount);
+            start = std::chrono::steady_clock::now();
+            for (UINT sample = 0; sample < MESHLET_CULL_SAMPLES; ++sample) {
+                WriteMeshletIndices(meshlets, visible.data(), static_cast<UINT>(visible.size()), sizeof(uint32_t), indices.data());
+            }
+            AddBenchmarkMetric(metrics, "meshlet_cull", "write_ms", ElapsedMs(start) / MESHLET_CULL_SAMPLES, BMK_Info);
+        }
+        snprintf(name, sizeof(name), "%s_culled_percent", view.Name);
+        AddBenchmarkMetric(metrics, "meshlet_cull", name, GetMeshletCulledTrianglePercent(stats));
+        snprintf(name, sizeof(name), "%s_ms_per_mtri", view.Name);
+        AddBenchmarkMetric(metrics, "meshlet_cull", name, cullMs / (stats.TrianglesTested * 0.000001), BMK_Info);
+    }
+    return complete;
+}
+
+//Area of the triangles whose corners do not all have the same color.
+double GetMixedColorArea(const ImportedMesh& mesh, const std::vector<uint32_t>& indices) {
+    double area = 0.0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const ImportVertex& a = mesh.Vertices[indices[i]];
+        const ImportVertex& b = mesh.Vertices[indices[i + 1]];
+        const ImportVertex& c = mesh.Vertices[indices[i + 2]];
+        if (a.Color.x != b.Color.x || a.Color.x != c.Color.x) {
+            XMVECTOR p = XMLoadFloat3(&a.Position);
+            area += 0.5 * XMVectorGetX(XMVector3Length(XMVector3Cross(XMLoadFloat3(&b.Position) - p, XMLoadFloat3(&c.Position) - p)));
+        }
+    }
+    return area;
+}
+
+//The LOD chain of the million triangle sphere with six red and blue stripes, how well the color term holds the
+//stripes' edges, and the level the selector picks at a few distances with its triangles before and after cluster culling.
+bool RunMeshLod(std::vector<BenchmarkMetric>& metrics) {
+    ImportedMesh mesh;
+    GenerateSphereMesh(mesh, MESHLET_CULL_RINGS, MESHLET_CULL_SEGMENTS, IA_Color);
+    for (size_t i = 0; i < mesh.Vertices.size(); ++i) {
+        float phi = XM_2PI * (i % (MESHLET_CULL_SEGMENTS + 1)) / MESHLET_CULL_SEGMENTS;
+        float red = sinf(3.0f * phi) > 0.0f ? 1.0f : 0.0f;
+        mesh.Vertices[i].Color = XMFLOAT4(red, 0.0f, 1.0f - red, 1.0f);
+    }
+    //Clockwise front faces, and no triangles collapsed at the poles.
+    std::vector<uint32_t> indices;
+    indices.reserve(mesh.Indices.size());
+    for (size_t i = 0; i < mesh.Indices.size(); i += 3) {
+        const uint32_t triangle[] = { mesh.Indices[i], mesh.Indices[i + 2], mesh.Indices[i + 1] };
+        XMVECTOR p = XMLoadFloat3(&mesh.Vertices[triangle[0]].Position);
+        XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&mesh.Vertices[triangle[1]].Position) - p, XMLoadFloat3(&mesh.Vertices[triangle[2]].Position) - p);
+        if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f) {
+            indices.insert(indices.end(), triangle, triangle + 3);
+        }
+    }
+    mesh.Indices.swap(indices);
+    UINT vertexCount = static_cast<UINT>(mesh.Vertices.size());
+    OptimizeVertexCache(mesh.Indices.data(), mesh.Indices.size(), vertexCount);
+
+    SimplifyVertices vertices = { &mesh.Vertices[0].Position, sizeof(ImportVertex), &mesh.Vertices[0].Color, sizeof(ImportVertex),
+        MESH_LOD_COLOR_WEIGHT, vertexCount };
+    std::vector<MeshLod> lods;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(MESH_LOD_SAMPLES, 1, [&](UINT) {
+        BuildMeshLods(lods, mesh.Indices.data(), mesh.Indices.size(), vertices);
+    }, nanoseconds, counters);
+    if (lods.size() <= MESH_LOD_BOUNDARY_LEVEL) {
+        fprintf(stderr, "mesh_lod: the chain has %zu levels.\n", lods.size());
+        return false;
+    }
+
+    //How far each level lands from half the triangles of the one before.
+    double worstTargetPercent = 0.0;
+    for (size_t level = 1; level < lods.size(); ++level) {
+        double target = lods[level - 1].Indices.size() / 3 * MESH_LOD_REDUCTION;
+        worstTargetPercent = std::max(worstTargetPercent, fabs(lods[level].Indices.size() / 3 - target) / target * 100.0);
+    }
+
+    //The same chain with position error alone lets the stripes' edges wander.
+    std::vector<MeshLod> positionLods;
+    SimplifyVertices positions = vertices;
+    positions.ColorWeight = 0.0f;
+    BuildMeshLods(positionLods, mesh.Indices.data(), mesh.Indices.size(), positions);
+
+    MeshletMesh meshlets;
+    BuildMeshlets(meshlets, lods[0].Indices.data(), lods[0].Indices.size(), vertices.Positions, vertices.PositionStride, vertexCount);
+    std::vector<float> errors;
+    errors.push_back(lods[0].Error);
+    for (size_t level = 1; level < lods.size(); ++level) {
+        AddMeshletLod(meshlets, lods[level].Indices.data(), lods[level].Indices.size(), vertices.Positions, vertices.PositionStride);
+        errors.push_back(lods[level].Error);
+    }
+
+    AddSceneMetrics(metrics, "mesh_lod", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "mesh_lod", "levels", static_cast<double>(lods.size()));
+    AddBenchmarkMetric(metrics, "mesh_lod", "worst_target_percent", worstTargetPercent);
+    AddBenchmarkMetric(metrics, "mesh_lod", "mixed_area", GetMixedColorArea(mesh, lods[MESH_LOD_BOUNDARY_LEVEL].Indices));
+    AddBenchmarkMetric(metrics, "mesh_lod", "mixed_area_position_only", GetMixedColorArea(mesh, positionLods[MESH_LOD_BOUNDARY_LEVEL].Indices));
+    AddBenchmarkMetric(metrics, "mesh_lod", "full_triangles", meshlets.Lods[0].TriangleCount);
+
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    float projectionScale = GetLodProjectionScale(projection, 720.0f);
+    XMMATRIX world = XMMatrixIdentity();
+    BoundingBox bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+    for (float distance : MESH_LOD_DISTANCES) {
+        XMVECTOR eye = XMVectorSet(0.0f, 0.0f, -distance, 1.0f);
+        UINT lod = SelectMeshLod(errors.data(), static_cast<UINT>(errors.size()), world, bounds, eye, projectionScale, MESH_LOD_MAX_PIXEL_ERROR);
+        XMMATRIX viewProjection = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projection;
+        std::vector<UINT> visible;
+        MeshletCullStats stats = {};
+        CullMeshlets(meshlets, lod, world, viewProjection, eye, visible, stats);
+        char name[64];
+        snprintf(name, sizeof(name), "lod_at_%g", distance);
+        AddBenchmarkMetric(metrics, "mesh_lod", name, lod);
+        snprintf(name, sizeof(name), "triangles_at_%g", distance);
+        AddBenchmarkMetric(metrics, "mesh_lod", name, meshlets.Lods[lod].TriangleCount);
+        snprintf(name, sizeof(name), "visible_triangles_at_%g", distance);
+        AddBenchmarkMetric(metrics, "mesh_lod", name, stats.TrianglesVisible);
+    }
+    return true;
+}
+
+//Sum of every byte, which also pages in a whole mapped range.
+uint64_t SumBytes(const void* data, size_t size) {
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+//Loading the mesh_import sphere to the point its vertex and index buffers could be created: from the cooked mesh file,
+//mapped and read through once, or from the .obj text, read, parsed and cooked. Both load the same asset from a file
+//written just before, so the OS serves them from its cache. The mapped payloads are checked to match the cooked ones
+//before timing.
+bool RunMeshLoad(std::vector<BenchmarkMetric>& metrics, bool text) {
+    const char* sceneName = text ? "mesh_load_text" : "mesh_load";
+    std::string objText;
+    WriteSphereObj(objText, MESH_IMPORT_RINGS, MESH_IMPORT_SEGMENTS);
+    ImportedMesh mesh;
+    CookedMesh cooked;
+    if (!ParseObj(objText.data(), objText.size(), mesh)) {
+        return false;
+    }
+    OptimizeImportedMesh(mesh);
+    MeshVertexFormat format = ChooseVertexFormat(mesh);
+    CookImportedMesh(mesh, format, ChooseIndexLayout(mesh, format), cooked);
+    MeshSource source = GetCookedMeshSource(cooked);
+
+    FILE* objFile = OpenFile(MESH_LOAD_OBJ_PATH, "wb");
+    if (!objFile) {
+        fprintf(stderr, "%s: could not write the .obj file.\n", sceneName);
+        return false;
+    }
+    bool written = fwrite(objText.data(), 1, objText.size(), objFile) == objText.size();
+    written = fclose(objFile) == 0 && written;
+    written = written && WriteMeshFile(MESH_LOAD_MESH_PATH, &source, 1);
+
+    bool loaded = false;
+    if (written) {
+        MeshFile meshFile;
+        if (OpenMeshFile(meshFile, MESH_LOAD_MESH_PATH)) {
+            const MeshFileEntry& entry = meshFile.Entries[0];
+            loaded = entry.VertexCount * entry.VertexStride == cooked.Vertices.size() && entry.IndexCount * entry.IndexSize == cooked.Indices.size() &&
+                memcmp(GetMeshVertexData(meshFile, 0), cooked.Vertices.data(), cooked.Vertices.size()) == 0 &&
+                memcmp(GetMeshIndexData(meshFile, 0), cooked.Indices.data(), cooked.Indices.size()) == 0;
+            CloseMeshFile(meshFile);
+        }
+        if (!loaded) {
+            fprintf(stderr, "%s: the mesh file does not hold the cooked mesh.\n", sceneName);
+        }
+    }
+    else {
+        fprintf(stderr, "%s: could not write the mesh files.\n", sceneName);
+    }
+
+    uint64_t fileBytes = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    if (loaded) {
+        MeasureFrames(MESH_LOAD_SAMPLES, 1, [&](UINT) {
+            if (text) {
+                std::vector<BYTE> data;
+                ImportedMesh loadedMesh;
+                CookedMesh loadedCooked;
+                if (!ReadWholeFile(MESH_LOAD_OBJ_PATH, data) || !ParseObj(reinterpret_cast<const char*>(data.data()), data.size(), loadedMesh)) {
+                    loaded = false;
+                    return;
+                }
+                OptimizeImportedMesh(loadedMesh);
+                MeshVertexFormat loadedFormat = ChooseVertexFormat(loadedMesh);
+                CookImportedMesh(loadedMesh, loadedFormat, ChooseIndexLayout(loadedMesh, loadedFormat), loadedCooked);
+                fileBytes = data.size();
+                loaded = loaded && loadedCooked.Vertices == cooked.Vertices && loadedCooked.Indices == cooked.Indices;
+            }
+            else {
+                MeshFile meshFile;
+                if (!OpenMeshFile(meshFile, MESH_LOAD_MESH_PATH)) {
+                    loaded = false;
+                    return;
+                }
+                const MeshFileEntry& entry = meshFile.Entries[0];
+                uint64_t sum = SumBytes(GetMeshVertexData(meshFile, 0), entry.VertexCount * entry.VertexStride) +
+                    SumBytes(GetMeshIndexData(meshFile, 0), entry.IndexCount * entry.IndexSize);
+                fileBytes = meshFile.File.Size;
+                loaded = loaded && sum != 0;
+                CloseMeshFile(meshFile);
+            }
+        }, nanoseconds, counters);
+    }
+    RemoveFile(MESH_LOAD_OBJ_PATH);
+    RemoveFile(MESH_LOAD_MESH_PATH);
+    if (!loaded) {
+        return false;
+    }
+    AddSceneMetrics(metrics, sceneName, nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, sceneName, "file_bytes", static_cast<double>(fileBytes));
+    return true;
+}
+
+bool RunMeshLoadMapped(std::vector<BenchmarkMetric>& metrics) {
+    return RunMeshLoad(metrics, false);
+}
+
+bool RunMeshLoadText(std::vector<BenchmarkMetric>& metrics) {
+    return RunMeshLoad(metrics, true);
+}
+
+//Streaming device that only keeps count of the bytes its textures would take. Texture ids are stored in the pointers.
+struct CountingStreamingDevice
+{
+    std::unordered_map<uintptr_t, uint64_t> TextureBytes;
+    uintptr_t NextTexture = 1;
+    uint64_t Bytes = 0;
+    uint64_t PeakBytes = 0;
+};
+
+TextureStreamingDevice GetCountingStreamingDevice(CountingStreamingDevice& counting) {
+    TextureStreamingDevice device;
+    device.CreateTexture = [&counting](TextureFormat format, bool, UINT width, UINT height, UINT mipCount, Texture& texture) {
+        uint64_t bytes = 0;
+        for (UINT mip = 0; mip < mipCount; ++mip) {
+            bytes += static_cast<uint64_t>(GetTextureRowPitch(format, std::max<UINT>(width >> mip, 1))) * GetTextureRowCount(format, std::max<UINT>(height >> mip, 1));
+        }
+        uintptr_t id = counting.NextTexture++;
+        counting.TextureBytes[id] = bytes;
+        counting.Bytes += bytes;
+        counting.PeakBytes = std::max<uint64_t>(counting.PeakBytes, counting.Bytes);
+        texture.Resource = reinterpret_cast<ID3D11Texture2D*>(id);
+        texture.View = reinterpret_cast<ID3D11ShaderResourceView*>(id);
+        texture.Format = format;
+        texture.Width = width;
+        texture.Height = height;
+        texture.MipCount = mipCount;
+        return true;
+    };
+    device.UploadMip = [](Texture&, UINT, const void*, UINT) {};
+    device.CopyMip = [](Texture&, UINT, const Texture&, UINT) {};
+    device.ReleaseTexture = [&counting](Texture& texture) {
+        uintptr_t id = reinterpret_cast<uintptr_t>(texture.Resource);
+        counting.Bytes -= counting.TextureBytes[id];
+        counting.TextureBytes.erase(id);
+        texture = Texture();
+    };
+    return device;
+}
+
+//Streaming against a device that only counts bytes. First every one of the distinct textures asks for full detail
+//under a budget that holds less than half of it, and the bytes resident at the end and at the peak are recorded. Then
+//each file is registered many times over and every texture requests the level its distance picks, moving every frame;
+//the requests and the update are timed.
+bool RunTextureStreaming(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<std::vector<BYTE>> files(TEXTURE_STREAMING_FILES);
+    std::vector<std::wstring> paths;
+    std::vector<VfsMount> mounts;
+    for (UINT i = 0; i < TEXTURE_STREAMING_FILES; ++i) {
+        //Half RGBA8 and half BC1, one of them not square.
+        TextureImage image;
+        image.Width = TEXTURE_STREAMING_SIZE;
+        image.Height = i == 3 ? TEXTURE_STREAMING_SIZE / 2 : TEXTURE_STREAMING_SIZE;
+        image.Pixels.resize(image.Width * image.Height * 4);
+        for (size_t p = 0; p < image.Pixels.size(); ++p) {
+            image.Pixels[p] = static_cast<BYTE>(((p * 2654435761u) >> 13) + i);
+        }
+        TextureCookSettings settings;
+        settings.Format = i % 2 ? TF_BC1 : TF_RGBA8;
+        CookedTexture cooked;
+        if (!CookTexture(image, settings, cooked) || !BuildTextureFile(GetCookedTextureSource(cooked), files[i])) {
+            return false;
+        }
+        paths.push_back(L"benchmark/textures/" + std::to_wstring(i) + L".etex");
+        mounts.push_back(MountMemoryFile(paths[i].c_str(), files[i].data(), files[i].size()));
+    }
+
+    CountingStreamingDevice counting;
+    InitTextureStreaming(GetCountingStreamingDevice(counting), TEXTURE_STREAMING_TEST_BUDGET);
+    std::vector<StreamedTexture> textures;
+    for (const std::wstring& path : paths) {
+        textures.push_back(RegisterStreamedTexture(path.c_str()));
+    }
+    FlushAssetLoader(nullptr, nullptr);
+    for (UINT frame = 0; frame < 3; ++frame) {
+        for (StreamedTexture texture : textures) {
+            RequestStreamedTextureMip(texture, 0);
+        }
+        UpdateTextureStreaming();
+        FlushAssetLoader(nullptr, nullptr);
+    }
+    TextureStreamingStats trimmedStats;
+    GetTextureStreamingStats(trimmedStats);
+    uint64_t trimmedPeakBytes = counting.PeakBytes;
+    ShutdownTextureStreaming();
+
+    counting = CountingStreamingDevice();
+    InitTextureStreaming(GetCountingStreamingDevice(counting), TEXTURE_STREAMING_TEST_BUDGET);
+    textures.clear();
+    for (UINT i = 0; i < TEXTURE_STREAMING_TEXTURES; ++i) {
+        textures.push_back(RegisterStreamedTexture(paths[i % TEXTURE_STREAMING_FILES].c_str()));
+    }
+    FlushAssetLoader(nullptr, nullptr);
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    float projectionScale = GetLodProjectionScale(projection, 720.0f);
+    BoundingBox bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(TEXTURE_STREAMING_SAMPLES, 1, [&](UINT frame) {
+        for (UINT i = 0; i < TEXTURE_STREAMING_TEXTURES; ++i) {
+            float distance = 1.0f + (i + frame) % 40;
+            RequestStreamedTexture(textures[i], 1.0f, bounds, XMVectorSet(0.0f, 0.0f, -distance, 1.0f), projectionScale);
+        }
+        UpdateTextureStreaming();
+    }, nanoseconds, counters);
+    FlushAssetLoader(nullptr, nullptr);
+    ShutdownTextureStreaming();
+    for (VfsMount mount : mounts) {
+        Unmount(mount);
+    }
+
+    bool withinBudget = trimmedPeakBytes <= TEXTURE_STREAMING_TEST_BUDGET && trimmedStats.OverrunFrames == 0;
+    if (!withinBudget) {
+        fprintf(stderr, "texture_streaming: %.1f MB resident at the peak, over a budget of %.1f MB.\n", trimmedPeakBytes / 1048576.0,
+            TEXTURE_STREAMING_TEST_BUDGET / 1048576.0);
+    }
+    AddSceneMetrics(metrics, "texture_streaming", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "texture_streaming", "requested_bytes", static_cast<double>(trimmedStats.RequestedBytes));
+    AddBenchmarkMetric(metrics, "texture_streaming", "resident_bytes", static_cast<double>(trimmedStats.ResidentBytes));
+    AddBenchmarkMetric(metrics, "texture_streaming", "peak_bytes", static_cast<double>(trimmedPeakBytes));
+    return withinBudget;
+}
+
+//Files scenes write next to the executable and remove when they finish.
+std::wstring GetBenchmarkFileName(const wchar_t* scene, UINT file) {
+    wchar_t name[96];
+    swprintf(name, _countof(name), L"EchoEngineBenchmark.%ls.%04u.bin", scene, file);
+    return name;
+}
+
+bool WriteBenchmarkFile(const wchar_t* path, const void* data, size_t size) {
+    FILE* output = OpenFile(path, "wb");
+    if (!output) {
+        return false;
+    }
+    bool written = size == 0 || fwrite(data, 1, size, output) == size;
+    return fclose(output) == 0 && written;
+}
+
+uint64_t DecodeBenchmarkAsset(const std::vector<BYTE>& data) {
+    uint64_t hash = 1469598103934665603ull;
+    for (UINT pass = 0; pass < ASSET_LOADER_DECODE_PASSES; ++pass) {
+        for (BYTE value : data) {
+            hash = (hash ^ value) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+struct AssetLoadRun
+{
+    double LoadMs;
+    double QueueMs;
+    UINT Frames;
+    //Longest a frame's main thread waited on VFS reads and opens.
+    double WorstMainBlockedMs;
+};
+
+//Load every file through the asset loader while the main thread keeps running frames, as the demo does while the cube
+//loads. The load ends when the last upload has run.
+void LoadBenchmarkAssets(std::atomic<uint64_t>& decoded, AssetLoadRun& run) {
+    VfsStats frameStats;
+    EndVfsFrame(frameStats);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<AssetHandle> assets;
+    for (UINT file = 0; file < ASSET_LOADER_FILES; ++file) {
+        std::wstring path = std::wstring(ASSET_LOADER_MOUNT_POINT) + L"/" + GetBenchmarkFileName(L"asset_loader", file);
+        assets.push_back(LoadAsset(path.c_str(), 0, [&decoded](std::vector<BYTE>& data) {
+            decoded += DecodeBenchmarkAsset(data) | 1;
+            return true;
+        }, [](ID3D11Device*, ID3D11DeviceContext*) {
+            return true;
+        }));
+    }
+    run.QueueMs = ElapsedMs(start);
+    run.Frames = 0;
+    run.WorstMainBlockedMs = 0.0;
+    for (;;) {
+        UpdateAssetLoader(nullptr, nullptr);
+        ++run.Frames;
+        EndVfsFrame(frameStats);
+        run.WorstMainBlockedMs = std::max(run.WorstMainBlockedMs, frameStats.MainThreadBlockedMs);
+        AssetLoaderStats stats;
+        GetAssetLoaderStats(stats);
+        if (stats.Pending == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    run.LoadMs = ElapsedMs(start);
+    for (AssetHandle asset : assets) {
+        ReleaseAsset(asset);
+    }
+}
+
+//800 files of 256 KB, read and decoded one after another on the main thread and then through the VFS and the asset
+//loader with one, two and four I/O threads. The files are written first, so the page cache is warm and the I/O
+//threads' prefetch of the next read has little to hide.
+bool RunAssetLoader(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<BYTE> data(ASSET_LOADER_FILE_SIZE);
+    uint32_t state = 9;
+    bool written = true;
+    for (UINT file = 0; file < ASSET_LOADER_FILES && written; ++file) {
+        for (BYTE& value : data) {
+            value = static_cast<BYTE>(NextBenchmarkRandom(state));
+        }
+        written = WriteBenchmarkFile(GetBenchmarkFileName(L"asset_loader", file).c_str(), data.data(), data.size());
+    }
+    VfsMount mount = MountDirectory(ASSET_LOADER_MOUNT_POINT, L".");
+
+    std::atomic<uint64_t> decoded(0);
+    double syncMs = 0.0;
+    bool loaded = written;
+    if (written) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (UINT file = 0; file < ASSET_LOADER_FILES && loaded; ++file) {
+            loaded = ReadWholeFile(GetBenchmarkFileName(L"asset_loader", file).c_str(), data);
+            decoded += DecodeBenchmarkAsset(data) | 1;
+        }
+        syncMs = ElapsedMs(start);
+    }
+
+    AssetLoadRun run = {};
+    uint64_t bytesRead = 0;
+    double readMs = 0.0;
+    UINT vfsOpens = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    if (loaded) {
+        MeasureFrames(ASSET_LOADER_SAMPLES, 1, [&](UINT) {
+            //The loader's and the VFS's stats are totals since they started.
+            AssetLoaderStats before;
+            GetAssetLoaderStats(before);
+            VfsStats vfsBefore;
+            GetVfsStats(vfsBefore);
+            LoadBenchmarkAssets(decoded, run);
+            AssetLoaderStats stats;
+            GetAssetLoaderStats(stats);
+            VfsStats vfsStats;
+            GetVfsStats(vfsStats);
+            loaded = stats.Loaded - before.Loaded == ASSET_LOADER_FILES && loaded;
+            bytesRead = stats.BytesRead - before.BytesRead;
+            readMs = stats.ReadTimeMs - before.ReadTimeMs;
+            vfsOpens = vfsStats.Opens - vfsBefore.Opens;
+        }, nanoseconds, counters);
+    }
+    std::vector<double> threadMs;
+    for (UINT ioThreads : ASSET_LOADER_IO_THREADS) {
+        AssetLoadRun threadRun = {};
+        ShutdownAssetLoader();
+        InitAssetLoader(ioThreads);
+        if (loaded) {
+            LoadBenchmarkAssets(decoded, threadRun);
+        }
+        threadMs.push_back(threadRun.LoadMs);
+    }
+    ShutdownAssetLoader();
+    InitAssetLoader();
+
+    Unmount(mount);
+    for (UINT file = 0; file < ASSET_LOADER_FILES; ++file) {
+        RemoveFile(GetBenchmarkFileName(L"asset_loader", file).c_str());
+    }
+    if (!loaded) {
+        fprintf(stderr, "asset_loader: the files could not be written or loaded.\n");
+        return false;
+    }
+    AddSceneMetrics(metrics, "asset_loader", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "asset_loader", "bytes_read", static_cast<double>(bytesRead));
+    AddBenchmarkMetric(metrics, "asset_loader", "sync_ms", syncMs, BMK_Info);
+    for (size_t i = 0; i < threadMs.size(); ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "io_threads_%u_ms", ASSET_LOADER_IO_THREADS[i]);
+        AddBenchmarkMetric(metrics, "asset_loader", name, threadMs[i], BMK_Info);
+    }
+    AddBenchmarkMetric(metrics, "asset_loader", "queue_ms", run.QueueMs, BMK_Info);
+    AddBenchmarkMetric(metrics, "asset_loader", "frames", run.Frames, BMK_Info);
+    //Time the I/O threads spent in reads, summed over threads, and the main thread's worst frame.
+    AddBenchmarkMetric(metrics, "asset_loader", "vfs_opens", vfsOpens);
+    AddBenchmarkMetric(metrics, "asset_loader", "read_thread_ms", readMs, BMK_Info);
+    AddBenchmarkMetric(metrics, "asset_loader", "main_blocked_ms_max", run.WorstMainBlockedMs, BMK_Info);
+    return decoded != 0;
+}
+
+//A mixed asset set: a third mesh-like float arrays, a third shader-like text and a third random bytes that do not
+//compress, mostly up to 256 KB with some small files and a few sizes at the chunk boundaries.
+void GenerateArchiveAssets(std::vector<std::vector<BYTE>>& assets, std::vector<std::wstring>& paths) {
+    const char* words[] = { "float4 ", "main", "(", "SV_POSITION", " : ", "cbuffer ", "matrix ", ";\n", "return ", "mul(" };
+    uint32_t state = 7;
+    assets.resize(ASSET_ARCHIVE_FILES);
+    paths.resize(ASSET_ARCHIVE_FILES);
+    for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+        size_t size = NextBenchmarkRandom(state) % 3 == 0 ? 1 + NextBenchmarkRandom(state) % 4096 : 1024 + NextBenchmarkRandom(state) % (256 << 10);
+        size = i == 5 ? 0 : i == 6 ? 3 * ASSET_ARCHIVE_CHUNK_SIZE : i == 7 ? ASSET_ARCHIVE_CHUNK_SIZE + 1 : size;
+        std::vector<BYTE>& asset = assets[i];
+        asset.resize(size);
+        wchar_t path[64];
+        if (i % 3 == 0) {
+            for (size_t k = 0; k + sizeof(float) <= size; k += sizeof(float)) {
+                float value = ((k / 12) % 97) * 0.25f + k % 12;
+                memcpy(&asset[k], &value, sizeof(float));
+            }
+            swprintf(path, _countof(path), L"meshes/m%u.emesh", i);
+        }
+        else if (i % 3 == 1) {
+            for (size_t k = 0; k < size; ++k) {
+                asset[k] = words[(k / 7 + NextBenchmarkRandom(state) % 3) % _countof(words)][k % 4];
+            }
+            swprintf(path, _countof(path), L"Shaders/S%u.cso", i);
+        }
+        else {
+            for (BYTE& value : asset) {
+                value = static_cast<BYTE>(NextBenchmarkRandom(state));
+            }
+            swprintf(path, _countof(path), L"textures/t%u.dds", i);
+        }
+        paths[i] = path;
+    }
+}
+
+//Reading 2000 assets at startup from loose files, from a compressed archive, from a stored archive into memory, and
+//from a stored archive in place, touching every page. The compressed archive is the timed part. The page cache is
+//warm; dropping it needs root, so the cold figures are not measured here.
+bool RunAssetArchive(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<std::vector<BYTE>> assets;
+    std::vector<std::wstring> paths;
+    GenerateArchiveAssets(assets, paths);
+    std::vector<AssetArchiveSource> sources(ASSET_ARCHIVE_FILES);
+    bool written = true;
+    for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+        AssetArchiveSource source = { paths[i].c_str(), assets[i].data(), assets[i].size(), false };
+        sources[i] = source;
+        written = written && WriteBenchmarkFile(GetBenchmarkFileName(L"asset_archive", i).c_str(), assets[i].data(), assets[i].size());
+    }
+    AssetArchiveWriteStats writeStats = {};
+    written = written && WriteAssetArchive(ASSET_ARCHIVE_STORED_PATH, sources.data(), ASSET_ARCHIVE_FILES);
+    for (AssetArchiveSource& source : sources) {
+        source.Compress = true;
+    }
+    written = written && WriteAssetArchive(ASSET_ARCHIVE_PATH, sources.data(), ASSET_ARCHIVE_FILES, &writeStats);
+
+    bool loaded = written;
+    HdrHistogram looseNanoseconds;
+    HdrHistogram nanoseconds;
+    HdrHistogram storedNanoseconds;
+    HdrHistogram inPlaceNanoseconds;
+    RenderCounters counters;
+    if (written) {
+        MeasureFrames(ASSET_ARCHIVE_SAMPLES, 1, [&](UINT) {
+            for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+                std::vector<BYTE> data;
+                loaded = (ReadWholeFile(GetBenchmarkFileName(L"asset_archive", i).c_str(), data) || assets[i].empty()) && loaded;
+            }
+        }, looseNanoseconds, counters);
+
+        auto readArchive = [&](const wchar_t* path) {
+            AssetArchive archive;
+            if (!OpenAssetArchive(archive, path)) {
+                loaded = false;
+                return;
+            }
+            for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+                std::vector<BYTE> data;
+                loaded = ReadAssetArchiveEntry(archive, FindAssetArchiveEntry(archive, paths[i].c_str()), data) && data.size() == assets[i].size() && loaded;
+            }
+            CloseAssetArchive(archive);
+        };
+        MeasureFrames(ASSET_ARCHIVE_SAMPLES, 1, [&](UINT) {
+            readArchive(ASSET_ARCHIVE_PATH);
+        }, nanoseconds, counters);
+        MeasureFrames(ASSET_ARCHIVE_SAMPLES, 1, [&](UINT) {
+            readArchive(ASSET_ARCHIVE_STORED_PATH);
+        }, storedNanoseconds, counters);
+
+        uint64_t pageSum = 0;
+        MeasureFrames(ASSET_ARCHIVE_SAMPLES, 1, [&](UINT) {
+            AssetArchive archive;
+            if (!OpenAssetArchive(archive, ASSET_ARCHIVE_STORED_PATH)) {
+                loaded = false;
+                return;
+            }
+            for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+                UINT entry = FindAssetArchiveEntry(archive, paths[i].c_str());
+                const BYTE* data = static_cast<const BYTE*>(GetAssetArchiveEntryData(archive, entry));
+                for (uint64_t offset = 0; offset < archive.Entries[entry].Size; offset += 4096) {
+                    pageSum += data[offset];
+                }
+            }
+            CloseAssetArchive(archive);
+        }, inPlaceNanoseconds, counters);
+        loaded = loaded && pageSum > 0;
+    }
+
+    for (UINT i = 0; i < ASSET_ARCHIVE_FILES; ++i) {
+        RemoveFile(GetBenchmarkFileName(L"asset_archive", i).c_str());
+    }
+    RemoveFile(ASSET_ARCHIVE_PATH);
+    RemoveFile(ASSET_ARCHIVE_STORED_PATH);
+    if (!loaded) {
+        fprintf(stderr, "asset_archive: the assets could not be written or read back.\n");
+        return false;
+    }
+    AddSceneMetrics(metrics, "asset_archive", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "asset_archive", "bytes", static_cast<double>(writeStats.Size));
+    AddBenchmarkMetric(metrics, "asset_archive", "stored_bytes", static_cast<double>(writeStats.StoredSize));
+    AddBenchmarkMetric(metrics, "asset_archive", "compressed_entries", writeStats.CompressedEntries);
+    AddBenchmarkMetric(metrics, "asset_archive", "loose_ms_p50", GetHdrPercentile(looseNanoseconds, 50.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, "asset_archive", "stored_ms_p50", GetHdrPercentile(storedNanoseconds, 50.0) * 0.000001, BMK_Info);
+    AddBenchmarkMetric(metrics, "asset_archive", "in_place_ms_p50", GetHdrPercentile(inPlaceNanoseconds, 50.0) * 0.000001, BMK_Info);
+    return true;
+}
+
+float GetTextureNoiseHash(int x, int y, int seed) {
+    uint32_t hash = x * 374761393u + y * 668265263u + seed * 2147483647u;
+    hash = (hash ^ (hash >> 13)) * 1274126177u;
+    return ((hash ^ (hash >> 16)) & 0xFFFF) / 65535.0f;
+}
+
+float GetTextureNoise(float x, float y, int seed) {
+    int ix = static_cast<int>(floorf(x));
+    int iy = static_cast<int>(floorf(y));
+    float fx = x - ix;
+    float fy = y - iy;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    float a = GetTextureNoiseHash(ix, iy, seed);
+    float b = GetTextureNoiseHash(ix + 1, iy, seed);
+    float c = GetTextureNoiseHash(ix, iy + 1, seed);
+    float d = GetTextureNoiseHash(ix + 1, iy + 1, seed);
+    return a + (b - a) * fx + (c - a) * fy + (a - b - c + d) * fx * fy;
+}
+
+//Six octaves of value noise in every channel, smooth at large scales and detailed at small ones like a photo.
+void GenerateNoiseImage(TextureImage& image, UINT size) {
+    image.Width = size;
+    image.Height = size;
+    image.Pixels.resize(size * size * 4);
+    for (UINT y = 0; y < size; ++y) {
+        for (UINT x = 0; x < size; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                float value = 0.0f;
+                float amplitude = 0.5f;
+                float frequency = 8.0f / size;
+                for (int octave = 0; octave < 6; ++octave, amplitude *= 0.5f, frequency *= 2.0f) {
+                    value += amplitude * GetTextureNoise(x * frequency, y * frequency, c * 17 + octave);
+                }
+                image.Pixels[(y * size + x) * 4 + c] = static_cast<BYTE>(std::min<float>(255.0f, value * 255.0f));
+            }
+        }
+    }
+}
+
+//Reference decoders for the quality check, written from the block format descriptions rather than the encoders.
+void ExpandBC565(uint16_t color, int* rgb) {
+    int r = color >> 11;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+void DecodeBC1Block(const BYTE* block, BYTE texels[16][4], bool alphaBlock) {
+    uint16_t color0;
+    uint16_t color1;
+    uint32_t indices;
+    memcpy(&color0, block, 2);
+    memcpy(&color1, block + 2, 2);
+    memcpy(&indices, block + 4, 4);
+    int palette[4][3];
+    ExpandBC565(color0, palette[0]);
+    ExpandBC565(color1, palette[1]);
+    bool fourColors = alphaBlock || color0 > color1;
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = fourColors ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+        palette[3][c] = fourColors ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+    }
+    for (int i = 0; i < 16; ++i) {
+        int index = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; ++c) {
+            texels[i][c] = static_cast<BYTE>(palette[index][c]);
+        }
+        if (!alphaBlock) {
+            texels[i][3] = !fourColors && index == 3 ? 0 : 255;
+        }
+    }
+}
+
+void DecodeBC4Block(const BYTE* block, BYTE texels[16][4], int channel) {
+    int values[8] = { block[0], block[1] };
+    if (values[0] > values[1]) {
+        for (int i = 1; i < 7; ++i) {
+            values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+        }
+    }
+    else {
+        for (int i = 1; i < 5; ++i) {
+            values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+        }
+        values[6] = 0;
+        values[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) {
+        bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (int i = 0; i < 16; ++i) {
+        texels[i][channel] = static_cast<BYTE>(values[(bits >> (3 * i)) & 7]);
+    }
+}
+
+uint32_t ReadBlockBits(const BYTE* block, UINT& position, UINT count) {
+    uint32_t value = 0;
+    for (UINT i = 0; i < count; ++i, ++position) {
+        value |= ((block[position / 8] >> (position % 8)) & 1) << i;
+    }
+    return value;
+}
+
+//Mode 6 only, the one mode the encoder writes. Returns false for any other mode.
+bool DecodeBC7Block(const BYTE* block, BYTE texels[16][4]) {
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    UINT position = 0;
+    if (ReadBlockBits(block, position, 7) != 64) {
+        return false;
+    }
+    int endpoints[2][4];
+    for (int c = 0; c < 4; ++c) {
+        endpoints[0][c] = ReadBlockBits(block, position, 7);
+        endpoints[1][c] = ReadBlockBits(block, position, 7);
+    }
+    int pBits[2];
+    pBits[0] = ReadBlockBits(block, position, 1);
+    pBits[1] = ReadBlockBits(block, position, 1);
+    for (int c = 0; c < 4; ++c) {
+        endpoints[0][c] = endpoints[0][c] << 1 | pBits[0];
+        endpoints[1][c] = endpoints[1][c] << 1 | pBits[1];
+    }
+    for (int i = 0; i < 16; ++i) {
+        int weight = weights[ReadBlockBits(block, position, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; ++c) {
+            texels[i][c] = static_cast<BYTE>((endpoints[0][c] * (64 - weight) + endpoints[1][c] * weight + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+//Peak signal to noise ratio of the encoded top level against the image, over the channels the format keeps.
+double GetEncodedTexturePsnr(const TextureImage& image, const std::vector<BYTE>& encoded, TextureFormat format) {
+    UINT channels = format == TF_BC1 ? 3 : format == TF_BC5 ? 2 : 4;
+    UINT blocksWide = (image.Width + 3) / 4;
+    UINT blockBytes = GetTextureFormatBlockBytes(format);
+    double squaredError = 0.0;
+    for (UINT by = 0; by < (image.Height + 3) / 4; ++by) {
+        for (UINT bx = 0; bx < blocksWide; ++bx) {
+            const BYTE* block = &encoded[(by * blocksWide + bx) * blockBytes];
+            BYTE texels[16][4];
+            memset(texels, 255, sizeof(texels));
+            if (format == TF_BC1) {
+                DecodeBC1Block(block, texels, false);
+            }
+            else if (format == TF_BC3) {
+                DecodeBC4Block(block, texels, 3);
+                DecodeBC1Block(block + 8, texels, true);
+            }
+            else if (format == TF_BC5) {
+                DecodeBC4Block(block, texels, 0);
+                DecodeBC4Block(block + 8, texels, 1);
+            }
+            else if (!DecodeBC7Block(block, texels)) {
+                return 0.0;
+            }
+            for (UINT i = 0; i < 16; ++i) {
+                UINT x = bx * 4 + i % 4;
+                UINT y = by * 4 + i / 4;
+                if (x >= image.Width || y >= image.Height) {
+                    continue;
+                }
+                for (UINT c = 0; c < channels; ++c) {
+                    double difference = static_cast<double>(image.Pixels[(y * image.Width + x) * 4 + c]) - texels[i][c];
+                    squaredError += difference * difference;
+                }
+            }
+        }
+    }
+    double samples = static_cast<double>(image.Width) * image.Height * channels;
+    return squaredError == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * samples / squaredError);
+}
+
+//Cooking a 2048x2048 noise image with its full mip chain to every block format: the quality of the top level, encode
+//throughput and the memory saved over RGBA8. BC5 is cooked as a normal map, the others as color.
+bool RunTextureCook(std::vector<BenchmarkMetric>& metrics) {
+    TextureImage image;
+    GenerateNoiseImage(image, TEXTURE_COOK_SIZE);
+
+    const TextureFormat formats[] = { TF_BC1, TF_BC3, TF_BC5, TF_BC7 };
+    const char* formatNames[] = { "bc1", "bc3", "bc5", "bc7" };
+    CookedTexture cooked[_countof(formats)];
+    TextureCookStats stats[_countof(formats)] = {};
+    bool cookedAll = true;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(TEXTURE_COOK_SAMPLES, 1, [&](UINT) {
+        for (UINT i = 0; i < _countof(formats); ++i) {
+            TextureCookSettings settings;
+            settings.Format = formats[i];
+            settings.Usage = formats[i] == TF_BC5 ? TU_NormalMap : TU_Color;
+            cookedAll = CookTexture(image, settings, cooked[i], &stats[i]) && cookedAll;
+        }
+    }, nanoseconds, counters);
+    if (!cookedAll) {
+        return false;
+    }
+
+    AddSceneMetrics(metrics, "texture_cook", nanoseconds, nullptr);
+    for (UINT i = 0; i < _countof(formats); ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s_psnr", formatNames[i]);
+        AddBenchmarkMetric(metrics, "texture_cook", name, GetEncodedTexturePsnr(image, cooked[i].Mips[0], formats[i]));
+        snprintf(name, sizeof(name), "%s_mpix_per_s", formatNames[i]);
+        AddBenchmarkMetric(metrics, "texture_cook", name, GetTextureEncodeThroughputMPixels(stats[i]), BMK_Info);
+        snprintf(name, sizeof(name), "%s_saved_percent", formatNames[i]);
+        AddBenchmarkMetric(metrics, "texture_cook", name, GetTextureMemorySavedPercent(stats[i]));
+    }
+    return true;
+}
+
+//Allocate a hundred thousand ranges and free them, every other one first so frees merge on one side and then on both.
+bool RunOffsetAllocator(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<uint32_t> sizes(OFFSET_ALLOCATOR_RANGES);
+    uint32_t state = 5;
+    for (uint32_t& size : sizes) {
+        size = 1 + NextBenchmarkRandom(state) % OFFSET_ALLOCATOR_MAX_SIZE;
+    }
+
+    OffsetAllocator allocator;
+    InitOffsetAllocator(allocator, OFFSET_ALLOCATOR_SIZE);
+    std::vector<uint32_t> allocations(OFFSET_ALLOCATOR_RANGES);
+    bool allocated = true;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(OFFSET_ALLOCATOR_SAMPLES, 1, [&](UINT) {
+        for (UINT i = 0; i < OFFSET_ALLOCATOR_RANGES; ++i) {
+            allocations[i] = AllocateOffset(allocator, sizes[i]);
+        }
+        allocated = allocator.AllocationCount == OFFSET_ALLOCATOR_RANGES && allocated;
+        for (UINT i = 0; i < OFFSET_ALLOCATOR_RANGES; i += 2) {
+            FreeOffset(allocator, allocations[i]);
+        }
+        for (UINT i = 1; i < OFFSET_ALLOCATOR_RANGES; i += 2) {
+            FreeOffset(allocator, allocations[i]);
+        }
+    }, nanoseconds, counters);
+    allocated = ValidateOffsetAllocator(allocator) && allocator.FreeSize == OFFSET_ALLOCATOR_SIZE && allocated;
+
+    AddSceneMetrics(metrics, "offset_allocator", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "offset_allocator", "ns_per_pair", static_cast<double>(GetHdrPercentile(nanoseconds, 50.0)) / OFFSET_ALLOCATOR_RANGES,
+        BMK_Info);
+    return allocated;
+}
+
+void GenerateRects(std::vector<PackedRect>& rects, UINT count, UINT minSize, UINT maxSize, uint32_t state) {
+    rects.resize(count);
+    for (PackedRect& rect : rects) {
+        rect.Width = minSize + NextBenchmarkRandom(state) % (maxSize - minSize + 1);
+        rect.Height = minSize + NextBenchmarkRandom(state) % (maxSize - minSize + 1);
+        rect.Packed = false;
+    }
+}
+
+//Two thousand small rects packed tallest first into a page with room to spare, and the occupancy a page reaches when
+//more rects are offered than fit on it.
+bool RunRectPack(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<PackedRect> rects;
+    GenerateRects(rects, RECT_PACK_RECTS, RECT_PACK_MIN_SIZE, RECT_PACK_MAX_SIZE, 11);
+    RectPacker packer;
+    UINT packed = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(RECT_PACK_SAMPLES, 1, [&](UINT) {
+        InitRectPacker(packer, RECT_PACK_SIZE, RECT_PACK_SIZE);
+        packed = PackRects(packer, rects.data(), RECT_PACK_RECTS);
+    }, nanoseconds, counters);
+    float occupancy = GetRectPackerOccupancyPercent(packer);
+
+    std::vector<PackedRect> saturatedRects;
+    GenerateRects(saturatedRects, RECT_PACK_SATURATED_RECTS, RECT_PACK_SATURATED_MIN_SIZE, RECT_PACK_MAX_SIZE, 3);
+    RectPacker saturated;
+    InitRectPacker(saturated, RECT_PACK_SATURATED_SIZE, RECT_PACK_SATURATED_SIZE);
+    UINT saturatedPacked = PackRects(saturated, saturatedRects.data(), RECT_PACK_SATURATED_RECTS);
+
+    AddSceneMetrics(metrics, "rect_pack", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "rect_pack", "packed", packed);
+    AddBenchmarkMetric(metrics, "rect_pack", "occupancy_percent", occupancy);
+    AddBenchmarkMetric(metrics, "rect_pack", "saturated_packed", saturatedPacked);
+    AddBenchmarkMetric(metrics, "rect_pack", "saturated_occupancy_percent", GetRectPackerOccupancyPercent(saturated));
+    return packed == RECT_PACK_RECTS && saturatedPacked < RECT_PACK_SATURATED_RECTS;
+}
+
+//Vertices of fifty thousand 16 pixel sprites over a 1080p viewport, the work a sprite batch flush does per quad.
+bool RunSpriteVertices(std::vector<BenchmarkMetric>& metrics) {
+    std::vector<Sprite> sprites(SPRITE_VERTICES_SPRITES);
+    uint32_t state = 13;
+    for (UINT i = 0; i < SPRITE_VERTICES_SPRITES; ++i) {
+        float x = GetBenchmarkRandom(state, 0.0f, SPRITE_VERTICES_VIEWPORT_WIDTH - 16.0f);
+        float y = GetBenchmarkRandom(state, 0.0f, SPRITE_VERTICES_VIEWPORT_HEIGHT - 16.0f);
+        Sprite sprite = { XMFLOAT4(x, y, x + 16.0f, y + 16.0f), XMFLOAT4(0.0f, 0.0f, 0.1f, 0.1f), 0xFFFFFFFF, i % 4 };
+        sprites[i] = sprite;
+    }
+
+    std::vector<SpriteVertex> vertices(static_cast<size_t>(SPRITE_VERTICES_SPRITES) * SPRITE_VERTICES);
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(SPRITE_VERTICES_SAMPLES, SPRITE_VERTICES_FRAMES_PER_SAMPLE, [&](UINT) {
+        GenerateSpriteVertices(sprites.data(), SPRITE_VERTICES_SPRITES, SPRITE_VERTICES_VIEWPORT_WIDTH, SPRITE_VERTICES_VIEWPORT_HEIGHT, vertices.data());
+    }, nanoseconds, counters);
+
+    AddSceneMetrics(metrics, "sprite_vertices", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "sprite_vertices", "mquads_per_s", SPRITE_VERTICES_SPRITES / (GetHdrPercentile(nanoseconds, 50.0) * 0.001), BMK_Info);
+    //The last sprite's bottom right corner lands on its clip space position.
+    const SpriteVertex& corner = vertices.back();
+    const Sprite& last = sprites.back();
+    return fabsf(corner.Position.x - (last.Rect.z * 2.0f / SPRITE_VERTICES_VIEWPORT_WIDTH - 1.0f)) < 1e-5f &&
+        fabsf(corner.Position.y - (1.0f - last.Rect.w * 2.0f / SPRITE_VERTICES_VIEWPORT_HEIGHT)) < 1e-5f;
+}
+
+//A glyph of a monospaced font without a real rasterizer behind it: blanks have only an advance, everything else a
+//small box of coverage.
+bool RasterizeBenchmarkGlyph(uint32_t codepoint, GlyphBitmap& glyph) {
+    if (codepoint == ' ') {
+        glyph.Width = 0;
+        glyph.Height = 0;
+        glyph.Advance = 5.0f;
+        return true;
+    }
+    glyph.Width = 6 + codepoint % 5;
+    glyph.Height = 10 + codepoint % 4;
+    glyph.OffsetX = 1;
+    glyph.OffsetY = -static_cast<int>(glyph.Height);
+    glyph.Advance = static_cast<float>(glyph.Width + 1);
+    glyph.Coverage.assign(static_cast<size_t>(glyph.Width) * glyph.Height, static_cast<BYTE>(codepoint));
+    return true;
+}
+
+UINT CountCodepoints(const std::string& text) {
+    UINT count = 0;
+    for (char byte : text) {
+        count += (static_cast<BYTE>(byte) & 0xC0) != 0x80;
+    }
+    return count;
+}
+
+//Laying out a full screen debug page every frame with every glyph already cached: HUD words mixing ASCII, Latin-1 and
+//Greek, or printable ASCII only.
+bool RunTextLayout(std::vector<BenchmarkMetric>& metrics, bool ascii) {
+    const char* words[] = { "frame ", "12.34 ", "ms ", "visible ", "objects: ", "1024 ", "culled ", u8"\u0394t ", u8"r\u00E9sum\u00E9 ", "GPU " };
+    std::string page;
+    for (UINT line = 0; line < TEXT_LAYOUT_LINES; ++line) {
+        size_t start = page.size();
+        for (UINT word = line; page.size() - start < TEXT_LAYOUT_LINE_BYTES; ++word) {
+            page += words[word % _countof(words)];
+        }
+        page += '\n';
+    }
+    if (ascii) {
+        for (size_t i = 0; i < page.size(); ++i) {
+            page[i] = (i + 1) % (TEXT_LAYOUT_LINE_BYTES + 1) == 0 ? '\n' : static_cast<char>('!' + i % 90);
+        }
+    }
+
+    GlyphFontMetrics fontMetrics = { 12.0f, 16.0f };
+    GlyphCache cache;
+    InitGlyphCache(cache, GLYPH_CACHE_DEFAULT_SIZE, RasterizeBenchmarkGlyph, fontMetrics);
+    std::vector<Sprite> sprites(page.size());
+    //The first layout rasterizes the page's glyphs; the frames measured only look them up.
+    BeginGlyphCacheFrame(cache);
+    LayoutText(cache, page.c_str(), 0.0f, 0.0f, 0xFFFFFFFF, 0, sprites.data(), static_cast<UINT>(sprites.size()));
+    GlyphCacheStats before;
+    GetGlyphCacheStats(cache, before);
+
+    UINT spriteCount = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(TEXT_LAYOUT_SAMPLES, TEXT_LAYOUT_FRAMES_PER_SAMPLE, [&](UINT) {
+        BeginGlyphCacheFrame(cache);
+        spriteCount = LayoutText(cache, page.c_str(), 0.0f, 0.0f, 0xFFFFFFFF, 0, sprites.data(), static_cast<UINT>(sprites.size()));
+    }, nanoseconds, counters);
+    GlyphCacheStats after;
+    GetGlyphCacheStats(cache, after);
+
+    const char* scene = ascii ? "text_layout_ascii" : "text_layout";
+    UINT codepoints = CountCodepoints(page);
+    AddSceneMetrics(metrics, scene, nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, scene, "codepoints", codepoints);
+    AddBenchmarkMetric(metrics, scene, "sprites", spriteCount);
+    AddBenchmarkMetric(metrics, scene, "mglyphs_per_s", codepoints / (GetHdrPercentile(nanoseconds, 50.0) * 0.001), BMK_Info);
+    return after.Misses == before.Misses && after.DroppedGlyphs == 0 && spriteCount > 0;
+}
+
+bool RunTextLayoutMixed(std::vector<BenchmarkMetric>& metrics) {
+    return RunTextLayout(metrics, false);
+}
+
+bool RunTextLayoutAscii(std::vector<BenchmarkMetric>& metrics) {
+    return RunTextLayout(metrics, true);
+}
+
+enum DebugDrawCase
+{
+    DDC_Lines,
+    DDC_Boxes,
+    // Lines queued with drawing switched off at run time.
+    DDC_Disabled
+};
+
+//Queue a hundred thousand lines, or the boxes that make as many, from one thread and merge them into the single buffer a
+//flush uploads.
+bool RunDebugDraw(std::vector<BenchmarkMetric>& metrics, DebugDrawCase drawCase) {
+    std::vector<XMFLOAT3> points(DEBUG_DRAW_LINES * 2);
+    for (UINT i = 0; i < DEBUG_DRAW_LINES * 2; ++i) {
+        points[i] = XMFLOAT3(static_cast<float>(i), static_cast<float>(i * 7 % 13), static_cast<float>(i % 5));
+    }
+    XMVECTOR lineColor = XMVectorSet(1.0f, 0.0f, 0.0f, 1.0f);
+    XMVECTOR boxColor = XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f);
+
+    std::vector<DebugVertex> vertices;
+    UINT vertexCount = 0;
+    UINT threads = 0;
+    double queueMs = 0.0;
+    double mergeMs = 0.0;
+    SetDebugDrawEnabled(drawCase != DDC_Disabled);
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(DEBUG_DRAW_SAMPLES, 1, [&](UINT frame) {
+        //Warmup frames are left out of the split between queuing and merging.
+        bool measured = frame >= BENCHMARK_WARMUP_FRAMES;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (drawCase == DDC_Boxes) {
+            for (UINT i = 0; i < DEBUG_DRAW_BOXES; ++i) {
+                DebugDrawBox(BoundingBox(points[i], XMFLOAT3(1.0f, 1.0f, 1.0f)), boxColor);
+            }
+        }
+        else {
+            for (UINT i = 0; i < DEBUG_DRAW_LINES; ++i) {
+                DebugDrawLine(XMLoadFloat3(&points[2 * i]), XMLoadFloat3(&points[2 * i + 1]), lineColor);
+            }
+        }
+        queueMs += measured ? ElapsedMs(start) : 0.0;
+
+        start = std::chrono::steady_clock::now();
+        vertexCount = GetDebugDrawVertexCount(threads);
+        vertices.resize(vertexCount);
+        MergeDebugDraw(vertices.data());
+        mergeMs += measured ? ElapsedMs(start) : 0.0;
+    }, nanoseconds, counters);
+    SetDebugDrawEnabled(true);
+
+    const char* scene = drawCase == DDC_Lines ? "debug_draw" : drawCase == DDC_Boxes ? "debug_draw_boxes" : "debug_draw_disabled";
+    AddSceneMetrics(metrics, scene, nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, scene, "lines", vertexCount / 2);
+    AddBenchmarkMetric(metrics, scene, "queue_ms", queueMs / DEBUG_DRAW_SAMPLES, BMK_Info);
+    AddBenchmarkMetric(metrics, scene, "merge_ms", mergeMs / DEBUG_DRAW_SAMPLES, BMK_Info);
+    UINT expectedLines = drawCase == DDC_Lines ? DEBUG_DRAW_LINES : drawCase == DDC_Boxes ? DEBUG_DRAW_BOXES * 12 : 0;
+    return vertexCount == expectedLines * 2 && (vertexCount == 0 || threads == 1);
+}
+
+bool RunDebugDrawLines(std::vector<BenchmarkMetric>& metrics) {
+    return RunDebugDraw(metrics, DDC_Lines);
+}
+
+bool RunDebugDrawBoxes(std::vector<BenchmarkMetric>& metrics) {
+    return RunDebugDraw(metrics, DDC_Boxes);
+}
+
+bool RunDebugDrawDisabled(std::vector<BenchmarkMetric>& metrics) {
+    return RunDebugDraw(metrics, DDC_Disabled);
+}
+
+//Record a hundred thousand frames of about 16 ms with a 45 ms spike every thousand, and check the histogram's percentiles
+//of a million values spread over nine orders of magnitude against the exact ones.
+bool RunFrameStats(std::vector<BenchmarkMetric>& metrics) {
+    uint32_t state = 17;
+    std::vector<FrameSample> samples(FRAME_STATS_FRAMES);
+    for (UINT i = 0; i < FRAME_STATS_FRAMES; ++i) {
+        FrameSample sample = { 16.0 + GetBenchmarkRandom(state, 0.0f, 1.5f), 2.0 + GetBenchmarkRandom(state, 0.0f, 1.0f),
+            5.0 + GetBenchmarkRandom(state, 0.0f, 1.0f), 8.0, 40 + NextBenchmarkRandom(state) % 10, 4096 };
+        if (i % FRAME_STATS_SPIKE_INTERVAL == FRAME_STATS_SPIKE_INTERVAL / 2) {
+            sample.FrameMs = 45.0;
+        }
+        samples[i] = sample;
+    }
+
+    FrameStats stats;
+    UINT stutters = 0;
+    HdrHistogram nanoseconds;
+    RenderCounters counters;
+    MeasureFrames(FRAME_STATS_SAMPLES, 1, [&](UINT) {
+        ResetFrameStats(stats);
+        stutters = 0;
+        for (const FrameSample& sample : samples) {
+            stutters += RecordFrame(stats, sample);
+        }
+    }, nanoseconds, counters);
+
+    HdrHistogram histogram;
+    std::vector<uint64_t> values(HDR_HISTOGRAM_VALUES);
+    for (uint64_t& value : values) {
+        value = static_cast<uint64_t>(exp(GetBenchmarkRandom(state, 0.0f, 20.0f)));
+        RecordHdrValue(histogram, value);
+    }
+    std::sort(values.begin(), values.end());
+    double worstError = 0.0;
+    const double percents[] = { 1.0, 10.0, 50.0, 90.0, 95.0, 99.0, 99.9, 100.0 };
+    for (double percent : percents) {
+        uint64_t exact = values[static_cast<size_t>(ceil(percent / 100.0 * values.size())) - 1];
+        double error = fabs(static_cast<double>(GetHdrPercentile(histogram, percent)) - exact) / exact;
+        worstError = std::max<double>(worstError, error);
+    }
+
+    AddSceneMetrics(metrics, "frame_stats", nanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "frame_stats", "stutters", stutters);
+    AddBenchmarkMetric(metrics, "frame_stats", "us_per_frame", GetHdrPercentile(nanoseconds, 50.0) * 0.001 / FRAME_STATS_FRAMES, BMK_Info);
+    AddBenchmarkMetric(metrics, "frame_stats", "histogram_bins", static_cast<double>(histogram.Counts.size()));
+    AddBenchmarkMetric(metrics, "frame_stats", "worst_percentile_error_percent", worstError * 100.0);
+    return stutters == FRAME_STATS_FRAMES / FRAME_STATS_SPIKE_INTERVAL;
+}
+
+//Nanoseconds a profiler clock read takes, the fastest of a few runs.
+double MeasureProfilerClockNs() {
+    double fastestNs = DBL_MAX;
+    for (UINT run = 0; run < 5; ++run) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (UINT i = 0; i < PROFILER_ZONES; ++i) {
+            ReadProfilerClock();
+        }
+        fastestNs = std::min<double>(fastestNs, ElapsedMs(start) * 1000000.0 / PROFILER_ZONES);
+    }
+    return fastestNs;
+}
+
+void OpenProfileZones() {
+    for (UINT i = 0; i < PROFILER_ZONES; ++i) {
+        PROFILE_ZONE("BenchmarkZone");
+    }
+}
+
+//Open ten thousand zones a frame outside a capture, then while recording one with a frame mark after every frame as the main
+//loop has. A zone that costs more than PROFILER_ZONE_BUDGET_NS and its clock reads while recording fails the scene.
+bool RunProfiler(std::vector<BenchmarkMetric>& metrics) {
+    InitProfiler();
+    HdrHistogram idleNanoseconds;
+    RenderCounters counters;
+    MeasureFrames(PROFILER_SAMPLES, 1, [&](UINT) {
+        OpenProfileZones();
+    }, idleNanoseconds, counters);
+
+    //The capture starts at the next frame mark and completes at the mark after the last frame.
+    StartProfilerCapture(BENCHMARK_WARMUP_FRAMES + PROFILER_SAMPLES);
+    ProfilerFrameMark();
+    HdrHistogram zoneNanoseconds;
+    HdrHistogram frameNanoseconds;
+    double drainMs = 0.0;
+    bool complete = false;
+    MeasureFrames(PROFILER_SAMPLES, 1, [&](UINT frame) {
+        bool measured = frame >= BENCHMARK_WARMUP_FRAMES;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        OpenProfileZones();
+        if (measured) {
+            RecordHdrValue(zoneNanoseconds, static_cast<uint64_t>(ElapsedMs(start) * 1000000.0 + 0.5));
+        }
+
+        start = std::chrono::steady_clock::now();
+        complete = ProfilerFrameMark();
+        drainMs += measured ? ElapsedMs(start) : 0.0;
+    }, frameNanoseconds, counters);
+    ProfilerStats stats;
+    GetProfilerStats(stats);
+    ShutdownProfiler();
+
+    double recordingNsPerZone = static_cast<double>(GetHdrPercentile(zoneNanoseconds, 50.0)) / PROFILER_ZONES;
+    double clockNs = MeasureProfilerClockNs();
+    AddSceneMetrics(metrics, "profiler", zoneNanoseconds, nullptr);
+    AddBenchmarkMetric(metrics, "profiler", "idle_ms_p50", GetHdrPercentile(idleNanoseconds, 50.0) * 0.000001, BMK_Time);
+    AddBenchmarkMetric(metrics, "profiler", "zones", stats.Zones);
+    AddBenchmarkMetric(metrics, "profiler", "dropped_zones", stats.DroppedZones);
+    AddBenchmarkMetric(metrics, "profiler", "recording_ns_per_zone", recordingNsPerZone, BMK_Info);
+    AddBenchmarkMetric(metrics, "profiler", "idle_ns_per_zone", static_cast<double>(GetHdrPercentile(idleNanoseconds, 50.0)) / PROFILER_ZONES, BMK_Info);
+    AddBenchmarkMetric(metrics, "profiler", "clock_ns", clockNs, BMK_Info);
+    AddBenchmarkMetric(metrics, "profiler", "drain_ms", drainMs / PROFILER_SAMPLES, BMK_Info);
+    return complete && stats.DroppedZones == 0 && recordingNsPerZone - 2.0 * clockNs < PROFILER_ZONE_BUDGET_NS;
+}
+
+struct BenchmarkScene
+{
+    const char* Name;
+    bool (*Run)(std::vector<BenchmarkMetric>& metrics);
+};
+
+const BenchmarkScene BENCHMARK_SCENES[] = {
+    { "single_cube", RunSingleCube },
+    { "instanced_cubes", RunInstancedCubes },
+    { "static_batch", RunStaticBatch },
+    { "culled_objects", RunCulledObjectsBVH },
+    { "culled_objects_grid", RunCulledObjectsGrid },
+    { "obj_import", RunObjImport },
+    { "mesh_import", RunMeshImport },
+    { "mesh_optimize", RunMeshOptimize },
+    { "mesh_layout", RunMeshLayout },
+    { "meshlet_cull", RunMeshletCull },
+    { "mesh_lod", RunMeshLod },
+    { "mesh_load", RunMeshLoadMapped },
+    { "mesh_load_text", RunMeshLoadText },
+    { "bvh_build", RunBVHBuild },
+    { "bvh_refit", RunBVHRefitAll },
+    { "bvh_refit_moved", RunBVHRefitMoved },
+    { "bvh_cull", RunBVHCull },
+    { "bvh_raycast", RunBVHRaycast },
+    { "spatial_hash", RunSpatialHashQueries },
+    { "spatial_scan", RunSpatialScanQueries },
+    { "texture_cook", RunTextureCook },
+    { "texture_streaming", RunTextureStreaming },
+    { "asset_loader", RunAssetLoader },
+    { "asset_archive", RunAssetArchive },
+    { "offset_allocator", RunOffsetAllocator },
+    { "rect_pack", RunRectPack },
+    { "sprite_vertices", RunSpriteVertices },
+    { "text_layout", RunTextLayoutMixed },
+    { "text_layout_ascii", RunTextLayoutAscii },
+    { "debug_draw", RunDebugDrawLines },
+    { "debug_draw_boxes", RunDebugDrawBoxes },
+    { "debug_draw_disabled", RunDebugDrawDisabled },
+    { "frame_stats", RunFrameStats },
+    { "profiler", RunProfiler }
+};
+
+bool IsSceneSelected(const std::vector<std::string>& scenes, const std::string& scene) {
+    return scenes.empty() || std::find(scenes.begin(), scenes.end(), scene) != scenes.end();
+}
+
+std::wstring WidenArgument(const char* argument) {
+    std::wstring result;
+    size_t length = mbstowcs(nullptr, argument, 0);
+    if (length != static_cast<size_t>(-1)) {
+        result.resize(length);
+        mbstowcs(&result[0], argument, length);
+    }
+    return result;
+}
+
+}
+
+//Exit code 0 when every metric is within its baseline, 1 when any regressed or is missing and 2 when the run itself failed.
+//--scene runs only the named scenes, and compares or updates only their metrics. --counts-only compares or updates only
+//the counters, which are the same on every machine, for a baseline that is shared.
+int main(int argc, char* argv[]) {
+    std::wstring baselinePath = BENCHMARK_BASELINE_PATH;
+    float thresholdPercent = BENCHMARK_DEFAULT_THRESHOLD_PERCENT;
+    bool updateBaseline = false;
+    bool countsOnly = false;
+    std::vector<std::string> scenes;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = WidenArgument(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            thresholdPercent = static_cast<float>(atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--update") == 0) {
+            updateBaseline = true;
+        }
+        else if (strcmp(argv[i], "--counts-only") == 0) {
+            countsOnly = true;
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            scenes.push_back(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--baseline file.json] [--threshold percent] [--update] [--counts-only] [--scene name]...\n", argv[0]);
+            return 2;
+        }
+    }
+    for (const std::string& scene : scenes) {
+        bool known = false;
+        for (const BenchmarkScene& benchmarkScene : BENCHMARK_SCENES) {
+            known = known || scene == benchmarkScene.Name;
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown scene %s.\n", scene.c_str());
+            return 2;
+        }
+    }
+
+    //The baseline is read first, so a run that has nothing to compare with fails before it takes any time.
+    std::vector<BenchmarkMetric> baseline;
+    bool baselineRead = ReadBenchmarkBaseline(baselinePath.c_str(), baseline);
+    if (!baselineRead && !updateBaseline) {
+        fprintf(stderr, "Could not read the baseline %ls. Run with --update to record one.\n", baselinePath.c_str());
+        return 2;
+    }
+    //Only the selected scenes' metrics are compared or replaced.
+    std::vector<BenchmarkMetric> otherScenes;
+    std::vector<BenchmarkMetric> selectedScenes;
+    for (const BenchmarkMetric& metric : baseline) {
+        (IsSceneSelected(scenes, GetBenchmarkScene(metric)) ? selectedScenes : otherScenes).push_back(metric);
+    }
+
+    InitJobSystem();
+    InitVirtualFileSystem();
+    InitAssetLoader();
+    InitGpuTimer(g_GpuTimer, CreateSoftwareGpuTimerBackend());
+    std::vector<BenchmarkMetric> metrics;
+    const char* failedScene = nullptr;
+    for (const BenchmarkScene& scene : BENCHMARK_SCENES) {
+        if (IsSceneSelected(scenes, scene.Name) && !scene.Run(metrics)) {
+            failedScene = scene.Name;
+            break;
+        }
+    }
+    ReleaseGpuTimer(g_GpuTimer);
+    ShutdownAssetLoader();
+    ShutdownVirtualFileSystem();
+    ShutdownJobSystem();
+    if (failedScene) {
+        fprintf(stderr, "The benchmark scene %s failed to run.\n", failedScene);
+        return 2;
+    }
+    if (countsOnly) {
+        metrics.erase(std::remove_if(metrics.begin(), metrics.end(),
+            [](const BenchmarkMetric& metric) { return metric.Kind != BMK_Count; }), metrics.end());
+    }
+
+    if (updateBaseline) {
+        otherScenes.insert(otherScenes.end(), metrics.begin(), metrics.end());
+        if (!WriteBenchmarkBaseline(baselinePath.c_str(), otherScenes)) {
+            fprintf(stderr, "Could not write the baseline.\n");
+            return 2;
+        }
+        printf("Baseline of %u metrics written.\n", static_cast<UINT>(otherScenes.size()));
+        return 0;
+    }
+
+    std::vector<BenchmarkComparison> comparisons;
+    UINT regressions = CompareBenchmarkMetrics(selectedScenes, metrics, thresholdPercent, comparisons);
+    PrintBenchmarkComparisons(stdout, comparisons);
+    printf("%u of %u metrics regressed or are missing.\n", regressions, static_cast<UINT>(comparisons.size()));
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+#include "EchoEngineCore.h"
+#include "DebugDraw.h"
+using namespace DirectX;
+
+#if DEBUG_DRAW_ENABLED
+
+namespace {
+
+//Corners of the cube from -1 to 1: the z = -1 face in order around it, then the z = 1 face.
+const float DEBUG_BOX_CORNERS[8][3] = {
+    { -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+    { -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }
+};
+const BYTE DEBUG_BOX_EDGES[12][2] = {
+    { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+    { 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+};
+
+struct DebugDrawBuffer
+{
+    std::vector<DebugVertex> Vertices;
+};
+
+std::mutex g_DebugDrawMutex;
+std::vector<std::unique_ptr<DebugDrawBuffer>> g_DebugDrawBuffers;
+//Changes on shutdown so threads register a new buffer instead of using a released one.
+std::atomic<UINT> g_DebugDrawGeneration{ 1 };
+std::atomic<bool> g_DebugDrawEnabled{ true };
+
+//Ends of a circle's segments on the unit circle.
+struct CircleDirections
+{
+    XMFLOAT2 Directions[DEBUG_DRAW_CIRCLE_SEGMENTS];
+
+    CircleDirections() {
+        for (UINT i = 0; i < DEBUG_DRAW_CIRCLE_SEGMENTS; ++i) {
+            XMScalarSinCos(&Directions[i].y, &Directions[i].x, XM_2PI * i / DEBUG_DRAW_CIRCLE_SEGMENTS);
+        }
+    }
+};
+const CircleDirections g_CircleDirections;
+
+thread_local DebugDrawBuffer* t_DebugDrawBuffer = nullptr;
+thread_local UINT t_DebugDrawGeneration = 0;
+
+DebugDrawBuffer& GetThreadDebugDrawBuffer() {
+    UINT generation = g_DebugDrawGeneration.load(std::memory_order_relaxed);
+    if (t_DebugDrawGeneration != generation) {
+        std::lock_guard<std::mutex> lock(g_DebugDrawMutex);
+        g_DebugDrawBuffers.emplace_back(new DebugDrawBuffer());
+        t_DebugDrawBuffer = g_DebugDrawBuffers.back().get();
+        t_DebugDrawGeneration = generation;
+    }
+    return *t_DebugDrawBuffer;
+}
+
+//Room for lineCount more lines at the end of the buffer.
+DebugVertex* AppendDebugLines(DebugDrawBuffer& buffer, UINT lineCount) {
+    size_t first = buffer.Vertices.size();
+    buffer.Vertices.resize(first + lineCount * 2);
+    return &buffer.Vertices[first];
+}
+
+inline void SetDebugLine(DebugVertex* line, FXMVECTOR from, FXMVECTOR to, uint32_t color) {
+    XMStoreFloat3(&line[0].Position, from);
+    line[0].Color = color;
+    XMStoreFloat3(&line[1].Position, to);
+    line[1].Color = color;
+}
+
+void AppendDebugBoxEdges(const XMVECTOR corners[8], uint32_t color) {
+    DebugVertex* lines = AppendDebugLines(GetThreadDebugDrawBuffer(), _countof(DEBUG_BOX_EDGES));
+    for (UINT i = 0; i < _countof(DEBUG_BOX_EDGES); ++i, lines += 2) {
+        SetDebugLine(lines, corners[DEBUG_BOX_EDGES[i][0]], corners[DEBUG_BOX_EDGES[i][1]], color);
+    }
+}
+
+}
+
+void SetDebugDrawEnabled(bool enabled) {
+    g_DebugDrawEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsDebugDrawEnabled() {
+    return g_DebugDrawEnabled.load(std::memory_order_relaxed);
+}
+
+void DebugDrawLine(FXMVECTOR from, FXMVECTOR to, FXMVECTOR color) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    SetDebugLine(AppendDebugLines(GetThreadDebugDrawBuffer(), 1), from, to, PackColor(color));
+}
+
+void DebugDrawBox(const BoundingBox& box, FXMVECTOR color) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    XMVECTOR center = XMLoadFloat3(&box.Center);
+    XMVECTOR extents = XMLoadFloat3(&box.Extents);
+    XMVECTOR corners[8];
+    for (UINT i = 0; i < 8; ++i) {
+        corners[i] = XMVectorMultiplyAdd(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(DEBUG_BOX_CORNERS[i])), extents, center);
+    }
+    AppendDebugBoxEdges(corners, PackColor(color));
+}
+
+void DebugDrawBox(FXMMATRIX matrix, FXMVECTOR color) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    XMVECTOR corners[8];
+    for (UINT i = 0; i < 8; ++i) {
+        corners[i] = XMVector3TransformCoord(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(DEBUG_BOX_CORNERS[i])), matrix);
+    }
+    AppendDebugBoxEdges(corners, PackColor(color));
+}
+
+void DebugDrawSphere(const BoundingSphere& sphere, FXMVECTOR color) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    XMVECTOR center = XMLoadFloat3(&sphere.Center);
+    uint32_t packedColor = PackColor(color);
+    const XMVECTOR axes[3] = {
+        XMVectorSet(sphere.Radius, 0.0f, 0.0f, 0.0f),
+        XMVectorSet(0.0f, sphere.Radius, 0.0f, 0.0f),
+        XMVectorSet(0.0f, 0.0f, sphere.Radius, 0.0f)
+    };
+
+    DebugVertex* lines = AppendDebugLines(GetThreadDebugDrawBuffer(), DEBUG_DRAW_CIRCLE_SEGMENTS * 3);
+    for (UINT circle = 0; circle < 3; ++circle) {
+        XMVECTOR axisU = axes[circle];
+        XMVECTOR axisV = axes[(circle + 1) % 3];
+        XMVECTOR previous = XMVectorAdd(center, axisU);
+        for (UINT i = 1; i <= DEBUG_DRAW_CIRCLE_SEGMENTS; ++i, lines += 2) {
+            const XMFLOAT2& direction = g_CircleDirections.Directions[i % DEBUG_DRAW_CIRCLE_SEGMENTS];
+            XMVECTOR point = XMVectorMultiplyAdd(axisV, XMVectorReplicate(direction.y), XMVectorMultiplyAdd(axisU, XMVectorReplicate(direction.x), center));
+            SetDebugLine(lines, previous, point, packedColor);
+            previous = point;
+        }
+    }
+}
+
+void DebugDrawFrustum(FXMMATRIX viewProjection, FXMVECTOR color) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    //Clip space depth runs from 0 to 1, so the cube's z = -1 face becomes the near plane.
+    XMMATRIX inverseViewProjection = XMMatrixInverse(nullptr, viewProjection);
+    XMVECTOR corners[8];
+    for (UINT i = 0; i < 8; ++i) {
+        XMVECTOR clipCorner = XMVectorSet(DEBUG_BOX_CORNERS[i][0], DEBUG_BOX_CORNERS[i][1], DEBUG_BOX_CORNERS[i][2] * 0.5f + 0.5f, 1.0f);
+        corners[i] = XMVector3TransformCoord(clipCorner, inverseViewProjection);
+    }
+    AppendDebugBoxEdges(corners, PackColor(color));
+}
+
+void DebugDrawAxes(FXMMATRIX matrix, float size) {
+    if (!IsDebugDrawEnabled()) {
+        return;
+    }
+    const uint32_t axisColors[3] = { 0xFF0000FF, 0xFF00FF00, 0xFFFF0000 };
+    XMVECTOR origin = matrix.r[3];
+    DebugVertex* lines = AppendDebugLines(GetThreadDebugDrawBuffer(), 3);
+    for (UINT i = 0; i < 3; ++i, lines += 2) {
+        SetDebugLine(lines, origin, XMVectorMultiplyAdd(XMVector3Normalize(matrix.r[i]), XMVectorReplicate(size), origin), axisColors[i]);
+    }
+}
+
+UINT GetDebugDrawVertexCount(UINT& threads) {
+    std::lock_guard<std::mutex> lock(g_DebugDrawMutex);
+    UINT vertexCount = 0;
+    threads = 0;
+    for (const std::unique_ptr<DebugDrawBuffer>& buffer : g_DebugDrawBuffers) {
+        vertexCount += static_cast<UINT>(buffer->Vertices.size());
+        threads += buffer->Vertices.empty() ? 0 : 1;
+    }
+    return vertexCount;
+}
+
+void MergeDebugDraw(DebugVertex* vertices) {
+    std::lock_guard<std::mutex> lock(g_DebugDrawMutex);
+    for (const std::unique_ptr<DebugDrawBuffer>& buffer : g_DebugDrawBuffers) {
+        if (vertices) {
+            memcpy(vertices, buffer->Vertices.data(), buffer->Vertices.size() * sizeof(DebugVertex));
+            vertices += buffer->Vertices.size();
+        }
+        buffer->Vertices.clear();
+    }
+}
+
+void ReleaseDebugDrawBuffers() {
+    std::lock_guard<std::mutex> lock(g_DebugDrawMutex);
+    g_DebugDrawBuffers.clear();
+    g_DebugDrawGeneration.fetch_add(1);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "EchoEnginePCH.h"
+#include "DebugDraw.h"
+#include "Profiler.h"
+#include "RenderCountersD3D11.h"
+
+#if DEBUG_DRAW_ENABLED
+
+namespace {
+
+//Smallest transient vertex buffer, in vertices.
+const UINT DEBUG_DRAW_MIN_VERTICES = 4096;
+
+ID3D11InputLayout* g_DebugInputLayout = nullptr;
+ID3D11Buffer* g_DebugVertexBuffer = nullptr;
+UINT g_DebugVertexCapacity = 0;
+
+}
+
+bool InitDebugDraw(ID3D11Device* device, const void* vertexShaderBytecode, size_t vertexShaderSize) {
+    assert(device);
+
+    //SimpleVertexShader reads a float3 color; the bytes are expanded to floats and alpha is left out.
+    D3D11_INPUT_ELEMENT_DESC vertexLayoutDesc[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(DebugVertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(DebugVertex, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+    HRESULT hr = device->CreateInputLayout(vertexLayoutDesc, _countof(vertexLayoutDesc), vertexShaderBytecode, vertexShaderSize, &g_DebugInputLayout);
+    return SUCCEEDED(hr);
+}
+
+void ShutdownDebugDraw() {
+    ReleaseDebugDrawBuffers();
+    SafeRelease(g_DebugInputLayout);
+    SafeRelease(g_DebugVertexBuffer);
+    g_DebugVertexCapacity = 0;
+}
+
+bool FlushDebugDraw(ID3D11Device* device, ID3D11DeviceContext* deviceContext, DebugDrawStats& stats) {
+    PROFILE_ZONE("FlushDebugDraw");
+    assert(device);
+    assert(deviceContext);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stats = DebugDrawStats();
+
+    UINT vertexCount = GetDebugDrawVertexCount(stats.Threads);
+    if (vertexCount == 0) {
+        return true;
+    }
+
+    if (g_DebugVertexCapacity < vertexCount) {
+        SafeRelease(g_DebugVertexBuffer);
+        g_DebugVertexCapacity = 0;
+
+        //Leave headroom so a slowly growing amount of lines does not reallocate every frame.
+        UINT capacity = std::max<UINT>(vertexCount + vertexCount / 2, DEBUG_DRAW_MIN_VERTICES);
+
+        D3D11_BUFFER_DESC vertexBufferDesc;
+        ZeroMemory(&vertexBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+        vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        vertexBufferDesc.ByteWidth = capacity * sizeof(DebugVertex);
+        vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+        HRESULT hr = DeviceCreateBuffer(device, &vertexBufferDesc, nullptr, &g_DebugVertexBuffer);
+        if (SUCCEEDED(hr)) {
+            g_DebugVertexCapacity = capacity;
+        }
+    }
+
+    //Merge every thread's lines into the transient buffer. The buffers are emptied even if that fails.
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    bool written = false;
+    if (g_DebugVertexBuffer && SUCCEEDED(ContextMap(deviceContext, g_DebugVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource))) {
+        MergeDebugDraw(static_cast<DebugVertex*>(mappedResource.pData));
+        ContextUnmap(deviceContext, g_DebugVertexBuffer, 0, static_cast<uint64_t>(vertexCount) * sizeof(DebugVertex));
+        written = true;
+    }
+    else {
+        MergeDebugDraw(nullptr);
+    }
+    stats.MergeTimeMs = ElapsedMs(start);
+    if (!written) {
+        return false;
+    }
+
+    UINT stride = sizeof(DebugVertex);
+    UINT offset = 0;
+    ContextIASetVertexBuffers(deviceContext, 0, 1, &g_DebugVertexBuffer, &stride, &offset);
+    ContextIASetInputLayout(deviceContext, g_DebugInputLayout);
+    ContextIASetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
+    ContextDraw(deviceContext, vertexCount, 0);
+    stats.Lines = vertexCount / 2;
+    stats.Draws = 1;
+    return true;
+}
+
+#endif
@@ -0,0 +1,341 @@
+#include "EchoEngineCore.h"
+#include "File.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::string NarrowPath(const wchar_t* path) {
+    std::string result;
+    size_t length = wcstombs(nullptr, path, 0);
+    if (length != static_cast<size_t>(-1)) {
+        result.resize(length);
+        wcstombs(&result[0], path, length);
+    }
+    return result;
+}
+
+}
+#endif
+
+bool OpenMappedFile(MappedFile& file, const wchar_t* path) {
+    CloseMappedFile(file);
+
+#ifdef _WIN32
+    file.File = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file.File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file.File, &size) || size.QuadPart == 0) {
+        CloseMappedFile(file);
+        return false;
+    }
+
+    file.Mapping = CreateFileMappingW(file.File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file.Mapping) {
+        CloseMappedFile(file);
+        return false;
+    }
+
+    file.Data = static_cast<const BYTE*>(MapViewOfFile(file.Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!file.Data) {
+        CloseMappedFile(file);
+        return false;
+    }
+    file.Size = static_cast<uint64_t>(size.QuadPart);
+#else
+    file.Descriptor = open(NarrowPath(path).c_str(), O_RDONLY);
+    if (file.Descriptor < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file.Descriptor, &status) != 0 || status.st_size == 0) {
+        CloseMappedFile(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file.Descriptor, 0);
+    if (data == MAP_FAILED) {
+        CloseMappedFile(file);
+        return false;
+    }
+    file.Data = static_cast<const BYTE*>(data);
+    file.Size = static_cast<uint64_t>(status.st_size);
+#endif
+
+    return true;
+}
+
+bool OpenMemoryFile(MappedFile& file, std::vector<BYTE>& data) {
+    CloseMappedFile(file);
+    if (data.empty()) {
+        return false;
+    }
+
+    file.Memory.swap(data);
+    file.Data = file.Memory.data();
+    file.Size = file.Memory.size();
+    return true;
+}
+
+void CloseMappedFile(MappedFile& file) {
+    if (!file.Memory.empty()) {
+        std::vector<BYTE>().swap(file.Memory);
+        file.Data = nullptr;
+    }
+
+#ifdef _WIN32
+    if (file.Data) {
+        UnmapViewOfFile(file.Data);
+    }
+    if (file.Mapping) {
+        CloseHandle(file.Mapping);
+    }
+    if (file.File != INVALID_HANDLE_VALUE) {
+        CloseHandle(file.File);
+    }
+    file.Mapping = nullptr;
+    file.File = INVALID_HANDLE_VALUE;
+#else
+    if (file.Data) {
+        munmap(const_cast<BYTE*>(file.Data), static_cast<size_t>(file.Size));
+    }
+    if (file.Descriptor >= 0) {
+        close(file.Descriptor);
+    }
+    file.Descriptor = -1;
+#endif
+    file.Data = nullptr;
+    file.Size = 0;
+}
+
+bool OpenReadOnlyFile(ReadOnlyFile& file, const wchar_t* path, FileAccess access) {
+    CloseReadOnlyFile(file);
+
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (access == FA_Sequential) {
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    }
+    else if (access == FA_Random) {
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    }
+    file.File = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file.File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file.File, &size)) {
+        CloseReadOnlyFile(file);
+        return false;
+    }
+    file.Size = static_cast<uint64_t>(size.QuadPart);
+#else
+    file.Descriptor = open(NarrowPath(path).c_str(), O_RDONLY);
+    if (file.Descriptor < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file.Descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+        CloseReadOnlyFile(file);
+        return false;
+    }
+    file.Size = static_cast<uint64_t>(status.st_size);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (access == FA_Sequential) {
+        posix_fadvise(file.Descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    else if (access == FA_Random) {
+        posix_fadvise(file.Descriptor, 0, 0, POSIX_FADV_RANDOM);
+    }
+#endif
+#endif
+
+    return true;
+}
+
+void CloseReadOnlyFile(ReadOnlyFile& file) {
+#ifdef _WIN32
+    if (file.File != INVALID_HANDLE_VALUE) {
+        CloseHandle(file.File);
+    }
+    file.File = INVALID_HANDLE_VALUE;
+#else
+    if (file.Descriptor >= 0) {
+        close(file.Descriptor);
+    }
+    file.Descriptor = -1;
+#endif
+    file.Size = 0;
+}
+
+bool ReadFileAt(const ReadOnlyFile& file, uint64_t offset, void* data, uint64_t size) {
+    if (offset > file.Size || size > file.Size - offset) {
+        return false;
+    }
+
+    BYTE* bytes = static_cast<BYTE*>(data);
+    uint64_t done = 0;
+    while (done < size) {
+        uint64_t position = offset + done;
+#ifdef _WIN32
+        //ReadFile takes 32-bit sizes, so large reads are split in pieces.
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        DWORD bytesRead = 0;
+        DWORD bytesToRead = static_cast<DWORD>(std::min<uint64_t>(size - done, 1u << 30));
+        if (!ReadFile(file.File, bytes + done, bytesToRead, &bytesRead, &overlapped) || bytesRead == 0) {
+            return false;
+        }
+#else
+        ssize_t bytesRead = pread(file.Descriptor, bytes + done, static_cast<size_t>(size - done), static_cast<off_t>(position));
+        if (bytesRead <= 0) {
+            return false;
+        }
+#endif
+        done += static_cast<uint64_t>(bytesRead);
+    }
+    return true;
+}
+
+bool ReadWholeFile(const wchar_t* path, std::vector<BYTE>& data) {
+    data.clear();
+
+    ReadOnlyFile file;
+    if (!OpenReadOnlyFile(file, path, FA_Sequential)) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.Size));
+    bool result = ReadFileAt(file, 0, data.data(), data.size());
+    CloseReadOnlyFile(file);
+
+    if (!result) {
+        data.clear();
+    }
+    return result;
+}
+
+bool FileExists(const wchar_t* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesW(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat status;
+    return stat(NarrowPath(path).c_str(), &status) == 0 && S_ISREG(status.st_mode);
+#endif
+}
+
+bool RemoveFile(const wchar_t* path) {
+#ifdef _WIN32
+    return DeleteFileW(path) != 0;
+#else
+    return unlink(NarrowPath(path).c_str()) == 0;
+#endif
+}
+
+bool PrefetchFile(const wchar_t* path) {
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    int descriptor = open(NarrowPath(path).c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    posix_fadvise(descriptor, 0, 0, POSIX_FADV_WILLNEED);
+    close(descriptor);
+    return true;
+#else
+    return FileExists(path);
+#endif
+}
+
+void AdviseMappedFile(const MappedFile& file, uint64_t offset, uint64_t size, FileAccess access) {
+#ifdef _WIN32
+    //Windows takes no access pattern for views; the file was opened for sequential scans.
+    (void)file; (void)offset; (void)size; (void)access;
+#else
+    if (!file.Memory.empty() || !file.Data || offset >= file.Size || access == FA_Normal) {
+        return;
+    }
+    //madvise wants page aligned addresses.
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = offset & ~(pageSize - 1);
+    uint64_t end = std::min<uint64_t>(offset + size, file.Size);
+    madvise(const_cast<BYTE*>(file.Data) + begin, static_cast<size_t>(end - begin), access == FA_Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#endif
+}
+
+void PrefetchMappedFile(const MappedFile& file, uint64_t offset, uint64_t size) {
+    if (!file.Memory.empty() || !file.Data || offset >= file.Size) {
+        return;
+    }
+    uint64_t end = std::min<uint64_t>(offset + size, file.Size);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<BYTE*>(file.Data) + offset;
+    range.NumberOfBytes = static_cast<SIZE_T>(end - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void)end;
+#endif
+#else
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = offset & ~(pageSize - 1);
+    madvise(const_cast<BYTE*>(file.Data) + begin, static_cast<size_t>(end - begin), MADV_WILLNEED);
+#endif
+}
+
+FILE* OpenFile(const wchar_t* path, const char* mode) {
+#ifdef _WIN32
+    std::wstring wideMode(mode, mode + strlen(mode));
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, path, wideMode.c_str()) != 0) {
+        return nullptr;
+    }
+    return file;
+#else
+    return fopen(NarrowPath(path).c_str(), mode);
+#endif
+}
+
+bool HasExtension(const wchar_t* path, const wchar_t* extension) {
+    size_t pathLength = wcslen(path);
+    size_t extensionLength = wcslen(extension);
+    if (pathLength < extensionLength) {
+        return false;
+    }
+    for (size_t i = 0; i < extensionLength; ++i) {
+        wchar_t c = path[pathLength - extensionLength + i];
+        if ((c >= L'A' && c <= L'Z' ? c - L'A' + L'a' : c) != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsFileRangeValid(uint64_t fileSize, uint64_t offset, uint64_t size, uint64_t alignment) {
+    return offset % alignment == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+bool WriteFilePadding(FILE* file, uint64_t& offset, uint64_t alignment) {
+    static const BYTE zeros[4096] = { 0 };
+    uint64_t aligned = AlignFileOffset(offset, alignment);
+    while (offset < aligned) {
+        size_t padding = static_cast<size_t>(std::min<uint64_t>(aligned - offset, sizeof(zeros)));
+        if (fwrite(zeros, 1, padding, file) != padding) {
+            return false;
+        }
+        offset += padding;
+    }
+    return true;
+}
@@ -0,0 +1,187 @@
+#include "EchoEngineCore.h"
+#include "FrameStats.h"
+#include "File.h"
+
+namespace {
+
+const uint64_t HDR_MANTISSA_VALUE = 1ull << HDR_HISTOGRAM_MANTISSA_BITS;
+const uint64_t HDR_MANTISSA_MASK = HDR_MANTISSA_VALUE - 1;
+
+const char* FRAME_METRIC_NAMES[NumFrameMetrics] = { "frame_time", "update_time", "render_time", "present_time", "draws", "upload_bytes" };
+const char* FRAME_METRIC_UNITS[NumFrameMetrics] = { "ms", "ms", "ms", "ms", "draws", "bytes" };
+
+//Bit scan through de Bruijn multiplication, as in the offset allocator, widened to 64 bits.
+uint32_t FindHighestSetBit(uint64_t value) {
+    static const uint8_t positions[32] = {
+        0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+        8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+    };
+    assert(value != 0);
+    uint32_t base = 0;
+    uint32_t word = static_cast<uint32_t>(value);
+    if (value >> 32) {
+        base = 32;
+        word = static_cast<uint32_t>(value >> 32);
+    }
+    word |= word >> 1;
+    word |= word >> 2;
+    word |= word >> 4;
+    word |= word >> 8;
+    word |= word >> 16;
+    return base + positions[(word * 0x07C4ACDDu) >> 27];
+}
+
+//Bins below HDR_MANTISSA_VALUE hold one value each; above, every power of two is split into HDR_MANTISSA_VALUE bins.
+uint32_t GetHdrBin(uint64_t value) {
+    if (value < HDR_MANTISSA_VALUE) {
+        return static_cast<uint32_t>(value);
+    }
+    uint32_t mantissaShift = FindHighestSetBit(value) - HDR_HISTOGRAM_MANTISSA_BITS;
+    return static_cast<uint32_t>(((mantissaShift + 1) << HDR_HISTOGRAM_MANTISSA_BITS) | ((value >> mantissaShift) & HDR_MANTISSA_MASK));
+}
+
+//Largest value that falls in the bin.
+uint64_t GetHdrBinHighestValue(uint32_t bin) {
+    if (bin < HDR_MANTISSA_VALUE) {
+        return bin;
+    }
+    uint32_t mantissaShift = (bin >> HDR_HISTOGRAM_MANTISSA_BITS) - 1;
+    uint64_t lowest = ((bin & HDR_MANTISSA_MASK) | HDR_MANTISSA_VALUE) << mantissaShift;
+    return lowest + (1ull << mantissaShift) - 1;
+}
+
+inline bool IsTimeMetric(FrameMetric metric) {
+    return metric <= FM_PresentTime;
+}
+
+inline uint64_t MsToMicroseconds(double ms) {
+    return ms > 0.0 ? static_cast<uint64_t>(ms * 1000.0 + 0.5) : 0;
+}
+
+}
+
+void RecordHdrValue(HdrHistogram& histogram, uint64_t value) {
+    uint32_t bin = GetHdrBin(value);
+    if (bin >= histogram.Counts.size()) {
+        histogram.Counts.resize(bin + 1, 0);
+    }
+    ++histogram.Counts[bin];
+
+    histogram.Min = histogram.TotalCount == 0 ? value : std::min<uint64_t>(histogram.Min, value);
+    histogram.Max = std::max<uint64_t>(histogram.Max, value);
+    histogram.Sum += static_cast<double>(value);
+    ++histogram.TotalCount;
+}
+
+void ResetHdrHistogram(HdrHistogram& histogram) {
+    histogram = HdrHistogram();
+}
+
+uint64_t GetHdrPercentile(const HdrHistogram& histogram, double percent) {
+    if (histogram.TotalCount == 0) {
+        return 0;
+    }
+
+    //Rank of the value sought, counting from 1.
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min<double>(std::max<double>(percent, 0.0), 100.0) / 100.0 * histogram.TotalCount));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (uint32_t bin = 0; bin < histogram.Counts.size(); ++bin) {
+        seen += histogram.Counts[bin];
+        if (seen >= rank) {
+            return std::min<uint64_t>(std::max<uint64_t>(GetHdrBinHighestValue(bin), histogram.Min), histogram.Max);
+        }
+    }
+    return histogram.Max;
+}
+
+void ResetFrameStats(FrameStats& stats) {
+    stats = FrameStats();
+}
+
+bool RecordFrame(FrameStats& stats, const FrameSample& sample) {
+    RecordHdrValue(stats.Metrics[FM_FrameTime], MsToMicroseconds(sample.FrameMs));
+    RecordHdrValue(stats.Metrics[FM_UpdateTime], MsToMicroseconds(sample.UpdateMs));
+    RecordHdrValue(stats.Metrics[FM_RenderTime], MsToMicroseconds(sample.RenderMs));
+    RecordHdrValue(stats.Metrics[FM_PresentTime], MsToMicroseconds(sample.PresentMs));
+    RecordHdrValue(stats.Metrics[FM_Draws], sample.Draws);
+    RecordHdrValue(stats.Metrics[FM_UploadBytes], sample.UploadBytes);
+
+    //Only frames with a full window of frames before them are judged.
+    bool stutter = false;
+    if (stats.Frames >= FRAME_STATS_STUTTER_WINDOW) {
+        float recent[FRAME_STATS_STUTTER_WINDOW];
+        memcpy(recent, stats.RecentFrameMs, sizeof(recent));
+        std::nth_element(recent, recent + FRAME_STATS_STUTTER_WINDOW / 2, recent + FRAME_STATS_STUTTER_WINDOW);
+        double median = recent[FRAME_STATS_STUTTER_WINDOW / 2];
+        stutter = sample.FrameMs > median * FRAME_STATS_STUTTER_FACTOR && sample.FrameMs - median >= FRAME_STATS_STUTTER_MIN_MS;
+        if (stutter) {
+            ++stats.Stutters;
+            if (stats.StutterList.size() < FRAME_STATS_MAX_STUTTERS) {
+                stats.StutterList.push_back({ stats.Frames, sample.FrameMs, median });
+            }
+        }
+    }
+
+    stats.RecentFrameMs[stats.Frames % FRAME_STATS_STUTTER_WINDOW] = static_cast<float>(sample.FrameMs);
+    ++stats.Frames;
+    return stutter;
+}
+
+void GetFrameMetricSummary(const FrameStats& stats, FrameMetric metric, FrameMetricSummary& summary) {
+    const HdrHistogram& histogram = stats.Metrics[metric];
+    double scale = IsTimeMetric(metric) ? 0.001 : 1.0;
+
+    summary.Name = FRAME_METRIC_NAMES[metric];
+    summary.Unit = FRAME_METRIC_UNITS[metric];
+    summary.Count = histogram.TotalCount;
+    summary.Min = histogram.Min * scale;
+    summary.Mean = histogram.TotalCount > 0 ? histogram.Sum / histogram.TotalCount * scale : 0.0;
+    summary.P50 = GetHdrPercentile(histogram, 50.0) * scale;
+    summary.P95 = GetHdrPercentile(histogram, 95.0) * scale;
+    summary.P99 = GetHdrPercentile(histogram, 99.0) * scale;
+    summary.Max = histogram.Max * scale;
+}
+
+bool WriteFrameStatsCsv(const FrameStats& stats, const wchar_t* path) {
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "metric,unit,count,min,mean,p50,p95,p99,max\n");
+    for (UINT i = 0; i < NumFrameMetrics; ++i) {
+        FrameMetricSummary summary;
+        GetFrameMetricSummary(stats, static_cast<FrameMetric>(i), summary);
+        fprintf(file, "%s,%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", summary.Name, summary.Unit, static_cast<unsigned long long>(summary.Count),
+            summary.Min, summary.Mean, summary.P50, summary.P95, summary.P99, summary.Max);
+    }
+
+    bool result = !ferror(file);
+    return fclose(file) == 0 && result;
+}
+
+bool WriteFrameStatsJson(const FrameStats& stats, const wchar_t* path) {
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"frames\": %u,\n  \"stutters\": %u,\n  \"metrics\": {\n", stats.Frames, stats.Stutters);
+    for (UINT i = 0; i < NumFrameMetrics; ++i) {
+        FrameMetricSummary summary;
+        GetFrameMetricSummary(stats, static_cast<FrameMetric>(i), summary);
+        fprintf(file, "    \"%s\": { \"unit\": \"%s\", \"count\": %llu, \"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+            summary.Name, summary.Unit, static_cast<unsigned long long>(summary.Count), summary.Min, summary.Mean, summary.P50, summary.P95, summary.P99,
+            summary.Max, i + 1 < NumFrameMetrics ? "," : "");
+    }
+    fprintf(file, "  },\n  \"stutter_frames\": [");
+    for (size_t i = 0; i < stats.StutterList.size(); ++i) {
+        const FrameStutter& stutter = stats.StutterList[i];
+        fprintf(file, "%s\n    { \"frame\": %u, \"ms\": %.3f, \"median_ms\": %.3f }", i > 0 ? "," : "", stutter.Frame, stutter.FrameMs, stutter.MedianMs);
+    }
+    fprintf(file, "%s]\n}\n", stats.StutterList.empty() ? "" : "\n  ");
+
+    bool result = !ferror(file);
+    return fclose(file) == 0 && result;
+}
@@ -0,0 +1,90 @@
+#include "EchoEngineCore.h"
+#include "Frustum.h"
+using namespace DirectX;
+
+void ExtractFrustum(Frustum& frustum, FXMMATRIX viewProjection) {
+    //DirectXMath uses row vectors (clip = v * M), so the planes are built from the columns of M.
+    XMMATRIX m = XMMatrixTranspose(viewProjection);
+
+    XMVECTOR planes[NumFrustumPlanes];
+    planes[FP_Left] = XMVectorAdd(m.r[3], m.r[0]);
+    planes[FP_Right] = XMVectorSubtract(m.r[3], m.r[0]);
+    planes[FP_Bottom] = XMVectorAdd(m.r[3], m.r[1]);
+    planes[FP_Top] = XMVectorSubtract(m.r[3], m.r[1]);
+    //Direct3D clip space depth is [0, w].
+    planes[FP_Near] = m.r[2];
+    planes[FP_Far] = XMVectorSubtract(m.r[3], m.r[2]);
+
+    for (int i = 0; i < NumFrustumPlanes; ++i) {
+        XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+    }
+}
+
+void ComputeFrustumBounds(const Frustum& frustum, BoundingBox& bounds) {
+    static const int cornerPlanes[8][3] = {
+        { FP_Near, FP_Left, FP_Bottom }, { FP_Near, FP_Right, FP_Bottom }, { FP_Near, FP_Left, FP_Top }, { FP_Near, FP_Right, FP_Top },
+        { FP_Far, FP_Left, FP_Bottom }, { FP_Far, FP_Right, FP_Bottom }, { FP_Far, FP_Left, FP_Top }, { FP_Far, FP_Right, FP_Top }
+    };
+
+    XMVECTOR minCorner = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maxCorner = XMVectorReplicate(-FLT_MAX);
+
+    for (int i = 0; i < 8; ++i) {
+        XMVECTOR p0 = XMLoadFloat4(&frustum.Planes[cornerPlanes[i][0]]);
+        XMVECTOR p1 = XMLoadFloat4(&frustum.Planes[cornerPlanes[i][1]]);
+        XMVECTOR p2 = XMLoadFloat4(&frustum.Planes[cornerPlanes[i][2]]);
+
+        //Intersection of three planes n.x + d = 0.
+        XMVECTOR c12 = XMVector3Cross(p1, p2);
+        XMVECTOR c20 = XMVector3Cross(p2, p0);
+        XMVECTOR c01 = XMVector3Cross(p0, p1);
+        XMVECTOR corner = XMVectorMultiply(c12, XMVectorSplatW(p0));
+        corner = XMVectorMultiplyAdd(c20, XMVectorSplatW(p1), corner);
+        corner = XMVectorMultiplyAdd(c01, XMVectorSplatW(p2), corner);
+        corner = XMVectorDivide(XMVectorNegate(corner), XMVector3Dot(p0, c12));
+
+        minCorner = XMVectorMin(minCorner, corner);
+        maxCorner = XMVectorMax(maxCorner, corner);
+    }
+
+    BoundingBox::CreateFromPoints(bounds, minCorner, maxCorner);
+}
+
+ContainmentType TestFrustumBox(const Frustum& frustum, const BoundingBox& box) {
+    ContainmentType result = CONTAINS;
+
+    for (int i = 0; i < NumFrustumPlanes; ++i) {
+        const XMFLOAT4& p = frustum.Planes[i];
+
+        //Distance of the box center and the projected half size of the box onto the plane normal.
+        float distance = p.x * box.Center.x + p.y * box.Center.y + p.z * box.Center.z + p.w;
+        float radius = fabsf(p.x) * box.Extents.x + fabsf(p.y) * box.Extents.y + fabsf(p.z) * box.Extents.z;
+
+        if (distance < -radius) {
+            return DISJOINT;
+        }
+        if (distance < radius) {
+            result = INTERSECTS;
+        }
+    }
+
+    return result;
+}
+
+ContainmentType TestFrustumSphere(const Frustum& frustum, const BoundingSphere& sphere) {
+    ContainmentType result = CONTAINS;
+
+    for (int i = 0; i < NumFrustumPlanes; ++i) {
+        const XMFLOAT4& p = frustum.Planes[i];
+        float distance = p.x * sphere.Center.x + p.y * sphere.Center.y + p.z * sphere.Center.z + p.w;
+
+        if (distance < -sphere.Radius) {
+            return DISJOINT;
+        }
+        if (distance < sphere.Radius) {
+            result = INTERSECTS;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,264 @@
+#include "EchoEnginePCH.h"
+#include "GeometryBuffer.h"
+#include "RenderCountersD3D11.h"
+using namespace DirectX;
+
+namespace {
+
+GeometryArena& GetIndexArena(GeometryBuffer& geometry, UINT indexSize) {
+    assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+    return geometry.IndexArenas[indexSize == sizeof(uint32_t) ? 1 : 0];
+}
+
+const GeometryArena& GetIndexArena(const GeometryBuffer& geometry, UINT indexSize) {
+    assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+    return geometry.IndexArenas[indexSize == sizeof(uint32_t) ? 1 : 0];
+}
+
+bool CreateArenaBuffer(ID3D11Device* device, const GeometryArena& arena, UINT elementCount, ID3D11Buffer** buffer) {
+    //Buffer sizes are 32-bit byte counts.
+    if (static_cast<uint64_t>(elementCount) * arena.ElementSize > 0xFFFFFFFFull) {
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bufferDesc;
+    ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    bufferDesc.BindFlags = arena.BindFlags;
+    bufferDesc.ByteWidth = elementCount * arena.ElementSize;
+    bufferDesc.CPUAccessFlags = 0;
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+
+    HRESULT hr = DeviceCreateBuffer(device, &bufferDesc, nullptr, buffer);
+    return SUCCEEDED(hr);
+}
+
+void CopyArenaRange(ID3D11DeviceContext* deviceContext, ID3D11Buffer* destination, UINT destinationOffset, ID3D11Buffer* source, UINT sourceOffset,
+    UINT elementCount, UINT elementSize) {
+    D3D11_BOX box = { sourceOffset * elementSize, 0, 0, (sourceOffset + elementCount) * elementSize, 1, 1 };
+    ContextCopySubresourceRegion(deviceContext, destination, 0, destinationOffset * elementSize, 0, 0, source, 0, &box);
+}
+
+//Allocate elementCount elements, creating the arena's buffer on first use and growing it into a larger one when full.
+uint32_t AllocateArenaRange(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryArena& arena, UINT initialSize, UINT elementCount) {
+    if (arena.Buffer) {
+        uint32_t allocation = AllocateOffset(arena.Allocator, elementCount);
+        if (allocation != OFFSET_ALLOCATION_NONE) {
+            return allocation;
+        }
+    }
+
+    UINT size = arena.Allocator.Size;
+    uint64_t newSize = arena.Buffer ? std::max<uint64_t>(2ull * size, static_cast<uint64_t>(size) + elementCount) : std::max<UINT>(initialSize, elementCount);
+    ID3D11Buffer* buffer = nullptr;
+    if (newSize > 0xFFFFFFFFull || !CreateArenaBuffer(device, arena, static_cast<UINT>(newSize), &buffer)) {
+        return OFFSET_ALLOCATION_NONE;
+    }
+
+    if (arena.Buffer) {
+        //Existing ranges keep their offsets, so the old contents are copied as a whole.
+        CopyArenaRange(deviceContext, buffer, 0, arena.Buffer, 0, size, arena.ElementSize);
+        SafeRelease(arena.Buffer);
+        GrowOffsetAllocator(arena.Allocator, static_cast<UINT>(newSize));
+    }
+    else {
+        InitOffsetAllocator(arena.Allocator, static_cast<UINT>(newSize));
+    }
+    arena.Buffer = buffer;
+    return AllocateOffset(arena.Allocator, elementCount);
+}
+
+void UploadArenaRange(ID3D11DeviceContext* deviceContext, const GeometryArena& arena, uint32_t allocation, const void* data) {
+    UINT offset = GetAllocationOffset(arena.Allocator, allocation);
+    UINT count = GetAllocationSize(arena.Allocator, allocation);
+    D3D11_BOX box = { offset * arena.ElementSize, 0, 0, (offset + count) * arena.ElementSize, 1, 1 };
+    ContextUpdateSubresource(deviceContext, arena.Buffer, 0, &box, data, 0, 0, static_cast<uint64_t>(count) * arena.ElementSize);
+}
+
+//Pack the arena's allocations into a fresh buffer.
+bool DefragmentArena(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryArena& arena, std::vector<OffsetAllocatorMove>& moves,
+    GeometryDefragmentStats& stats) {
+    ID3D11Buffer* buffer = nullptr;
+    if (!CreateArenaBuffer(device, arena, arena.Allocator.Size, &buffer)) {
+        return false;
+    }
+
+    UINT usedSize = arena.Allocator.Size - arena.Allocator.FreeSize;
+    DefragmentOffsetAllocator(arena.Allocator, moves);
+
+    std::vector<OffsetAllocatorCopy> copies;
+    GetDefragmentCopies(moves, usedSize, copies);
+    for (const OffsetAllocatorCopy& copy : copies) {
+        CopyArenaRange(deviceContext, buffer, copy.DestinationOffset, arena.Buffer, copy.SourceOffset, copy.Size, arena.ElementSize);
+    }
+
+    SafeRelease(arena.Buffer);
+    arena.Buffer = buffer;
+
+    ++stats.ArenasDefragmented;
+    stats.AllocationsMoved += static_cast<UINT>(moves.size());
+    stats.BytesCopied += static_cast<uint64_t>(usedSize) * arena.ElementSize;
+    return true;
+}
+
+void PrintArena(FILE* file, const char* name, const GeometryArena& arena) {
+    if (!arena.Buffer) {
+        return;
+    }
+
+    const double megabyte = 1024.0 * 1024.0;
+    OffsetAllocatorReport report;
+    GetOffsetAllocatorReport(arena.Allocator, report);
+    fprintf(file, "  %-48s %10u / %10u elements (%8.2f MB), %6u allocations, %5u free ranges, %5.1f%% fragmented\n", name,
+        report.Size - report.FreeSize, report.Size, static_cast<double>(report.Size) * arena.ElementSize / megabyte, report.AllocationCount,
+        report.FreeRangeCount, GetOffsetAllocatorFragmentationPercent(report));
+}
+
+}
+
+void InitGeometryBuffer(GeometryBuffer& geometry) {
+    for (UINT i = 0; i < NumMeshVertexFormats; ++i) {
+        GeometryArena& arena = geometry.VertexArenas[i];
+        arena.ElementSize = GetVertexFormatStride(static_cast<MeshVertexFormat>(i));
+        arena.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        InitOffsetAllocator(arena.Allocator, 0);
+    }
+    for (UINT i = 0; i < GEOMETRY_INDEX_SIZE_COUNT; ++i) {
+        GeometryArena& arena = geometry.IndexArenas[i];
+        arena.ElementSize = i == 0 ? sizeof(uint16_t) : sizeof(uint32_t);
+        arena.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        InitOffsetAllocator(arena.Allocator, 0);
+    }
+}
+
+void ReleaseGeometryBuffer(GeometryBuffer& geometry) {
+    for (GeometryArena& arena : geometry.VertexArenas) {
+        SafeRelease(arena.Buffer);
+        InitOffsetAllocator(arena.Allocator, 0);
+    }
+    for (GeometryArena& arena : geometry.IndexArenas) {
+        SafeRelease(arena.Buffer);
+        InitOffsetAllocator(arena.Allocator, 0);
+    }
+}
+
+bool AllocateGeometry(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, MeshVertexFormat vertexFormat, UINT vertexCount,
+    const void* vertices, UINT indexSize, UINT indexCount, const void* indices, GeometryAllocation& allocation) {
+    assert(device);
+    assert(deviceContext);
+    assert(vertexFormat < NumMeshVertexFormats);
+
+    GeometryArena& vertexArena = geometry.VertexArenas[vertexFormat];
+    GeometryArena& indexArena = GetIndexArena(geometry, indexSize);
+
+    allocation.VertexFormat = vertexFormat;
+    allocation.IndexSize = indexSize;
+    allocation.VertexAllocation = OFFSET_ALLOCATION_NONE;
+    allocation.IndexAllocation = OFFSET_ALLOCATION_NONE;
+    //An empty range would still take an element and upload it from vertices or indices, which may be null.
+    if (vertexCount == 0 || indexCount == 0) {
+        return false;
+    }
+    allocation.VertexAllocation = AllocateArenaRange(device, deviceContext, vertexArena, GEOMETRY_VERTEX_ARENA_SIZE, vertexCount);
+    if (allocation.VertexAllocation == OFFSET_ALLOCATION_NONE) {
+        return false;
+    }
+    allocation.IndexAllocation = AllocateArenaRange(device, deviceContext, indexArena, GEOMETRY_INDEX_ARENA_SIZE, indexCount);
+    if (allocation.IndexAllocation == OFFSET_ALLOCATION_NONE) {
+        FreeOffset(vertexArena.Allocator, allocation.VertexAllocation);
+        allocation.VertexAllocation = OFFSET_ALLOCATION_NONE;
+        return false;
+    }
+
+    UploadArenaRange(deviceContext, vertexArena, allocation.VertexAllocation, vertices);
+    UploadArenaRange(deviceContext, indexArena, allocation.IndexAllocation, indices);
+    return true;
+}
+
+void FreeGeometry(GeometryBuffer& geometry, GeometryAllocation& allocation) {
+    if (allocation.VertexAllocation != OFFSET_ALLOCATION_NONE) {
+        FreeOffset(geometry.VertexArenas[allocation.VertexFormat].Allocator, allocation.VertexAllocation);
+        allocation.VertexAllocation = OFFSET_ALLOCATION_NONE;
+    }
+    if (allocation.IndexAllocation != OFFSET_ALLOCATION_NONE) {
+        FreeOffset(GetIndexArena(geometry, allocation.IndexSize).Allocator, allocation.IndexAllocation);
+        allocation.IndexAllocation = OFFSET_ALLOCATION_NONE;
+    }
+}
+
+UINT GetGeometryBaseVertex(const GeometryBuffer& geometry, const GeometryAllocation& allocation) {
+    return GetAllocationOffset(geometry.VertexArenas[allocation.VertexFormat].Allocator, allocation.VertexAllocation);
+}
+
+UINT GetGeometryStartIndex(const GeometryBuffer& geometry, const GeometryAllocation& allocation) {
+    return GetAllocationOffset(GetIndexArena(geometry, allocation.IndexSize).Allocator, allocation.IndexAllocation);
+}
+
+void BindGeometryVertexBuffer(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, MeshVertexFormat vertexFormat) {
+    const GeometryArena& arena = geometry.VertexArenas[vertexFormat];
+    const UINT offset = 0;
+    ContextIASetVertexBuffers(deviceContext, 0, 1, &arena.Buffer, &arena.ElementSize, &offset);
+}
+
+void BindGeometryIndexBuffer(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, UINT indexSize) {
+    const GeometryArena& arena = GetIndexArena(geometry, indexSize);
+    ContextIASetIndexBuffer(deviceContext, arena.Buffer, indexSize == sizeof(uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT, 0);
+}
+
+bool DefragmentGeometryBuffer(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, float thresholdPercent,
+    GeometryDefragmentStats* stats) {
+    assert(device);
+    assert(deviceContext);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GeometryDefragmentStats defragmentStats = {};
+
+    GeometryArena* arenas[NumMeshVertexFormats + GEOMETRY_INDEX_SIZE_COUNT];
+    UINT arenaCount = 0;
+    for (GeometryArena& arena : geometry.VertexArenas) {
+        arenas[arenaCount++] = &arena;
+    }
+    for (GeometryArena& arena : geometry.IndexArenas) {
+        arenas[arenaCount++] = &arena;
+    }
+
+    bool result = true;
+    std::vector<OffsetAllocatorMove> moves;
+    for (UINT i = 0; i < arenaCount; ++i) {
+        GeometryArena& arena = *arenas[i];
+        if (!arena.Buffer) {
+            continue;
+        }
+        OffsetAllocatorReport report;
+        GetOffsetAllocatorReport(arena.Allocator, report);
+        if (GetOffsetAllocatorFragmentationPercent(report) <= thresholdPercent) {
+            continue;
+        }
+        if (!DefragmentArena(device, deviceContext, arena, moves, defragmentStats)) {
+            result = false;
+        }
+    }
+
+    defragmentStats.TimeMs = ElapsedMs(start);
+    if (stats) {
+        *stats = defragmentStats;
+    }
+    return result;
+}
+
+void PrintGeometryBufferReport(FILE* file, const GeometryBuffer& geometry) {
+    static const char* vertexFormatNames[] = {
+        "vertices (position, color)",
+        "vertices (compact position, color)",
+        "vertices (compact position, normal, color)",
+        "vertices (compact pos, normal, texcoord, color)"
+    };
+    static_assert(sizeof(vertexFormatNames) / sizeof(vertexFormatNames[0]) == NumMeshVertexFormats, "Missing vertex format name");
+
+    fprintf(file, "Geometry arenas:\n");
+    for (UINT i = 0; i < NumMeshVertexFormats; ++i) {
+        PrintArena(file, vertexFormatNames[i], geometry.VertexArenas[i]);
+    }
+    PrintArena(file, "16-bit indices", geometry.IndexArenas[0]);
+    PrintArena(file, "32-bit indices", geometry.IndexArenas[1]);
+}
@@ -0,0 +1,334 @@
+#include "EchoEngineCore.h"
+#include "GlyphCache.h"
+using namespace DirectX;
+
+namespace {
+
+//Empty texels around every glyph so filtering never picks up a neighbour.
+const UINT GLYPH_PADDING = 1;
+const UINT GLYPH_TAB_SPACES = 4;
+
+//Decode the code point at the cursor and move past it. Malformed sequences decode to the replacement
+//character one byte at a time.
+uint32_t DecodeUtf8(const char*& cursor) {
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(cursor);
+    uint32_t codepoint;
+    UINT continuationBytes;
+    if (bytes[0] < 0x80) {
+        ++cursor;
+        return bytes[0];
+    }
+    else if ((bytes[0] & 0xE0) == 0xC0) {
+        codepoint = bytes[0] & 0x1F;
+        continuationBytes = 1;
+    }
+    else if ((bytes[0] & 0xF0) == 0xE0) {
+        codepoint = bytes[0] & 0x0F;
+        continuationBytes = 2;
+    }
+    else if ((bytes[0] & 0xF8) == 0xF0) {
+        codepoint = bytes[0] & 0x07;
+        continuationBytes = 3;
+    }
+    else {
+        ++cursor;
+        return GLYPH_REPLACEMENT_CHARACTER;
+    }
+
+    //The terminator is not a continuation byte, so a truncated sequence stops at the end of the string.
+    for (UINT i = 1; i <= continuationBytes; ++i) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            ++cursor;
+            return GLYPH_REPLACEMENT_CHARACTER;
+        }
+        codepoint = codepoint << 6 | (bytes[i] & 0x3F);
+    }
+    cursor += continuationBytes + 1;
+    return codepoint;
+}
+
+void MarkGlyphCacheDirty(GlyphCache& cache, UINT x, UINT y, UINT width, UINT height) {
+    if (cache.DirtyRight == cache.DirtyLeft) {
+        cache.DirtyLeft = x;
+        cache.DirtyTop = y;
+        cache.DirtyRight = x + width;
+        cache.DirtyBottom = y + height;
+        return;
+    }
+    cache.DirtyLeft = std::min<UINT>(cache.DirtyLeft, x);
+    cache.DirtyTop = std::min<UINT>(cache.DirtyTop, y);
+    cache.DirtyRight = std::max<UINT>(cache.DirtyRight, x + width);
+    cache.DirtyBottom = std::max<UINT>(cache.DirtyBottom, y + height);
+}
+
+void RegisterGlyph(GlyphCache& cache, uint32_t codepoint, UINT glyph) {
+    if (codepoint < _countof(cache.AsciiGlyphs)) {
+        cache.AsciiGlyphs[codepoint] = glyph;
+    }
+    else {
+        cache.Lookup[codepoint] = glyph;
+    }
+}
+
+void SetGlyphTexCoords(const GlyphCache& cache, CachedGlyph& glyph) {
+    float texelSize = 1.0f / static_cast<float>(cache.Size);
+    glyph.TexCoords = XMFLOAT4(glyph.X * texelSize, glyph.Y * texelSize, (glyph.X + glyph.Width) * texelSize, (glyph.Y + glyph.Height) * texelSize);
+}
+
+//Keep the most recently used glyphs that fill up to half the atlas, so the frame after a repack has room for
+//new ones, and pack them again from scratch.
+void RepackGlyphCache(GlyphCache& cache) {
+    std::vector<UINT> order(cache.Glyphs.size());
+    for (UINT i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&cache](UINT a, UINT b) {
+        return cache.Glyphs[a].LastUsedFrame > cache.Glyphs[b].LastUsedFrame;
+    });
+
+    uint64_t areaBudget = static_cast<uint64_t>(cache.Size) * cache.Size / 2;
+    uint64_t keptArea = 0;
+    std::vector<CachedGlyph> kept;
+    std::vector<PackedRect> rects;
+    for (UINT i : order) {
+        const CachedGlyph& glyph = cache.Glyphs[i];
+        if (glyph.Width == 0) {
+            kept.push_back(glyph);
+            continue;
+        }
+        PackedRect rect = { glyph.Width + GLYPH_PADDING * 2, glyph.Height + GLYPH_PADDING * 2, 0, 0, false };
+        uint64_t area = static_cast<uint64_t>(rect.Width) * rect.Height;
+        if (keptArea + area > areaBudget) {
+            //Everything further down the order was used longer ago.
+            break;
+        }
+        keptArea += area;
+        kept.push_back(glyph);
+        rects.push_back(rect);
+    }
+
+    ResetRectPacker(cache.Packer);
+    PackRects(cache.Packer, rects.data(), static_cast<UINT>(rects.size()));
+
+    std::vector<BYTE> coverage(cache.Coverage.size(), 0);
+    std::vector<CachedGlyph> glyphs;
+    size_t rect = 0;
+    for (CachedGlyph& glyph : kept) {
+        if (glyph.Width != 0) {
+            const PackedRect& packed = rects[rect++];
+            if (!packed.Packed) {
+                continue;
+            }
+            UINT x = packed.X + GLYPH_PADDING;
+            UINT y = packed.Y + GLYPH_PADDING;
+            for (UINT row = 0; row < glyph.Height; ++row) {
+                memcpy(&coverage[static_cast<size_t>(y + row) * cache.Size + x], &cache.Coverage[static_cast<size_t>(glyph.Y + row) * cache.Size + glyph.X],
+                    glyph.Width);
+            }
+            glyph.X = x;
+            glyph.Y = y;
+            SetGlyphTexCoords(cache, glyph);
+        }
+        glyphs.push_back(glyph);
+    }
+
+    cache.Stats.Evictions += static_cast<UINT>(cache.Glyphs.size() - glyphs.size());
+    ++cache.Stats.Repacks;
+    cache.Glyphs.swap(glyphs);
+    cache.Coverage.swap(coverage);
+
+    std::fill(cache.AsciiGlyphs, cache.AsciiGlyphs + _countof(cache.AsciiGlyphs), GLYPH_NONE);
+    cache.Lookup.clear();
+    for (UINT i = 0; i < cache.Glyphs.size(); ++i) {
+        RegisterGlyph(cache, cache.Glyphs[i].Codepoint, i);
+    }
+    MarkGlyphCacheDirty(cache, 0, 0, cache.Size, cache.Size);
+}
+
+//Rasterize a glyph and pack it into the atlas.
+UINT AddGlyph(GlyphCache& cache, uint32_t codepoint) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    GlyphBitmap& bitmap = cache.Bitmap;
+    bitmap.Width = 0;
+    bitmap.Height = 0;
+    bitmap.OffsetX = 0;
+    bitmap.OffsetY = 0;
+    bitmap.Advance = 0.0f;
+    bool rasterized = cache.Rasterize && cache.Rasterize(codepoint, bitmap);
+    cache.Stats.RasterizeTimeMs += ElapsedMs(start);
+
+    //Code points the font lacks share the replacement character's glyph.
+    if (!rasterized && codepoint != GLYPH_REPLACEMENT_CHARACTER) {
+        UINT replacement = FindGlyph(cache, GLYPH_REPLACEMENT_CHARACTER);
+        if (replacement != GLYPH_NONE) {
+            RegisterGlyph(cache, codepoint, replacement);
+        }
+        return replacement;
+    }
+
+    CachedGlyph glyph;
+    glyph.Codepoint = codepoint;
+    glyph.X = 0;
+    glyph.Y = 0;
+    glyph.Width = 0;
+    glyph.Height = 0;
+    glyph.OffsetX = bitmap.OffsetX;
+    glyph.OffsetY = bitmap.OffsetY;
+    glyph.Advance = bitmap.Advance;
+    glyph.TexCoords = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+    glyph.LastUsedFrame = cache.Frame;
+
+    //Glyphs too large for the atlas keep their advance but draw nothing.
+    bool drawable = rasterized && bitmap.Width > 0 && bitmap.Height > 0 && bitmap.Width + GLYPH_PADDING * 2 <= cache.Size &&
+        bitmap.Height + GLYPH_PADDING * 2 <= cache.Size && bitmap.Coverage.size() >= static_cast<size_t>(bitmap.Width) * bitmap.Height;
+    if (drawable) {
+        UINT x;
+        UINT y;
+        if (!PackRect(cache.Packer, bitmap.Width + GLYPH_PADDING * 2, bitmap.Height + GLYPH_PADDING * 2, x, y)) {
+            cache.RepackPending = true;
+            ++cache.Stats.DroppedGlyphs;
+            return GLYPH_NONE;
+        }
+        glyph.X = x + GLYPH_PADDING;
+        glyph.Y = y + GLYPH_PADDING;
+        glyph.Width = bitmap.Width;
+        glyph.Height = bitmap.Height;
+        SetGlyphTexCoords(cache, glyph);
+        for (UINT row = 0; row < glyph.Height; ++row) {
+            memcpy(&cache.Coverage[static_cast<size_t>(glyph.Y + row) * cache.Size + glyph.X], &bitmap.Coverage[static_cast<size_t>(row) * bitmap.Width],
+                glyph.Width);
+        }
+        MarkGlyphCacheDirty(cache, glyph.X, glyph.Y, glyph.Width, glyph.Height);
+    }
+
+    UINT index = static_cast<UINT>(cache.Glyphs.size());
+    cache.Glyphs.push_back(glyph);
+    RegisterGlyph(cache, codepoint, index);
+    return index;
+}
+
+}
+
+void InitGlyphCache(GlyphCache& cache, UINT size, const GlyphRasterizer& rasterizer, const GlyphFontMetrics& metrics) {
+    ResetGlyphCache(cache);
+    cache.Size = size;
+    cache.Rasterize = rasterizer;
+    cache.Metrics = metrics;
+    InitRectPacker(cache.Packer, size, size);
+    cache.Coverage.assign(static_cast<size_t>(size) * size, 0);
+
+    //The texture starts out undefined, so the first upload covers all of it.
+    MarkGlyphCacheDirty(cache, 0, 0, size, size);
+}
+
+void ResetGlyphCache(GlyphCache& cache) {
+    cache.Size = 0;
+    cache.Rasterize = GlyphRasterizer();
+    cache.Glyphs.clear();
+    std::fill(cache.AsciiGlyphs, cache.AsciiGlyphs + _countof(cache.AsciiGlyphs), GLYPH_NONE);
+    cache.Lookup.clear();
+    cache.Coverage.clear();
+    cache.DirtyLeft = 0;
+    cache.DirtyTop = 0;
+    cache.DirtyRight = 0;
+    cache.DirtyBottom = 0;
+    cache.RepackPending = false;
+    cache.Frame = 0;
+    cache.Stats = GlyphCacheStats();
+}
+
+void BeginGlyphCacheFrame(GlyphCache& cache) {
+    ++cache.Frame;
+    if (cache.RepackPending) {
+        RepackGlyphCache(cache);
+        cache.RepackPending = false;
+    }
+}
+
+UINT FindGlyph(GlyphCache& cache, uint32_t codepoint) {
+    UINT glyph = GLYPH_NONE;
+    if (codepoint < _countof(cache.AsciiGlyphs)) {
+        glyph = cache.AsciiGlyphs[codepoint];
+    }
+    else {
+        std::unordered_map<uint32_t, UINT>::const_iterator found = cache.Lookup.find(codepoint);
+        if (found != cache.Lookup.end()) {
+            glyph = found->second;
+        }
+    }
+
+    if (glyph != GLYPH_NONE) {
+        ++cache.Stats.Hits;
+        cache.Glyphs[glyph].LastUsedFrame = cache.Frame;
+        return glyph;
+    }
+    ++cache.Stats.Misses;
+    return AddGlyph(cache, codepoint);
+}
+
+UINT LayoutText(GlyphCache& cache, const char* text, float x, float y, uint32_t color, UINT atlas, Sprite* sprites, UINT maxSprites,
+    XMFLOAT2* extent) {
+    float penX = x;
+    float lineTop = y;
+    float width = 0.0f;
+    UINT spriteCount = 0;
+    const char* cursor = text;
+    while (*cursor) {
+        uint32_t codepoint = static_cast<BYTE>(*cursor) < 0x80 ? static_cast<BYTE>(*cursor++) : DecodeUtf8(cursor);
+        if (codepoint == '\n') {
+            width = std::max<float>(width, penX - x);
+            penX = x;
+            lineTop += cache.Metrics.LineHeight;
+            continue;
+        }
+        if (codepoint == '\r') {
+            continue;
+        }
+        if (codepoint == '\t') {
+            UINT space = FindGlyph(cache, ' ');
+            if (space != GLYPH_NONE) {
+                penX += cache.Glyphs[space].Advance * GLYPH_TAB_SPACES;
+            }
+            continue;
+        }
+
+        UINT index = FindGlyph(cache, codepoint);
+        if (index == GLYPH_NONE) {
+            continue;
+        }
+        const CachedGlyph& glyph = cache.Glyphs[index];
+        if (glyph.Width > 0) {
+            if (spriteCount < maxSprites) {
+                Sprite& sprite = sprites[spriteCount];
+                float left = penX + glyph.OffsetX;
+                float top = lineTop + cache.Metrics.Ascent + glyph.OffsetY;
+                sprite.Rect = XMFLOAT4(left, top, left + glyph.Width, top + glyph.Height);
+                sprite.TexCoords = glyph.TexCoords;
+                sprite.Color = color;
+                sprite.Atlas = atlas;
+            }
+            ++spriteCount;
+        }
+        penX += glyph.Advance;
+    }
+
+    if (extent) {
+        extent->x = std::max<float>(width, penX - x);
+        extent->y = lineTop + cache.Metrics.LineHeight - y;
+    }
+    return spriteCount;
+}
+
+void GetGlyphCacheStats(const GlyphCache& cache, GlyphCacheStats& stats) {
+    stats = cache.Stats;
+    stats.Glyphs = static_cast<UINT>(cache.Glyphs.size());
+}
+
+float GetGlyphCacheHitPercent(const GlyphCacheStats& stats) {
+    UINT lookups = stats.Hits + stats.Misses;
+    if (lookups == 0) {
+        return 0.0f;
+    }
+    return 100.0f * static_cast<float>(stats.Hits) / static_cast<float>(lookups);
+}
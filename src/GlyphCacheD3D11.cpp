@@ -0,0 +1,145 @@
+#include "EchoEnginePCH.h"
+#include "GlyphCacheD3D11.h"
+#include "RenderCountersD3D11.h"
+
+namespace {
+
+struct GdiFont
+{
+    HDC DeviceContext = nullptr;
+    HFONT Font = nullptr;
+    std::vector<BYTE> Buffer;
+
+    ~GdiFont() {
+        if (Font) {
+            DeleteObject(Font);
+        }
+        if (DeviceContext) {
+            DeleteDC(DeviceContext);
+        }
+    }
+};
+
+}
+
+GlyphRasterizer CreateGdiGlyphRasterizer(const wchar_t* faceName, int pixelHeight, GlyphFontMetrics& metrics) {
+    std::shared_ptr<GdiFont> font = std::make_shared<GdiFont>();
+    font->DeviceContext = CreateCompatibleDC(nullptr);
+    if (!font->DeviceContext) {
+        return GlyphRasterizer();
+    }
+
+    //A negative height asks for the height of the characters rather than of their cells.
+    font->Font = CreateFontW(-pixelHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_TT_PRECIS, CLIP_DEFAULT_PRECIS,
+        ANTIALIASED_QUALITY, FIXED_PITCH | FF_MODERN, faceName);
+    if (!font->Font) {
+        return GlyphRasterizer();
+    }
+    SelectObject(font->DeviceContext, font->Font);
+
+    TEXTMETRICW textMetrics;
+    if (!GetTextMetricsW(font->DeviceContext, &textMetrics)) {
+        return GlyphRasterizer();
+    }
+    metrics.Ascent = static_cast<float>(textMetrics.tmAscent);
+    metrics.LineHeight = static_cast<float>(textMetrics.tmHeight + textMetrics.tmExternalLeading);
+
+    return [font](uint32_t codepoint, GlyphBitmap& glyph) {
+        //GDI takes UTF-16 code units, and code points past the basic plane do not fit in one.
+        if (codepoint > 0xFFFF) {
+            return false;
+        }
+
+        const MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+        GLYPHMETRICS glyphMetrics;
+        DWORD size = GetGlyphOutlineW(font->DeviceContext, codepoint, GGO_GRAY8_BITMAP, &glyphMetrics, 0, nullptr, &identity);
+        if (size == GDI_ERROR) {
+            return false;
+        }
+        glyph.OffsetX = glyphMetrics.gmptGlyphOrigin.x;
+        glyph.OffsetY = -glyphMetrics.gmptGlyphOrigin.y;
+        glyph.Advance = static_cast<float>(glyphMetrics.gmCellIncX);
+
+        //Blanks have an advance but no bitmap.
+        if (size == 0) {
+            glyph.Width = 0;
+            glyph.Height = 0;
+            return true;
+        }
+        font->Buffer.resize(size);
+        if (GetGlyphOutlineW(font->DeviceContext, codepoint, GGO_GRAY8_BITMAP, &glyphMetrics, size, font->Buffer.data(), &identity) == GDI_ERROR) {
+            return false;
+        }
+
+        //Rows are padded to four bytes and coverage goes from 0 to 64.
+        glyph.Width = glyphMetrics.gmBlackBoxX;
+        glyph.Height = glyphMetrics.gmBlackBoxY;
+        UINT pitch = (glyph.Width + 3) & ~3u;
+        glyph.Coverage.resize(static_cast<size_t>(glyph.Width) * glyph.Height);
+        for (UINT y = 0; y < glyph.Height; ++y) {
+            const BYTE* source = &font->Buffer[static_cast<size_t>(y) * pitch];
+            BYTE* destination = &glyph.Coverage[static_cast<size_t>(y) * glyph.Width];
+            for (UINT x = 0; x < glyph.Width; ++x) {
+                destination[x] = static_cast<BYTE>(std::min<UINT>(source[x], 64) * 255 / 64);
+            }
+        }
+        return true;
+    };
+}
+
+bool CreateGlyphCache(ID3D11Device* device, UINT size, const GlyphRasterizer& rasterizer, const GlyphFontMetrics& metrics, GlyphCache& cache) {
+    ReleaseGlyphCache(cache);
+
+    if (device && !CreateEmptyTexture(device, TF_RGBA8, false, size, size, 1, cache.Atlas)) {
+        return false;
+    }
+    InitGlyphCache(cache, size, rasterizer, metrics);
+    return true;
+}
+
+void ReleaseGlyphCache(GlyphCache& cache) {
+    ReleaseTexture(cache.Atlas);
+    ResetGlyphCache(cache);
+}
+
+void UploadGlyphCache(ID3D11DeviceContext* deviceContext, GlyphCache& cache) {
+    assert(deviceContext);
+    if (!cache.Atlas.Resource || cache.DirtyRight == cache.DirtyLeft) {
+        return;
+    }
+
+    //Expand the changed coverage to white texels with the coverage in alpha.
+    UINT width = cache.DirtyRight - cache.DirtyLeft;
+    UINT height = cache.DirtyBottom - cache.DirtyTop;
+    cache.UploadTexels.resize(static_cast<size_t>(width) * height * 4);
+    BYTE* texel = cache.UploadTexels.data();
+    for (UINT y = cache.DirtyTop; y < cache.DirtyBottom; ++y) {
+        const BYTE* coverage = &cache.Coverage[static_cast<size_t>(y) * cache.Size + cache.DirtyLeft];
+        for (UINT x = 0; x < width; ++x, texel += 4) {
+            texel[0] = 255;
+            texel[1] = 255;
+            texel[2] = 255;
+            texel[3] = coverage[x];
+        }
+    }
+
+    D3D11_BOX box = { cache.DirtyLeft, cache.DirtyTop, 0, cache.DirtyRight, cache.DirtyBottom, 1 };
+    ContextUpdateSubresource(deviceContext, cache.Atlas.Resource, 0, &box, cache.UploadTexels.data(), width * 4, 0,
+        static_cast<uint64_t>(width) * 4 * (cache.DirtyBottom - cache.DirtyTop));
+    cache.DirtyLeft = 0;
+    cache.DirtyTop = 0;
+    cache.DirtyRight = 0;
+    cache.DirtyBottom = 0;
+}
+
+void DrawString(SpriteBatch& batch, GlyphCache& cache, UINT atlas, float x, float y, const char* text, uint32_t color) {
+    //A string never needs more sprites than it has bytes, so lay it out straight into the queue.
+    size_t first = batch.Sprites.size();
+    UINT room = batch.Capacity > first ? batch.Capacity - static_cast<UINT>(first) : 0;
+    UINT maxSprites = static_cast<UINT>(std::min<size_t>(room, strlen(text)));
+    batch.Sprites.resize(first + maxSprites);
+    UINT spriteCount = LayoutText(cache, text, x, y, color, atlas, batch.Sprites.data() + first, maxSprites);
+    UINT written = std::min<UINT>(spriteCount, maxSprites);
+    batch.Sprites.resize(first + written);
+    batch.DroppedSprites += spriteCount - written;
+}
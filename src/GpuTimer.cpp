@@ -0,0 +1,182 @@
+#include "EchoEngineCore.h"
+#include "GpuTimer.h"
+
+namespace {
+
+struct SoftwareGpuTimestamps
+{
+    uint64_t Timestamps[GPU_TIMER_FRAME_LATENCY][GPU_TIMER_MAX_TIMESTAMPS] = {};
+};
+
+//Pass i's timestamps follow the frame's own two.
+inline UINT GetPassBeginTimestamp(UINT pass) {
+    return 2 + pass * 2;
+}
+
+inline UINT GetPassEndTimestamp(UINT pass) {
+    return 3 + pass * 2;
+}
+
+//Read back the frames the GPU has finished, oldest first, stopping at the first one still pending.
+void ResolveGpuTimerFrames(GpuTimer& timer) {
+    for (UINT age = GPU_TIMER_FRAME_LATENCY; age > 0; --age) {
+        if (timer.Frame < age) {
+            continue;
+        }
+        GpuTimerSlot& slot = timer.Slots[(timer.Frame - age) % GPU_TIMER_FRAME_LATENCY];
+        if (!slot.Pending) {
+            continue;
+        }
+
+        UINT passCount = static_cast<UINT>(slot.Passes.size());
+        uint64_t frequency = 0;
+        GpuTimestampResult result = timer.Backend.ReadTimestamps((timer.Frame - age) % GPU_TIMER_FRAME_LATENCY, GetPassBeginTimestamp(passCount),
+            timer.Timestamps.data(), frequency);
+        if (result == GTR_Pending) {
+            return;
+        }
+        slot.Pending = false;
+        if (result == GTR_Disjoint || frequency == 0) {
+            ++timer.Stats.DisjointFrames;
+            continue;
+        }
+
+        const uint64_t* timestamps = timer.Timestamps.data();
+        double msPerTick = 1000.0 / frequency;
+        timer.Timings.clear();
+        for (UINT i = 0; i < passCount; ++i) {
+            int64_t start = static_cast<int64_t>(timestamps[GetPassBeginTimestamp(i)] - timestamps[0]);
+            int64_t duration = static_cast<int64_t>(timestamps[GetPassEndTimestamp(i)] - timestamps[GetPassBeginTimestamp(i)]);
+            timer.Timings.push_back({ slot.Passes[i].Name, slot.Passes[i].Depth, std::max<int64_t>(start, 0) * msPerTick,
+                std::max<int64_t>(duration, 0) * msPerTick });
+        }
+        timer.Stats.FrameMs = std::max<int64_t>(static_cast<int64_t>(timestamps[1] - timestamps[0]), 0) * msPerTick;
+        ++timer.Stats.ResolvedFrames;
+
+        //GPU and CPU clocks are not synchronized, so the passes are laid out from the CPU time the frame began.
+        if (IsProfilerRecording()) {
+            double cpuTicksPerMs = GetProfilerTicksPerSecond() / 1000.0;
+            RecordProfileTrackZone(timer.ProfilerTrack, "GPU Frame", slot.CpuStart,
+                slot.CpuStart + static_cast<uint64_t>(timer.Stats.FrameMs * cpuTicksPerMs));
+            for (const GpuPassTiming& timing : timer.Timings) {
+                uint64_t start = slot.CpuStart + static_cast<uint64_t>(timing.StartMs * cpuTicksPerMs);
+                RecordProfileTrackZone(timer.ProfilerTrack, timing.Name, start, start + static_cast<uint64_t>(timing.DurationMs * cpuTicksPerMs));
+            }
+        }
+    }
+}
+
+}
+
+GpuTimerBackend CreateSoftwareGpuTimerBackend() {
+    std::shared_ptr<SoftwareGpuTimestamps> state = std::make_shared<SoftwareGpuTimestamps>();
+
+    GpuTimerBackend backend;
+    backend.BeginFrame = [](UINT) {};
+    backend.EndFrame = [](UINT) {};
+    backend.WriteTimestamp = [state](UINT slot, UINT index) {
+        state->Timestamps[slot][index] = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+    backend.ReadTimestamps = [state](UINT slot, UINT count, uint64_t* timestamps, uint64_t& frequency) {
+        memcpy(timestamps, state->Timestamps[slot], count * sizeof(uint64_t));
+        frequency = 1000000000;
+        return GTR_Ready;
+    };
+    return backend;
+}
+
+void InitGpuTimer(GpuTimer& timer, const GpuTimerBackend& backend) {
+    ReleaseGpuTimer(timer);
+    timer.Backend = backend;
+    timer.ProfilerTrack = CreateProfilerTrack("GPU");
+    timer.Timestamps.resize(GPU_TIMER_MAX_TIMESTAMPS);
+}
+
+void ReleaseGpuTimer(GpuTimer& timer) {
+    timer = GpuTimer();
+}
+
+void BeginGpuTimerFrame(GpuTimer& timer) {
+    timer.CurrentSlot = GPU_TIMER_NO_PASS;
+    timer.Depth = 0;
+    if (!timer.Backend.ReadTimestamps) {
+        return;
+    }
+
+    ResolveGpuTimerFrames(timer);
+
+    //The slot still holds a frame from GPU_TIMER_FRAME_LATENCY frames ago that the GPU has not finished.
+    UINT slotIndex = timer.Frame % GPU_TIMER_FRAME_LATENCY;
+    GpuTimerSlot& slot = timer.Slots[slotIndex];
+    if (slot.Pending) {
+        ++timer.Stats.SkippedFrames;
+        return;
+    }
+
+    timer.CurrentSlot = slotIndex;
+    slot.Passes.clear();
+    slot.CpuStart = ReadProfilerClock();
+    slot.Pending = true;
+    timer.Backend.BeginFrame(slotIndex);
+    timer.Backend.WriteTimestamp(slotIndex, 0);
+}
+
+void EndGpuTimerFrame(GpuTimer& timer) {
+    ++timer.Frame;
+    if (timer.CurrentSlot == GPU_TIMER_NO_PASS) {
+        return;
+    }
+
+    GpuTimerSlot& slot = timer.Slots[timer.CurrentSlot];
+    for (UINT i = 0; i < slot.Passes.size(); ++i) {
+        if (!slot.Passes[i].Ended) {
+            timer.Backend.WriteTimestamp(timer.CurrentSlot, GetPassEndTimestamp(i));
+            slot.Passes[i].Ended = true;
+        }
+    }
+    timer.Backend.WriteTimestamp(timer.CurrentSlot, 1);
+    timer.Backend.EndFrame(timer.CurrentSlot);
+    timer.CurrentSlot = GPU_TIMER_NO_PASS;
+}
+
+UINT BeginGpuPass(GpuTimer& timer, const char* name) {
+    if (timer.CurrentSlot == GPU_TIMER_NO_PASS) {
+        return GPU_TIMER_NO_PASS;
+    }
+    GpuTimerSlot& slot = timer.Slots[timer.CurrentSlot];
+    if (slot.Passes.size() >= GPU_TIMER_MAX_PASSES) {
+        ++timer.Stats.DroppedPasses;
+        return GPU_TIMER_NO_PASS;
+    }
+
+    UINT pass = static_cast<UINT>(slot.Passes.size());
+    slot.Passes.push_back({ name, timer.Depth, false });
+    ++timer.Depth;
+    timer.Backend.WriteTimestamp(timer.CurrentSlot, GetPassBeginTimestamp(pass));
+    return pass;
+}
+
+void EndGpuPass(GpuTimer& timer, UINT pass) {
+    if (timer.CurrentSlot == GPU_TIMER_NO_PASS || pass == GPU_TIMER_NO_PASS) {
+        return;
+    }
+    GpuTimerPass& timerPass = timer.Slots[timer.CurrentSlot].Passes[pass];
+    if (timerPass.Ended) {
+        return;
+    }
+
+    timer.Backend.WriteTimestamp(timer.CurrentSlot, GetPassEndTimestamp(pass));
+    timerPass.Ended = true;
+    --timer.Depth;
+}
+
+double GetGpuPassMs(const GpuTimer& timer, const char* name) {
+    double ms = 0.0;
+    for (const GpuPassTiming& timing : timer.Timings) {
+        if (strcmp(timing.Name, name) == 0) {
+            ms += timing.DurationMs;
+        }
+    }
+    return ms;
+}
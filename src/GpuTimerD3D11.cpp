@@ -0,0 +1,81 @@
+#include "EchoEnginePCH.h"
+#include "GpuTimer.h"
+
+namespace {
+
+struct D3D11GpuTimerQueries
+{
+    ID3D11DeviceContext* DeviceContext = nullptr;
+    ID3D11Query* Disjoint[GPU_TIMER_FRAME_LATENCY] = {};
+    ID3D11Query* Timestamps[GPU_TIMER_FRAME_LATENCY][GPU_TIMER_MAX_TIMESTAMPS] = {};
+
+    ~D3D11GpuTimerQueries() {
+        for (UINT slot = 0; slot < GPU_TIMER_FRAME_LATENCY; ++slot) {
+            SafeRelease(Disjoint[slot]);
+            for (UINT i = 0; i < GPU_TIMER_MAX_TIMESTAMPS; ++i) {
+                SafeRelease(Timestamps[slot][i]);
+            }
+        }
+        SafeRelease(DeviceContext);
+    }
+};
+
+}
+
+GpuTimerBackend CreateD3D11GpuTimerBackend(ID3D11Device* device, ID3D11DeviceContext* deviceContext) {
+    assert(device);
+    assert(deviceContext);
+
+    std::shared_ptr<D3D11GpuTimerQueries> queries = std::make_shared<D3D11GpuTimerQueries>();
+    queries->DeviceContext = deviceContext;
+    deviceContext->AddRef();
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+    for (UINT slot = 0; slot < GPU_TIMER_FRAME_LATENCY; ++slot) {
+        if (FAILED(device->CreateQuery(&disjointDesc, &queries->Disjoint[slot]))) {
+            return GpuTimerBackend();
+        }
+        for (UINT i = 0; i < GPU_TIMER_MAX_TIMESTAMPS; ++i) {
+            if (FAILED(device->CreateQuery(&timestampDesc, &queries->Timestamps[slot][i]))) {
+                return GpuTimerBackend();
+            }
+        }
+    }
+
+    GpuTimerBackend backend;
+    backend.BeginFrame = [queries](UINT slot) {
+        queries->DeviceContext->Begin(queries->Disjoint[slot]);
+    };
+    backend.EndFrame = [queries](UINT slot) {
+        queries->DeviceContext->End(queries->Disjoint[slot]);
+    };
+    backend.WriteTimestamp = [queries](UINT slot, UINT index) {
+        queries->DeviceContext->End(queries->Timestamps[slot][index]);
+    };
+    backend.ReadTimestamps = [queries](UINT slot, UINT count, uint64_t* timestamps, uint64_t& frequency) {
+        //DONOTFLUSH keeps a frame that is not ready from pushing the command buffer out early.
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        HRESULT hr = queries->DeviceContext->GetData(queries->Disjoint[slot], &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+        if (hr == S_FALSE) {
+            return GTR_Pending;
+        }
+        if (FAILED(hr) || disjoint.Disjoint) {
+            return GTR_Disjoint;
+        }
+        for (UINT i = 0; i < count; ++i) {
+            UINT64 timestamp;
+            hr = queries->DeviceContext->GetData(queries->Timestamps[slot][i], &timestamp, sizeof(timestamp), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            if (hr == S_FALSE) {
+                return GTR_Pending;
+            }
+            if (FAILED(hr)) {
+                return GTR_Disjoint;
+            }
+            timestamps[i] = timestamp;
+        }
+        frequency = disjoint.Frequency;
+        return GTR_Ready;
+    };
+    return backend;
+}
@@ -0,0 +1,132 @@
+#include "EchoEngineCore.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace {
+
+std::vector<std::thread> g_Workers;
+std::deque<std::function<void()>> g_JobQueue;
+std::mutex g_JobMutex;
+std::condition_variable g_JobAvailable;
+bool g_JobSystemRunning = false;
+
+bool TryRunJob() {
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(g_JobMutex);
+        if (g_JobQueue.empty()) {
+            return false;
+        }
+        job = std::move(g_JobQueue.front());
+        g_JobQueue.pop_front();
+    }
+    job();
+    return true;
+}
+
+void WorkerMain(UINT index) {
+    char name[32];
+    snprintf(name, sizeof(name), "Worker %u", index);
+    SetProfilerThreadName(name);
+
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(g_JobMutex);
+            g_JobAvailable.wait(lock, [] { return !g_JobSystemRunning || !g_JobQueue.empty(); });
+            if (g_JobQueue.empty()) {
+                return;
+            }
+            job = std::move(g_JobQueue.front());
+            g_JobQueue.pop_front();
+        }
+        job();
+    }
+}
+
+}
+
+void InitJobSystem(UINT threadCount) {
+    assert(g_Workers.empty());
+
+    if (threadCount == 0) {
+        UINT cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 0;
+    }
+
+    g_JobSystemRunning = true;
+    for (UINT i = 0; i < threadCount; ++i) {
+        g_Workers.push_back(std::thread(WorkerMain, i + 1));
+    }
+}
+
+void ShutdownJobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(g_JobMutex);
+        g_JobSystemRunning = false;
+    }
+    g_JobAvailable.notify_all();
+
+    for (std::thread& worker : g_Workers) {
+        worker.join();
+    }
+    g_Workers.clear();
+}
+
+UINT GetWorkerCount() {
+    return static_cast<UINT>(g_Workers.size());
+}
+
+void RunJob(JobCounter& counter, std::function<void()> job) {
+    counter.Pending++;
+
+    //Without workers the job simply runs inline.
+    if (g_Workers.empty()) {
+        job();
+        counter.Pending--;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_JobMutex);
+        g_JobQueue.push_back([&counter, job] {
+            {
+                PROFILE_ZONE("Job");
+                job();
+            }
+            counter.Pending--;
+        });
+    }
+    g_JobAvailable.notify_one();
+}
+
+void WaitForCounter(JobCounter& counter) {
+    PROFILE_ZONE("WaitForCounter");
+    while (counter.Pending.load() > 0) {
+        if (!TryRunJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ParallelFor(UINT count, UINT batchSize, const std::function<void(UINT, UINT)>& body) {
+    if (count == 0) {
+        return;
+    }
+    batchSize = std::max<UINT>(batchSize, 1);
+
+    if (g_Workers.empty() || count <= batchSize) {
+        body(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (UINT begin = batchSize; begin < count; begin += batchSize) {
+        UINT end = std::min<UINT>(begin + batchSize, count);
+        RunJob(counter, [&body, begin, end] { body(begin, end); });
+    }
+
+    //The first batch runs on the calling thread.
+    body(0, std::min<UINT>(batchSize, count));
+    WaitForCounter(counter);
+}
@@ -0,0 +1,90 @@
+#include "EchoEnginePCH.h"
+#include "Mesh.h"
+#include "RenderCountersD3D11.h"
+using namespace DirectX;
+
+bool CreateMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, const MeshFile& meshFile, UINT meshIndex, Mesh& mesh) {
+    assert(device);
+    assert(meshFile.Header && meshIndex < meshFile.Header->MeshCount);
+
+    const MeshFileEntry& entry = meshFile.Entries[meshIndex];
+
+    //The payloads are already in GPU layout, so the mapped pages are uploaded as they are.
+    if (!AllocateGeometry(device, deviceContext, geometry, static_cast<MeshVertexFormat>(entry.VertexFormat), entry.VertexCount, GetMeshVertexData(meshFile, meshIndex),
+        entry.IndexSize, entry.IndexCount, GetMeshIndexData(meshFile, meshIndex), mesh.Geometry)) {
+        return false;
+    }
+
+    mesh.VertexFormat = static_cast<MeshVertexFormat>(entry.VertexFormat);
+    mesh.VertexStride = entry.VertexStride;
+    mesh.VertexCount = entry.VertexCount;
+    mesh.IndexCount = entry.IndexCount;
+    mesh.IndexFormat = entry.IndexSize == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+    const MeshFileSubmesh* submeshes = GetMeshSubmeshes(meshFile, meshIndex);
+    mesh.Submeshes.assign(submeshes, submeshes + entry.SubmeshCount);
+    mesh.Bounds = GetMeshBounds(meshFile, meshIndex);
+    mesh.PositionScale = XMFLOAT3(entry.PositionScale);
+    mesh.PositionBias = XMFLOAT3(entry.PositionBias);
+
+    return true;
+}
+
+void ReleaseMesh(GeometryBuffer& geometry, Mesh& mesh) {
+    FreeGeometry(geometry, mesh.Geometry);
+    mesh.VertexCount = 0;
+    mesh.IndexCount = 0;
+    mesh.Submeshes.clear();
+}
+
+void BindMeshBuffers(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const Mesh& mesh) {
+    BindGeometryVertexBuffer(deviceContext, geometry, mesh.Geometry.VertexFormat);
+    BindGeometryIndexBuffer(deviceContext, geometry, mesh.Geometry.IndexSize);
+}
+
+void DrawMesh(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const Mesh& mesh) {
+    UINT baseVertex = GetGeometryBaseVertex(geometry, mesh.Geometry);
+    UINT startIndex = GetGeometryStartIndex(geometry, mesh.Geometry);
+    for (const MeshFileSubmesh& submesh : mesh.Submeshes) {
+        ContextDrawIndexed(deviceContext, submesh.IndexCount, startIndex + submesh.StartIndex, static_cast<INT>(baseVertex + submesh.BaseVertex));
+    }
+}
+
+XMMATRIX GetMeshDequantizeMatrix(const Mesh& mesh) {
+    XMMATRIX scale = XMMatrixScaling(mesh.PositionScale.x, mesh.PositionScale.y, mesh.PositionScale.z);
+    return XMMatrixMultiply(scale, XMMatrixTranslation(mesh.PositionBias.x, mesh.PositionBias.y, mesh.PositionBias.z));
+}
+
+bool CreateMeshInputLayout(ID3D11Device* device, MeshVertexFormat format, const void* shaderBytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout) {
+    assert(device);
+
+    //Elements the shader does not read are skipped by the input assembler.
+    D3D11_INPUT_ELEMENT_DESC elements[4];
+    UINT elementCount = 0;
+
+    switch (format) {
+    case MVF_PositionColor:
+        elements[elementCount++] = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexPosColor, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexPosColor, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        break;
+    case MVF_CompactPositionColor:
+        elements[elementCount++] = { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(VertexCompactPosColor, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(VertexCompactPosColor, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        break;
+    case MVF_CompactPositionNormalColor:
+        elements[elementCount++] = { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(VertexCompactPosNormalColor, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(VertexCompactPosNormalColor, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(VertexCompactPosNormalColor, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        break;
+    case MVF_CompactPositionNormalTexCoordColor:
+        elements[elementCount++] = { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(VertexCompactPosNormalTexColor, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(VertexCompactPosNormalTexColor, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(VertexCompactPosNormalTexColor, TexCoord), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[elementCount++] = { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(VertexCompactPosNormalTexColor, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        break;
+    default:
+        return false;
+    }
+
+    HRESULT hr = device->CreateInputLayout(elements, elementCount, shaderBytecode, bytecodeLength, inputLayout);
+    return SUCCEEDED(hr);
+}
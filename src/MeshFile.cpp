@@ -0,0 +1,247 @@
+#include "EchoEngineCore.h"
+#include "MeshFile.h"
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace {
+
+bool AreSubmeshesValid(const MeshFileEntry& entry, const MeshFileSubmesh* submeshes) {
+    for (UINT i = 0; i < entry.SubmeshCount; ++i) {
+        const MeshFileSubmesh& submesh = submeshes[i];
+        if (static_cast<uint64_t>(submesh.StartIndex) + submesh.IndexCount > entry.IndexCount
+            || static_cast<uint64_t>(submesh.BaseVertex) + submesh.VertexCount > entry.VertexCount
+            || (entry.IndexSize == 2 && submesh.VertexCount > MESH_INDEX16_VERTEX_LIMIT)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Submesh list of a mesh source, or a single submesh covering all of it.
+const MeshFileSubmesh* GetSourceSubmeshes(const MeshSource& mesh, UINT& submeshCount, MeshFileSubmesh& wholeMesh) {
+    if (mesh.SubmeshCount > 0) {
+        submeshCount = mesh.SubmeshCount;
+        return mesh.Submeshes;
+    }
+    wholeMesh.StartIndex = 0;
+    wholeMesh.IndexCount = mesh.IndexCount;
+    wholeMesh.BaseVertex = 0;
+    wholeMesh.VertexCount = mesh.VertexCount;
+    submeshCount = mesh.IndexCount > 0 ? 1 : 0;
+    return &wholeMesh;
+}
+
+//Check the header and table of the file's bytes and point the mesh file at them.
+bool ValidateMeshFile(MeshFile& meshFile) {
+    const MappedFile& file = meshFile.File;
+    if (file.Size < sizeof(MeshFileHeader)) {
+        CloseMeshFile(meshFile);
+        return false;
+    }
+
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(file.Data);
+    if (header->Magic != MESH_FILE_MAGIC || header->Version != MESH_FILE_VERSION
+        || static_cast<uint64_t>(header->MeshCount) * sizeof(MeshFileEntry) > file.Size - sizeof(MeshFileHeader)) {
+        CloseMeshFile(meshFile);
+        return false;
+    }
+
+    const MeshFileEntry* entries = reinterpret_cast<const MeshFileEntry*>(file.Data + sizeof(MeshFileHeader));
+    for (UINT i = 0; i < header->MeshCount; ++i) {
+        const MeshFileEntry& entry = entries[i];
+        if (entry.VertexFormat >= NumMeshVertexFormats || entry.VertexStride != GetVertexFormatStride(static_cast<MeshVertexFormat>(entry.VertexFormat))
+            || (entry.IndexSize != 2 && entry.IndexSize != 4)
+            || !IsFileRangeValid(file.Size, entry.VertexDataOffset, static_cast<uint64_t>(entry.VertexStride) * entry.VertexCount, MESH_FILE_ALIGNMENT)
+            || !IsFileRangeValid(file.Size, entry.IndexDataOffset, static_cast<uint64_t>(entry.IndexSize) * entry.IndexCount, MESH_FILE_ALIGNMENT)
+            || !IsFileRangeValid(file.Size, entry.SubmeshDataOffset, sizeof(MeshFileSubmesh) * static_cast<uint64_t>(entry.SubmeshCount), MESH_FILE_ALIGNMENT)
+            || !AreSubmeshesValid(entry, reinterpret_cast<const MeshFileSubmesh*>(file.Data + entry.SubmeshDataOffset))) {
+            CloseMeshFile(meshFile);
+            return false;
+        }
+    }
+
+    meshFile.Header = header;
+    meshFile.Entries = entries;
+    return true;
+}
+
+}
+
+UINT GetVertexFormatStride(MeshVertexFormat format) {
+    switch (format) {
+    case MVF_PositionColor:
+        return sizeof(VertexPosColor);
+    case MVF_CompactPositionColor:
+        return sizeof(VertexCompactPosColor);
+    case MVF_CompactPositionNormalColor:
+        return sizeof(VertexCompactPosNormalColor);
+    case MVF_CompactPositionNormalTexCoordColor:
+        return sizeof(VertexCompactPosNormalTexColor);
+    default:
+        return 0;
+    }
+}
+
+bool OpenMeshFile(MeshFile& meshFile, const wchar_t* path) {
+    CloseMeshFile(meshFile);
+
+    if (!OpenMappedFile(meshFile.File, path)) {
+        return false;
+    }
+    return ValidateMeshFile(meshFile);
+}
+
+bool OpenMeshFileFromMemory(MeshFile& meshFile, std::vector<BYTE>& data) {
+    CloseMeshFile(meshFile);
+
+    if (!OpenMemoryFile(meshFile.File, data)) {
+        return false;
+    }
+    return ValidateMeshFile(meshFile);
+}
+
+void DecodeMeshPositions(const MeshFile& meshFile, UINT mesh, XMFLOAT3* positions) {
+    const MeshFileEntry& entry = meshFile.Entries[mesh];
+    const BYTE* vertex = static_cast<const BYTE*>(GetMeshVertexData(meshFile, mesh));
+
+    XMVECTOR scale = XMVectorSet(entry.PositionScale[0], entry.PositionScale[1], entry.PositionScale[2], 0.0f);
+    XMVECTOR bias = XMVectorSet(entry.PositionBias[0], entry.PositionBias[1], entry.PositionBias[2], 0.0f);
+
+    for (UINT i = 0; i < entry.VertexCount; ++i, vertex += entry.VertexStride) {
+        //Every layout starts with its position.
+        XMVECTOR position;
+        if (entry.VertexFormat == MVF_PositionColor) {
+            position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex));
+        }
+        else {
+            position = XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(vertex));
+        }
+        XMStoreFloat3(&positions[i], XMVectorMultiplyAdd(position, scale, bias));
+    }
+}
+
+void DecodeMeshColors(const MeshFile& meshFile, UINT mesh, XMFLOAT4* colors) {
+    const MeshFileEntry& entry = meshFile.Entries[mesh];
+    const BYTE* vertex = static_cast<const BYTE*>(GetMeshVertexData(meshFile, mesh));
+
+    for (UINT i = 0; i < entry.VertexCount; ++i, vertex += entry.VertexStride) {
+        if (entry.VertexFormat == MVF_PositionColor) {
+            const XMFLOAT3& color = reinterpret_cast<const VertexPosColor*>(vertex)->Color;
+            colors[i] = XMFLOAT4(color.x, color.y, color.z, 1.0f);
+        }
+        else {
+            //Every compact layout ends with its color.
+            XMStoreFloat4(&colors[i], XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(vertex + entry.VertexStride - sizeof(XMUBYTEN4))));
+        }
+    }
+}
+
+void DecodeMeshIndices(const MeshFile& meshFile, UINT mesh, uint32_t* indices) {
+    const MeshFileEntry& entry = meshFile.Entries[mesh];
+    const MeshFileSubmesh* submeshes = GetMeshSubmeshes(meshFile, mesh);
+    const void* indexData = GetMeshIndexData(meshFile, mesh);
+
+    for (UINT i = 0; i < entry.SubmeshCount; ++i) {
+        const MeshFileSubmesh& submesh = submeshes[i];
+        for (UINT j = submesh.StartIndex; j < submesh.StartIndex + submesh.IndexCount; ++j) {
+            uint32_t index = entry.IndexSize == 4 ? static_cast<const uint32_t*>(indexData)[j] : static_cast<const uint16_t*>(indexData)[j];
+            indices[j] = index + submesh.BaseVertex;
+        }
+    }
+}
+
+void CloseMeshFile(MeshFile& meshFile) {
+    CloseMappedFile(meshFile.File);
+    meshFile.Header = nullptr;
+    meshFile.Entries = nullptr;
+}
+
+const void* GetMeshVertexData(const MeshFile& meshFile, UINT mesh) {
+    assert(meshFile.Header && mesh < meshFile.Header->MeshCount);
+    return meshFile.File.Data + meshFile.Entries[mesh].VertexDataOffset;
+}
+
+const void* GetMeshIndexData(const MeshFile& meshFile, UINT mesh) {
+    assert(meshFile.Header && mesh < meshFile.Header->MeshCount);
+    return meshFile.File.Data + meshFile.Entries[mesh].IndexDataOffset;
+}
+
+const MeshFileSubmesh* GetMeshSubmeshes(const MeshFile& meshFile, UINT mesh) {
+    assert(meshFile.Header && mesh < meshFile.Header->MeshCount);
+    return reinterpret_cast<const MeshFileSubmesh*>(meshFile.File.Data + meshFile.Entries[mesh].SubmeshDataOffset);
+}
+
+BoundingBox GetMeshBounds(const MeshFile& meshFile, UINT mesh) {
+    assert(meshFile.Header && mesh < meshFile.Header->MeshCount);
+    const MeshFileEntry& entry = meshFile.Entries[mesh];
+    return BoundingBox(XMFLOAT3(entry.BoundsCenter), XMFLOAT3(entry.BoundsExtents));
+}
+
+bool WriteMeshFile(const wchar_t* path, const MeshSource* meshes, UINT meshCount) {
+    MeshFileHeader header = { MESH_FILE_MAGIC, MESH_FILE_VERSION, meshCount, 0 };
+
+    //Lay out the payloads after the table.
+    std::vector<MeshFileEntry> entries(meshCount);
+    uint64_t offset = sizeof(MeshFileHeader) + sizeof(MeshFileEntry) * static_cast<uint64_t>(meshCount);
+    for (UINT i = 0; i < meshCount; ++i) {
+        const MeshSource& mesh = meshes[i];
+        MeshFileEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(MeshFileEntry));
+
+        entry.VertexFormat = mesh.VertexFormat;
+        entry.VertexStride = mesh.VertexStride;
+        entry.VertexCount = mesh.VertexCount;
+        entry.IndexSize = mesh.IndexSize;
+        entry.IndexCount = mesh.IndexCount;
+        MeshFileSubmesh wholeMesh;
+        GetSourceSubmeshes(mesh, entry.SubmeshCount, wholeMesh);
+        entry.VertexDataOffset = AlignFileOffset(offset, MESH_FILE_ALIGNMENT);
+        offset = entry.VertexDataOffset + static_cast<uint64_t>(mesh.VertexStride) * mesh.VertexCount;
+        entry.IndexDataOffset = AlignFileOffset(offset, MESH_FILE_ALIGNMENT);
+        offset = entry.IndexDataOffset + static_cast<uint64_t>(mesh.IndexSize) * mesh.IndexCount;
+        entry.SubmeshDataOffset = AlignFileOffset(offset, MESH_FILE_ALIGNMENT);
+        offset = entry.SubmeshDataOffset + sizeof(MeshFileSubmesh) * static_cast<uint64_t>(entry.SubmeshCount);
+
+        entry.BoundsCenter[0] = mesh.Bounds.Center.x;
+        entry.BoundsCenter[1] = mesh.Bounds.Center.y;
+        entry.BoundsCenter[2] = mesh.Bounds.Center.z;
+        entry.BoundsExtents[0] = mesh.Bounds.Extents.x;
+        entry.BoundsExtents[1] = mesh.Bounds.Extents.y;
+        entry.BoundsExtents[2] = mesh.Bounds.Extents.z;
+
+        entry.PositionScale[0] = mesh.PositionScale.x;
+        entry.PositionScale[1] = mesh.PositionScale.y;
+        entry.PositionScale[2] = mesh.PositionScale.z;
+        entry.PositionBias[0] = mesh.PositionBias.x;
+        entry.PositionBias[1] = mesh.PositionBias.y;
+        entry.PositionBias[2] = mesh.PositionBias.z;
+    }
+
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && (meshCount == 0 || fwrite(entries.data(), sizeof(MeshFileEntry), meshCount, file) == meshCount);
+
+    offset = sizeof(MeshFileHeader) + sizeof(MeshFileEntry) * static_cast<uint64_t>(meshCount);
+    for (UINT i = 0; written && i < meshCount; ++i) {
+        const MeshSource& mesh = meshes[i];
+        size_t vertexBytes = static_cast<size_t>(mesh.VertexStride) * mesh.VertexCount;
+        size_t indexBytes = static_cast<size_t>(mesh.IndexSize) * mesh.IndexCount;
+
+        written = WriteFilePadding(file, offset, MESH_FILE_ALIGNMENT) && fwrite(mesh.Vertices, 1, vertexBytes, file) == vertexBytes;
+        offset += vertexBytes;
+        written = written && WriteFilePadding(file, offset, MESH_FILE_ALIGNMENT) && fwrite(mesh.Indices, 1, indexBytes, file) == indexBytes;
+        offset += indexBytes;
+
+        UINT submeshCount;
+        MeshFileSubmesh wholeMesh;
+        const MeshFileSubmesh* submeshes = GetSourceSubmeshes(mesh, submeshCount, wholeMesh);
+        written = written && WriteFilePadding(file, offset, MESH_FILE_ALIGNMENT) && fwrite(submeshes, sizeof(MeshFileSubmesh), submeshCount, file) == submeshCount;
+        offset += sizeof(MeshFileSubmesh) * static_cast<uint64_t>(submeshCount);
+    }
+
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,1740 @@
+#include "EchoEngineCore.h"
+#include "MeshImporter.h"
+#include "JobSystem.h"
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace {
+
+const size_t OBJ_CHUNK_SIZE = 1 << 20;
+const UINT IMPORT_VERTEX_BATCH = 16384;
+const UINT IMPORT_INVALID_INDEX = 0xFFFFFFFF;
+
+const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+const int GLTF_MAX_NODE_DEPTH = 64;
+
+const double g_PowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// TEXT PARSING
+
+inline bool IsDigit(char c) {
+    return static_cast<unsigned>(c - '0') < 10;
+}
+
+// Value of a hexadecimal digit, or 16 for any other character.
+inline UINT GetHexDigit(char c) {
+    return IsDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 16;
+}
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+inline const char* SkipSpaces(const char* p, const char* end) {
+    while (p < end && IsSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Position of the next '\n', or end.
+inline const char* FindLineEnd(const char* p, const char* end) {
+    const void* newline = memchr(p, '\n', end - p);
+    return newline ? static_cast<const char*>(newline) : end;
+}
+
+// Decimal number without locale or terminator requirements. Precision is limited to 19 significant digits.
+bool ParseNumber(const char*& p, const char* end, double& value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        ++s;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+
+    for (; s < end && IsDigit(*s); ++s) {
+        anyDigits = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += mantissa != 0;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && IsDigit(*s); ++s) {
+            anyDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    if (!anyDigits) {
+        return false;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = *e == '-';
+            ++e;
+        }
+        if (e < end && IsDigit(*e)) {
+            int exponentValue = 0;
+            for (; e < end && IsDigit(*e); ++e) {
+                exponentValue = std::min<int>(exponentValue * 10 + (*e - '0'), 1000);
+            }
+            exponent += negativeExponent ? -exponentValue : exponentValue;
+            s = e;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        result = exponent >= -22 ? result / g_PowersOfTen[-exponent] : result * pow(10.0, exponent);
+    }
+    else if (exponent > 0) {
+        result = exponent <= 22 ? result * g_PowersOfTen[exponent] : result * pow(10.0, exponent);
+    }
+
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+inline bool ParseFloat(const char*& p, const char* end, float& value) {
+    double number;
+    p = SkipSpaces(p, end);
+    if (!ParseNumber(p, end, number)) {
+        return false;
+    }
+    value = static_cast<float>(number);
+    return true;
+}
+
+bool ParseInt(const char*& p, const char* end, int& value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        ++s;
+    }
+    if (s >= end || !IsDigit(*s)) {
+        return false;
+    }
+
+    int64_t result = 0;
+    for (; s < end && IsDigit(*s); ++s) {
+        result = std::min<int64_t>(result * 10 + (*s - '0'), 0x7FFFFFFF);
+    }
+
+    value = static_cast<int>(negative ? -result : result);
+    p = s;
+    return true;
+}
+
+// VERTEX WELDING
+
+inline uint64_t MixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash of the raw bytes of a key made of 32-bit words.
+template<typename Key>
+uint64_t HashKey(const Key& key) {
+    static_assert(sizeof(Key) % sizeof(uint32_t) == 0, "Weld keys must be made of 32-bit words.");
+
+    uint32_t words[sizeof(Key) / sizeof(uint32_t)];
+    memcpy(words, &key, sizeof(Key));
+
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+    for (uint32_t word : words) {
+        h = (h ^ word) * 0x100000001B3ULL;
+    }
+    return MixHash(h);
+}
+
+// Open addressing table from key hash to the index of the unique key.
+struct WeldTable
+{
+    std::vector<UINT> Slots;
+    size_t Mask;
+};
+
+void InitWeldTable(WeldTable& table, size_t expectedKeys) {
+    size_t capacity = 64;
+    while (capacity < expectedKeys * 2) {
+        capacity <<= 1;
+    }
+    table.Slots.assign(capacity, IMPORT_INVALID_INDEX);
+    table.Mask = capacity - 1;
+}
+
+void InsertWeldSlot(WeldTable& table, uint64_t hash, UINT value) {
+    size_t slot = hash & table.Mask;
+    while (table.Slots[slot] != IMPORT_INVALID_INDEX) {
+        slot = (slot + 1) & table.Mask;
+    }
+    table.Slots[slot] = value;
+}
+
+// Index of key in unique, appending it if it was not seen before.
+template<typename Key>
+UINT WeldKey(WeldTable& table, std::vector<Key>& unique, const Key& key) {
+    uint64_t hash = HashKey(key);
+    for (size_t slot = hash & table.Mask;; slot = (slot + 1) & table.Mask) {
+        UINT index = table.Slots[slot];
+        if (index == IMPORT_INVALID_INDEX) {
+            break;
+        }
+        if (memcmp(&unique[index], &key, sizeof(Key)) == 0) {
+            return index;
+        }
+    }
+
+    UINT index = static_cast<UINT>(unique.size());
+    unique.push_back(key);
+
+    //Keep the load factor at or below one half.
+    if (unique.size() * 2 > table.Slots.size()) {
+        table.Slots.assign(table.Slots.size() * 2, IMPORT_INVALID_INDEX);
+        table.Mask = table.Slots.size() - 1;
+        for (UINT i = 0; i < unique.size(); ++i) {
+            InsertWeldSlot(table, HashKey(unique[i]), i);
+        }
+    }
+    else {
+        InsertWeldSlot(table, hash, index);
+    }
+    return index;
+}
+
+void ComputeImportedBounds(ImportedMesh& mesh) {
+    if (mesh.Vertices.empty()) {
+        mesh.Bounds = BoundingBox();
+        return;
+    }
+    BoundingBox::CreateFromPoints(mesh.Bounds, mesh.Vertices.size(), &mesh.Vertices[0].Position, sizeof(ImportVertex));
+}
+
+void FillImportStats(ImportStats* stats, const ImportedMesh& mesh, uint64_t sourceBytes, double parseTimeMs, double weldTimeMs, std::chrono::steady_clock::time_point start) {
+    if (!stats) {
+        return;
+    }
+    stats->SourceBytes = sourceBytes;
+    stats->VertexCount = static_cast<UINT>(mesh.Vertices.size());
+    stats->TriangleCount = static_cast<UINT>(mesh.Indices.size() / 3);
+    stats->ParseTimeMs = parseTimeMs;
+    stats->WeldTimeMs = weldTimeMs;
+    stats->TotalTimeMs = ElapsedMs(start);
+}
+
+// OBJ
+
+// Absolute, zero based attribute indices of one face corner.
+struct ObjCorner
+{
+    UINT Position;
+    UINT TexCoord;
+    UINT Normal;
+};
+
+struct ObjChunk
+{
+    const char* Begin;
+    const char* End;
+    UINT PositionCount;
+    UINT TexCoordCount;
+    UINT NormalCount;
+    // Absolute index of the chunk's first attribute of each kind.
+    UINT FirstPosition;
+    UINT FirstTexCoord;
+    UINT FirstNormal;
+    bool HasColors;
+    bool Valid;
+    // Triangulated faces.
+    std::vector<ObjCorner> Corners;
+};
+
+struct ObjAttributes
+{
+    std::vector<XMFLOAT3> Positions;
+    // Sized like Positions when the file uses "v x y z r g b" vertex colors.
+    std::vector<XMFLOAT3> Colors;
+    std::vector<XMFLOAT2> TexCoords;
+    std::vector<XMFLOAT3> Normals;
+};
+
+enum ObjLineType {
+    OL_Other,
+    OL_Position,
+    OL_TexCoord,
+    OL_Normal,
+    OL_Face
+};
+
+// Classify a line and move p past its keyword.
+ObjLineType GetObjLineType(const char*& p, const char* end) {
+    p = SkipSpaces(p, end);
+    if (end - p < 2) {
+        return OL_Other;
+    }
+    if (p[0] == 'v') {
+        if (IsSpace(p[1])) {
+            p += 2;
+            return OL_Position;
+        }
+        if (end - p >= 3 && IsSpace(p[2])) {
+            if (p[1] == 't') {
+                p += 3;
+                return OL_TexCoord;
+            }
+            if (p[1] == 'n') {
+                p += 3;
+                return OL_Normal;
+            }
+        }
+    }
+    else if (p[0] == 'f' && IsSpace(p[1])) {
+        p += 2;
+        return OL_Face;
+    }
+    return OL_Other;
+}
+
+// First pass: count the attributes so every chunk knows where its data goes.
+void CountObjChunk(ObjChunk& chunk) {
+    for (const char* line = chunk.Begin; line < chunk.End;) {
+        const char* lineEnd = FindLineEnd(line, chunk.End);
+        const char* p = line;
+
+        switch (GetObjLineType(p, lineEnd)) {
+        case OL_Position:
+            //The first position of a chunk tells whether the file carries vertex colors.
+            if (chunk.PositionCount++ == 0) {
+                float value;
+                UINT values = 0;
+                while (values < 6 && ParseFloat(p, lineEnd, value)) {
+                    ++values;
+                }
+                chunk.HasColors = values == 6;
+            }
+            break;
+        case OL_TexCoord:
+            ++chunk.TexCoordCount;
+            break;
+        case OL_Normal:
+            ++chunk.NormalCount;
+            break;
+        default:
+            break;
+        }
+
+        line = lineEnd < chunk.End ? lineEnd + 1 : chunk.End;
+    }
+}
+
+// Positive OBJ indices are absolute and one based; negative ones count back from the current attribute.
+inline bool ResolveObjIndex(int index, UINT first, UINT local, UINT& resolved) {
+    if (index > 0) {
+        resolved = static_cast<UINT>(index - 1);
+        return true;
+    }
+    if (index < 0) {
+        int64_t absolute = static_cast<int64_t>(first) + local + index;
+        if (absolute >= 0) {
+            resolved = static_cast<UINT>(absolute);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Second pass: write the attributes into the shared arrays and triangulate the faces.
+void ParseObjChunk(ObjChunk& chunk, ObjAttributes& attributes) {
+    UINT position = 0;
+    UINT texCoord = 0;
+    UINT normal = 0;
+    std::vector<ObjCorner> polygon;
+
+    for (const char* line = chunk.Begin; line < chunk.End;) {
+        const char* lineEnd = FindLineEnd(line, chunk.End);
+        const char* p = line;
+
+        switch (GetObjLineType(p, lineEnd)) {
+        case OL_Position:
+            {
+                float x, y, z;
+                if (!ParseFloat(p, lineEnd, x) || !ParseFloat(p, lineEnd, y) || !ParseFloat(p, lineEnd, z)) {
+                    chunk.Valid = false;
+                    return;
+                }
+                //OBJ is right handed; mirror z into the engine's left handed space.
+                attributes.Positions[chunk.FirstPosition + position] = XMFLOAT3(x, y, -z);
+
+                if (!attributes.Colors.empty()) {
+                    float r, g, b;
+                    XMFLOAT3& color = attributes.Colors[chunk.FirstPosition + position];
+                    if (ParseFloat(p, lineEnd, r) && ParseFloat(p, lineEnd, g) && ParseFloat(p, lineEnd, b)) {
+                        color = XMFLOAT3(r, g, b);
+                    }
+                    else {
+                        color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+                    }
+                }
+                ++position;
+            }
+            break;
+        case OL_TexCoord:
+            {
+                float u, v = 0.0f;
+                if (!ParseFloat(p, lineEnd, u)) {
+                    chunk.Valid = false;
+                    return;
+                }
+                ParseFloat(p, lineEnd, v);
+                //OBJ texture space starts at the bottom left, Direct3D's at the top left.
+                attributes.TexCoords[chunk.FirstTexCoord + texCoord] = XMFLOAT2(u, 1.0f - v);
+                ++texCoord;
+            }
+            break;
+        case OL_Normal:
+            {
+                float x, y, z;
+                if (!ParseFloat(p, lineEnd, x) || !ParseFloat(p, lineEnd, y) || !ParseFloat(p, lineEnd, z)) {
+                    chunk.Valid = false;
+                    return;
+                }
+                attributes.Normals[chunk.FirstNormal + normal] = XMFLOAT3(x, y, -z);
+                ++normal;
+            }
+            break;
+        case OL_Face:
+            {
+                polygon.clear();
+                for (;;) {
+                    int index;
+                    p = SkipSpaces(p, lineEnd);
+                    if (!ParseInt(p, lineEnd, index)) {
+                        break;
+                    }
+
+                    ObjCorner corner = { IMPORT_INVALID_INDEX, IMPORT_INVALID_INDEX, IMPORT_INVALID_INDEX };
+                    bool valid = ResolveObjIndex(index, chunk.FirstPosition, position, corner.Position);
+                    if (valid && p < lineEnd && *p == '/') {
+                        ++p;
+                        if (p < lineEnd && *p != '/') {
+                            valid = ParseInt(p, lineEnd, index) && ResolveObjIndex(index, chunk.FirstTexCoord, texCoord, corner.TexCoord);
+                        }
+                        if (valid && p < lineEnd && *p == '/') {
+                            ++p;
+                            valid = ParseInt(p, lineEnd, index) && ResolveObjIndex(index, chunk.FirstNormal, normal, corner.Normal);
+                        }
+                    }
+                    if (!valid) {
+                        chunk.Valid = false;
+                        return;
+                    }
+                    polygon.push_back(corner);
+                }
+
+                if (polygon.size() < 3) {
+                    chunk.Valid = false;
+                    return;
+                }
+
+                //Fan triangulation. Mirroring z turns the counter clockwise OBJ winding into clockwise.
+                for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                    chunk.Corners.push_back(polygon[0]);
+                    chunk.Corners.push_back(polygon[i]);
+                    chunk.Corners.push_back(polygon[i + 1]);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        line = lineEnd < chunk.End ? lineEnd + 1 : chunk.End;
+    }
+}
+
+// JSON
+
+enum JsonType {
+    JT_Null,
+    JT_Bool,
+    JT_Number,
+    JT_String,
+    JT_Array,
+    JT_Object
+};
+
+const UINT JSON_INVALID_NODE = 0xFFFFFFFF;
+const int JSON_MAX_DEPTH = 64;
+
+struct JsonNode
+{
+    JsonType Type;
+    double Number;
+    std::string String;
+    // Member name when the node is the value of an object member.
+    std::string Key;
+    std::vector<UINT> Children;
+};
+
+inline const char* SkipJsonSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+void AppendUtf8(std::string& out, UINT codePoint) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+// p points at the opening quote.
+bool ParseJsonString(const char*& p, const char* end, std::string& out) {
+    for (++p; p < end && *p != '"';) {
+        char c = *p++;
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (p >= end) {
+            return false;
+        }
+
+        char escaped = *p++;
+        switch (escaped) {
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u':
+            {
+                if (end - p < 4) {
+                    return false;
+                }
+                UINT codePoint = 0;
+                for (int i = 0; i < 4; ++i, ++p) {
+                    UINT digit = GetHexDigit(*p);
+                    if (digit > 15) {
+                        return false;
+                    }
+                    codePoint = codePoint * 16 + digit;
+                }
+                AppendUtf8(out, codePoint);
+            }
+            break;
+        default:
+            out.push_back(escaped);
+            break;
+        }
+    }
+    if (p >= end) {
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+// Append the value at p and its descendants to nodes. Returns the value's node or JSON_INVALID_NODE.
+UINT ParseJsonValue(const char*& p, const char* end, std::vector<JsonNode>& nodes, int depth) {
+    p = SkipJsonSpaces(p, end);
+    if (p >= end || depth > JSON_MAX_DEPTH) {
+        return JSON_INVALID_NODE;
+    }
+
+    UINT index = static_cast<UINT>(nodes.size());
+    nodes.push_back(JsonNode());
+    nodes[index].Type = JT_Null;
+    nodes[index].Number = 0.0;
+
+    char c = *p;
+    if (c == '{' || c == '[') {
+        bool isObject = c == '{';
+        char close = isObject ? '}' : ']';
+        nodes[index].Type = isObject ? JT_Object : JT_Array;
+
+        p = SkipJsonSpaces(p + 1, end);
+        if (p < end && *p == close) {
+            ++p;
+            return index;
+        }
+
+        for (;;) {
+            std::string key;
+            if (isObject) {
+                p = SkipJsonSpaces(p, end);
+                if (p >= end || *p != '"' || !ParseJsonString(p, end, key)) {
+                    return JSON_INVALID_NODE;
+                }
+                p = SkipJsonSpaces(p, end);
+                if (p >= end || *p != ':') {
+                    return JSON_INVALID_NODE;
+                }
+                ++p;
+            }
+
+            UINT child = ParseJsonValue(p, end, nodes, depth + 1);
+            if (child == JSON_INVALID_NODE) {
+                return JSON_INVALID_NODE;
+            }
+            nodes[child].Key.swap(key);
+            nodes[index].Children.push_back(child);
+
+            p = SkipJsonSpaces(p, end);
+            if (p < end && *p == ',') {
+                ++p;
+                continue;
+            }
+            if (p < end && *p == close) {
+                ++p;
+                return index;
+            }
+            return JSON_INVALID_NODE;
+        }
+    }
+
+    if (c == '"') {
+        nodes[index].Type = JT_String;
+        return ParseJsonString(p, end, nodes[index].String) ? index : JSON_INVALID_NODE;
+    }
+    if (end - p >= 4 && strncmp(p, "true", 4) == 0) {
+        nodes[index].Type = JT_Bool;
+        nodes[index].Number = 1.0;
+        p += 4;
+        return index;
+    }
+    if (end - p >= 5 && strncmp(p, "false", 5) == 0) {
+        nodes[index].Type = JT_Bool;
+        p += 5;
+        return index;
+    }
+    if (end - p >= 4 && strncmp(p, "null", 4) == 0) {
+        p += 4;
+        return index;
+    }
+
+    nodes[index].Type = JT_Number;
+    return ParseNumber(p, end, nodes[index].Number) ? index : JSON_INVALID_NODE;
+}
+
+const JsonNode* FindJsonMember(const std::vector<JsonNode>& nodes, const JsonNode* object, const char* key) {
+    if (!object || object->Type != JT_Object) {
+        return nullptr;
+    }
+    for (UINT child : object->Children) {
+        if (nodes[child].Key == key) {
+            return &nodes[child];
+        }
+    }
+    return nullptr;
+}
+
+const JsonNode* GetJsonElement(const std::vector<JsonNode>& nodes, const JsonNode* array, uint64_t element) {
+    if (!array || array->Type != JT_Array || element >= array->Children.size()) {
+        return nullptr;
+    }
+    return &nodes[array->Children[static_cast<size_t>(element)]];
+}
+
+// Read a non-negative integer member. value is left untouched when it is missing or invalid.
+bool GetJsonUint(const std::vector<JsonNode>& nodes, const JsonNode* object, const char* key, uint64_t& value) {
+    const JsonNode* member = FindJsonMember(nodes, object, key);
+    if (!member || member->Type != JT_Number || member->Number < 0.0 || member->Number > 9.0e15) {
+        return false;
+    }
+    value = static_cast<uint64_t>(member->Number);
+    return true;
+}
+
+// Read a numeric array member of exactly count elements.
+bool GetJsonFloats(const std::vector<JsonNode>& nodes, const JsonNode* object, const char* key, float* values, UINT count) {
+    const JsonNode* member = FindJsonMember(nodes, object, key);
+    if (!member || member->Type != JT_Array || member->Children.size() != count) {
+        return false;
+    }
+    for (UINT i = 0; i < count; ++i) {
+        const JsonNode& element = nodes[member->Children[i]];
+        if (element.Type != JT_Number) {
+            return false;
+        }
+        values[i] = static_cast<float>(element.Number);
+    }
+    return true;
+}
+
+// GLTF
+
+struct GltfBuffer
+{
+    const BYTE* Data;
+    size_t Size;
+};
+
+struct GltfDocument
+{
+    std::vector<JsonNode> Nodes;
+    const JsonNode* Root;
+    std::vector<GltfBuffer> Buffers;
+    // Storage behind Buffers for external files and data URIs.
+    std::vector<MappedFile> Files;
+    std::vector<std::vector<BYTE>> DecodedBuffers;
+};
+
+struct GltfAccessor
+{
+    const BYTE* Data;
+    UINT Count;
+    UINT Stride;
+    UINT ComponentType;
+    UINT Components;
+    bool Normalized;
+};
+
+void CloseGltfDocument(GltfDocument& document) {
+    for (MappedFile& file : document.Files) {
+        CloseMappedFile(file);
+    }
+    document.Files.clear();
+}
+
+inline const JsonNode* GetGltfElement(const GltfDocument& document, const char* array, uint64_t element) {
+    return GetJsonElement(document.Nodes, FindJsonMember(document.Nodes, document.Root, array), element);
+}
+
+bool DecodeBase64(const char* text, size_t length, std::vector<BYTE>& out) {
+    UINT accumulator = 0;
+    int bits = 0;
+    for (size_t i = 0; i < length && text[i] != '='; ++i) {
+        char c = text[i];
+        int value = (c >= 'A' && c <= 'Z') ? c - 'A' : (c >= 'a' && c <= 'z') ? c - 'a' + 26 : IsDigit(c) ? c - '0' + 52 : c == '+' ? 62 : c == '/' ? 63 : -1;
+        if (value < 0) {
+            return false;
+        }
+        accumulator = ((accumulator << 6) | value) & 0xFFFFFF;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<BYTE>(accumulator >> bits));
+        }
+    }
+    return true;
+}
+
+// Relative URI to a path next to the glTF file. Percent escapes are decoded; other bytes are widened as is.
+std::wstring GetGltfBufferPath(const std::wstring& baseDirectory, const std::string& uri) {
+    std::wstring path = baseDirectory;
+    for (size_t i = 0; i < uri.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(uri[i]);
+        if (c == '%' && i + 2 < uri.size() && GetHexDigit(uri[i + 1]) < 16 && GetHexDigit(uri[i + 2]) < 16) {
+            c = static_cast<unsigned char>(GetHexDigit(uri[i + 1]) * 16 + GetHexDigit(uri[i + 2]));
+            i += 2;
+        }
+        path.push_back(static_cast<wchar_t>(c));
+    }
+    return path;
+}
+
+bool LoadGltfBuffers(GltfDocument& document, const std::wstring& baseDirectory, const BYTE* binary, size_t binarySize) {
+    const JsonNode* buffers = FindJsonMember(document.Nodes, document.Root, "buffers");
+    size_t bufferCount = buffers && buffers->Type == JT_Array ? buffers->Children.size() : 0;
+
+    for (size_t i = 0; i < bufferCount; ++i) {
+        const JsonNode* buffer = GetJsonElement(document.Nodes, buffers, i);
+        uint64_t byteLength = 0;
+        GetJsonUint(document.Nodes, buffer, "byteLength", byteLength);
+
+        GltfBuffer data = { nullptr, 0 };
+        const JsonNode* uri = FindJsonMember(document.Nodes, buffer, "uri");
+        if (!uri) {
+            //Only the first buffer of a .glb may omit its URI; it refers to the BIN chunk.
+            if (i != 0 || !binary) {
+                return false;
+            }
+            data.Data = binary;
+            data.Size = binarySize;
+        }
+        else if (uri->Type != JT_String) {
+            return false;
+        }
+        else if (uri->String.compare(0, 5, "data:") == 0) {
+            size_t comma = uri->String.find(',');
+            if (comma == std::string::npos || uri->String.rfind(";base64", comma) == std::string::npos) {
+                return false;
+            }
+            document.DecodedBuffers.push_back(std::vector<BYTE>());
+            std::vector<BYTE>& decoded = document.DecodedBuffers.back();
+            if (!DecodeBase64(uri->String.data() + comma + 1, uri->String.size() - comma - 1, decoded)) {
+                return false;
+            }
+            data.Data = decoded.data();
+            data.Size = decoded.size();
+        }
+        else {
+            if (baseDirectory.empty()) {
+                return false;
+            }
+            MappedFile file;
+            if (!OpenMappedFile(file, GetGltfBufferPath(baseDirectory, uri->String).c_str())) {
+                return false;
+            }
+            document.Files.push_back(file);
+            data.Data = file.Data;
+            data.Size = static_cast<size_t>(file.Size);
+        }
+
+        if (data.Size < byteLength) {
+            return false;
+        }
+        document.Buffers.push_back(data);
+    }
+    return true;
+}
+
+UINT GetGltfComponentSize(UINT componentType) {
+    switch (componentType) {
+    case 5120: // BYTE
+    case 5121: // UNSIGNED_BYTE
+        return 1;
+    case 5122: // SHORT
+    case 5123: // UNSIGNED_SHORT
+        return 2;
+    case 5125: // UNSIGNED_INT
+    case 5126: // FLOAT
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+UINT GetGltfComponentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+bool GetGltfAccessor(const GltfDocument& document, uint64_t accessorIndex, GltfAccessor& accessor) {
+    const std::vector<JsonNode>& nodes = document.Nodes;
+    const JsonNode* accessorNode = GetGltfElement(document, "accessors", accessorIndex);
+    //Sparse accessors and accessors without a buffer view are not supported.
+    uint64_t viewIndex;
+    if (!accessorNode || FindJsonMember(nodes, accessorNode, "sparse") || !GetJsonUint(nodes, accessorNode, "bufferView", viewIndex)) {
+        return false;
+    }
+
+    const JsonNode* view = GetGltfElement(document, "bufferViews", viewIndex);
+    uint64_t bufferIndex;
+    if (!view || !GetJsonUint(nodes, view, "buffer", bufferIndex) || bufferIndex >= document.Buffers.size()) {
+        return false;
+    }
+    const GltfBuffer& buffer = document.Buffers[static_cast<size_t>(bufferIndex)];
+
+    uint64_t viewOffset = 0, viewLength = 0, viewStride = 0, accessorOffset = 0, componentType = 0, count = 0;
+    GetJsonUint(nodes, view, "byteOffset", viewOffset);
+    GetJsonUint(nodes, view, "byteLength", viewLength);
+    GetJsonUint(nodes, view, "byteStride", viewStride);
+    GetJsonUint(nodes, accessorNode, "byteOffset", accessorOffset);
+    GetJsonUint(nodes, accessorNode, "componentType", componentType);
+    GetJsonUint(nodes, accessorNode, "count", count);
+
+    const JsonNode* type = FindJsonMember(nodes, accessorNode, "type");
+    const JsonNode* normalized = FindJsonMember(nodes, accessorNode, "normalized");
+
+    accessor.ComponentType = static_cast<UINT>(componentType);
+    accessor.Components = type && type->Type == JT_String ? GetGltfComponentCount(type->String) : 0;
+    accessor.Normalized = normalized && normalized->Type == JT_Bool && normalized->Number != 0.0;
+
+    UINT elementSize = GetGltfComponentSize(accessor.ComponentType) * accessor.Components;
+    if (elementSize == 0 || count > 0xFFFFFFFF || viewStride > 255) {
+        return false;
+    }
+    accessor.Count = static_cast<UINT>(count);
+    accessor.Stride = viewStride ? static_cast<UINT>(viewStride) : elementSize;
+
+    //Every element must lie inside the buffer view, which must lie inside the buffer.
+    if (viewOffset > buffer.Size || viewLength > buffer.Size - viewOffset) {
+        return false;
+    }
+    if (count > 0 && accessorOffset + accessor.Stride * (count - 1) + elementSize > viewLength) {
+        return false;
+    }
+
+    accessor.Data = buffer.Data + viewOffset + accessorOffset;
+    return true;
+}
+
+float ReadGltfComponent(const BYTE* data, UINT componentType, bool normalized) {
+    switch (componentType) {
+    case 5120:
+        {
+            int8_t value = static_cast<int8_t>(data[0]);
+            return normalized ? std::max<float>(value / 127.0f, -1.0f) : value;
+        }
+    case 5121:
+        return normalized ? data[0] / 255.0f : data[0];
+    case 5122:
+        {
+            int16_t value;
+            memcpy(&value, data, sizeof(value));
+            return normalized ? std::max<float>(value / 32767.0f, -1.0f) : value;
+        }
+    case 5123:
+        {
+            uint16_t value;
+            memcpy(&value, data, sizeof(value));
+            return normalized ? value / 65535.0f : value;
+        }
+    case 5125:
+        {
+            uint32_t value;
+            memcpy(&value, data, sizeof(value));
+            return static_cast<float>(value);
+        }
+    case 5126:
+        {
+            float value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    default:
+        return 0.0f;
+    }
+}
+
+// Read up to four components of one element. Missing components read as 0, or 1 for w.
+void ReadGltfElement(const GltfAccessor& accessor, UINT element, float values[4]) {
+    const BYTE* data = accessor.Data + static_cast<size_t>(element) * accessor.Stride;
+    UINT componentSize = GetGltfComponentSize(accessor.ComponentType);
+    for (UINT i = 0; i < 4; ++i) {
+        values[i] = i < accessor.Components ? ReadGltfComponent(data + i * componentSize, accessor.ComponentType, accessor.Normalized) : (i == 3 ? 1.0f : 0.0f);
+    }
+}
+
+inline UINT ReadGltfIndex(const GltfAccessor& accessor, UINT element) {
+    const BYTE* data = accessor.Data + static_cast<size_t>(element) * accessor.Stride;
+    if (accessor.ComponentType == 5121) {
+        return data[0];
+    }
+    if (accessor.ComponentType == 5123) {
+        uint16_t index;
+        memcpy(&index, data, sizeof(index));
+        return index;
+    }
+    uint32_t index;
+    memcpy(&index, data, sizeof(index));
+    return index;
+}
+
+// Look up an optional vertex attribute. It must have one element per position.
+bool GetGltfAttribute(const GltfDocument& document, const JsonNode* attributes, const char* name, UINT minComponents, UINT vertexCount, GltfAccessor& accessor, bool& present) {
+    uint64_t accessorIndex;
+    present = GetJsonUint(document.Nodes, attributes, name, accessorIndex);
+    if (!present) {
+        return true;
+    }
+    return GetGltfAccessor(document, accessorIndex, accessor) && accessor.Components >= minComponents && accessor.Count == vertexCount;
+}
+
+bool ImportGltfPrimitive(const GltfDocument& document, const JsonNode* primitive, FXMMATRIX world, ImportedMesh& mesh) {
+    const std::vector<JsonNode>& nodes = document.Nodes;
+
+    //Only triangle lists are imported; points, lines and strips are skipped.
+    uint64_t mode = 4;
+    GetJsonUint(nodes, primitive, "mode", mode);
+    if (mode != 4) {
+        return true;
+    }
+
+    const JsonNode* attributes = FindJsonMember(nodes, primitive, "attributes");
+    uint64_t positionIndex;
+    GltfAccessor positions;
+    if (!GetJsonUint(nodes, attributes, "POSITION", positionIndex) || !GetGltfAccessor(document, positionIndex, positions) || positions.Components != 3) {
+        return false;
+    }
+
+    UINT vertexCount = positions.Count;
+    GltfAccessor normals, texCoords, colors;
+    bool hasNormals, hasTexCoords, hasColors;
+    if (!GetGltfAttribute(document, attributes, "NORMAL", 3, vertexCount, normals, hasNormals)
+        || !GetGltfAttribute(document, attributes, "TEXCOORD_0", 2, vertexCount, texCoords, hasTexCoords)
+        || !GetGltfAttribute(document, attributes, "COLOR_0", 3, vertexCount, colors, hasColors)) {
+        return false;
+    }
+
+    mesh.Attributes |= (hasNormals ? IA_Normal : 0) | (hasTexCoords ? IA_TexCoord : 0) | (hasColors ? IA_Color : 0);
+
+    //Normals go through the inverse transpose; a mirroring transform also flips the winding.
+    XMVECTOR determinant;
+    XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(&determinant, world));
+    bool flipWinding = XMVectorGetX(determinant) < 0.0f;
+
+    size_t baseVertex = mesh.Vertices.size();
+    mesh.Vertices.resize(baseVertex + vertexCount);
+    ImportVertex* vertices = mesh.Vertices.data() + baseVertex;
+
+    ParallelFor(vertexCount, IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+        float values[4];
+        for (UINT i = begin; i < end; ++i) {
+            ImportVertex& vertex = vertices[i];
+
+            ReadGltfElement(positions, i, values);
+            XMStoreFloat3(&vertex.Position, XMVector3TransformCoord(XMVectorSet(values[0], values[1], values[2], 1.0f), world));
+            //glTF is right handed; mirror z into the engine's left handed space.
+            vertex.Position.z = -vertex.Position.z;
+
+            vertex.Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            if (hasNormals) {
+                ReadGltfElement(normals, i, values);
+                XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(values[0], values[1], values[2], 0.0f), normalMatrix)));
+                vertex.Normal.z = -vertex.Normal.z;
+            }
+
+            vertex.TexCoord = XMFLOAT2(0.0f, 0.0f);
+            if (hasTexCoords) {
+                ReadGltfElement(texCoords, i, values);
+                vertex.TexCoord = XMFLOAT2(values[0], values[1]);
+            }
+
+            vertex.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            if (hasColors) {
+                ReadGltfElement(colors, i, values);
+                vertex.Color = XMFLOAT4(values[0], values[1], values[2], values[3]);
+            }
+        }
+    });
+
+    uint64_t indicesIndex;
+    GltfAccessor indices;
+    bool hasIndices = GetJsonUint(nodes, primitive, "indices", indicesIndex);
+    if (hasIndices && (!GetGltfAccessor(document, indicesIndex, indices) || indices.Components != 1
+        || (indices.ComponentType != 5121 && indices.ComponentType != 5123 && indices.ComponentType != 5125))) {
+        return false;
+    }
+
+    UINT indexCount = hasIndices ? indices.Count : vertexCount;
+    if (indexCount % 3 != 0) {
+        return false;
+    }
+
+    size_t baseIndex = mesh.Indices.size();
+    mesh.Indices.resize(baseIndex + indexCount);
+    uint32_t* out = mesh.Indices.data() + baseIndex;
+    std::atomic<bool> valid(true);
+
+    ParallelFor(indexCount / 3, IMPORT_VERTEX_BATCH / 3, [&](UINT begin, UINT end) {
+        for (UINT triangle = begin; triangle < end; ++triangle) {
+            UINT corner[3];
+            for (UINT i = 0; i < 3; ++i) {
+                corner[i] = hasIndices ? ReadGltfIndex(indices, triangle * 3 + i) : triangle * 3 + i;
+                if (corner[i] >= vertexCount) {
+                    valid = false;
+                    corner[i] = 0;
+                }
+            }
+            //Mirroring z turns the counter clockwise glTF winding into clockwise.
+            out[triangle * 3 + 0] = static_cast<uint32_t>(baseVertex + corner[0]);
+            out[triangle * 3 + 1] = static_cast<uint32_t>(baseVertex + corner[flipWinding ? 2 : 1]);
+            out[triangle * 3 + 2] = static_cast<uint32_t>(baseVertex + corner[flipWinding ? 1 : 2]);
+        }
+    });
+
+    return valid;
+}
+
+bool ImportGltfMesh(const GltfDocument& document, uint64_t meshIndex, FXMMATRIX world, ImportedMesh& mesh) {
+    const JsonNode* meshNode = GetGltfElement(document, "meshes", meshIndex);
+    const JsonNode* primitives = FindJsonMember(document.Nodes, meshNode, "primitives");
+    if (!primitives || primitives->Type != JT_Array) {
+        return false;
+    }
+    for (UINT child : primitives->Children) {
+        if (!ImportGltfPrimitive(document, &document.Nodes[child], world, mesh)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Local transform of a node in row vector form.
+XMMATRIX GetGltfNodeMatrix(const GltfDocument& document, const JsonNode* node) {
+    //glTF stores column major matrices for column vectors; read row major that is already the row vector form.
+    float values[16];
+    if (GetJsonFloats(document.Nodes, node, "matrix", values, 16)) {
+        XMFLOAT4X4 matrix(values);
+        return XMLoadFloat4x4(&matrix);
+    }
+
+    float scale[3] = { 1.0f, 1.0f, 1.0f };
+    float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float translation[3] = { 0.0f, 0.0f, 0.0f };
+    GetJsonFloats(document.Nodes, node, "scale", scale, 3);
+    GetJsonFloats(document.Nodes, node, "rotation", rotation, 4);
+    GetJsonFloats(document.Nodes, node, "translation", translation, 3);
+
+    XMMATRIX m = XMMatrixScaling(scale[0], scale[1], scale[2]);
+    m = XMMatrixMultiply(m, XMMatrixRotationQuaternion(XMVectorSet(rotation[0], rotation[1], rotation[2], rotation[3])));
+    return XMMatrixMultiply(m, XMMatrixTranslation(translation[0], translation[1], translation[2]));
+}
+
+bool ImportGltfNode(const GltfDocument& document, uint64_t nodeIndex, FXMMATRIX parentWorld, ImportedMesh& mesh, int depth) {
+    const JsonNode* node = GetGltfElement(document, "nodes", nodeIndex);
+    if (!node || depth > GLTF_MAX_NODE_DEPTH) {
+        return false;
+    }
+
+    XMMATRIX world = XMMatrixMultiply(GetGltfNodeMatrix(document, node), parentWorld);
+
+    uint64_t meshIndex;
+    if (GetJsonUint(document.Nodes, node, "mesh", meshIndex) && !ImportGltfMesh(document, meshIndex, world, mesh)) {
+        return false;
+    }
+
+    const JsonNode* children = FindJsonMember(document.Nodes, node, "children");
+    if (children && children->Type == JT_Array) {
+        for (UINT child : children->Children) {
+            const JsonNode& childIndex = document.Nodes[child];
+            if (childIndex.Type != JT_Number || childIndex.Number < 0.0
+                || !ImportGltfNode(document, static_cast<uint64_t>(childIndex.Number), world, mesh, depth + 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Import the default scene, or every mesh untransformed when the file has no scenes.
+bool ParseGltfDocument(const char* json, size_t jsonSize, const std::wstring& baseDirectory, const BYTE* binary, size_t binarySize, uint64_t sourceBytes, ImportedMesh& mesh, ImportStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    mesh.Vertices.clear();
+    mesh.Indices.clear();
+    mesh.Attributes = 0;
+
+    GltfDocument document;
+    const char* p = json;
+    if (ParseJsonValue(p, json + jsonSize, document.Nodes, 0) != 0 || document.Nodes[0].Type != JT_Object) {
+        return false;
+    }
+    document.Root = &document.Nodes[0];
+
+    const JsonNode* version = FindJsonMember(document.Nodes, FindJsonMember(document.Nodes, document.Root, "asset"), "version");
+    if (!version || version->Type != JT_String || version->String.compare(0, 2, "2.") != 0) {
+        return false;
+    }
+
+    bool imported = LoadGltfBuffers(document, baseDirectory, binary, binarySize);
+
+    uint64_t sceneIndex = 0;
+    GetJsonUint(document.Nodes, document.Root, "scene", sceneIndex);
+    const JsonNode* scene = GetGltfElement(document, "scenes", sceneIndex);
+    const JsonNode* roots = FindJsonMember(document.Nodes, scene, "nodes");
+
+    if (imported && roots && roots->Type == JT_Array) {
+        for (UINT root : roots->Children) {
+            const JsonNode& rootIndex = document.Nodes[root];
+            if (rootIndex.Type != JT_Number || rootIndex.Number < 0.0
+                || !ImportGltfNode(document, static_cast<uint64_t>(rootIndex.Number), XMMatrixIdentity(), mesh, 0)) {
+                imported = false;
+                break;
+            }
+        }
+    }
+    else if (imported) {
+        const JsonNode* meshes = FindJsonMember(document.Nodes, document.Root, "meshes");
+        size_t meshCount = meshes && meshes->Type == JT_Array ? meshes->Children.size() : 0;
+        for (size_t i = 0; imported && i < meshCount; ++i) {
+            imported = ImportGltfMesh(document, i, XMMatrixIdentity(), mesh);
+        }
+    }
+
+    CloseGltfDocument(document);
+    if (!imported) {
+        return false;
+    }
+    double parseTimeMs = ElapsedMs(start);
+
+    //Exporters tend to split vertices per primitive and per face; weld them back together.
+    std::chrono::steady_clock::time_point weldStart = std::chrono::steady_clock::now();
+    WeldImportedVertices(mesh);
+    ComputeImportedBounds(mesh);
+    double weldTimeMs = ElapsedMs(weldStart);
+
+    FillImportStats(stats, mesh, sourceBytes, parseTimeMs, weldTimeMs, start);
+    return true;
+}
+
+bool ParseGlbContainer(const BYTE* data, size_t size, const std::wstring& baseDirectory, ImportedMesh& mesh, ImportStats* stats) {
+    uint32_t header[3];
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size) {
+        return false;
+    }
+
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    const BYTE* binary = nullptr;
+    size_t binarySize = 0;
+
+    for (size_t offset = sizeof(header); offset + 8 <= header[2];) {
+        uint32_t chunk[2];
+        memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > header[2] - offset) {
+            return false;
+        }
+
+        if (chunk[1] == GLB_CHUNK_JSON && !json) {
+            json = reinterpret_cast<const char*>(data + offset);
+            jsonSize = chunk[0];
+        }
+        else if (chunk[1] == GLB_CHUNK_BIN && !binary) {
+            binary = data + offset;
+            binarySize = chunk[0];
+        }
+        offset += chunk[0];
+    }
+
+    return json && ParseGltfDocument(json, jsonSize, baseDirectory, binary, binarySize, size, mesh, stats);
+}
+
+// VERTEX ENCODING
+
+// Octahedral mapping of a unit vector onto the [-1, 1] square.
+XMVECTOR EncodeOctahedral(FXMVECTOR normal) {
+    XMVECTOR absNormal = XMVectorAbs(normal);
+    float sum = XMVectorGetX(absNormal) + XMVectorGetY(absNormal) + XMVectorGetZ(absNormal);
+    if (sum == 0.0f) {
+        return XMVectorZero();
+    }
+
+    float x = XMVectorGetX(normal) / sum;
+    float y = XMVectorGetY(normal) / sum;
+    if (XMVectorGetZ(normal) < 0.0f) {
+        //Fold the lower hemisphere over the diagonals.
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return XMVectorSet(x, y, 0.0f, 0.0f);
+}
+
+// Attributes after position and color, per compact layout.
+inline void EncodeExtraAttributes(const ImportVertex&, VertexCompactPosColor&) {
+}
+
+inline void EncodeExtraAttributes(const ImportVertex& source, VertexCompactPosNormalColor& vertex) {
+    XMStoreShortN2(&vertex.Normal, EncodeOctahedral(XMLoadFloat3(&source.Normal)));
+}
+
+inline void EncodeExtraAttributes(const ImportVertex& source, VertexCompactPosNormalTexColor& vertex) {
+    XMStoreShortN2(&vertex.Normal, EncodeOctahedral(XMLoadFloat3(&source.Normal)));
+    XMStoreHalf2(&vertex.TexCoord, XMLoadFloat2(&source.TexCoord));
+}
+
+template<typename Vertex>
+void EncodeCompactVertices(const ImportedMesh& mesh, FXMVECTOR scale, FXMVECTOR bias, Vertex* vertices) {
+    //Positions map to 0..1 inside the mesh bounds; flat axes have no scale and store 0.
+    XMVECTOR inverseScale = XMVectorSelect(XMVectorReciprocal(scale), XMVectorZero(), XMVectorLessOrEqual(scale, XMVectorZero()));
+
+    ParallelFor(static_cast<UINT>(mesh.Vertices.size()), IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            const ImportVertex& source = mesh.Vertices[i];
+            Vertex& vertex = vertices[i];
+
+            XMVECTOR position = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&source.Position), bias), inverseScale);
+            XMStoreUShortN4(&vertex.Position, XMVectorSetW(position, 1.0f));
+            XMStoreUByteN4(&vertex.Color, XMLoadFloat4(&source.Color));
+            EncodeExtraAttributes(source, vertex);
+        }
+    });
+}
+
+//Cut the triangle list into runs that touch at most MESH_INDEX16_VERTEX_LIMIT vertices each.
+//vertexMap receives the source vertex of every output vertex, submesh by submesh, and the
+//indices become relative to their submesh's base vertex.
+void SplitTriangles(const ImportedMesh& mesh, std::vector<uint32_t>& vertexMap, std::vector<uint32_t>& indices, std::vector<MeshFileSubmesh>& submeshes) {
+    //Local index of every source vertex, valid when its stamp matches the current submesh.
+    std::vector<UINT> submeshStamps(mesh.Vertices.size(), IMPORT_INVALID_INDEX);
+    std::vector<uint32_t> localIndices(mesh.Vertices.size());
+
+    vertexMap.clear();
+    indices.resize(mesh.Indices.size());
+    submeshes.clear();
+
+    MeshFileSubmesh submesh = {};
+    UINT stamp = 0;
+    for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+        const uint32_t* triangle = &mesh.Indices[i];
+        UINT newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            newVertices += submeshStamps[triangle[k]] != stamp && !repeated ? 1 : 0;
+        }
+
+        if (submesh.VertexCount + newVertices > MESH_INDEX16_VERTEX_LIMIT) {
+            submeshes.push_back(submesh);
+            submesh.StartIndex = static_cast<uint32_t>(i);
+            submesh.IndexCount = 0;
+            submesh.BaseVertex = static_cast<uint32_t>(vertexMap.size());
+            submesh.VertexCount = 0;
+            ++stamp;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            uint32_t vertex = triangle[k];
+            if (submeshStamps[vertex] != stamp) {
+                submeshStamps[vertex] = stamp;
+                localIndices[vertex] = submesh.VertexCount++;
+                vertexMap.push_back(vertex);
+            }
+            indices[i + k] = localIndices[vertex];
+        }
+        submesh.IndexCount += 3;
+    }
+
+    if (submesh.IndexCount > 0) {
+        submeshes.push_back(submesh);
+    }
+}
+
+std::wstring GetDirectory(const wchar_t* path) {
+    std::wstring directory(path);
+    size_t separator = directory.find_last_of(L"/\\");
+    return separator == std::wstring::npos ? std::wstring() : directory.substr(0, separator + 1);
+}
+
+}
+
+bool ParseObj(const char* text, size_t size, ImportedMesh& mesh, ImportStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //Split the text into chunks that end on line boundaries.
+    std::vector<ObjChunk> chunks;
+    const char* end = text + size;
+    for (const char* begin = text; begin < end;) {
+        const char* chunkEnd = begin + std::min<size_t>(OBJ_CHUNK_SIZE, end - begin);
+        if (chunkEnd < end) {
+            chunkEnd = FindLineEnd(chunkEnd, end);
+            chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+        }
+
+        ObjChunk chunk = {};
+        chunk.Begin = begin;
+        chunk.End = chunkEnd;
+        chunk.Valid = true;
+        chunks.push_back(std::move(chunk));
+        begin = chunkEnd;
+    }
+
+    UINT chunkCount = static_cast<UINT>(chunks.size());
+    ParallelFor(chunkCount, 1, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            CountObjChunk(chunks[i]);
+        }
+    });
+
+    //Prefix sums give every chunk the absolute index of its first attribute.
+    UINT positionCount = 0, texCoordCount = 0, normalCount = 0;
+    bool hasColors = false;
+    for (ObjChunk& chunk : chunks) {
+        chunk.FirstPosition = positionCount;
+        chunk.FirstTexCoord = texCoordCount;
+        chunk.FirstNormal = normalCount;
+        positionCount += chunk.PositionCount;
+        texCoordCount += chunk.TexCoordCount;
+        normalCount += chunk.NormalCount;
+        hasColors = hasColors || chunk.HasColors;
+    }
+
+    ObjAttributes attributes;
+    attributes.Positions.resize(positionCount);
+    attributes.Colors.resize(hasColors ? positionCount : 0);
+    attributes.TexCoords.resize(texCoordCount);
+    attributes.Normals.resize(normalCount);
+
+    ParallelFor(chunkCount, 1, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            ParseObjChunk(chunks[i], attributes);
+        }
+    });
+
+    size_t cornerCount = 0;
+    for (const ObjChunk& chunk : chunks) {
+        if (!chunk.Valid) {
+            return false;
+        }
+        cornerCount += chunk.Corners.size();
+    }
+    double parseTimeMs = ElapsedMs(start);
+
+    //Weld corners that share the same position, texcoord and normal into one vertex.
+    std::chrono::steady_clock::time_point weldStart = std::chrono::steady_clock::now();
+
+    WeldTable table;
+    InitWeldTable(table, positionCount);
+    std::vector<ObjCorner> uniqueCorners;
+    uniqueCorners.reserve(positionCount);
+
+    mesh.Indices.clear();
+    mesh.Indices.reserve(cornerCount);
+    for (ObjChunk& chunk : chunks) {
+        for (const ObjCorner& corner : chunk.Corners) {
+            if (corner.Position >= positionCount
+                || (corner.TexCoord != IMPORT_INVALID_INDEX && corner.TexCoord >= texCoordCount)
+                || (corner.Normal != IMPORT_INVALID_INDEX && corner.Normal >= normalCount)) {
+                return false;
+            }
+            mesh.Indices.push_back(WeldKey(table, uniqueCorners, corner));
+        }
+        std::vector<ObjCorner>().swap(chunk.Corners);
+    }
+
+    UINT vertexCount = static_cast<UINT>(uniqueCorners.size());
+    mesh.Vertices.resize(vertexCount);
+    ParallelFor(vertexCount, IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            const ObjCorner& corner = uniqueCorners[i];
+            ImportVertex& vertex = mesh.Vertices[i];
+
+            vertex.Position = attributes.Positions[corner.Position];
+            vertex.Normal = corner.Normal != IMPORT_INVALID_INDEX ? attributes.Normals[corner.Normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+            vertex.TexCoord = corner.TexCoord != IMPORT_INVALID_INDEX ? attributes.TexCoords[corner.TexCoord] : XMFLOAT2(0.0f, 0.0f);
+            if (hasColors) {
+                const XMFLOAT3& color = attributes.Colors[corner.Position];
+                vertex.Color = XMFLOAT4(color.x, color.y, color.z, 1.0f);
+            }
+            else {
+                vertex.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            }
+        }
+    });
+
+    mesh.Attributes = (normalCount ? IA_Normal : 0) | (texCoordCount ? IA_TexCoord : 0) | (hasColors ? IA_Color : 0);
+    ComputeImportedBounds(mesh);
+    double weldTimeMs = ElapsedMs(weldStart);
+
+    FillImportStats(stats, mesh, size, parseTimeMs, weldTimeMs, start);
+    return true;
+}
+
+bool ParseGlb(const BYTE* data, size_t size, ImportedMesh& mesh, ImportStats* stats) {
+    return ParseGlbContainer(data, size, std::wstring(), mesh, stats);
+}
+
+bool ImportMesh(const wchar_t* path, ImportedMesh& mesh, ImportStats* stats) {
+    MappedFile file;
+    if (!OpenMappedFile(file, path)) {
+        return false;
+    }
+
+    const char* text = reinterpret_cast<const char*>(file.Data);
+    size_t size = static_cast<size_t>(file.Size);
+    bool imported = false;
+
+    if (HasExtension(path, L".obj")) {
+        imported = ParseObj(text, size, mesh, stats);
+    }
+    else if (HasExtension(path, L".glb")) {
+        imported = ParseGlbContainer(file.Data, size, GetDirectory(path), mesh, stats);
+    }
+    else if (HasExtension(path, L".gltf")) {
+        imported = ParseGltfDocument(text, size, GetDirectory(path), nullptr, 0, size, mesh, stats);
+    }
+
+    CloseMappedFile(file);
+    return imported;
+}
+
+void WeldImportedVertices(ImportedMesh& mesh) {
+    WeldTable table;
+    InitWeldTable(table, mesh.Vertices.size());
+
+    std::vector<ImportVertex> uniqueVertices;
+    uniqueVertices.reserve(mesh.Vertices.size());
+    std::vector<uint32_t> remap(mesh.Vertices.size());
+
+    for (size_t i = 0; i < mesh.Vertices.size(); ++i) {
+        remap[i] = WeldKey(table, uniqueVertices, mesh.Vertices[i]);
+    }
+    for (uint32_t& index : mesh.Indices) {
+        index = remap[index];
+    }
+    mesh.Vertices.swap(uniqueVertices);
+}
+
+void OptimizeImportedMesh(ImportedMesh& mesh, MeshOptimizeStats* stats) {
+    UINT vertexCount = static_cast<UINT>(mesh.Vertices.size());
+    uint32_t* indices = mesh.Indices.data();
+    size_t indexCount = mesh.Indices.size();
+    if (stats) {
+        AnalyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, stats->Before);
+    }
+    if (vertexCount == 0) {
+        if (stats) {
+            stats->After = stats->Before;
+            stats->VertexCacheTimeMs = stats->OverdrawTimeMs = stats->VertexFetchTimeMs = 0.0;
+        }
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    OptimizeVertexCache(indices, indexCount, vertexCount);
+    double vertexCacheTimeMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    OptimizeOverdraw(indices, indexCount, &mesh.Vertices[0].Position, sizeof(ImportVertex), vertexCount, OVERDRAW_THRESHOLD);
+    double overdrawTimeMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> remap(vertexCount);
+    UINT usedVertexCount = OptimizeVertexFetchRemap(indices, indexCount, vertexCount, remap.data());
+
+    std::vector<ImportVertex> vertices(usedVertexCount);
+    ParallelFor(vertexCount, IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            if (remap[i] != MESH_OPTIMIZER_INVALID_INDEX) {
+                vertices[remap[i]] = mesh.Vertices[i];
+            }
+        }
+    });
+    mesh.Vertices.swap(vertices);
+    if (usedVertexCount != vertexCount) {
+        ComputeImportedBounds(mesh);
+    }
+    double vertexFetchTimeMs = ElapsedMs(start);
+
+    if (stats) {
+        AnalyzeVertexCache(mesh.Indices.data(), indexCount, usedVertexCount, VERTEX_CACHE_SIZE, stats->After);
+        stats->VertexCacheTimeMs = vertexCacheTimeMs;
+        stats->OverdrawTimeMs = overdrawTimeMs;
+        stats->VertexFetchTimeMs = vertexFetchTimeMs;
+    }
+}
+
+double GetImportThroughputMBs(const ImportStats& stats) {
+    if (stats.TotalTimeMs <= 0.0) {
+        return 0.0;
+    }
+    return (stats.SourceBytes / (1024.0 * 1024.0)) / (stats.TotalTimeMs / 1000.0);
+}
+
+MeshVertexFormat ChooseVertexFormat(const ImportedMesh& mesh) {
+    if (mesh.Attributes & IA_TexCoord) {
+        return MVF_CompactPositionNormalTexCoordColor;
+    }
+    if (mesh.Attributes & IA_Normal) {
+        return MVF_CompactPositionNormalColor;
+    }
+    return MVF_CompactPositionColor;
+}
+
+MeshIndexLayout ChooseIndexLayout(const ImportedMesh& mesh, MeshVertexFormat format) {
+    if (mesh.Vertices.size() <= MESH_INDEX16_VERTEX_LIMIT) {
+        return MIL_Index16;
+    }
+
+    //Splitting duplicates the vertices on every cut; it pays off unless the mesh is cut up badly.
+    std::vector<uint32_t> vertexMap;
+    std::vector<uint32_t> indices;
+    std::vector<MeshFileSubmesh> submeshes;
+    SplitTriangles(mesh, vertexMap, indices, submeshes);
+
+    uint64_t vertexStride = GetVertexFormatStride(format);
+    uint64_t splitBytes = vertexStride * vertexMap.size() + sizeof(uint16_t) * static_cast<uint64_t>(indices.size());
+    uint64_t index32Bytes = vertexStride * mesh.Vertices.size() + sizeof(uint32_t) * static_cast<uint64_t>(mesh.Indices.size());
+    return submeshes.size() <= MESH_MAX_SPLIT_SUBMESHES && splitBytes < index32Bytes ? MIL_Split16 : MIL_Index32;
+}
+
+void CookImportedMesh(const ImportedMesh& importedMesh, MeshVertexFormat format, MeshIndexLayout indexLayout, CookedMesh& cooked) {
+    assert(indexLayout != MIL_Index16 || importedMesh.Vertices.size() <= MESH_INDEX16_VERTEX_LIMIT);
+
+    //A split mesh is cooked from its vertices copied submesh by submesh.
+    ImportedMesh splitMesh;
+    if (indexLayout == MIL_Split16) {
+        std::vector<uint32_t> vertexMap;
+        SplitTriangles(importedMesh, vertexMap, splitMesh.Indices, cooked.Submeshes);
+
+        splitMesh.Vertices.resize(vertexMap.size());
+        ParallelFor(static_cast<UINT>(vertexMap.size()), IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+            for (UINT i = begin; i < end; ++i) {
+                splitMesh.Vertices[i] = importedMesh.Vertices[vertexMap[i]];
+            }
+        });
+        splitMesh.Attributes = importedMesh.Attributes;
+        splitMesh.Bounds = importedMesh.Bounds;
+    }
+    else {
+        MeshFileSubmesh submesh = { 0, static_cast<uint32_t>(importedMesh.Indices.size()), 0, static_cast<uint32_t>(importedMesh.Vertices.size()) };
+        cooked.Submeshes.assign(importedMesh.Indices.empty() ? 0 : 1, submesh);
+    }
+    const ImportedMesh& mesh = indexLayout == MIL_Split16 ? splitMesh : importedMesh;
+
+    cooked.VertexFormat = format;
+    cooked.VertexStride = GetVertexFormatStride(format);
+    cooked.VertexCount = static_cast<UINT>(mesh.Vertices.size());
+    cooked.Vertices.resize(static_cast<size_t>(cooked.VertexStride) * cooked.VertexCount);
+
+    XMVECTOR boundsCenter = XMLoadFloat3(&mesh.Bounds.Center);
+    XMVECTOR boundsExtents = XMLoadFloat3(&mesh.Bounds.Extents);
+    XMVECTOR scale = XMVectorAdd(boundsExtents, boundsExtents);
+    XMVECTOR bias = XMVectorSubtract(boundsCenter, boundsExtents);
+
+    switch (format) {
+    case MVF_PositionColor:
+        {
+            VertexPosColor* vertices = reinterpret_cast<VertexPosColor*>(cooked.Vertices.data());
+            ParallelFor(cooked.VertexCount, IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+                for (UINT i = begin; i < end; ++i) {
+                    const ImportVertex& source = mesh.Vertices[i];
+                    vertices[i].Position = source.Position;
+                    vertices[i].Color = XMFLOAT3(source.Color.x, source.Color.y, source.Color.z);
+                }
+            });
+            scale = XMVectorSplatOne();
+            bias = XMVectorZero();
+        }
+        break;
+    case MVF_CompactPositionColor:
+        EncodeCompactVertices(mesh, scale, bias, reinterpret_cast<VertexCompactPosColor*>(cooked.Vertices.data()));
+        break;
+    case MVF_CompactPositionNormalColor:
+        EncodeCompactVertices(mesh, scale, bias, reinterpret_cast<VertexCompactPosNormalColor*>(cooked.Vertices.data()));
+        break;
+    case MVF_CompactPositionNormalTexCoordColor:
+        EncodeCompactVertices(mesh, scale, bias, reinterpret_cast<VertexCompactPosNormalTexColor*>(cooked.Vertices.data()));
+        break;
+    default:
+        assert(false);
+        break;
+    }
+
+    XMStoreFloat3(&cooked.PositionScale, scale);
+    XMStoreFloat3(&cooked.PositionBias, bias);
+
+    cooked.IndexLayout = indexLayout;
+    cooked.IndexSize = indexLayout == MIL_Index32 ? sizeof(uint32_t) : sizeof(uint16_t);
+    cooked.IndexCount = static_cast<UINT>(mesh.Indices.size());
+    cooked.Indices.resize(static_cast<size_t>(cooked.IndexSize) * cooked.IndexCount);
+    if (indexLayout == MIL_Index32) {
+        if (cooked.IndexCount > 0) {
+            memcpy(cooked.Indices.data(), mesh.Indices.data(), cooked.Indices.size());
+        }
+    }
+    else {
+        uint16_t* indices = reinterpret_cast<uint16_t*>(cooked.Indices.data());
+        ParallelFor(cooked.IndexCount, IMPORT_VERTEX_BATCH, [&](UINT begin, UINT end) {
+            for (UINT i = begin; i < end; ++i) {
+                indices[i] = static_cast<uint16_t>(mesh.Indices[i]);
+            }
+        });
+    }
+
+    cooked.Bounds = mesh.Bounds;
+}
+
+MeshSource GetCookedMeshSource(const CookedMesh& cooked) {
+    MeshSource source;
+    source.VertexFormat = cooked.VertexFormat;
+    source.VertexStride = cooked.VertexStride;
+    source.VertexCount = cooked.VertexCount;
+    source.Vertices = cooked.Vertices.data();
+    source.IndexSize = cooked.IndexSize;
+    source.IndexCount = cooked.IndexCount;
+    source.Indices = cooked.Indices.data();
+    source.SubmeshCount = static_cast<UINT>(cooked.Submeshes.size());
+    source.Submeshes = cooked.Submeshes.data();
+    source.Bounds = cooked.Bounds;
+    source.PositionScale = cooked.PositionScale;
+    source.PositionBias = cooked.PositionBias;
+    return source;
+}
+
+void GetMeshMemoryReport(const ImportedMesh& mesh, const CookedMesh& cooked, MeshMemoryReport& report) {
+    UINT fullVertexSize = sizeof(XMFLOAT3) * 2;
+    fullVertexSize += (mesh.Attributes & IA_Normal) ? sizeof(XMFLOAT3) : 0;
+    fullVertexSize += (mesh.Attributes & IA_TexCoord) ? sizeof(XMFLOAT2) : 0;
+
+    report.VertexCount = cooked.VertexCount;
+    report.IndexCount = cooked.IndexCount;
+    report.IndexLayout = cooked.IndexLayout;
+    report.SubmeshCount = static_cast<UINT>(cooked.Submeshes.size());
+    report.FullVertexBytes = static_cast<uint64_t>(fullVertexSize) * mesh.Vertices.size();
+    report.FullIndexBytes = sizeof(uint32_t) * static_cast<uint64_t>(mesh.Indices.size());
+    report.VertexBytes = cooked.Vertices.size();
+    report.IndexBytes = cooked.Indices.size();
+}
+
+void PrintMeshMemoryReport(FILE* file, const char* name, const MeshMemoryReport& report) {
+    const double megabyte = 1024.0 * 1024.0;
+    uint64_t fullBytes = report.FullVertexBytes + report.FullIndexBytes;
+    uint64_t bytes = report.VertexBytes + report.IndexBytes;
+
+    static const char* indexLayoutNames[] = { "16-bit", "32-bit", "split 16-bit" };
+    fprintf(file, "%s: %u vertices, %u indices, %u submeshes (%s indices)\n", name, report.VertexCount, report.IndexCount,
+        report.SubmeshCount, indexLayoutNames[report.IndexLayout]);
+    fprintf(file, "  vertices %8.2f MB -> %8.2f MB (%.2fx)\n", report.FullVertexBytes / megabyte, report.VertexBytes / megabyte,
+        report.VertexBytes ? static_cast<double>(report.FullVertexBytes) / report.VertexBytes : 0.0);
+    fprintf(file, "  indices  %8.2f MB -> %8.2f MB (%.2fx)\n", report.FullIndexBytes / megabyte, report.IndexBytes / megabyte,
+        report.IndexBytes ? static_cast<double>(report.FullIndexBytes) / report.IndexBytes : 0.0);
+    fprintf(file, "  total    %8.2f MB -> %8.2f MB (%.2fx)\n", fullBytes / megabyte, bytes / megabyte,
+        bytes ? static_cast<double>(fullBytes) / bytes : 0.0);
+}
+
+bool CookMeshFile(const wchar_t* sourcePath, const wchar_t* outputPath, ImportStats* stats, MeshMemoryReport* report, MeshOptimizeStats* optimizeStats) {
+    ImportedMesh mesh;
+    if (!ImportMesh(sourcePath, mesh, stats)) {
+        return false;
+    }
+    OptimizeImportedMesh(mesh, optimizeStats);
+
+    CookedMesh cooked;
+    MeshVertexFormat format = ChooseVertexFormat(mesh);
+    CookImportedMesh(mesh, format, ChooseIndexLayout(mesh, format), cooked);
+    if (report) {
+        GetMeshMemoryReport(mesh, cooked, *report);
+    }
+
+    MeshSource source = GetCookedMeshSource(cooked);
+    return WriteMeshFile(outputPath, &source, 1);
+}
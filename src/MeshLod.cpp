@@ -0,0 +1,472 @@
+#include "EchoEngineCore.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "JobSystem.h"
+using namespace DirectX;
+
+namespace {
+
+//Position plus weighted RGB.
+const UINT SIMPLIFY_DIMENSIONS = 6;
+const UINT QUADRIC_MATRIX_SIZE = SIMPLIFY_DIMENSIONS * (SIMPLIFY_DIMENSIONS + 1) / 2;
+const float SIMPLIFY_EPSILON = 1e-12f;
+const UINT SIMPLIFY_BATCH_SIZE = 4096;
+//A collapse may turn a triangle's normal by at most acos(this).
+const float SIMPLIFY_MIN_NORMAL_DOT = 0.25f;
+//Objects whose bounding sphere reaches closer than this to the eye always get full detail.
+const float LOD_MIN_DISTANCE = 1e-4f;
+
+//Symmetric matrix A (upper triangle, row by row), vector B and constant C of
+//Q(v) = v'Av + 2B'v + C, summed over triangles and weighted by their area.
+struct Quadric
+{
+    float A[QUADRIC_MATRIX_SIZE];
+    float B[SIMPLIFY_DIMENSIONS];
+    float C;
+    float Weight;
+};
+
+struct CollapseCandidate
+{
+    uint32_t Vertex;
+    uint32_t Target;
+    float Cost;
+};
+
+void AddQuadric(Quadric& quadric, const Quadric& other) {
+    for (UINT i = 0; i < QUADRIC_MATRIX_SIZE; ++i) {
+        quadric.A[i] += other.A[i];
+    }
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        quadric.B[i] += other.B[i];
+    }
+    quadric.C += other.C;
+    quadric.Weight += other.Weight;
+}
+
+float EvaluateQuadric(const Quadric& quadric, const float* v) {
+    float result = quadric.C;
+    UINT element = 0;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        result += 2.0f * quadric.B[i] * v[i];
+        result += quadric.A[element++] * v[i] * v[i];
+        for (UINT j = i + 1; j < SIMPLIFY_DIMENSIONS; ++j) {
+            result += 2.0f * quadric.A[element++] * v[i] * v[j];
+        }
+    }
+    return result;
+}
+
+//Squared distance to the plane of the triangle in the joint position and color space
+//(Garland and Heckbert 1998, section 3.1), scaled by weight.
+void AccumulateTriangleQuadric(Quadric& quadric, const float* p, const float* q, const float* r, float weight) {
+    float e1[SIMPLIFY_DIMENSIONS];
+    float e2[SIMPLIFY_DIMENSIONS];
+    float length1 = 0.0f;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        e1[i] = q[i] - p[i];
+        length1 += e1[i] * e1[i];
+    }
+    if (length1 <= SIMPLIFY_EPSILON) {
+        return;
+    }
+    length1 = sqrtf(length1);
+
+    float projection = 0.0f;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        e1[i] /= length1;
+        projection += (r[i] - p[i]) * e1[i];
+    }
+    float length2 = 0.0f;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        e2[i] = r[i] - p[i] - projection * e1[i];
+        length2 += e2[i] * e2[i];
+    }
+    if (length2 <= SIMPLIFY_EPSILON) {
+        return;
+    }
+    length2 = sqrtf(length2);
+
+    float pe1 = 0.0f;
+    float pe2 = 0.0f;
+    float pp = 0.0f;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        e2[i] /= length2;
+        pe1 += p[i] * e1[i];
+        pe2 += p[i] * e2[i];
+        pp += p[i] * p[i];
+    }
+
+    UINT element = 0;
+    for (UINT i = 0; i < SIMPLIFY_DIMENSIONS; ++i) {
+        for (UINT j = i; j < SIMPLIFY_DIMENSIONS; ++j) {
+            float identity = i == j ? 1.0f : 0.0f;
+            quadric.A[element++] += weight * (identity - e1[i] * e1[j] - e2[i] * e2[j]);
+        }
+        quadric.B[i] += weight * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+    }
+    quadric.C += weight * (pp - pe1 * pe1 - pe2 * pe2);
+    quadric.Weight += weight;
+}
+
+//Error of moving vertex onto target: both quadrics evaluated at the target, normalized to a squared distance.
+//targetErrors holds every vertex's own quadric evaluated at itself.
+float GetCollapseCost(const std::vector<Quadric>& quadrics, const std::vector<float>& attributes, const std::vector<float>& targetErrors, uint32_t vertex, uint32_t target) {
+    float error = EvaluateQuadric(quadrics[vertex], &attributes[target * SIMPLIFY_DIMENSIONS]) + targetErrors[target];
+    float weight = quadrics[vertex].Weight + quadrics[target].Weight;
+    return std::max<float>(error, 0.0f) / std::max<float>(weight, SIMPLIFY_EPSILON);
+}
+
+inline XMVECTOR LoadAttributePosition(const std::vector<float>& attributes, uint32_t vertex) {
+    return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&attributes[vertex * SIMPLIFY_DIMENSIONS]));
+}
+
+//Whether moving vertex onto target turns any of its remaining triangles too far, or over.
+bool CollapseFlipsTriangles(const std::vector<float>& attributes, const uint32_t* indices, const std::vector<UINT>& triangleOffsets,
+    const std::vector<UINT>& triangles, uint32_t vertex, uint32_t target) {
+    XMVECTOR targetPosition = LoadAttributePosition(attributes, target);
+    for (UINT i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; ++i) {
+        const uint32_t* triangle = indices + triangles[i] * 3;
+        if (triangle[0] == target || triangle[1] == target || triangle[2] == target) {
+            continue;
+        }
+
+        XMVECTOR corners[3];
+        XMVECTOR moved[3];
+        for (int k = 0; k < 3; ++k) {
+            corners[k] = LoadAttributePosition(attributes, triangle[k]);
+            moved[k] = triangle[k] == vertex ? targetPosition : corners[k];
+        }
+        XMVECTOR before = XMVector3Cross(XMVectorSubtract(corners[1], corners[0]), XMVectorSubtract(corners[2], corners[0]));
+        XMVECTOR after = XMVector3Cross(XMVectorSubtract(moved[1], moved[0]), XMVectorSubtract(moved[2], moved[0]));
+        float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+        if (XMVectorGetX(XMVector3Dot(before, after)) <= SIMPLIFY_MIN_NORMAL_DOT * lengths) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Vertices sharing a position with another vertex sit on an attribute seam, and vertices on an edge
+//used by a single triangle sit on an open border. Moving either would tear or shrink the surface.
+void FindLockedVertices(std::vector<BYTE>& locked, const uint32_t* indices, size_t indexCount, const std::vector<float>& attributes, UINT vertexCount) {
+    locked.assign(vertexCount, 0);
+
+    //Only referenced vertices matter; coarse levels address a small part of the vertex buffer.
+    std::vector<BYTE> used(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        used[indices[i]] = 1;
+    }
+    std::vector<uint32_t> order;
+    for (UINT i = 0; i < vertexCount; ++i) {
+        if (used[i]) {
+            order.push_back(i);
+        }
+    }
+    auto lessPosition = [&](uint32_t a, uint32_t b) {
+        const float* pa = &attributes[a * SIMPLIFY_DIMENSIONS];
+        const float* pb = &attributes[b * SIMPLIFY_DIMENSIONS];
+        return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+    };
+    std::sort(order.begin(), order.end(), lessPosition);
+
+    std::vector<uint32_t> canonical(vertexCount);
+    UINT usedCount = static_cast<UINT>(order.size());
+    for (UINT begin = 0; begin < usedCount;) {
+        UINT end = begin + 1;
+        while (end < usedCount && !lessPosition(order[begin], order[end])) {
+            ++end;
+        }
+        for (UINT i = begin; i < end; ++i) {
+            canonical[order[i]] = order[begin];
+            locked[order[i]] = end - begin > 1 ? 1 : 0;
+        }
+        begin = end;
+    }
+
+    //Outgoing edges per canonical vertex; an edge is on a border when its reverse does not exist.
+    std::vector<UINT> edgeOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        ++edgeOffsets[canonical[indices[i]] + 1];
+    }
+    for (UINT i = 0; i < vertexCount; ++i) {
+        edgeOffsets[i + 1] += edgeOffsets[i];
+    }
+    std::vector<uint32_t> edgeTargets(indexCount);
+    std::vector<UINT> edgeFill(edgeOffsets.begin(), edgeOffsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t from = canonical[indices[i + k]];
+            edgeTargets[edgeFill[from]++] = canonical[indices[i + (k + 1) % 3]];
+        }
+    }
+
+    std::vector<BYTE> border(vertexCount, 0);
+    for (UINT from = 0; from < vertexCount; ++from) {
+        for (UINT i = edgeOffsets[from]; i < edgeOffsets[from + 1]; ++i) {
+            uint32_t to = edgeTargets[i];
+            const uint32_t* reverseBegin = &edgeTargets[0] + edgeOffsets[to];
+            const uint32_t* reverseEnd = &edgeTargets[0] + edgeOffsets[to + 1];
+            if (std::find(reverseBegin, reverseEnd, from) == reverseEnd) {
+                border[from] = 1;
+                border[to] = 1;
+            }
+        }
+    }
+    for (UINT i = 0; i < vertexCount; ++i) {
+        locked[i] |= border[canonical[i]];
+    }
+}
+
+}
+
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const SimplifyVertices& vertices, size_t targetIndexCount, float* error) {
+    assert(destination != indices);
+    assert(indexCount % 3 == 0);
+
+    UINT vertexCount = vertices.Count;
+    std::copy(indices, indices + indexCount, destination);
+    if (error) {
+        *error = 0.0f;
+    }
+    if (indexCount <= targetIndexCount || vertexCount == 0) {
+        return indexCount;
+    }
+
+    //Work in a space where the mesh spans a unit cube, so ColorWeight does not depend on the mesh's size.
+    const BYTE* positionData = reinterpret_cast<const BYTE*>(vertices.Positions);
+    XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+    for (UINT i = 0; i < vertexCount; ++i) {
+        XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positionData + vertices.PositionStride * i));
+        minimum = XMVectorMin(minimum, position);
+        maximum = XMVectorMax(maximum, position);
+    }
+    XMFLOAT3 extents;
+    XMStoreFloat3(&extents, XMVectorSubtract(maximum, minimum));
+    float extent = std::max<float>(std::max<float>(extents.x, extents.y), extents.z);
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+    std::vector<float> attributes(static_cast<size_t>(vertexCount) * SIMPLIFY_DIMENSIONS, 0.0f);
+    const BYTE* colorData = reinterpret_cast<const BYTE*>(vertices.Colors);
+    for (UINT i = 0; i < vertexCount; ++i) {
+        float* v = &attributes[i * SIMPLIFY_DIMENSIONS];
+        XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positionData + vertices.PositionStride * i));
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(v), XMVectorScale(XMVectorSubtract(position, minimum), scale));
+        if (colorData) {
+            const XMFLOAT4& color = *reinterpret_cast<const XMFLOAT4*>(colorData + vertices.ColorStride * i);
+            v[3] = color.x * vertices.ColorWeight;
+            v[4] = color.y * vertices.ColorWeight;
+            v[5] = color.z * vertices.ColorWeight;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const float* p = &attributes[indices[i] * SIMPLIFY_DIMENSIONS];
+        const float* q = &attributes[indices[i + 1] * SIMPLIFY_DIMENSIONS];
+        const float* r = &attributes[indices[i + 2] * SIMPLIFY_DIMENSIONS];
+        XMVECTOR normal = XMVector3Cross(XMVectorSubtract(LoadAttributePosition(attributes, indices[i + 1]), LoadAttributePosition(attributes, indices[i])),
+            XMVectorSubtract(LoadAttributePosition(attributes, indices[i + 2]), LoadAttributePosition(attributes, indices[i])));
+        float area = 0.5f * XMVectorGetX(XMVector3Length(normal));
+
+        Quadric quadric;
+        memset(&quadric, 0, sizeof(Quadric));
+        AccumulateTriangleQuadric(quadric, p, q, r, area);
+        for (int k = 0; k < 3; ++k) {
+            AddQuadric(quadrics[indices[i + k]], quadric);
+        }
+    }
+
+    std::vector<BYTE> locked;
+    FindLockedVertices(locked, indices, indexCount, attributes, vertexCount);
+
+    std::vector<UINT> triangleOffsets(vertexCount + 1);
+    std::vector<UINT> triangles;
+    std::vector<float> targetErrors(vertexCount);
+    std::vector<CollapseCandidate> bestCollapses(vertexCount);
+    std::vector<CollapseCandidate> candidates;
+    std::vector<uint32_t> remap(vertexCount);
+    for (UINT i = 0; i < vertexCount; ++i) {
+        remap[i] = i;
+    }
+    std::vector<BYTE> touched(vertexCount);
+    std::vector<uint32_t> collapsed;
+    float maxCost = 0.0f;
+
+    //Each pass collapses the cheapest independent edges, then drops the triangles that became degenerate.
+    while (indexCount > targetIndexCount) {
+        UINT triangleCount = static_cast<UINT>(indexCount / 3);
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (size_t i = 0; i < indexCount; ++i) {
+            ++triangleOffsets[destination[i] + 1];
+        }
+        for (UINT i = 0; i < vertexCount; ++i) {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        triangles.resize(indexCount);
+        std::vector<UINT> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i) {
+            triangles[fill[destination[i]]++] = static_cast<UINT>(i / 3);
+        }
+
+        //Cheapest collapse of every free vertex onto one of its neighbors.
+        ParallelFor(vertexCount, SIMPLIFY_BATCH_SIZE, [&](UINT begin, UINT end) {
+            for (UINT vertex = begin; vertex < end; ++vertex) {
+                if (triangleOffsets[vertex] != triangleOffsets[vertex + 1]) {
+                    targetErrors[vertex] = EvaluateQuadric(quadrics[vertex], &attributes[vertex * SIMPLIFY_DIMENSIONS]);
+                }
+            }
+        });
+        ParallelFor(vertexCount, SIMPLIFY_BATCH_SIZE, [&](UINT begin, UINT end) {
+            for (UINT vertex = begin; vertex < end; ++vertex) {
+                CollapseCandidate& best = bestCollapses[vertex];
+                best.Vertex = vertex;
+                best.Target = vertex;
+                best.Cost = FLT_MAX;
+                if (locked[vertex]) {
+                    continue;
+                }
+                for (UINT i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; ++i) {
+                    const uint32_t* triangle = destination + triangles[i] * 3;
+                    for (int k = 0; k < 3; ++k) {
+                        if (triangle[k] == vertex) {
+                            continue;
+                        }
+                        float cost = GetCollapseCost(quadrics, attributes, targetErrors, vertex, triangle[k]);
+                        if (cost < best.Cost) {
+                            best.Target = triangle[k];
+                            best.Cost = cost;
+                        }
+                    }
+                }
+            }
+        });
+
+        candidates.clear();
+        for (const CollapseCandidate& collapse : bestCollapses) {
+            if (collapse.Target != collapse.Vertex) {
+                candidates.push_back(collapse);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const CollapseCandidate& a, const CollapseCandidate& b) {
+            return a.Cost < b.Cost;
+        });
+
+        //A collapse removes about two triangles; stop the pass before overshooting the target.
+        UINT collapseLimit = std::max<UINT>((triangleCount - static_cast<UINT>(targetIndexCount / 3) + 1) / 2, 1);
+        std::fill(touched.begin(), touched.end(), 0);
+        collapsed.clear();
+        for (const CollapseCandidate& candidate : candidates) {
+            if (collapsed.size() >= collapseLimit) {
+                break;
+            }
+            if (touched[candidate.Vertex] || touched[candidate.Target]) {
+                continue;
+            }
+            if (CollapseFlipsTriangles(attributes, destination, triangleOffsets, triangles, candidate.Vertex, candidate.Target)) {
+                continue;
+            }
+
+            //Freeze the neighborhood so the remaining collapses of this pass see unchanged triangles.
+            for (UINT i = triangleOffsets[candidate.Vertex]; i < triangleOffsets[candidate.Vertex + 1]; ++i) {
+                const uint32_t* triangle = destination + triangles[i] * 3;
+                touched[triangle[0]] = 1;
+                touched[triangle[1]] = 1;
+                touched[triangle[2]] = 1;
+            }
+            remap[candidate.Vertex] = candidate.Target;
+            AddQuadric(quadrics[candidate.Target], quadrics[candidate.Vertex]);
+            maxCost = std::max<float>(maxCost, candidate.Cost);
+            collapsed.push_back(candidate.Vertex);
+        }
+        if (collapsed.empty()) {
+            break;
+        }
+
+        size_t writeCount = 0;
+        for (size_t i = 0; i < indexCount; i += 3) {
+            uint32_t a = remap[destination[i]];
+            uint32_t b = remap[destination[i + 1]];
+            uint32_t c = remap[destination[i + 2]];
+            if (a != b && b != c && c != a) {
+                destination[writeCount++] = a;
+                destination[writeCount++] = b;
+                destination[writeCount++] = c;
+            }
+        }
+        indexCount = writeCount;
+        for (uint32_t vertex : collapsed) {
+            remap[vertex] = vertex;
+        }
+    }
+
+    if (error) {
+        *error = sqrtf(maxCost) / scale;
+    }
+    return indexCount;
+}
+
+void BuildMeshLods(std::vector<MeshLod>& lods, const uint32_t* indices, size_t indexCount, const SimplifyVertices& vertices) {
+    lods.clear();
+
+    MeshLod full;
+    full.Indices.assign(indices, indices + indexCount);
+    full.Error = 0.0f;
+    lods.push_back(std::move(full));
+
+    while (lods.size() < MESH_MAX_LODS) {
+        const std::vector<uint32_t>& previous = lods.back().Indices;
+        float previousError = lods.back().Error;
+        size_t targetIndexCount = static_cast<size_t>(previous.size() / 3 * MESH_LOD_REDUCTION) * 3;
+
+        MeshLod lod;
+        lod.Indices.resize(previous.size());
+        float error = 0.0f;
+        size_t lodIndexCount = SimplifyMesh(lod.Indices.data(), previous.data(), previous.size(), vertices, targetIndexCount, &error);
+        if (lodIndexCount == 0 || lodIndexCount > previous.size() * MESH_LOD_MIN_REDUCTION) {
+            break;
+        }
+
+        //Every level measures its error against the previous one, so the sum bounds the distance to the full mesh.
+        lod.Indices.resize(lodIndexCount);
+        lod.Error = previousError + error;
+        OptimizeVertexCache(lod.Indices.data(), lodIndexCount, vertices.Count);
+        lods.push_back(std::move(lod));
+    }
+}
+
+float GetLodProjectionScale(CXMMATRIX projection, float viewportHeight) {
+    //_22 is cot(fovY / 2): the projected height of one unit at distance 1, in half viewports.
+    return XMVectorGetY(projection.r[1]) * viewportHeight * 0.5f;
+}
+
+UINT SelectMeshLod(const float* lodErrors, UINT lodCount, FXMMATRIX world, const BoundingBox& worldBounds, FXMVECTOR eyePosition,
+    float projectionScale, float maxPixelError) {
+    //The largest axis scale of the world matrix turns mesh space errors into world units.
+    float scale = XMVectorGetX(XMVectorMax(XMVectorMax(XMVector3LengthSq(world.r[0]), XMVector3LengthSq(world.r[1])), XMVector3LengthSq(world.r[2])));
+    scale = sqrtf(scale);
+
+    //Project at the nearest point of the bounding sphere, where the error looks largest.
+    XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+    float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&worldBounds.Extents)));
+    float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eyePosition))) - radius;
+    if (distance <= LOD_MIN_DISTANCE) {
+        return 0;
+    }
+
+    float pixelsPerUnit = scale * projectionScale / distance;
+    UINT lod = 0;
+    while (lod + 1 < lodCount && lodErrors[lod + 1] * pixelsPerUnit <= maxPixelError) {
+        ++lod;
+    }
+    return lod;
+}
+
+float GetLodTriangleReductionPercent(const MeshLodStats& stats) {
+    if (stats.FullDetailTriangles == 0) {
+        return 0.0f;
+    }
+    return 100.0f * (stats.FullDetailTriangles - stats.LodTriangles) / stats.FullDetailTriangles;
+}
@@ -0,0 +1,381 @@
+#include "EchoEngineCore.h"
+#include "MeshOptimizer.h"
+using namespace DirectX;
+
+namespace {
+
+//Forsyth's scoring, tuned for an LRU cache of FORSYTH_CACHE_SIZE entries.
+const UINT FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+//Valences at or above this share the last table entry.
+const UINT FORSYTH_MAX_VALENCE = 32;
+
+struct VertexScoreTable
+{
+    float Cache[FORSYTH_CACHE_SIZE];
+    float Valence[FORSYTH_MAX_VALENCE];
+};
+
+VertexScoreTable BuildVertexScoreTable() {
+    VertexScoreTable table;
+    for (UINT i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+        //The vertices of the last triangle get a fixed score so the next triangle does not just reuse two of them.
+        if (i < 3) {
+            table.Cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+        }
+        else {
+            float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            table.Cache[i] = powf(1.0f - (i - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    //Vertices with few triangles left are boosted so they get finished off and leave no lone triangles behind.
+    table.Valence[0] = 0.0f;
+    for (UINT i = 1; i < FORSYTH_MAX_VALENCE; ++i) {
+        table.Valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+    }
+    return table;
+}
+
+const VertexScoreTable& GetVertexScoreTable() {
+    static const VertexScoreTable table = BuildVertexScoreTable();
+    return table;
+}
+
+inline float GetVertexScore(const VertexScoreTable& table, UINT cachePosition, UINT remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+    float score = cachePosition < FORSYTH_CACHE_SIZE ? table.Cache[cachePosition] : 0.0f;
+    return score + table.Valence[std::min<UINT>(remainingTriangles, FORSYTH_MAX_VALENCE - 1)];
+}
+
+//Triangles using each vertex; Counts shrink as triangles are emitted.
+struct TriangleAdjacency
+{
+    std::vector<UINT> Counts;
+    std::vector<UINT> Offsets;
+    std::vector<UINT> Triangles;
+};
+
+void BuildTriangleAdjacency(TriangleAdjacency& adjacency, const uint32_t* indices, size_t indexCount, UINT vertexCount) {
+    adjacency.Counts.assign(vertexCount, 0);
+    adjacency.Offsets.resize(vertexCount);
+    adjacency.Triangles.resize(indexCount);
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        ++adjacency.Counts[indices[i]];
+    }
+
+    UINT offset = 0;
+    for (UINT i = 0; i < vertexCount; ++i) {
+        adjacency.Offsets[i] = offset;
+        offset += adjacency.Counts[i];
+    }
+
+    std::vector<UINT> fill(adjacency.Offsets);
+    for (size_t i = 0; i < indexCount; ++i) {
+        adjacency.Triangles[fill[indices[i]]++] = static_cast<UINT>(i / 3);
+    }
+}
+
+//FIFO cache simulation: a vertex is cached while fewer than cacheSize misses happened since it was loaded.
+struct FifoCache
+{
+    std::vector<UINT> Timestamps;
+    UINT Timestamp;
+    UINT Size;
+};
+
+void InitFifoCache(FifoCache& cache, UINT vertexCount, UINT cacheSize) {
+    cache.Timestamps.assign(vertexCount, 0);
+    cache.Timestamp = cacheSize + 1;
+    cache.Size = cacheSize;
+}
+
+inline void FlushFifoCache(FifoCache& cache) {
+    cache.Timestamp += cache.Size + 1;
+}
+
+inline UINT SimulateFifoCache(FifoCache& cache, const uint32_t* triangle) {
+    UINT misses = 0;
+    for (int i = 0; i < 3; ++i) {
+        UINT& timestamp = cache.Timestamps[triangle[i]];
+        if (cache.Timestamp - timestamp > cache.Size) {
+            timestamp = cache.Timestamp++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+struct OverdrawCluster
+{
+    UINT FirstTriangle;
+    UINT TriangleCount;
+    float SortKey;
+};
+
+inline XMVECTOR LoadPosition(const BYTE* positions, size_t positionStride, uint32_t index) {
+    return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + positionStride * index));
+}
+
+}
+
+void AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, UINT vertexCount, UINT cacheSize, VertexCacheStats& stats) {
+    FifoCache cache;
+    InitFifoCache(cache, vertexCount, cacheSize);
+
+    size_t triangleCount = indexCount / 3;
+    UINT misses = 0;
+    for (size_t i = 0; i < triangleCount; ++i) {
+        misses += SimulateFifoCache(cache, indices + i * 3);
+    }
+
+    UINT usedVertices = 0;
+    for (UINT timestamp : cache.Timestamps) {
+        usedVertices += timestamp != 0 ? 1 : 0;
+    }
+
+    stats.TriangleCount = static_cast<UINT>(triangleCount);
+    stats.VertexCount = usedVertices;
+    stats.CacheMisses = misses;
+    stats.ACMR = triangleCount ? static_cast<float>(misses) / triangleCount : 0.0f;
+    stats.ATVR = usedVertices ? static_cast<float>(misses) / usedVertices : 0.0f;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, UINT vertexCount) {
+    UINT triangleCount = static_cast<UINT>(indexCount / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    const VertexScoreTable& table = GetVertexScoreTable();
+    std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+    TriangleAdjacency adjacency;
+    BuildTriangleAdjacency(adjacency, source.data(), source.size(), vertexCount);
+
+    std::vector<float> vertexScores(vertexCount);
+    for (UINT i = 0; i < vertexCount; ++i) {
+        vertexScores[i] = GetVertexScore(table, FORSYTH_CACHE_SIZE, adjacency.Counts[i]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    UINT bestTriangle = 0;
+    for (UINT i = 0; i < triangleCount; ++i) {
+        const uint32_t* triangle = &source[i * 3];
+        triangleScores[i] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        if (triangleScores[i] > triangleScores[bestTriangle]) {
+            bestTriangle = i;
+        }
+    }
+
+    std::vector<BYTE> emitted(triangleCount, 0);
+    UINT cache[FORSYTH_CACHE_SIZE + 3];
+    UINT cacheCount = 0;
+    UINT nextInputTriangle = 0;
+
+    for (UINT outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle) {
+        if (bestTriangle == MESH_OPTIMIZER_INVALID_INDEX) {
+            //Dead end: no cached vertex has triangles left, carry on with the next triangle in input order.
+            while (emitted[nextInputTriangle]) {
+                ++nextInputTriangle;
+            }
+            bestTriangle = nextInputTriangle;
+        }
+
+        const uint32_t* triangle = &source[bestTriangle * 3];
+        indices[outputTriangle * 3 + 0] = triangle[0];
+        indices[outputTriangle * 3 + 1] = triangle[1];
+        indices[outputTriangle * 3 + 2] = triangle[2];
+        emitted[bestTriangle] = 1;
+
+        //Drop the triangle from the lists of its vertices.
+        for (int i = 0; i < 3; ++i) {
+            UINT* triangles = &adjacency.Triangles[adjacency.Offsets[triangle[i]]];
+            UINT& count = adjacency.Counts[triangle[i]];
+            for (UINT j = 0; j < count; ++j) {
+                if (triangles[j] == bestTriangle) {
+                    triangles[j] = triangles[count - 1];
+                    break;
+                }
+            }
+            --count;
+        }
+
+        //The triangle's vertices move to the front of the LRU cache.
+        UINT newCache[FORSYTH_CACHE_SIZE + 3];
+        UINT newCacheCount = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (i == 0 || (triangle[i] != triangle[0] && (i == 1 || triangle[i] != triangle[1]))) {
+                newCache[newCacheCount++] = triangle[i];
+            }
+        }
+        for (UINT i = 0; i < cacheCount; ++i) {
+            UINT vertex = cache[i];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                newCache[newCacheCount++] = vertex;
+            }
+        }
+
+        //Rescore every vertex that moved, including the ones pushed out of the cache.
+        for (UINT i = 0; i < newCacheCount; ++i) {
+            UINT vertex = newCache[i];
+            float score = GetVertexScore(table, i, adjacency.Counts[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const UINT* triangles = &adjacency.Triangles[adjacency.Offsets[vertex]];
+            for (UINT j = 0; j < adjacency.Counts[vertex]; ++j) {
+                triangleScores[triangles[j]] += delta;
+            }
+        }
+
+        //The next triangle is the best one touching the cache.
+        cacheCount = std::min<UINT>(newCacheCount, FORSYTH_CACHE_SIZE);
+        bestTriangle = MESH_OPTIMIZER_INVALID_INDEX;
+        float bestScore = -FLT_MAX;
+        for (UINT i = 0; i < cacheCount; ++i) {
+            UINT vertex = newCache[i];
+            cache[i] = vertex;
+
+            const UINT* triangles = &adjacency.Triangles[adjacency.Offsets[vertex]];
+            for (UINT j = 0; j < adjacency.Counts[vertex]; ++j) {
+                if (triangleScores[triangles[j]] > bestScore) {
+                    bestScore = triangleScores[triangles[j]];
+                    bestTriangle = triangles[j];
+                }
+            }
+        }
+    }
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const XMFLOAT3* positions, size_t positionStride, UINT vertexCount, float threshold) {
+    UINT triangleCount = static_cast<UINT>(indexCount / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    FifoCache cache;
+    InitFifoCache(cache, vertexCount, VERTEX_CACHE_SIZE);
+
+    //Hard boundaries: a triangle missing on all three vertices starts over with a cold cache, so
+    //the vertex cache order is not tied to what came before it.
+    std::vector<UINT> hardBoundaries;
+    for (UINT i = 0; i < triangleCount; ++i) {
+        if (SimulateFifoCache(cache, indices + i * 3) == 3 || i == 0) {
+            hardBoundaries.push_back(i);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    //Soft boundaries: split a hard cluster as soon as the part since the last split has a miss
+    //ratio within threshold of the whole cluster's.
+    std::vector<OverdrawCluster> clusters;
+    for (size_t i = 0; i + 1 < hardBoundaries.size(); ++i) {
+        UINT begin = hardBoundaries[i];
+        UINT end = hardBoundaries[i + 1];
+
+        FlushFifoCache(cache);
+        UINT clusterMisses = 0;
+        for (UINT j = begin; j < end; ++j) {
+            clusterMisses += SimulateFifoCache(cache, indices + j * 3);
+        }
+        float targetRatio = threshold * clusterMisses / (end - begin);
+
+        FlushFifoCache(cache);
+        UINT splitBegin = begin;
+        UINT misses = 0;
+        for (UINT j = begin; j < end; ++j) {
+            misses += SimulateFifoCache(cache, indices + j * 3);
+            if (j + 1 == end || misses <= targetRatio * (j + 1 - splitBegin)) {
+                OverdrawCluster cluster = { splitBegin, j + 1 - splitBegin, 0.0f };
+                clusters.push_back(cluster);
+                FlushFifoCache(cache);
+                splitBegin = j + 1;
+                misses = 0;
+            }
+        }
+    }
+
+    //Area weighted centroid and normal of every cluster and of the whole mesh.
+    const BYTE* positionData = reinterpret_cast<const BYTE*>(positions);
+    std::vector<XMFLOAT4> clusterCentroids(clusters.size());
+    std::vector<XMFLOAT3> clusterNormals(clusters.size());
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        const OverdrawCluster& cluster = clusters[i];
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+
+        for (UINT j = cluster.FirstTriangle; j < cluster.FirstTriangle + cluster.TriangleCount; ++j) {
+            XMVECTOR p0 = LoadPosition(positionData, positionStride, indices[j * 3 + 0]);
+            XMVECTOR p1 = LoadPosition(positionData, positionStride, indices[j * 3 + 1]);
+            XMVECTOR p2 = LoadPosition(positionData, positionStride, indices[j * 3 + 2]);
+
+            //Clockwise front faces: this cross product points out of the front face.
+            XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            float triangleArea = XMVectorGetX(XMVector3Length(cross));
+            centroid = XMVectorMultiplyAdd(XMVectorAdd(XMVectorAdd(p0, p1), p2), XMVectorReplicate(triangleArea / 3.0f), centroid);
+            normal = XMVectorAdd(normal, cross);
+            area += triangleArea;
+        }
+
+        XMStoreFloat4(&clusterCentroids[i], XMVectorSetW(centroid, area));
+        XMStoreFloat3(&clusterNormals[i], normal);
+        meshCentroid = XMVectorAdd(meshCentroid, centroid);
+        meshArea += area;
+    }
+    meshCentroid = meshArea > 0.0f ? XMVectorScale(meshCentroid, 1.0f / meshArea) : meshCentroid;
+
+    //Clusters facing away from the center draw first; they are the most likely to occlude the rest.
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        float area = clusterCentroids[i].w;
+        XMVECTOR normal = XMLoadFloat3(&clusterNormals[i]);
+        if (area <= 0.0f || XMVector3Equal(normal, XMVectorZero())) {
+            continue;
+        }
+        XMVECTOR centroid = XMVectorScale(XMLoadFloat4(&clusterCentroids[i]), 1.0f / area);
+        clusters[i].SortKey = XMVectorGetX(XMVector3Dot(XMVectorSubtract(centroid, meshCentroid), XMVector3Normalize(normal)));
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster& a, const OverdrawCluster& b) {
+        return a.SortKey > b.SortKey;
+    });
+
+    std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+    uint32_t* output = indices;
+    for (const OverdrawCluster& cluster : clusters) {
+        size_t clusterIndexCount = static_cast<size_t>(cluster.TriangleCount) * 3;
+        memcpy(output, &source[static_cast<size_t>(cluster.FirstTriangle) * 3], clusterIndexCount * sizeof(uint32_t));
+        output += clusterIndexCount;
+    }
+}
+
+UINT OptimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, UINT vertexCount, uint32_t* remap) {
+    std::fill(remap, remap + vertexCount, MESH_OPTIMIZER_INVALID_INDEX);
+
+    UINT usedVertices = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t& index = indices[i];
+        if (remap[index] == MESH_OPTIMIZER_INVALID_INDEX) {
+            remap[index] = usedVertices++;
+        }
+        index = remap[index];
+    }
+    return usedVertices;
+}
+
+void PrintMeshOptimizeStats(FILE* file, const char* name, const MeshOptimizeStats& stats) {
+    fprintf(file, "%s: %u triangles, %u vertices\n", name, stats.After.TriangleCount, stats.After.VertexCount);
+    fprintf(file, "  ACMR %6.3f -> %6.3f\n", stats.Before.ACMR, stats.After.ACMR);
+    fprintf(file, "  ATVR %6.3f -> %6.3f (%u entry FIFO)\n", stats.Before.ATVR, stats.After.ATVR, VERTEX_CACHE_SIZE);
+    fprintf(file, "  vertex cache %.2f ms, overdraw %.2f ms, vertex fetch %.2f ms\n", stats.VertexCacheTimeMs, stats.OverdrawTimeMs, stats.VertexFetchTimeMs);
+}
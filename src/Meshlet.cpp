@@ -0,0 +1,208 @@
+#include "EchoEngineCore.h"
+#include "Meshlet.h"
+#include "MeshFile.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+using namespace DirectX;
+
+namespace {
+
+const UINT MESHLET_INVALID_INDEX = 0xFFFFFFFF;
+const UINT MESHLET_BATCH_SIZE = 256;
+//Clusters whose normals spread further than acos(this) from their axis never pass the cone test.
+const float MESHLET_MIN_CONE_DOT = 0.1f;
+
+void ComputeMeshletBounds(const MeshletMesh& meshlets, Meshlet& meshlet, const BYTE* positions, size_t positionStride) {
+    XMFLOAT3 points[MESHLET_MAX_VERTICES];
+    for (UINT i = 0; i < meshlet.VertexCount; ++i) {
+        points[i] = *reinterpret_cast<const XMFLOAT3*>(positions + positionStride * meshlets.Vertices[meshlet.VertexOffset + i]);
+    }
+
+    BoundingSphere sphere;
+    BoundingSphere::CreateFromPoints(sphere, meshlet.VertexCount, points, sizeof(XMFLOAT3));
+    meshlet.Center = sphere.Center;
+    meshlet.Radius = sphere.Radius;
+
+    //Clockwise front faces: cross(p1 - p0, p2 - p0) points out of the front face.
+    XMVECTOR normals[MESHLET_MAX_TRIANGLES];
+    UINT normalCount = 0;
+    XMVECTOR axis = XMVectorZero();
+    const BYTE* triangle = &meshlets.Triangles[meshlet.TriangleOffset];
+    for (UINT i = 0; i < meshlet.TriangleCount; ++i, triangle += 3) {
+        XMVECTOR p0 = XMLoadFloat3(&points[triangle[0]]);
+        XMVECTOR p1 = XMLoadFloat3(&points[triangle[1]]);
+        XMVECTOR p2 = XMLoadFloat3(&points[triangle[2]]);
+        XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+        if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f) {
+            normal = XMVector3Normalize(normal);
+            normals[normalCount++] = normal;
+            axis = XMVectorAdd(axis, normal);
+        }
+    }
+
+    meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    meshlet.ConeCutoff = 1.0f;
+    if (normalCount == 0 || XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f) {
+        return;
+    }
+
+    axis = XMVector3Normalize(axis);
+    float minDot = 1.0f;
+    for (UINT i = 0; i < normalCount; ++i) {
+        minDot = std::min<float>(minDot, XMVectorGetX(XMVector3Dot(normals[i], axis)));
+    }
+    if (minDot <= MESHLET_MIN_CONE_DOT) {
+        return;
+    }
+
+    //The normal cone has half angle acos(minDot). The cluster is back facing from every direction
+    //within 90 degrees minus that angle of the axis, whose cosine is sin(acos(minDot)).
+    XMStoreFloat3(&meshlet.ConeAxis, axis);
+    meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+template<typename Index>
+void WriteIndices(const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, Index* indices) {
+    std::vector<UINT> offsets(visibleCount);
+    UINT offset = 0;
+    for (UINT i = 0; i < visibleCount; ++i) {
+        offsets[i] = offset;
+        offset += meshlets.Meshlets[visibleMeshlets[i]].TriangleCount * 3;
+    }
+
+    ParallelFor(visibleCount, MESHLET_BATCH_SIZE, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            const Meshlet& meshlet = meshlets.Meshlets[visibleMeshlets[i]];
+            const uint32_t* vertices = &meshlets.Vertices[meshlet.VertexOffset];
+            const BYTE* triangles = &meshlets.Triangles[meshlet.TriangleOffset];
+            Index* output = indices + offsets[i];
+            for (UINT j = 0; j < meshlet.TriangleCount * 3; ++j) {
+                output[j] = static_cast<Index>(vertices[triangles[j]]);
+            }
+        }
+    });
+}
+
+}
+
+void BuildMeshlets(MeshletMesh& meshlets, const uint32_t* indices, size_t indexCount, const XMFLOAT3* positions, size_t positionStride, UINT vertexCount) {
+    meshlets.Meshlets.clear();
+    meshlets.Vertices.clear();
+    meshlets.Triangles.clear();
+    meshlets.Lods.clear();
+    meshlets.MeshVertexCount = vertexCount;
+    AddMeshletLod(meshlets, indices, indexCount, positions, positionStride);
+}
+
+void AddMeshletLod(MeshletMesh& meshlets, const uint32_t* indices, size_t indexCount, const XMFLOAT3* positions, size_t positionStride) {
+    MeshletLod lod;
+    lod.FirstMeshlet = static_cast<UINT>(meshlets.Meshlets.size());
+    lod.TriangleCount = static_cast<UINT>(indexCount / 3);
+
+    //Local index of every mesh vertex, valid when its stamp matches the current meshlet.
+    std::vector<UINT> meshletStamps(meshlets.MeshVertexCount, MESHLET_INVALID_INDEX);
+    std::vector<BYTE> localIndices(meshlets.MeshVertexCount);
+
+    Meshlet meshlet = {};
+    meshlet.VertexOffset = static_cast<UINT>(meshlets.Vertices.size());
+    meshlet.TriangleOffset = static_cast<UINT>(meshlets.Triangles.size());
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const uint32_t* triangle = indices + i;
+        UINT stamp = static_cast<UINT>(meshlets.Meshlets.size());
+        UINT newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            newVertices += meshletStamps[triangle[k]] != stamp && !repeated ? 1 : 0;
+        }
+
+        if (meshlet.VertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.TriangleCount == MESHLET_MAX_TRIANGLES) {
+            meshlets.Meshlets.push_back(meshlet);
+            meshlet.VertexOffset = static_cast<UINT>(meshlets.Vertices.size());
+            meshlet.TriangleOffset = static_cast<UINT>(meshlets.Triangles.size());
+            meshlet.VertexCount = 0;
+            meshlet.TriangleCount = 0;
+            ++stamp;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            uint32_t vertex = triangle[k];
+            if (meshletStamps[vertex] != stamp) {
+                meshletStamps[vertex] = stamp;
+                localIndices[vertex] = static_cast<BYTE>(meshlet.VertexCount++);
+                meshlets.Vertices.push_back(vertex);
+            }
+            meshlets.Triangles.push_back(localIndices[vertex]);
+        }
+        ++meshlet.TriangleCount;
+    }
+    if (meshlet.TriangleCount > 0) {
+        meshlets.Meshlets.push_back(meshlet);
+    }
+    lod.MeshletCount = static_cast<UINT>(meshlets.Meshlets.size()) - lod.FirstMeshlet;
+    meshlets.Lods.push_back(lod);
+
+    const BYTE* positionData = reinterpret_cast<const BYTE*>(positions);
+    ParallelFor(lod.MeshletCount, MESHLET_BATCH_SIZE, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            ComputeMeshletBounds(meshlets, meshlets.Meshlets[lod.FirstMeshlet + i], positionData, positionStride);
+        }
+    });
+}
+
+UINT CullMeshlets(const MeshletMesh& meshlets, UINT lod, FXMMATRIX world, CXMMATRIX viewProjection, FXMVECTOR eyePosition, std::vector<UINT>& visibleMeshlets, MeshletCullStats& stats) {
+    assert(lod < meshlets.Lods.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //Test in mesh space: the frustum planes come from world * viewProjection and the eye is moved
+    //by the inverse world matrix. Both tests are exact under any world matrix that keeps the winding.
+    Frustum frustum;
+    ExtractFrustum(frustum, XMMatrixMultiply(world, viewProjection));
+    XMVECTOR eye = XMVector3TransformCoord(eyePosition, XMMatrixInverse(nullptr, world));
+
+    UINT indexCount = 0;
+    UINT visibleCount = 0;
+    const MeshletLod& range = meshlets.Lods[lod];
+    for (UINT i = range.FirstMeshlet; i < range.FirstMeshlet + range.MeshletCount; ++i) {
+        const Meshlet& meshlet = meshlets.Meshlets[i];
+        if (TestFrustumSphere(frustum, BoundingSphere(meshlet.Center, meshlet.Radius)) == DISJOINT) {
+            ++stats.FrustumCulled;
+            continue;
+        }
+
+        XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&meshlet.Center), eye);
+        float distance = XMVectorGetX(XMVector3Length(toCenter));
+        if (XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&meshlet.ConeAxis))) >= meshlet.ConeCutoff * distance + meshlet.Radius) {
+            ++stats.BackfaceCulled;
+            continue;
+        }
+
+        visibleMeshlets.push_back(i);
+        indexCount += meshlet.TriangleCount * 3;
+        ++visibleCount;
+    }
+
+    stats.MeshletsTested += range.MeshletCount;
+    stats.MeshletsVisible += visibleCount;
+    stats.TrianglesTested += range.TriangleCount;
+    stats.TrianglesVisible += indexCount / 3;
+    stats.CullTimeMs += ElapsedMs(start);
+    return indexCount;
+}
+
+void WriteMeshletIndices(const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, UINT indexSize, void* indices) {
+    if (indexSize == sizeof(uint32_t)) {
+        WriteIndices(meshlets, visibleMeshlets, visibleCount, static_cast<uint32_t*>(indices));
+    }
+    else {
+        assert(meshlets.MeshVertexCount <= MESH_INDEX16_VERTEX_LIMIT);
+        WriteIndices(meshlets, visibleMeshlets, visibleCount, static_cast<uint16_t*>(indices));
+    }
+}
+
+float GetMeshletCulledTrianglePercent(const MeshletCullStats& stats) {
+    if (stats.TrianglesTested == 0) {
+        return 0.0f;
+    }
+    return 100.0f * (stats.TrianglesTested - stats.TrianglesVisible) / stats.TrianglesTested;
+}
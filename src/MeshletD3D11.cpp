@@ -0,0 +1,71 @@
+#include "EchoEnginePCH.h"
+#include "MeshletD3D11.h"
+#include "MeshFile.h"
+#include "Profiler.h"
+#include "RenderCountersD3D11.h"
+
+namespace {
+
+//Smallest index stream allocation, in indices.
+const UINT MESHLET_STREAM_MIN_INDICES = 4096;
+
+}
+
+bool UpdateMeshletIndexStream(ID3D11Device* device, ID3D11DeviceContext* deviceContext, MeshletIndexStream& stream, const MeshletMesh& meshlets,
+    const UINT* visibleMeshlets, UINT visibleCount, MeshletCullStats& stats) {
+    PROFILE_ZONE("UpdateMeshletIndexStream");
+    assert(device);
+    assert(deviceContext);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    UINT indexCount = 0;
+    for (UINT i = 0; i < visibleCount; ++i) {
+        indexCount += meshlets.Meshlets[visibleMeshlets[i]].TriangleCount * 3;
+    }
+    if (indexCount == 0) {
+        return true;
+    }
+
+    UINT indexSize = meshlets.MeshVertexCount > MESH_INDEX16_VERTEX_LIMIT ? sizeof(uint32_t) : sizeof(uint16_t);
+    if (!stream.IndexBuffer || stream.Capacity < indexCount || stream.IndexSize != indexSize) {
+        ReleaseMeshletIndexStream(stream);
+
+        //Leave headroom so a slowly growing view does not reallocate every frame.
+        UINT capacity = std::max<UINT>(indexCount + indexCount / 2, MESHLET_STREAM_MIN_INDICES);
+
+        D3D11_BUFFER_DESC indexBufferDesc;
+        ZeroMemory(&indexBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+        indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        indexBufferDesc.ByteWidth = capacity * indexSize;
+        indexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        indexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+        HRESULT hr = DeviceCreateBuffer(device, &indexBufferDesc, nullptr, &stream.IndexBuffer);
+        if (FAILED(hr)) {
+            return false;
+        }
+        stream.Capacity = capacity;
+        stream.IndexSize = indexSize;
+        stream.IndexFormat = indexSize == sizeof(uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = ContextMap(deviceContext, stream.IndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(hr)) {
+        return false;
+    }
+    WriteMeshletIndices(meshlets, visibleMeshlets, visibleCount, stream.IndexSize, mappedResource.pData);
+    ContextUnmap(deviceContext, stream.IndexBuffer, 0, static_cast<uint64_t>(indexCount) * stream.IndexSize);
+
+    stats.WriteTimeMs += ElapsedMs(start);
+    return true;
+}
+
+void ReleaseMeshletIndexStream(MeshletIndexStream& stream) {
+    SafeRelease(stream.IndexBuffer);
+    stream.Capacity = 0;
+    stream.IndexSize = 0;
+    stream.IndexFormat = DXGI_FORMAT_UNKNOWN;
+}
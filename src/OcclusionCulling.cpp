@@ -0,0 +1,310 @@
+#include "EchoEngineCore.h"
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+using namespace DirectX;
+
+namespace {
+
+//Triangle prepared for rasterization: edge functions and depth plane in pixel space.
+struct ScreenTriangle
+{
+    int MinX, MinY, MaxX, MaxY;
+    float EdgeA[3], EdgeB[3], EdgeC[3];
+    float DepthA, DepthB, DepthC;
+};
+
+//Vertices closer than this (or behind the eye) make a triangle unusable as an occluder.
+const float OCCLUSION_MIN_W = 1e-4f;
+
+inline UINT GetOccluderIndex(const Occluder& occluder, UINT i) {
+    if (occluder.IndexSize == 4) {
+        return static_cast<const uint32_t*>(occluder.Indices)[i];
+    }
+    return static_cast<const WORD*>(occluder.Indices)[i];
+}
+
+void SetupTriangles(const OcclusionBuffer& buffer, const Occluder& occluder, FXMMATRIX viewProjection, std::vector<XMFLOAT4>& clipPositions, std::vector<ScreenTriangle>& triangles) {
+    XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&occluder.WorldMatrix), viewProjection);
+
+    clipPositions.resize(occluder.VertexCount);
+    const BYTE* position = reinterpret_cast<const BYTE*>(occluder.Positions);
+    for (UINT i = 0; i < occluder.VertexCount; ++i, position += occluder.PositionStride) {
+        XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(position));
+        XMStoreFloat4(&clipPositions[i], XMVector3Transform(p, worldViewProjection));
+    }
+
+    float width = static_cast<float>(buffer.Width);
+    float height = static_cast<float>(buffer.Height);
+
+    triangles.clear();
+    for (UINT i = 0; i + 2 < occluder.IndexCount; i += 3) {
+        XMFLOAT3 v[3];
+        bool clipped = false;
+        for (int k = 0; k < 3; ++k) {
+            const XMFLOAT4& c = clipPositions[GetOccluderIndex(occluder, i + k)];
+            if (c.w < OCCLUSION_MIN_W || c.z < 0.0f) {
+                clipped = true;
+                break;
+            }
+            float invW = 1.0f / c.w;
+            v[k].x = (c.x * invW * 0.5f + 0.5f) * width;
+            v[k].y = (0.5f - c.y * invW * 0.5f) * height;
+            v[k].z = c.z * invW;
+        }
+        //Dropping a near clipped occluder triangle only makes the test more conservative.
+        if (clipped) {
+            continue;
+        }
+
+        //Clockwise triangles are front facing (D3D11_CULL_BACK with FrontCounterClockwise = FALSE).
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (area <= 0.0f) {
+            continue;
+        }
+
+        ScreenTriangle tri;
+        float minX = std::min<float>(v[0].x, std::min<float>(v[1].x, v[2].x));
+        float maxX = std::max<float>(v[0].x, std::max<float>(v[1].x, v[2].x));
+        float minY = std::min<float>(v[0].y, std::min<float>(v[1].y, v[2].y));
+        float maxY = std::max<float>(v[0].y, std::max<float>(v[1].y, v[2].y));
+
+        //Pixels are covered when their center is inside the triangle.
+        tri.MinX = std::max<int>(0, static_cast<int>(ceilf(minX - 0.5f)));
+        tri.MaxX = std::min<int>(buffer.Width - 1, static_cast<int>(floorf(maxX - 0.5f)));
+        tri.MinY = std::max<int>(0, static_cast<int>(ceilf(minY - 0.5f)));
+        tri.MaxY = std::min<int>(buffer.Height - 1, static_cast<int>(floorf(maxY - 0.5f)));
+        if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY) {
+            continue;
+        }
+
+        //Edge k is opposite vertex k, so it doubles as that vertex's barycentric weight.
+        for (int k = 0; k < 3; ++k) {
+            const XMFLOAT3& a = v[(k + 1) % 3];
+            const XMFLOAT3& b = v[(k + 2) % 3];
+            tri.EdgeA[k] = a.y - b.y;
+            tri.EdgeB[k] = b.x - a.x;
+            tri.EdgeC[k] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+        }
+
+        float invArea = 1.0f / area;
+        tri.DepthA = (v[0].z * tri.EdgeA[0] + v[1].z * tri.EdgeA[1] + v[2].z * tri.EdgeA[2]) * invArea;
+        tri.DepthB = (v[0].z * tri.EdgeB[0] + v[1].z * tri.EdgeB[1] + v[2].z * tri.EdgeB[2]) * invArea;
+        tri.DepthC = (v[0].z * tri.EdgeC[0] + v[1].z * tri.EdgeC[1] + v[2].z * tri.EdgeC[2]) * invArea;
+
+        triangles.push_back(tri);
+    }
+}
+
+//Rasterize every triangle into rows [rowBegin, rowEnd), four pixels at a time.
+void RasterizeBand(OcclusionBuffer& buffer, const std::vector<std::vector<ScreenTriangle>>& triangles, int rowBegin, int rowEnd) {
+    XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+    XMVECTOR zero = XMVectorZero();
+
+    for (const std::vector<ScreenTriangle>& occluderTriangles : triangles) {
+        for (const ScreenTriangle& tri : occluderTriangles) {
+            int y0 = std::max<int>(tri.MinY, rowBegin);
+            int y1 = std::min<int>(tri.MaxY, rowEnd - 1);
+            if (y0 > y1) {
+                continue;
+            }
+
+            //Start on a 4 pixel boundary; lanes left of the triangle fail the edge tests.
+            int x0 = tri.MinX & ~3;
+            XMVECTOR startX = XMVectorAdd(XMVectorReplicate(static_cast<float>(x0)), laneOffsets);
+
+            XMVECTOR edgeA[3], edgeStep[3];
+            for (int k = 0; k < 3; ++k) {
+                edgeA[k] = XMVectorReplicate(tri.EdgeA[k]);
+                edgeStep[k] = XMVectorReplicate(tri.EdgeA[k] * 4.0f);
+            }
+            XMVECTOR depthA = XMVectorReplicate(tri.DepthA);
+            XMVECTOR depthStep = XMVectorReplicate(tri.DepthA * 4.0f);
+
+            for (int y = y0; y <= y1; ++y) {
+                float centerY = y + 0.5f;
+
+                XMVECTOR edge[3];
+                for (int k = 0; k < 3; ++k) {
+                    edge[k] = XMVectorMultiplyAdd(edgeA[k], startX, XMVectorReplicate(tri.EdgeB[k] * centerY + tri.EdgeC[k]));
+                }
+                XMVECTOR depth = XMVectorMultiplyAdd(depthA, startX, XMVectorReplicate(tri.DepthB * centerY + tri.DepthC));
+
+                float* row = &buffer.Depth[y * buffer.Width];
+                for (int x = x0; x <= tri.MaxX; x += 4) {
+                    XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(XMVectorGreaterOrEqual(edge[0], zero), XMVectorGreaterOrEqual(edge[1], zero)), XMVectorGreaterOrEqual(edge[2], zero));
+
+                    XMFLOAT4* pixels = reinterpret_cast<XMFLOAT4*>(row + x);
+                    XMVECTOR current = XMLoadFloat4(pixels);
+                    XMStoreFloat4(pixels, XMVectorSelect(current, XMVectorMin(current, depth), inside));
+
+                    for (int k = 0; k < 3; ++k) {
+                        edge[k] = XMVectorAdd(edge[k], edgeStep[k]);
+                    }
+                    depth = XMVectorAdd(depth, depthStep);
+                }
+            }
+        }
+    }
+}
+
+}
+
+void InitOcclusionBuffer(OcclusionBuffer& buffer, UINT width, UINT height) {
+    assert(width % OCCLUSION_TILE_SIZE == 0 && height % OCCLUSION_TILE_SIZE == 0);
+
+    buffer.Width = width;
+    buffer.Height = height;
+    buffer.Depth.assign(width * height, 1.0f);
+    buffer.TilesX = width / OCCLUSION_TILE_SIZE;
+    buffer.TilesY = height / OCCLUSION_TILE_SIZE;
+    buffer.TileMaxDepth.assign(buffer.TilesX * buffer.TilesY, 1.0f);
+    XMStoreFloat4x4(&buffer.ViewProjection, XMMatrixIdentity());
+}
+
+void RasterizeOccluders(OcclusionBuffer& buffer, FXMMATRIX viewProjection, const Occluder* occluders, UINT occluderCount, OcclusionStats& stats) {
+    PROFILE_ZONE("RasterizeOccluders");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    XMStoreFloat4x4(&buffer.ViewProjection, viewProjection);
+    std::fill(buffer.Depth.begin(), buffer.Depth.end(), 1.0f);
+
+    //Transform and set up each occluder on its own job.
+    std::vector<std::vector<ScreenTriangle>> triangles(occluderCount);
+    XMMATRIX vp = viewProjection;
+    ParallelFor(occluderCount, 1, [&](UINT begin, UINT end) {
+        std::vector<XMFLOAT4> clipPositions;
+        for (UINT i = begin; i < end; ++i) {
+            SetupTriangles(buffer, occluders[i], vp, clipPositions, triangles[i]);
+        }
+    });
+
+    stats.OccluderTriangles = 0;
+    for (const std::vector<ScreenTriangle>& occluderTriangles : triangles) {
+        stats.OccluderTriangles += static_cast<UINT>(occluderTriangles.size());
+    }
+
+    //Each job owns a horizontal band of tile rows, so no two jobs write the same pixel.
+    UINT bands = std::min<UINT>(GetWorkerCount() + 1, buffer.TilesY);
+    UINT tileRowsPerBand = (buffer.TilesY + bands - 1) / bands;
+    ParallelFor(bands, 1, [&](UINT begin, UINT end) {
+        for (UINT band = begin; band < end; ++band) {
+            int rowBegin = static_cast<int>(band * tileRowsPerBand * OCCLUSION_TILE_SIZE);
+            int rowEnd = std::min<int>(buffer.Height, static_cast<int>((band + 1) * tileRowsPerBand * OCCLUSION_TILE_SIZE));
+            RasterizeBand(buffer, triangles, rowBegin, rowEnd);
+
+            //Build the tile level for the rows this band just finished.
+            for (int ty = rowBegin / OCCLUSION_TILE_SIZE; ty < rowEnd / static_cast<int>(OCCLUSION_TILE_SIZE); ++ty) {
+                for (UINT tx = 0; tx < buffer.TilesX; ++tx) {
+                    float maxDepth = 0.0f;
+                    for (UINT y = 0; y < OCCLUSION_TILE_SIZE; ++y) {
+                        const float* row = &buffer.Depth[(ty * OCCLUSION_TILE_SIZE + y) * buffer.Width + tx * OCCLUSION_TILE_SIZE];
+                        for (UINT x = 0; x < OCCLUSION_TILE_SIZE; ++x) {
+                            maxDepth = std::max<float>(maxDepth, row[x]);
+                        }
+                    }
+                    buffer.TileMaxDepth[ty * buffer.TilesX + tx] = maxDepth;
+                }
+            }
+        }
+    });
+
+    stats.RasterTimeMs = ElapsedMs(start);
+}
+
+bool IsOccluded(const OcclusionBuffer& buffer, const BoundingBox& worldBounds) {
+    XMMATRIX viewProjection = XMLoadFloat4x4(&buffer.ViewProjection);
+    XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+    XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+
+    float width = static_cast<float>(buffer.Width);
+    float height = static_cast<float>(buffer.Height);
+    float minX = FLT_MAX, minY = FLT_MAX, minDepth = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+
+    for (int i = 0; i < 8; ++i) {
+        XMVECTOR sign = XMVectorSet((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 0.0f);
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, XMVector3Transform(XMVectorMultiplyAdd(extents, sign, center), viewProjection));
+
+        //Boxes crossing the near plane are never rejected.
+        if (c.w < OCCLUSION_MIN_W || c.z < 0.0f) {
+            return false;
+        }
+
+        float invW = 1.0f / c.w;
+        float x = (c.x * invW * 0.5f + 0.5f) * width;
+        float y = (0.5f - c.y * invW * 0.5f) * height;
+        minX = std::min<float>(minX, x);
+        maxX = std::max<float>(maxX, x);
+        minY = std::min<float>(minY, y);
+        maxY = std::max<float>(maxY, y);
+        minDepth = std::min<float>(minDepth, c.z * invW);
+    }
+
+    //Leave anything outside the buffer to frustum culling.
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height) {
+        return false;
+    }
+
+    int x0 = std::max<int>(0, static_cast<int>(floorf(minX)));
+    int x1 = std::min<int>(buffer.Width - 1, static_cast<int>(floorf(maxX)));
+    int y0 = std::max<int>(0, static_cast<int>(floorf(minY)));
+    int y1 = std::min<int>(buffer.Height - 1, static_cast<int>(floorf(maxY)));
+
+    for (int ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / static_cast<int>(OCCLUSION_TILE_SIZE); ++ty) {
+        for (int tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / static_cast<int>(OCCLUSION_TILE_SIZE); ++tx) {
+            //Whole tile nearer than the box: nothing to refine.
+            if (buffer.TileMaxDepth[ty * buffer.TilesX + tx] < minDepth) {
+                continue;
+            }
+
+            int px0 = std::max<int>(x0, tx * OCCLUSION_TILE_SIZE);
+            int px1 = std::min<int>(x1, (tx + 1) * OCCLUSION_TILE_SIZE - 1);
+            int py0 = std::max<int>(y0, ty * OCCLUSION_TILE_SIZE);
+            int py1 = std::min<int>(y1, (ty + 1) * OCCLUSION_TILE_SIZE - 1);
+            for (int y = py0; y <= py1; ++y) {
+                const float* row = &buffer.Depth[y * buffer.Width];
+                for (int x = px0; x <= px1; ++x) {
+                    if (row[x] >= minDepth) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void CullOccludedObjects(const OcclusionBuffer& buffer, const BoundingBox* bounds, std::vector<UINT>& visibleObjects, OcclusionStats& stats) {
+    PROFILE_ZONE("CullOccludedObjects");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    UINT count = static_cast<UINT>(visibleObjects.size());
+    std::vector<BYTE> occluded(count, 0);
+    ParallelFor(count, 256, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            occluded[i] = IsOccluded(buffer, bounds[visibleObjects[i]]) ? 1 : 0;
+        }
+    });
+
+    UINT kept = 0;
+    for (UINT i = 0; i < count; ++i) {
+        if (!occluded[i]) {
+            visibleObjects[kept++] = visibleObjects[i];
+        }
+    }
+    visibleObjects.resize(kept);
+
+    stats.ObjectsTested = count;
+    stats.ObjectsRejected = count - kept;
+    stats.TestTimeMs = ElapsedMs(start);
+}
+
+float GetOcclusionRejectedPercent(const OcclusionStats& stats) {
+    if (stats.ObjectsTested == 0) {
+        return 0.0f;
+    }
+    return 100.0f * stats.ObjectsRejected / stats.ObjectsTested;
+}
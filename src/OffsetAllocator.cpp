@@ -0,0 +1,419 @@
+#include "EchoEngineCore.h"
+#include "OffsetAllocator.h"
+
+namespace {
+
+//Size classes are small floats: 3 mantissa bits below a 5 bit exponent. Classes 0-7 hold exact sizes.
+const uint32_t BIN_MANTISSA_BITS = 3;
+const uint32_t BIN_MANTISSA_VALUE = 1 << BIN_MANTISSA_BITS;
+const uint32_t BIN_MANTISSA_MASK = BIN_MANTISSA_VALUE - 1;
+
+//Bit scans through de Bruijn multiplication, so no compiler intrinsics are needed.
+uint32_t FindLowestSetBit(uint32_t value) {
+    static const uint8_t positions[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    assert(value != 0);
+    return positions[((value & (0u - value)) * 0x077CB531u) >> 27];
+}
+
+uint32_t FindHighestSetBit(uint32_t value) {
+    static const uint8_t positions[32] = {
+        0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+        8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+    };
+    assert(value != 0);
+    value |= value >> 1;
+    value |= value >> 2;
+    value |= value >> 4;
+    value |= value >> 8;
+    value |= value >> 16;
+    return positions[(value * 0x07C4ACDDu) >> 27];
+}
+
+//Smallest class whose every range can hold size.
+uint32_t SizeToBinRoundUp(uint32_t size) {
+    if (size < BIN_MANTISSA_VALUE) {
+        return size;
+    }
+    uint32_t mantissaShift = FindHighestSetBit(size) - BIN_MANTISSA_BITS;
+    uint32_t bin = ((mantissaShift + 1) << BIN_MANTISSA_BITS) | ((size >> mantissaShift) & BIN_MANTISSA_MASK);
+    //Any bits below the mantissa make the range larger than the class; the carry may move to the next exponent.
+    if (size & ((1u << mantissaShift) - 1)) {
+        ++bin;
+    }
+    return bin;
+}
+
+//Largest class whose ranges are never larger than size.
+uint32_t SizeToBinRoundDown(uint32_t size) {
+    if (size < BIN_MANTISSA_VALUE) {
+        return size;
+    }
+    uint32_t mantissaShift = FindHighestSetBit(size) - BIN_MANTISSA_BITS;
+    return ((mantissaShift + 1) << BIN_MANTISSA_BITS) | ((size >> mantissaShift) & BIN_MANTISSA_MASK);
+}
+
+uint32_t AcquireNode(OffsetAllocator& allocator) {
+    if (!allocator.FreeNodes.empty()) {
+        uint32_t node = allocator.FreeNodes.back();
+        allocator.FreeNodes.pop_back();
+        return node;
+    }
+    allocator.Nodes.push_back(OffsetAllocator::Node());
+    return static_cast<uint32_t>(allocator.Nodes.size() - 1);
+}
+
+void ReleaseNode(OffsetAllocator& allocator, uint32_t node) {
+    allocator.FreeNodes.push_back(node);
+}
+
+void InsertIntoBin(OffsetAllocator& allocator, uint32_t nodeIndex) {
+    OffsetAllocator::Node& node = allocator.Nodes[nodeIndex];
+    uint32_t bin = SizeToBinRoundDown(node.Size);
+    uint32_t level = bin >> BIN_MANTISSA_BITS;
+    allocator.UsedBinLevels |= 1u << level;
+    allocator.UsedBins[level] |= static_cast<uint8_t>(1u << (bin & BIN_MANTISSA_MASK));
+
+    node.Used = false;
+    node.BinPrevious = OFFSET_ALLOCATION_NONE;
+    node.BinNext = allocator.BinHeads[bin];
+    if (node.BinNext != OFFSET_ALLOCATION_NONE) {
+        allocator.Nodes[node.BinNext].BinPrevious = nodeIndex;
+    }
+    allocator.BinHeads[bin] = nodeIndex;
+}
+
+void RemoveFromBin(OffsetAllocator& allocator, uint32_t nodeIndex) {
+    OffsetAllocator::Node& node = allocator.Nodes[nodeIndex];
+    if (node.BinPrevious != OFFSET_ALLOCATION_NONE) {
+        allocator.Nodes[node.BinPrevious].BinNext = node.BinNext;
+    }
+    else {
+        uint32_t bin = SizeToBinRoundDown(node.Size);
+        allocator.BinHeads[bin] = node.BinNext;
+        if (node.BinNext == OFFSET_ALLOCATION_NONE) {
+            uint32_t level = bin >> BIN_MANTISSA_BITS;
+            allocator.UsedBins[level] &= static_cast<uint8_t>(~(1u << (bin & BIN_MANTISSA_MASK)));
+            if (allocator.UsedBins[level] == 0) {
+                allocator.UsedBinLevels &= ~(1u << level);
+            }
+        }
+    }
+    if (node.BinNext != OFFSET_ALLOCATION_NONE) {
+        allocator.Nodes[node.BinNext].BinPrevious = node.BinPrevious;
+    }
+}
+
+//First non-empty class at or above minBin.
+uint32_t FindFreeBin(const OffsetAllocator& allocator, uint32_t minBin) {
+    uint32_t level = minBin >> BIN_MANTISSA_BITS;
+    uint32_t bins = allocator.UsedBins[level] & (0xFFu << (minBin & BIN_MANTISSA_MASK)) & 0xFFu;
+    if (bins) {
+        return (level << BIN_MANTISSA_BITS) | FindLowestSetBit(bins);
+    }
+
+    uint32_t levels = level + 1 < 32 ? allocator.UsedBinLevels & (0xFFFFFFFFu << (level + 1)) : 0;
+    if (!levels) {
+        return OFFSET_ALLOCATION_NONE;
+    }
+    level = FindLowestSetBit(levels);
+    return (level << BIN_MANTISSA_BITS) | FindLowestSetBit(allocator.UsedBins[level]);
+}
+
+//New free node covering [offset, offset + size), linked in address order after previous.
+uint32_t InsertFreeRange(OffsetAllocator& allocator, uint32_t offset, uint32_t size, uint32_t previous) {
+    uint32_t nodeIndex = AcquireNode(allocator);
+    OffsetAllocator::Node& node = allocator.Nodes[nodeIndex];
+    node.Offset = offset;
+    node.Size = size;
+    node.Previous = previous;
+    node.Next = previous != OFFSET_ALLOCATION_NONE ? allocator.Nodes[previous].Next : OFFSET_ALLOCATION_NONE;
+    if (previous != OFFSET_ALLOCATION_NONE) {
+        allocator.Nodes[previous].Next = nodeIndex;
+    }
+    if (node.Next != OFFSET_ALLOCATION_NONE) {
+        allocator.Nodes[node.Next].Previous = nodeIndex;
+    }
+    else {
+        allocator.Tail = nodeIndex;
+    }
+    InsertIntoBin(allocator, nodeIndex);
+    return nodeIndex;
+}
+
+void ResetBins(OffsetAllocator& allocator) {
+    allocator.UsedBinLevels = 0;
+    memset(allocator.UsedBins, 0, sizeof(allocator.UsedBins));
+    std::fill(allocator.BinHeads, allocator.BinHeads + OFFSET_ALLOCATOR_BIN_COUNT, OFFSET_ALLOCATION_NONE);
+}
+
+}
+
+void InitOffsetAllocator(OffsetAllocator& allocator, uint32_t size) {
+    allocator.Size = size;
+    allocator.FreeSize = size;
+    allocator.AllocationCount = 0;
+    allocator.Tail = OFFSET_ALLOCATION_NONE;
+    allocator.Nodes.clear();
+    allocator.FreeNodes.clear();
+    ResetBins(allocator);
+
+    if (size > 0) {
+        InsertFreeRange(allocator, 0, size, OFFSET_ALLOCATION_NONE);
+    }
+}
+
+uint32_t AllocateOffset(OffsetAllocator& allocator, uint32_t size) {
+    size = std::max<uint32_t>(size, 1);
+    uint32_t nodeIndex = OFFSET_ALLOCATION_NONE;
+    uint32_t bin = FindFreeBin(allocator, SizeToBinRoundUp(size));
+    if (bin != OFFSET_ALLOCATION_NONE) {
+        nodeIndex = allocator.BinHeads[bin];
+    }
+    else {
+        //The class below holds ranges both smaller and larger than size; search it before giving up,
+        //so allocation only fails when no free range fits.
+        for (uint32_t node = allocator.BinHeads[SizeToBinRoundDown(size)]; node != OFFSET_ALLOCATION_NONE; node = allocator.Nodes[node].BinNext) {
+            if (allocator.Nodes[node].Size >= size) {
+                nodeIndex = node;
+                break;
+            }
+        }
+        if (nodeIndex == OFFSET_ALLOCATION_NONE) {
+            return OFFSET_ALLOCATION_NONE;
+        }
+    }
+    RemoveFromBin(allocator, nodeIndex);
+
+    //Return the tail of the range to the free lists.
+    uint32_t remainder = allocator.Nodes[nodeIndex].Size - size;
+    if (remainder > 0) {
+        InsertFreeRange(allocator, allocator.Nodes[nodeIndex].Offset + size, remainder, nodeIndex);
+    }
+
+    OffsetAllocator::Node& node = allocator.Nodes[nodeIndex];
+    node.Size = size;
+    node.Used = true;
+    allocator.FreeSize -= size;
+    ++allocator.AllocationCount;
+    return nodeIndex;
+}
+
+void FreeOffset(OffsetAllocator& allocator, uint32_t allocation) {
+    assert(allocation < allocator.Nodes.size() && allocator.Nodes[allocation].Used);
+
+    allocator.FreeSize += allocator.Nodes[allocation].Size;
+    --allocator.AllocationCount;
+
+    //Absorb free neighbors so adjacent free ranges never coexist.
+    uint32_t previous = allocator.Nodes[allocation].Previous;
+    if (previous != OFFSET_ALLOCATION_NONE && !allocator.Nodes[previous].Used) {
+        RemoveFromBin(allocator, previous);
+        OffsetAllocator::Node& node = allocator.Nodes[allocation];
+        node.Offset = allocator.Nodes[previous].Offset;
+        node.Size += allocator.Nodes[previous].Size;
+        node.Previous = allocator.Nodes[previous].Previous;
+        if (node.Previous != OFFSET_ALLOCATION_NONE) {
+            allocator.Nodes[node.Previous].Next = allocation;
+        }
+        ReleaseNode(allocator, previous);
+    }
+
+    uint32_t next = allocator.Nodes[allocation].Next;
+    if (next != OFFSET_ALLOCATION_NONE && !allocator.Nodes[next].Used) {
+        RemoveFromBin(allocator, next);
+        OffsetAllocator::Node& node = allocator.Nodes[allocation];
+        node.Size += allocator.Nodes[next].Size;
+        node.Next = allocator.Nodes[next].Next;
+        if (node.Next != OFFSET_ALLOCATION_NONE) {
+            allocator.Nodes[node.Next].Previous = allocation;
+        }
+        else {
+            allocator.Tail = allocation;
+        }
+        ReleaseNode(allocator, next);
+    }
+
+    InsertIntoBin(allocator, allocation);
+}
+
+uint32_t GetAllocationOffset(const OffsetAllocator& allocator, uint32_t allocation) {
+    assert(allocation < allocator.Nodes.size() && allocator.Nodes[allocation].Used);
+    return allocator.Nodes[allocation].Offset;
+}
+
+uint32_t GetAllocationSize(const OffsetAllocator& allocator, uint32_t allocation) {
+    assert(allocation < allocator.Nodes.size() && allocator.Nodes[allocation].Used);
+    return allocator.Nodes[allocation].Size;
+}
+
+void GrowOffsetAllocator(OffsetAllocator& allocator, uint32_t size) {
+    assert(size >= allocator.Size);
+    uint32_t extra = size - allocator.Size;
+    if (extra == 0) {
+        return;
+    }
+
+    uint32_t tail = allocator.Tail;
+    if (tail != OFFSET_ALLOCATION_NONE && !allocator.Nodes[tail].Used) {
+        RemoveFromBin(allocator, tail);
+        allocator.Nodes[tail].Size += extra;
+        InsertIntoBin(allocator, tail);
+    }
+    else {
+        InsertFreeRange(allocator, allocator.Size, extra, tail);
+    }
+    allocator.Size = size;
+    allocator.FreeSize += extra;
+}
+
+void DefragmentOffsetAllocator(OffsetAllocator& allocator, std::vector<OffsetAllocatorMove>& moves) {
+    moves.clear();
+
+    //Collect the allocations in address order and drop every free range.
+    std::vector<uint32_t> allocations;
+    allocations.reserve(allocator.AllocationCount);
+    for (uint32_t node = allocator.Tail; node != OFFSET_ALLOCATION_NONE;) {
+        uint32_t previous = allocator.Nodes[node].Previous;
+        if (allocator.Nodes[node].Used) {
+            allocations.push_back(node);
+        }
+        else {
+            ReleaseNode(allocator, node);
+        }
+        node = previous;
+    }
+    std::reverse(allocations.begin(), allocations.end());
+    ResetBins(allocator);
+
+    uint32_t offset = 0;
+    uint32_t previous = OFFSET_ALLOCATION_NONE;
+    for (uint32_t allocation : allocations) {
+        OffsetAllocator::Node& node = allocator.Nodes[allocation];
+        if (node.Offset != offset) {
+            OffsetAllocatorMove move = { allocation, node.Offset, offset, node.Size };
+            moves.push_back(move);
+            node.Offset = offset;
+        }
+        node.Previous = previous;
+        node.Next = OFFSET_ALLOCATION_NONE;
+        if (previous != OFFSET_ALLOCATION_NONE) {
+            allocator.Nodes[previous].Next = allocation;
+        }
+        offset += node.Size;
+        previous = allocation;
+    }
+    allocator.Tail = previous;
+
+    if (offset < allocator.Size) {
+        InsertFreeRange(allocator, offset, allocator.Size - offset, previous);
+    }
+}
+
+void GetDefragmentCopies(const std::vector<OffsetAllocatorMove>& moves, uint32_t usedSize, std::vector<OffsetAllocatorCopy>& copies) {
+    copies.clear();
+
+    //Everything below the first move stays where it is.
+    uint32_t prefix = moves.empty() ? usedSize : moves[0].DestinationOffset;
+    if (prefix > 0) {
+        OffsetAllocatorCopy copy = { 0, 0, prefix };
+        copies.push_back(copy);
+    }
+    //Allocations that were adjacent before the move still are.
+    for (size_t i = 0; i < moves.size();) {
+        OffsetAllocatorCopy copy = { moves[i].SourceOffset, moves[i].DestinationOffset, moves[i].Size };
+        for (++i; i < moves.size() && moves[i].SourceOffset == copy.SourceOffset + copy.Size && moves[i].DestinationOffset == copy.DestinationOffset + copy.Size; ++i) {
+            copy.Size += moves[i].Size;
+        }
+        copies.push_back(copy);
+    }
+}
+
+void GetOffsetAllocatorReport(const OffsetAllocator& allocator, OffsetAllocatorReport& report) {
+    report.Size = allocator.Size;
+    report.FreeSize = allocator.FreeSize;
+    report.LargestFreeRange = 0;
+    report.FreeRangeCount = 0;
+    report.AllocationCount = allocator.AllocationCount;
+
+    for (uint32_t node = allocator.Tail; node != OFFSET_ALLOCATION_NONE; node = allocator.Nodes[node].Previous) {
+        if (!allocator.Nodes[node].Used) {
+            report.LargestFreeRange = std::max<uint32_t>(report.LargestFreeRange, allocator.Nodes[node].Size);
+            ++report.FreeRangeCount;
+        }
+    }
+}
+
+float GetOffsetAllocatorFragmentationPercent(const OffsetAllocatorReport& report) {
+    if (report.FreeSize == 0) {
+        return 0.0f;
+    }
+    return 100.0f * (report.FreeSize - report.LargestFreeRange) / report.FreeSize;
+}
+
+bool ValidateOffsetAllocator(const OffsetAllocator& allocator) {
+    //Walk the address order list back from the tail.
+    std::vector<uint32_t> nodes;
+    for (uint32_t node = allocator.Tail; node != OFFSET_ALLOCATION_NONE; node = allocator.Nodes[node].Previous) {
+        if (node >= allocator.Nodes.size() || nodes.size() >= allocator.Nodes.size()) {
+            return false;
+        }
+        nodes.push_back(node);
+    }
+    std::reverse(nodes.begin(), nodes.end());
+    if (nodes.size() + allocator.FreeNodes.size() != allocator.Nodes.size()) {
+        return false;
+    }
+
+    uint32_t offset = 0;
+    uint32_t freeSize = 0;
+    uint32_t freeRanges = 0;
+    uint32_t allocations = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const OffsetAllocator::Node& node = allocator.Nodes[nodes[i]];
+        uint32_t next = i + 1 < nodes.size() ? nodes[i + 1] : OFFSET_ALLOCATION_NONE;
+        if (node.Offset != offset || node.Size == 0 || node.Next != next) {
+            return false;
+        }
+        if (node.Used) {
+            ++allocations;
+        }
+        else {
+            if (i > 0 && !allocator.Nodes[nodes[i - 1]].Used) {
+                return false;
+            }
+            freeSize += node.Size;
+            ++freeRanges;
+        }
+        offset += node.Size;
+    }
+    if (offset != allocator.Size || freeSize != allocator.FreeSize || allocations != allocator.AllocationCount) {
+        return false;
+    }
+
+    //Every class is listed in the bitmasks exactly when it has free ranges, and holds only free ranges of its size.
+    uint32_t binnedRanges = 0;
+    for (uint32_t bin = 0; bin < OFFSET_ALLOCATOR_BIN_COUNT; ++bin) {
+        bool listed = (allocator.UsedBins[bin >> BIN_MANTISSA_BITS] >> (bin & BIN_MANTISSA_MASK)) & 1;
+        if (listed != (allocator.BinHeads[bin] != OFFSET_ALLOCATION_NONE)) {
+            return false;
+        }
+        uint32_t previous = OFFSET_ALLOCATION_NONE;
+        for (uint32_t node = allocator.BinHeads[bin]; node != OFFSET_ALLOCATION_NONE; node = allocator.Nodes[node].BinNext) {
+            if (binnedRanges >= freeRanges || allocator.Nodes[node].Used || allocator.Nodes[node].BinPrevious != previous ||
+                SizeToBinRoundDown(allocator.Nodes[node].Size) != bin) {
+                return false;
+            }
+            previous = node;
+            ++binnedRanges;
+        }
+    }
+    for (uint32_t level = 0; level < OFFSET_ALLOCATOR_BIN_COUNT / 8; ++level) {
+        if (((allocator.UsedBinLevels >> level) & 1) != (allocator.UsedBins[level] != 0 ? 1u : 0u)) {
+            return false;
+        }
+    }
+    return binnedRanges == freeRanges;
+}
@@ -0,0 +1,302 @@
+#include "EchoEngineCore.h"
+#include "Profiler.h"
+#include "File.h"
+
+#if PROFILER_ENABLED
+
+namespace {
+
+struct ProfileEvent
+{
+    const char* Name;
+    uint64_t Start;
+    uint64_t End;
+};
+
+//A thread's ring. The thread is the only one to advance Write and the frame mark the only one to advance Read,
+//so the indices only ever grow and their difference is the number of zones waiting.
+struct ProfilerThread
+{
+    ProfileEvent Events[PROFILER_RING_SIZE];
+    std::atomic<uint32_t> Write{ 0 };
+    std::atomic<uint32_t> Read{ 0 };
+    std::atomic<UINT> Dropped{ 0 };
+    UINT Track = 0;
+    std::string Name;
+};
+
+struct CapturedZone
+{
+    const char* Name;
+    uint64_t Start;
+    uint64_t End;
+    UINT Track;
+};
+
+struct ProfilerCapture
+{
+    std::vector<CapturedZone> Zones;
+    //Start of every captured frame, then the end of the last one.
+    std::vector<uint64_t> FrameMarks;
+    std::vector<std::string> TrackNames;
+    UINT FrameCount = 0;
+    UINT DroppedZones = 0;
+    bool Complete = false;
+};
+
+std::mutex g_ProfilerMutex;
+std::vector<std::unique_ptr<ProfilerThread>> g_ProfilerThreads;
+//Changes on shutdown so threads register a new ring instead of using a released one.
+std::atomic<UINT> g_ProfilerGeneration{ 1 };
+std::atomic<bool> g_ProfilerRecording{ false };
+//Frames asked for by StartProfilerCapture, waiting for the next frame mark.
+UINT g_RequestedCaptureFrames = 0;
+ProfilerCapture g_Capture;
+ProfilerStats g_ProfilerStats = {};
+//Clock reading and time taken together by InitProfiler, to convert ticks to microseconds.
+uint64_t g_ReferenceTicks = 0;
+std::chrono::steady_clock::time_point g_ReferenceTime;
+
+thread_local ProfilerThread* t_ProfilerThread = nullptr;
+thread_local UINT t_ProfilerGeneration = 0;
+
+ProfilerThread& GetThreadProfiler() {
+    UINT generation = g_ProfilerGeneration.load(std::memory_order_relaxed);
+    if (t_ProfilerGeneration != generation) {
+        std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+        g_ProfilerThreads.emplace_back(new ProfilerThread());
+        t_ProfilerThread = g_ProfilerThreads.back().get();
+        t_ProfilerThread->Track = static_cast<UINT>(g_ProfilerThreads.size());
+        t_ProfilerThread->Name = "Thread " + std::to_string(t_ProfilerThread->Track);
+        t_ProfilerGeneration = generation;
+    }
+    return *t_ProfilerThread;
+}
+
+void PushProfileEvent(ProfilerThread& thread, const char* name, uint64_t start, uint64_t end) {
+    uint32_t write = thread.Write.load(std::memory_order_relaxed);
+    if (write - thread.Read.load(std::memory_order_acquire) >= PROFILER_RING_SIZE) {
+        thread.Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ProfileEvent& event = thread.Events[write & (PROFILER_RING_SIZE - 1)];
+    event.Name = name;
+    event.Start = start;
+    event.End = end;
+    thread.Write.store(write + 1, std::memory_order_release);
+}
+
+//Empty every thread's ring, into the capture if it is recording. Call with the profiler mutex held.
+void DrainProfilerThreads(bool capture) {
+    for (std::unique_ptr<ProfilerThread>& thread : g_ProfilerThreads) {
+        uint32_t read = thread->Read.load(std::memory_order_relaxed);
+        uint32_t write = thread->Write.load(std::memory_order_acquire);
+        UINT dropped = thread->Dropped.exchange(0, std::memory_order_relaxed);
+        if (capture) {
+            //Zones on tracks can be recorded late, after timing something from before the capture began.
+            for (; read != write; ++read) {
+                const ProfileEvent& event = thread->Events[read & (PROFILER_RING_SIZE - 1)];
+                if (event.Start >= g_Capture.FrameMarks.front()) {
+                    g_Capture.Zones.push_back({ event.Name, event.Start, event.End, thread->Track });
+                }
+            }
+            g_Capture.DroppedZones += dropped;
+        }
+        thread->Read.store(write, std::memory_order_release);
+    }
+}
+
+double GetTicksPerMicrosecond() {
+#if PROFILER_USE_TSC
+    //The counter runs at a constant rate on every processor this targets, so one interval calibrates it.
+    uint64_t ticks = ReadProfilerClock();
+    double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_ReferenceTime).count();
+    return microseconds > 0.0 && ticks > g_ReferenceTicks ? (ticks - g_ReferenceTicks) / microseconds : 1.0;
+#else
+    return 1000.0;
+#endif
+}
+
+void WriteJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (; *text; ++text) {
+        unsigned char c = static_cast<unsigned char>(*text);
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        }
+        else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        }
+        else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void WriteTrackMetadata(FILE* file, UINT track, const char* name) {
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", track);
+    WriteJsonString(file, name);
+    fprintf(file, "}},\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}},\n", track, track);
+}
+
+}
+
+void InitProfiler() {
+    g_ReferenceTime = std::chrono::steady_clock::now();
+    g_ReferenceTicks = ReadProfilerClock();
+}
+
+void ShutdownProfiler() {
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    g_ProfilerRecording.store(false);
+    g_ProfilerThreads.clear();
+    g_ProfilerGeneration.fetch_add(1);
+    g_RequestedCaptureFrames = 0;
+    g_Capture = ProfilerCapture();
+}
+
+void SetProfilerThreadName(const char* name) {
+    ProfilerThread& thread = GetThreadProfiler();
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    thread.Name = name;
+}
+
+bool StartProfilerCapture(UINT frameCount) {
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    if (frameCount == 0 || g_RequestedCaptureFrames > 0 || g_ProfilerRecording.load()) {
+        return false;
+    }
+    g_RequestedCaptureFrames = frameCount;
+    return true;
+}
+
+bool IsProfilerRecording() {
+    return g_ProfilerRecording.load(std::memory_order_relaxed);
+}
+
+bool ProfilerFrameMark() {
+    uint64_t now = ReadProfilerClock();
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+
+    //Zones that closed after a capture ended are emptied out along with the rest.
+    bool recording = g_ProfilerRecording.load(std::memory_order_relaxed);
+    DrainProfilerThreads(recording);
+
+    if (recording) {
+        g_Capture.FrameMarks.push_back(now);
+        if (g_Capture.FrameMarks.size() <= g_Capture.FrameCount) {
+            return false;
+        }
+
+        g_ProfilerRecording.store(false);
+        g_Capture.TrackNames.clear();
+        for (std::unique_ptr<ProfilerThread>& thread : g_ProfilerThreads) {
+            g_Capture.TrackNames.push_back(thread->Name);
+        }
+        g_Capture.Complete = true;
+
+        std::vector<bool> tracksUsed(g_Capture.TrackNames.size() + 1, false);
+        for (const CapturedZone& zone : g_Capture.Zones) {
+            tracksUsed[zone.Track] = true;
+        }
+        g_ProfilerStats.Frames = g_Capture.FrameCount;
+        g_ProfilerStats.Zones = static_cast<UINT>(g_Capture.Zones.size());
+        g_ProfilerStats.DroppedZones = g_Capture.DroppedZones;
+        g_ProfilerStats.Threads = static_cast<UINT>(std::count(tracksUsed.begin(), tracksUsed.end(), true));
+        return true;
+    }
+
+    if (g_RequestedCaptureFrames > 0) {
+        g_Capture = ProfilerCapture();
+        g_Capture.FrameCount = g_RequestedCaptureFrames;
+        g_Capture.FrameMarks.push_back(now);
+        g_RequestedCaptureFrames = 0;
+        g_ProfilerRecording.store(true);
+    }
+    return false;
+}
+
+bool WriteChromeTrace(const wchar_t* path, ProfilerStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    if (!g_Capture.Complete) {
+        return false;
+    }
+
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    //Times are microseconds from the start of the first frame. Track 0 holds the frames and thread tracks follow in
+    //the order the threads registered.
+    double ticksPerMicrosecond = GetTicksPerMicrosecond();
+    uint64_t origin = g_Capture.FrameMarks.front();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"EchoEngine\"}},\n");
+    WriteTrackMetadata(file, 0, "Frames");
+    for (size_t i = 0; i < g_Capture.TrackNames.size(); ++i) {
+        WriteTrackMetadata(file, static_cast<UINT>(i + 1), g_Capture.TrackNames[i].c_str());
+    }
+    for (size_t i = 0; i + 1 < g_Capture.FrameMarks.size(); ++i) {
+        fprintf(file, "{\"name\":\"Frame %zu\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f},\n", i,
+            (g_Capture.FrameMarks[i] - origin) / ticksPerMicrosecond, (g_Capture.FrameMarks[i + 1] - g_Capture.FrameMarks[i]) / ticksPerMicrosecond);
+    }
+    for (const CapturedZone& zone : g_Capture.Zones) {
+        fprintf(file, "{\"name\":");
+        WriteJsonString(file, zone.Name);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n", zone.Track,
+            (zone.Start - origin) / ticksPerMicrosecond, (zone.End - zone.Start) / ticksPerMicrosecond);
+    }
+    //The last event carries no trailing comma.
+    fprintf(file, "{\"name\":\"Capture end\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}\n]}\n",
+        (g_Capture.FrameMarks.back() - origin) / ticksPerMicrosecond);
+
+    bool result = !ferror(file);
+    result = fclose(file) == 0 && result;
+
+    g_ProfilerStats.ExportTimeMs = ElapsedMs(start);
+    if (stats) {
+        *stats = g_ProfilerStats;
+    }
+    return result;
+}
+
+void GetProfilerStats(ProfilerStats& stats) {
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    stats = g_ProfilerStats;
+}
+
+double GetProfilerTicksPerSecond() {
+    return GetTicksPerMicrosecond() * 1000000.0;
+}
+
+void RecordProfileZone(const char* name, uint64_t start, uint64_t end) {
+    PushProfileEvent(GetThreadProfiler(), name, start, end);
+}
+
+UINT CreateProfilerTrack(const char* name) {
+    std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+    g_ProfilerThreads.emplace_back(new ProfilerThread());
+    ProfilerThread& track = *g_ProfilerThreads.back();
+    track.Track = static_cast<UINT>(g_ProfilerThreads.size());
+    track.Name = name;
+    return track.Track;
+}
+
+void RecordProfileTrackZone(UINT track, const char* name, uint64_t start, uint64_t end) {
+    ProfilerThread* ring = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_ProfilerMutex);
+        if (track == 0 || track > g_ProfilerThreads.size()) {
+            return;
+        }
+        ring = g_ProfilerThreads[track - 1].get();
+    }
+    PushProfileEvent(*ring, name, start, end);
+}
+
+#endif
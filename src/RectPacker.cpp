@@ -0,0 +1,141 @@
+#include "EchoEngineCore.h"
+#include "RectPacker.h"
+using namespace DirectX;
+
+namespace {
+
+//Lowest y at which a rectangle starting at the segment's left edge clears every segment below it,
+//and the area it would leave empty under it.
+bool FitSkyline(const RectPacker& packer, size_t segment, UINT width, UINT height, UINT& y, uint64_t& wastedArea) {
+    UINT x = packer.Skyline[segment].X;
+    if (x + width > packer.Width) {
+        return false;
+    }
+
+    y = 0;
+    UINT remaining = width;
+    for (size_t i = segment; remaining > 0; ++i) {
+        y = std::max<UINT>(y, packer.Skyline[i].Y);
+        if (y + height > packer.Height) {
+            return false;
+        }
+        remaining -= std::min<UINT>(remaining, packer.Skyline[i].Width);
+    }
+
+    wastedArea = 0;
+    remaining = width;
+    for (size_t i = segment; remaining > 0; ++i) {
+        UINT covered = std::min<UINT>(remaining, packer.Skyline[i].Width);
+        wastedArea += static_cast<uint64_t>(y - packer.Skyline[i].Y) * covered;
+        remaining -= covered;
+    }
+    return true;
+}
+
+//Raise the skyline over a rectangle placed at the segment's left edge.
+void AddSkylineSegment(RectPacker& packer, size_t segment, UINT width, UINT top) {
+    SkylineSegment added = { packer.Skyline[segment].X, top, width };
+    packer.Skyline.insert(packer.Skyline.begin() + segment, added);
+
+    //Trim or remove the segments the new one now covers.
+    UINT right = added.X + added.Width;
+    size_t next = segment + 1;
+    while (next < packer.Skyline.size() && packer.Skyline[next].X < right) {
+        SkylineSegment& covered = packer.Skyline[next];
+        UINT coveredRight = covered.X + covered.Width;
+        if (coveredRight <= right) {
+            packer.Skyline.erase(packer.Skyline.begin() + next);
+            continue;
+        }
+        covered.Width = coveredRight - right;
+        covered.X = right;
+        break;
+    }
+
+    //Merge neighbours at the same height so the skyline stays short.
+    for (size_t i = 0; i + 1 < packer.Skyline.size();) {
+        if (packer.Skyline[i].Y == packer.Skyline[i + 1].Y) {
+            packer.Skyline[i].Width += packer.Skyline[i + 1].Width;
+            packer.Skyline.erase(packer.Skyline.begin() + i + 1);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+}
+
+void InitRectPacker(RectPacker& packer, UINT width, UINT height) {
+    packer.Width = width;
+    packer.Height = height;
+    ResetRectPacker(packer);
+}
+
+void ResetRectPacker(RectPacker& packer) {
+    SkylineSegment floor = { 0, 0, packer.Width };
+    packer.Skyline.assign(1, floor);
+    packer.UsedArea = 0;
+}
+
+bool PackRect(RectPacker& packer, UINT width, UINT height, UINT& x, UINT& y) {
+    if (width == 0 || height == 0 || width > packer.Width || height > packer.Height) {
+        return false;
+    }
+
+    size_t bestSegment = packer.Skyline.size();
+    UINT bestTop = UINT_MAX;
+    uint64_t bestWaste = UINT64_MAX;
+    for (size_t i = 0; i < packer.Skyline.size(); ++i) {
+        UINT fitY;
+        uint64_t waste;
+        if (!FitSkyline(packer, i, width, height, fitY, waste)) {
+            continue;
+        }
+        UINT top = fitY + height;
+        if (top < bestTop || (top == bestTop && waste < bestWaste)) {
+            bestSegment = i;
+            bestTop = top;
+            bestWaste = waste;
+            y = fitY;
+        }
+    }
+    if (bestSegment == packer.Skyline.size()) {
+        return false;
+    }
+
+    x = packer.Skyline[bestSegment].X;
+    AddSkylineSegment(packer, bestSegment, width, bestTop);
+    packer.UsedArea += static_cast<uint64_t>(width) * height;
+    return true;
+}
+
+UINT PackRects(RectPacker& packer, PackedRect* rects, UINT count) {
+    std::vector<UINT> order(count);
+    for (UINT i = 0; i < count; ++i) {
+        order[i] = i;
+        rects[i].Packed = false;
+    }
+    std::sort(order.begin(), order.end(), [rects](UINT a, UINT b) {
+        if (rects[a].Height != rects[b].Height) {
+            return rects[a].Height > rects[b].Height;
+        }
+        return rects[a].Width > rects[b].Width;
+    });
+
+    UINT packed = 0;
+    for (UINT i : order) {
+        PackedRect& rect = rects[i];
+        rect.Packed = PackRect(packer, rect.Width, rect.Height, rect.X, rect.Y);
+        packed += rect.Packed ? 1 : 0;
+    }
+    return packed;
+}
+
+float GetRectPackerOccupancyPercent(const RectPacker& packer) {
+    uint64_t area = static_cast<uint64_t>(packer.Width) * packer.Height;
+    if (area == 0) {
+        return 0.0f;
+    }
+    return 100.0f * static_cast<float>(packer.UsedArea) / static_cast<float>(area);
+}
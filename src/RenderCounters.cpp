@@ -0,0 +1,139 @@
+#include "EchoEngineCore.h"
+#include "RenderCounters.h"
+
+namespace {
+
+//Keys of what each bind point has bound, with a bit per slot for whether it is known.
+struct BoundSlots
+{
+    uint64_t Keys[RENDER_COUNTERS_TRACKED_SLOTS];
+    uint32_t Known;
+};
+
+RenderCounters g_RenderCounters = {};
+//Resources can be created on any thread.
+std::atomic<UINT> g_BufferCreations{ 0 };
+std::atomic<UINT> g_TextureCreations{ 0 };
+BoundSlots g_BoundState[RBP_Count] = {};
+RenderPrimitive g_Primitive = RP_Other;
+
+uint64_t GetTriangleCount(UINT count) {
+    switch (g_Primitive) {
+    case RP_TriangleList:
+        return count / 3;
+    case RP_TriangleStrip:
+        return count > 2 ? count - 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+}
+
+void BeginRenderCountersFrame(RenderCounters* lastFrame) {
+    UINT bufferCreations = g_BufferCreations.exchange(0);
+    UINT textureCreations = g_TextureCreations.exchange(0);
+    if (lastFrame) {
+        *lastFrame = g_RenderCounters;
+        lastFrame->BufferCreations = bufferCreations;
+        lastFrame->TextureCreations = textureCreations;
+    }
+    g_RenderCounters = RenderCounters();
+}
+
+void GetRenderCounters(RenderCounters& counters) {
+    counters = g_RenderCounters;
+    counters.BufferCreations = g_BufferCreations.load();
+    counters.TextureCreations = g_TextureCreations.load();
+}
+
+void InvalidateRenderStateCache() {
+    for (UINT i = 0; i < RBP_Count; ++i) {
+        g_BoundState[i] = BoundSlots();
+    }
+    g_Primitive = RP_Other;
+}
+
+float GetRedundantStateBindPercent(const RenderCounters& counters) {
+    return counters.StateBinds > 0 ? 100.0f * counters.RedundantStateBinds / counters.StateBinds : 0.0f;
+}
+
+uint64_t HashRenderState(const void* data, size_t size, uint64_t key) {
+    //FNV-1a over the value's bytes.
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        key = (key ^ bytes[i]) * 1099511628211ull;
+    }
+    return key;
+}
+
+bool CountStateBind(RenderBindPoint point, UINT startSlot, UINT count, const uint64_t* keys) {
+    BoundSlots& bound = g_BoundState[point];
+    bool redundant = true;
+    for (UINT i = 0; i < count; ++i) {
+        UINT slot = startSlot + i;
+        if (slot >= RENDER_COUNTERS_TRACKED_SLOTS) {
+            redundant = false;
+            continue;
+        }
+        uint32_t bit = 1u << slot;
+        if ((bound.Known & bit) == 0 || bound.Keys[slot] != keys[i]) {
+            redundant = false;
+            bound.Keys[slot] = keys[i];
+            bound.Known |= bit;
+        }
+    }
+
+    ++g_RenderCounters.StateBinds;
+    if (redundant) {
+        ++g_RenderCounters.RedundantStateBinds;
+    }
+    else if (point == RBP_VertexShader || point == RBP_PixelShader) {
+        ++g_RenderCounters.ShaderSwitches;
+    }
+    return redundant;
+}
+
+bool CountTopologyBind(RenderPrimitive primitive, uint64_t key) {
+    g_Primitive = primitive;
+    return CountStateBind(RBP_Topology, 0, 1, &key);
+}
+
+void CountDraw(UINT count, bool indexed) {
+    ++g_RenderCounters.Draws;
+    if (indexed) {
+        g_RenderCounters.Indices += count;
+    }
+    else {
+        g_RenderCounters.Vertices += count;
+    }
+    //Triangles are only counted once the topology is known.
+    if (g_BoundState[RBP_Topology].Known) {
+        g_RenderCounters.Triangles += GetTriangleCount(count);
+    }
+}
+
+void CountUpdate(uint64_t bytes) {
+    ++g_RenderCounters.Updates;
+    g_RenderCounters.UploadBytes += bytes;
+}
+
+void CountMap() {
+    ++g_RenderCounters.Maps;
+}
+
+void CountUnmap(uint64_t bytesWritten) {
+    g_RenderCounters.UploadBytes += bytesWritten;
+}
+
+void CountCopy() {
+    ++g_RenderCounters.Copies;
+}
+
+void CountBufferCreation() {
+    g_BufferCreations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountTextureCreation() {
+    g_TextureCreations.fetch_add(1, std::memory_order_relaxed);
+}
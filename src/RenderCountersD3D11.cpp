@@ -0,0 +1,184 @@
+#include "EchoEnginePCH.h"
+#include "RenderCountersD3D11.h"
+
+namespace {
+
+RenderPrimitive GetRenderPrimitive(D3D11_PRIMITIVE_TOPOLOGY topology) {
+    switch (topology) {
+    case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
+        return RP_TriangleList;
+    case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP:
+        return RP_TriangleStrip;
+    default:
+        return RP_Other;
+    }
+}
+
+//Count a bind of count objects from startSlot. Slots past the tracked ones need no key.
+template<class T>
+void CountObjectBinds(RenderBindPoint point, UINT startSlot, UINT count, T* const* objects) {
+    uint64_t keys[RENDER_COUNTERS_TRACKED_SLOTS];
+    UINT tracked = startSlot < RENDER_COUNTERS_TRACKED_SLOTS ? std::min<UINT>(count, RENDER_COUNTERS_TRACKED_SLOTS - startSlot) : 0;
+    for (UINT i = 0; i < tracked; ++i) {
+        keys[i] = GetRenderStateKey(objects[i]);
+    }
+    CountStateBind(point, startSlot, count, keys);
+}
+
+template<class T>
+void CountObjectBind(RenderBindPoint point, T* object) {
+    uint64_t key = GetRenderStateKey(object);
+    CountStateBind(point, 0, 1, &key);
+}
+
+}
+
+void ContextDraw(ID3D11DeviceContext* deviceContext, UINT vertexCount, UINT startVertex) {
+    deviceContext->Draw(vertexCount, startVertex);
+    CountDraw(vertexCount, false);
+}
+
+void ContextDrawIndexed(ID3D11DeviceContext* deviceContext, UINT indexCount, UINT startIndex, INT baseVertex) {
+    deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+    CountDraw(indexCount, true);
+}
+
+void ContextIASetInputLayout(ID3D11DeviceContext* deviceContext, ID3D11InputLayout* inputLayout) {
+    CountObjectBind(RBP_InputLayout, inputLayout);
+    deviceContext->IASetInputLayout(inputLayout);
+}
+
+void ContextIASetPrimitiveTopology(ID3D11DeviceContext* deviceContext, D3D11_PRIMITIVE_TOPOLOGY topology) {
+    CountTopologyBind(GetRenderPrimitive(topology), static_cast<uint64_t>(topology));
+    deviceContext->IASetPrimitiveTopology(topology);
+}
+
+void ContextIASetVertexBuffers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides,
+    const UINT* offsets) {
+    uint64_t keys[RENDER_COUNTERS_TRACKED_SLOTS];
+    UINT tracked = startSlot < RENDER_COUNTERS_TRACKED_SLOTS ? std::min<UINT>(count, RENDER_COUNTERS_TRACKED_SLOTS - startSlot) : 0;
+    for (UINT i = 0; i < tracked; ++i) {
+        uint64_t key = HashRenderState(&buffers[i], sizeof(buffers[i]));
+        key = HashRenderState(&strides[i], sizeof(strides[i]), key);
+        keys[i] = HashRenderState(&offsets[i], sizeof(offsets[i]), key);
+    }
+    CountStateBind(RBP_VertexBuffers, startSlot, count, keys);
+    deviceContext->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void ContextIASetIndexBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) {
+    uint64_t key = HashRenderState(&buffer, sizeof(buffer));
+    key = HashRenderState(&format, sizeof(format), key);
+    key = HashRenderState(&offset, sizeof(offset), key);
+    CountStateBind(RBP_IndexBuffer, 0, 1, &key);
+    deviceContext->IASetIndexBuffer(buffer, format, offset);
+}
+
+void ContextVSSetShader(ID3D11DeviceContext* deviceContext, ID3D11VertexShader* shader) {
+    CountObjectBind(RBP_VertexShader, shader);
+    deviceContext->VSSetShader(shader, nullptr, 0);
+}
+
+void ContextVSSetConstantBuffers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) {
+    CountObjectBinds(RBP_VSConstantBuffers, startSlot, count, buffers);
+    deviceContext->VSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void ContextPSSetShader(ID3D11DeviceContext* deviceContext, ID3D11PixelShader* shader) {
+    CountObjectBind(RBP_PixelShader, shader);
+    deviceContext->PSSetShader(shader, nullptr, 0);
+}
+
+void ContextPSSetShaderResources(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) {
+    CountObjectBinds(RBP_PSShaderResources, startSlot, count, views);
+    deviceContext->PSSetShaderResources(startSlot, count, views);
+}
+
+void ContextPSSetSamplers(ID3D11DeviceContext* deviceContext, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) {
+    CountObjectBinds(RBP_PSSamplers, startSlot, count, samplers);
+    deviceContext->PSSetSamplers(startSlot, count, samplers);
+}
+
+void ContextRSSetState(ID3D11DeviceContext* deviceContext, ID3D11RasterizerState* state) {
+    CountObjectBind(RBP_Rasterizer, state);
+    deviceContext->RSSetState(state);
+}
+
+void ContextRSSetViewports(ID3D11DeviceContext* deviceContext, UINT count, const D3D11_VIEWPORT* viewports) {
+    //The viewports are bound together, so they are one value.
+    uint64_t key = HashRenderState(&count, sizeof(count));
+    key = HashRenderState(viewports, count * sizeof(D3D11_VIEWPORT), key);
+    CountStateBind(RBP_Viewports, 0, 1, &key);
+    deviceContext->RSSetViewports(count, viewports);
+}
+
+void ContextOMSetRenderTargets(ID3D11DeviceContext* deviceContext, UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) {
+    //So are the render targets and the depth stencil view.
+    uint64_t key = HashRenderState(&count, sizeof(count));
+    if (count > 0) {
+        key = HashRenderState(views, count * sizeof(views[0]), key);
+    }
+    key = HashRenderState(&depthStencilView, sizeof(depthStencilView), key);
+    CountStateBind(RBP_RenderTargets, 0, 1, &key);
+    deviceContext->OMSetRenderTargets(count, views, depthStencilView);
+}
+
+void ContextOMSetBlendState(ID3D11DeviceContext* deviceContext, ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) {
+    //A null blend factor means all ones.
+    const FLOAT ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const FLOAT* factor = blendFactor ? blendFactor : ones;
+    uint64_t key = HashRenderState(&state, sizeof(state));
+    key = HashRenderState(factor, 4 * sizeof(FLOAT), key);
+    key = HashRenderState(&sampleMask, sizeof(sampleMask), key);
+    CountStateBind(RBP_Blend, 0, 1, &key);
+    deviceContext->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void ContextOMSetDepthStencilState(ID3D11DeviceContext* deviceContext, ID3D11DepthStencilState* state, UINT stencilRef) {
+    uint64_t key = HashRenderState(&state, sizeof(state));
+    key = HashRenderState(&stencilRef, sizeof(stencilRef), key);
+    CountStateBind(RBP_DepthStencil, 0, 1, &key);
+    deviceContext->OMSetDepthStencilState(state, stencilRef);
+}
+
+void ContextUpdateSubresource(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data,
+    UINT rowPitch, UINT depthPitch, uint64_t bytes) {
+    deviceContext->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+    CountUpdate(bytes);
+}
+
+HRESULT ContextMap(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT flags,
+    D3D11_MAPPED_SUBRESOURCE* mappedResource) {
+    HRESULT hr = deviceContext->Map(resource, subresource, mapType, flags, mappedResource);
+    if (SUCCEEDED(hr)) {
+        CountMap();
+    }
+    return hr;
+}
+
+void ContextUnmap(ID3D11DeviceContext* deviceContext, ID3D11Resource* resource, UINT subresource, uint64_t bytesWritten) {
+    deviceContext->Unmap(resource, subresource);
+    CountUnmap(bytesWritten);
+}
+
+void ContextCopySubresourceRegion(ID3D11DeviceContext* deviceContext, ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y,
+    UINT z, ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) {
+    deviceContext->CopySubresourceRegion(destination, destinationSubresource, x, y, z, source, sourceSubresource, sourceBox);
+    CountCopy();
+}
+
+HRESULT DeviceCreateBuffer(ID3D11Device* device, const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer) {
+    HRESULT hr = device->CreateBuffer(desc, data, buffer);
+    if (SUCCEEDED(hr)) {
+        CountBufferCreation();
+    }
+    return hr;
+}
+
+HRESULT DeviceCreateTexture2D(ID3D11Device* device, const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture) {
+    HRESULT hr = device->CreateTexture2D(desc, data, texture);
+    if (SUCCEEDED(hr)) {
+        CountTextureCreation();
+    }
+    return hr;
+}
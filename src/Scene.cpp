@@ -0,0 +1,102 @@
+#include "EchoEngineCore.h"
+#include "Scene.h"
+#include "Profiler.h"
+using namespace DirectX;
+
+void InitScene(Scene& scene, SceneIndexType indexType, float gridCellSize) {
+    assert(scene.Objects.empty());
+
+    scene.IndexType = indexType;
+    scene.IndexedObjects = 0;
+    scene.MovedObjects.clear();
+    if (indexType == SI_SpatialHash) {
+        InitSpatialHash(scene.Grid, gridCellSize);
+    }
+}
+
+UINT AddSceneObject(Scene& scene, FXMMATRIX worldMatrix, const BoundingBox& localBounds) {
+    SceneObject object;
+    XMStoreFloat4x4(&object.WorldMatrix, worldMatrix);
+    object.LocalBounds = localBounds;
+
+    BoundingBox worldBounds;
+    localBounds.Transform(worldBounds, worldMatrix);
+
+    scene.Objects.push_back(object);
+    scene.WorldBounds.push_back(worldBounds);
+
+    return static_cast<UINT>(scene.Objects.size() - 1);
+}
+
+void SetSceneObjectTransform(Scene& scene, UINT object, FXMMATRIX worldMatrix) {
+    assert(object < scene.Objects.size());
+
+    XMStoreFloat4x4(&scene.Objects[object].WorldMatrix, worldMatrix);
+    scene.Objects[object].LocalBounds.Transform(scene.WorldBounds[object], worldMatrix);
+    scene.MovedObjects.push_back(object);
+}
+
+void UpdateScene(Scene& scene) {
+    PROFILE_ZONE("UpdateScene");
+    UINT objectCount = static_cast<UINT>(scene.Objects.size());
+
+    if (scene.IndexType == SI_BVH) {
+        if (scene.IndexedObjects != objectCount) {
+            BuildBVH(scene.Hierarchy, scene.WorldBounds.data(), objectCount);
+        }
+        else if (!scene.MovedObjects.empty()) {
+            RefitBVH(scene.Hierarchy, scene.WorldBounds.data(), scene.MovedObjects.data(), static_cast<UINT>(scene.MovedObjects.size()));
+        }
+    }
+    else {
+        //Batch moves need distinct objects. New objects are inserted with their latest bounds, so drop their moves.
+        std::sort(scene.MovedObjects.begin(), scene.MovedObjects.end());
+        scene.MovedObjects.erase(std::unique(scene.MovedObjects.begin(), scene.MovedObjects.end()), scene.MovedObjects.end());
+        scene.MovedObjects.erase(std::lower_bound(scene.MovedObjects.begin(), scene.MovedObjects.end(), scene.IndexedObjects), scene.MovedObjects.end());
+
+        scene.MovedBounds.resize(scene.MovedObjects.size());
+        for (size_t i = 0; i < scene.MovedObjects.size(); ++i) {
+            scene.MovedBounds[i] = scene.WorldBounds[scene.MovedObjects[i]];
+        }
+        MoveSpatialHashObjects(scene.Grid, scene.MovedObjects.data(), scene.MovedBounds.data(), static_cast<UINT>(scene.MovedObjects.size()));
+
+        for (UINT object = scene.IndexedObjects; object < objectCount; ++object) {
+            InsertSpatialHashObject(scene.Grid, object, scene.WorldBounds[object]);
+        }
+    }
+
+    scene.IndexedObjects = objectCount;
+    scene.MovedObjects.clear();
+}
+
+void CullScene(const Scene& scene, const Frustum& frustum, std::vector<UINT>& visibleObjects) {
+    PROFILE_ZONE("CullScene");
+    assert(scene.IndexedObjects == scene.Objects.size());
+
+    if (scene.IndexType == SI_BVH) {
+        CullBVH(scene.Hierarchy, scene.WorldBounds.data(), frustum, visibleObjects);
+    }
+    else {
+        QuerySpatialHashFrustum(scene.Grid, frustum, visibleObjects);
+    }
+}
+
+bool PickScene(const Scene& scene, FXMVECTOR origin, FXMVECTOR direction, UINT& object, float& distance) {
+    assert(scene.IndexedObjects == scene.Objects.size());
+
+    if (scene.IndexType == SI_BVH) {
+        return RaycastBVH(scene.Hierarchy, scene.WorldBounds.data(), origin, direction, FLT_MAX, object, distance);
+    }
+
+    //The grid has no ray query; picking is rare enough to test every object.
+    object = BVH_INVALID_INDEX;
+    distance = FLT_MAX;
+    for (UINT i = 0; i < scene.WorldBounds.size(); ++i) {
+        float hitDistance;
+        if (scene.WorldBounds[i].Intersects(origin, direction, hitDistance) && std::max<float>(hitDistance, 0.0f) < distance) {
+            distance = std::max<float>(hitDistance, 0.0f);
+            object = i;
+        }
+    }
+    return object != BVH_INVALID_INDEX;
+}
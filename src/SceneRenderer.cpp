@@ -0,0 +1,163 @@
+#include "EchoEngineCore.h"
+#include "SceneRenderer.h"
+#include "MeshFile.h"
+#include "Profiler.h"
+using namespace DirectX;
+
+namespace {
+
+//Key of the meshlet index stream. Geometry arenas are keyed by their index size, so they never match it.
+const uint64_t HEADLESS_MESHLET_STREAM_KEY = 1;
+
+//Key of the one object a headless device keeps for every other bind point.
+const uint64_t HEADLESS_STATE_KEY = 1;
+
+}
+
+SceneRenderDevice CreateHeadlessSceneRenderDevice(UINT meshIndexCount) {
+    std::shared_ptr<std::vector<BYTE>> indices = std::make_shared<std::vector<BYTE>>();
+
+    SceneRenderDevice device;
+    device.BindState = [](RenderBindPoint point) {
+        if (point == RBP_Topology) {
+            CountTopologyBind(RP_TriangleList, RP_TriangleList);
+        }
+        else {
+            CountStateBind(point, 0, 1, &HEADLESS_STATE_KEY);
+        }
+    };
+    device.BindGeometryIndices = [](UINT indexSize) {
+        uint64_t key = indexSize;
+        CountStateBind(RBP_IndexBuffer, 0, 1, &key);
+    };
+    device.WriteMeshletIndices = [indices](const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, MeshletCullStats& stats) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        UINT indexCount = 0;
+        for (UINT i = 0; i < visibleCount; ++i) {
+            indexCount += meshlets.Meshlets[visibleMeshlets[i]].TriangleCount * 3;
+        }
+        if (indexCount > 0) {
+            UINT indexSize = meshlets.MeshVertexCount > MESH_INDEX16_VERTEX_LIMIT ? sizeof(uint32_t) : sizeof(uint16_t);
+            indices->resize(static_cast<size_t>(indexCount) * indexSize);
+            CountMap();
+            WriteMeshletIndices(meshlets, visibleMeshlets, visibleCount, indexSize, indices->data());
+            CountUnmap(indices->size());
+            stats.WriteTimeMs += ElapsedMs(start);
+        }
+        CountStateBind(RBP_IndexBuffer, 0, 1, &HEADLESS_MESHLET_STREAM_KEY);
+        return true;
+    };
+    device.UpdateViewMatrix = [](FXMMATRIX) {
+        CountUpdate(sizeof(XMMATRIX));
+    };
+    device.UpdateObjectMatrix = [](FXMMATRIX) {
+        CountUpdate(sizeof(XMMATRIX));
+    };
+    device.DrawMeshlets = [](UINT indexCount, UINT) {
+        CountDraw(indexCount, true);
+    };
+    device.DrawMesh = [meshIndexCount]() {
+        CountDraw(meshIndexCount, true);
+    };
+    device.DrawStaticChunk = [](const StaticBatchChunk& chunk) {
+        CountDraw(chunk.IndexCount, true);
+    };
+    return device;
+}
+
+void SubmitScene(SceneRenderer& renderer, const SceneRenderDevice& device, FXMMATRIX view, CXMMATRIX projection, float viewportHeight) {
+    PROFILE_ZONE("SubmitScene");
+
+    device.UpdateViewMatrix(view);
+
+    //Set up the pipeline, in the order of its stages.
+    const RenderBindPoint pipelineState[] = { RBP_VertexBuffers, RBP_InputLayout, RBP_Topology, RBP_VertexShader, RBP_VSConstantBuffers,
+        RBP_Rasterizer, RBP_Viewports, RBP_PixelShader, RBP_RenderTargets, RBP_DepthStencil };
+    for (RenderBindPoint point : pipelineState) {
+        device.BindState(point);
+    }
+
+    //Cull the scene against the view frustum, then against the occluders.
+    XMMATRIX viewProjection = XMMatrixMultiply(view, projection);
+    Frustum frustum;
+    ExtractFrustum(frustum, viewProjection);
+    renderer.VisibleObjects.clear();
+    if (renderer.Objects) {
+        CullScene(*renderer.Objects, frustum, renderer.VisibleObjects);
+    }
+    renderer.OcclusionCulling = OcclusionStats();
+    if (renderer.OcclusionTarget) {
+        RasterizeOccluders(*renderer.OcclusionTarget, viewProjection, renderer.Occluders, renderer.OccluderCount, renderer.OcclusionCulling);
+        CullOccludedObjects(*renderer.OcclusionTarget, renderer.Objects->WorldBounds.data(), renderer.VisibleObjects, renderer.OcclusionCulling);
+    }
+
+    //Pick the coarsest detail level of every visible object that stays within a pixel of the full mesh, cull
+    //that level's meshlets and pack the surviving triangles into this frame's index stream.
+    renderer.LevelOfDetail = MeshLodStats();
+    renderer.MeshletCulling = MeshletCullStats();
+    renderer.VisibleMeshlets.clear();
+    renderer.DrawIndexCounts.clear();
+    bool useMeshletStream = false;
+    if (renderer.Meshlets) {
+        const MeshletMesh& meshlets = *renderer.Meshlets;
+        XMVECTOR eyePosition = XMMatrixInverse(nullptr, view).r[3];
+        float lodProjectionScale = GetLodProjectionScale(projection, viewportHeight);
+        for (UINT object : renderer.VisibleObjects) {
+            XMMATRIX world = XMLoadFloat4x4(&renderer.Objects->Objects[object].WorldMatrix);
+            UINT lod = 0;
+            if (renderer.LodErrors) {
+                lod = SelectMeshLod(renderer.LodErrors, static_cast<UINT>(meshlets.Lods.size()), world, renderer.Objects->WorldBounds[object], eyePosition,
+                    lodProjectionScale, MESH_LOD_MAX_PIXEL_ERROR);
+            }
+            ++renderer.LevelOfDetail.Objects;
+            ++renderer.LevelOfDetail.ObjectsPerLod[lod];
+            renderer.LevelOfDetail.FullDetailTriangles += meshlets.Lods[0].TriangleCount;
+            renderer.LevelOfDetail.LodTriangles += meshlets.Lods[lod].TriangleCount;
+
+            renderer.DrawIndexCounts.push_back(CullMeshlets(meshlets, lod, world, viewProjection, eyePosition, renderer.VisibleMeshlets,
+                renderer.MeshletCulling));
+        }
+        useMeshletStream = device.WriteMeshletIndices(meshlets, renderer.VisibleMeshlets.data(), static_cast<UINT>(renderer.VisibleMeshlets.size()),
+            renderer.MeshletCulling);
+    }
+    //Draw from the meshlet index stream, or the whole mesh if there is none.
+    if (!useMeshletStream) {
+        device.BindGeometryIndices(renderer.MeshIndexSize);
+    }
+
+    UINT scenePass = renderer.Timer ? BeginGpuPass(*renderer.Timer, "Scene") : GPU_TIMER_NO_PASS;
+
+    //Render the visible objects. Compact vertex positions are expanded by the dequantize matrix.
+    XMMATRIX dequantizeMatrix = XMMatrixMultiply(XMMatrixScaling(renderer.PositionScale.x, renderer.PositionScale.y, renderer.PositionScale.z),
+        XMMatrixTranslation(renderer.PositionBias.x, renderer.PositionBias.y, renderer.PositionBias.z));
+    UINT startIndex = 0;
+    for (size_t i = 0; i < renderer.VisibleObjects.size(); ++i) {
+        UINT indexCount = useMeshletStream ? renderer.DrawIndexCounts[i] : 0;
+        if (useMeshletStream && indexCount == 0) {
+            continue;
+        }
+
+        device.UpdateObjectMatrix(XMMatrixMultiply(dequantizeMatrix, XMLoadFloat4x4(&renderer.Objects->Objects[renderer.VisibleObjects[i]].WorldMatrix)));
+        if (useMeshletStream) {
+            device.DrawMeshlets(indexCount, startIndex);
+            startIndex += indexCount;
+        }
+        else {
+            device.DrawMesh();
+        }
+    }
+
+    //Render the static chunks in view. They share the mesh's vertex format, and a chunk's quantization box is its object matrix.
+    renderer.VisibleChunks.clear();
+    if (renderer.Batch) {
+        CullStaticBatch(*renderer.Batch, frustum, renderer.VisibleChunks);
+        device.BindGeometryIndices(sizeof(uint16_t));
+        for (UINT chunk : renderer.VisibleChunks) {
+            device.UpdateObjectMatrix(GetStaticChunkMatrix(renderer.Batch->Chunks[chunk]));
+            device.DrawStaticChunk(renderer.Batch->Chunks[chunk]);
+        }
+    }
+    if (renderer.Timer) {
+        EndGpuPass(*renderer.Timer, scenePass);
+    }
+}
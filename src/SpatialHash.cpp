@@ -0,0 +1,313 @@
+#include "EchoEngineCore.h"
+#include "SpatialHash.h"
+#include "JobSystem.h"
+using namespace DirectX;
+
+namespace {
+
+const int SPATIAL_HASH_COORD_LIMIT = (1 << 19) - 1;
+
+//Spread the low 20 bits of v so that they occupy every third bit.
+inline uint64_t SpreadBits(uint32_t v) {
+    uint64_t x = v & 0xFFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFFull;
+    x = (x | x << 16) & 0x1F0000FF0000FFull;
+    x = (x | x << 8) & 0x100F00F00F00F00Full;
+    x = (x | x << 4) & 0x10C30C30C30C30C3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+inline uint64_t MakeCellKey(UINT level, int x, int y, int z) {
+    uint64_t morton = SpreadBits(static_cast<uint32_t>(x + SPATIAL_HASH_COORD_LIMIT + 1))
+        | SpreadBits(static_cast<uint32_t>(y + SPATIAL_HASH_COORD_LIMIT + 1)) << 1
+        | SpreadBits(static_cast<uint32_t>(z + SPATIAL_HASH_COORD_LIMIT + 1)) << 2;
+    return static_cast<uint64_t>(level) << 60 | morton;
+}
+
+inline float CellSize(const SpatialHash& hash, UINT level) {
+    return ldexpf(hash.BaseCellSize, static_cast<int>(level));
+}
+
+//Cell coordinate of a value, clamped to the grid. Clamping before the conversion keeps values far outside it defined.
+inline int ClampCellCoordinate(float value, float cellSize) {
+    float coordinate = floorf(value / cellSize);
+    return static_cast<int>(std::min<float>(std::max<float>(coordinate, -SPATIAL_HASH_COORD_LIMIT), SPATIAL_HASH_COORD_LIMIT));
+}
+
+//Cell coordinate of an object's center, which has to lie within the grid. Query volumes may reach past it and are
+//clamped instead, since the cells at the edge hold whatever lies beyond.
+inline int CellCoordinate(float value, float cellSize) {
+    assert(fabsf(floorf(value / cellSize)) <= SPATIAL_HASH_COORD_LIMIT);
+    return ClampCellCoordinate(value, cellSize);
+}
+
+inline float MaxExtent(const BoundingBox& bounds) {
+    return std::max<float>(bounds.Extents.x, std::max<float>(bounds.Extents.y, bounds.Extents.z));
+}
+
+//Smallest level whose cells are at least as large as the object.
+UINT SelectLevel(const SpatialHash& hash, const BoundingBox& bounds) {
+    float size = 2.0f * MaxExtent(bounds);
+    UINT level = 0;
+    float cellSize = hash.BaseCellSize;
+    while (level < SPATIAL_HASH_LEVELS - 1 && cellSize < size) {
+        cellSize *= 2.0f;
+        ++level;
+    }
+    return level;
+}
+
+uint64_t ComputeCellKey(const SpatialHash& hash, const BoundingBox& bounds, UINT& level, int& x, int& y, int& z) {
+    level = SelectLevel(hash, bounds);
+    float cellSize = CellSize(hash, level);
+    x = CellCoordinate(bounds.Center.x, cellSize);
+    y = CellCoordinate(bounds.Center.y, cellSize);
+    z = CellCoordinate(bounds.Center.z, cellSize);
+    return MakeCellKey(level, x, y, z);
+}
+
+inline uint64_t GetCellKey(const SpatialCell& cell) {
+    return MakeCellKey(cell.Level, cell.X, cell.Y, cell.Z);
+}
+
+void LinkObject(SpatialHash& hash, UINT object, uint64_t key, UINT level, int x, int y, int z) {
+    UINT cellIndex;
+    std::unordered_map<uint64_t, UINT>::iterator it = hash.CellLookup.find(key);
+    if (it != hash.CellLookup.end()) {
+        cellIndex = it->second;
+    }
+    else {
+        if (!hash.FreeCells.empty()) {
+            cellIndex = hash.FreeCells.back();
+            hash.FreeCells.pop_back();
+        }
+        else {
+            cellIndex = static_cast<UINT>(hash.Cells.size());
+            hash.Cells.push_back(SpatialCell());
+        }
+        SpatialCell& cell = hash.Cells[cellIndex];
+        cell.Level = level;
+        cell.X = x;
+        cell.Y = y;
+        cell.Z = z;
+        hash.CellLookup[key] = cellIndex;
+        hash.LevelCellCount[level]++;
+    }
+
+    SpatialCell& cell = hash.Cells[cellIndex];
+    SpatialHashObject& entry = hash.Objects[object];
+    entry.Cell = cellIndex;
+    entry.Slot = static_cast<UINT>(cell.Objects.size());
+    cell.Objects.push_back(object);
+
+    hash.LevelObjectCount[level]++;
+    hash.LevelMaxExtent[level] = std::max<float>(hash.LevelMaxExtent[level], MaxExtent(entry.Bounds));
+}
+
+void UnlinkObject(SpatialHash& hash, UINT object) {
+    SpatialHashObject& entry = hash.Objects[object];
+    SpatialCell& cell = hash.Cells[entry.Cell];
+
+    //Swap with the last object of the cell to keep removal O(1).
+    UINT last = cell.Objects.back();
+    cell.Objects[entry.Slot] = last;
+    hash.Objects[last].Slot = entry.Slot;
+    cell.Objects.pop_back();
+
+    hash.LevelObjectCount[cell.Level]--;
+    if (cell.Objects.empty()) {
+        hash.CellLookup.erase(GetCellKey(cell));
+        hash.LevelCellCount[cell.Level]--;
+        hash.FreeCells.push_back(entry.Cell);
+    }
+
+    entry.Cell = SPATIAL_HASH_INVALID_INDEX;
+    entry.Slot = SPATIAL_HASH_INVALID_INDEX;
+}
+
+//Call visit(cell, looseBounds) for every cell whose loose bounds may overlap [queryMin, queryMax].
+template<class CellVisitor>
+void VisitCells(const SpatialHash& hash, const XMFLOAT3& queryMin, const XMFLOAT3& queryMax, CellVisitor visit) {
+    for (UINT level = 0; level < SPATIAL_HASH_LEVELS; ++level) {
+        if (hash.LevelObjectCount[level] == 0) {
+            continue;
+        }
+
+        float cellSize = CellSize(hash, level);
+        float margin = hash.LevelMaxExtent[level];
+        int x0 = ClampCellCoordinate(queryMin.x - margin, cellSize);
+        int y0 = ClampCellCoordinate(queryMin.y - margin, cellSize);
+        int z0 = ClampCellCoordinate(queryMin.z - margin, cellSize);
+        int x1 = ClampCellCoordinate(queryMax.x + margin, cellSize);
+        int y1 = ClampCellCoordinate(queryMax.y + margin, cellSize);
+        int z1 = ClampCellCoordinate(queryMax.z + margin, cellSize);
+
+        float halfCell = 0.5f * cellSize;
+        XMFLOAT3 looseExtents(halfCell + margin, halfCell + margin, halfCell + margin);
+
+        //Large query volumes scan the live cells of the level instead of every coordinate in range.
+        double rangeCells = static_cast<double>(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+        if (rangeCells > hash.LevelCellCount[level]) {
+            for (const SpatialCell& cell : hash.Cells) {
+                if (cell.Level != level || cell.Objects.empty()
+                    || cell.X < x0 || cell.X > x1 || cell.Y < y0 || cell.Y > y1 || cell.Z < z0 || cell.Z > z1) {
+                    continue;
+                }
+                BoundingBox looseBounds(XMFLOAT3((cell.X + 0.5f) * cellSize, (cell.Y + 0.5f) * cellSize, (cell.Z + 0.5f) * cellSize), looseExtents);
+                visit(cell, looseBounds);
+            }
+            continue;
+        }
+
+        for (int z = z0; z <= z1; ++z) {
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    std::unordered_map<uint64_t, UINT>::const_iterator it = hash.CellLookup.find(MakeCellKey(level, x, y, z));
+                    if (it == hash.CellLookup.end()) {
+                        continue;
+                    }
+                    BoundingBox looseBounds(XMFLOAT3((x + 0.5f) * cellSize, (y + 0.5f) * cellSize, (z + 0.5f) * cellSize), looseExtents);
+                    visit(hash.Cells[it->second], looseBounds);
+                }
+            }
+        }
+    }
+}
+
+}
+
+void InitSpatialHash(SpatialHash& hash, float baseCellSize) {
+    assert(baseCellSize > 0.0f);
+
+    hash.BaseCellSize = baseCellSize;
+    hash.CellLookup.clear();
+    hash.Cells.clear();
+    hash.FreeCells.clear();
+    hash.Objects.clear();
+    hash.BatchKeys.clear();
+    for (UINT level = 0; level < SPATIAL_HASH_LEVELS; ++level) {
+        hash.LevelObjectCount[level] = 0;
+        hash.LevelCellCount[level] = 0;
+        hash.LevelMaxExtent[level] = 0.0f;
+    }
+}
+
+void InsertSpatialHashObject(SpatialHash& hash, UINT object, const BoundingBox& bounds) {
+    if (object >= hash.Objects.size()) {
+        SpatialHashObject empty;
+        empty.Cell = SPATIAL_HASH_INVALID_INDEX;
+        empty.Slot = SPATIAL_HASH_INVALID_INDEX;
+        hash.Objects.resize(object + 1, empty);
+    }
+    assert(hash.Objects[object].Cell == SPATIAL_HASH_INVALID_INDEX);
+
+    UINT level;
+    int x, y, z;
+    uint64_t key = ComputeCellKey(hash, bounds, level, x, y, z);
+    hash.Objects[object].Bounds = bounds;
+    LinkObject(hash, object, key, level, x, y, z);
+}
+
+void MoveSpatialHashObject(SpatialHash& hash, UINT object, const BoundingBox& bounds) {
+    assert(object < hash.Objects.size() && hash.Objects[object].Cell != SPATIAL_HASH_INVALID_INDEX);
+
+    UINT level;
+    int x, y, z;
+    uint64_t key = ComputeCellKey(hash, bounds, level, x, y, z);
+
+    SpatialHashObject& entry = hash.Objects[object];
+    entry.Bounds = bounds;
+    if (key == GetCellKey(hash.Cells[entry.Cell])) {
+        hash.LevelMaxExtent[level] = std::max<float>(hash.LevelMaxExtent[level], MaxExtent(bounds));
+        return;
+    }
+
+    UnlinkObject(hash, object);
+    LinkObject(hash, object, key, level, x, y, z);
+}
+
+void RemoveSpatialHashObject(SpatialHash& hash, UINT object) {
+    assert(object < hash.Objects.size() && hash.Objects[object].Cell != SPATIAL_HASH_INVALID_INDEX);
+    UnlinkObject(hash, object);
+}
+
+void MoveSpatialHashObjects(SpatialHash& hash, const UINT* objects, const BoundingBox* bounds, UINT count) {
+    const uint64_t updatedInPlace = ~0ull;
+    hash.BatchKeys.resize(count);
+
+    //Objects staying in their cell (the common case) only touch their own entry.
+    ParallelFor(count, 1024, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            UINT level;
+            int x, y, z;
+            uint64_t key = ComputeCellKey(hash, bounds[i], level, x, y, z);
+
+            SpatialHashObject& entry = hash.Objects[objects[i]];
+            if (key == GetCellKey(hash.Cells[entry.Cell]) && MaxExtent(bounds[i]) <= hash.LevelMaxExtent[level]) {
+                entry.Bounds = bounds[i];
+                hash.BatchKeys[i] = updatedInPlace;
+            }
+            else {
+                hash.BatchKeys[i] = key;
+            }
+        }
+    });
+
+    for (UINT i = 0; i < count; ++i) {
+        if (hash.BatchKeys[i] != updatedInPlace) {
+            MoveSpatialHashObject(hash, objects[i], bounds[i]);
+        }
+    }
+}
+
+void QuerySpatialHashBox(const SpatialHash& hash, const BoundingBox& box, std::vector<UINT>& results) {
+    XMFLOAT3 queryMin(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+    XMFLOAT3 queryMax(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+    VisitCells(hash, queryMin, queryMax, [&](const SpatialCell& cell, const BoundingBox& looseBounds) {
+        if (!looseBounds.Intersects(box)) {
+            return;
+        }
+        for (UINT object : cell.Objects) {
+            if (hash.Objects[object].Bounds.Intersects(box)) {
+                results.push_back(object);
+            }
+        }
+    });
+}
+
+void QuerySpatialHashSphere(const SpatialHash& hash, const BoundingSphere& sphere, std::vector<UINT>& results) {
+    XMFLOAT3 queryMin(sphere.Center.x - sphere.Radius, sphere.Center.y - sphere.Radius, sphere.Center.z - sphere.Radius);
+    XMFLOAT3 queryMax(sphere.Center.x + sphere.Radius, sphere.Center.y + sphere.Radius, sphere.Center.z + sphere.Radius);
+
+    VisitCells(hash, queryMin, queryMax, [&](const SpatialCell& cell, const BoundingBox& looseBounds) {
+        if (!looseBounds.Intersects(sphere)) {
+            return;
+        }
+        for (UINT object : cell.Objects) {
+            if (hash.Objects[object].Bounds.Intersects(sphere)) {
+                results.push_back(object);
+            }
+        }
+    });
+}
+
+void QuerySpatialHashFrustum(const SpatialHash& hash, const Frustum& frustum, std::vector<UINT>& results) {
+    BoundingBox frustumBounds;
+    ComputeFrustumBounds(frustum, frustumBounds);
+    XMFLOAT3 queryMin(frustumBounds.Center.x - frustumBounds.Extents.x, frustumBounds.Center.y - frustumBounds.Extents.y, frustumBounds.Center.z - frustumBounds.Extents.z);
+    XMFLOAT3 queryMax(frustumBounds.Center.x + frustumBounds.Extents.x, frustumBounds.Center.y + frustumBounds.Extents.y, frustumBounds.Center.z + frustumBounds.Extents.z);
+
+    VisitCells(hash, queryMin, queryMax, [&](const SpatialCell& cell, const BoundingBox& looseBounds) {
+        ContainmentType containment = TestFrustumBox(frustum, looseBounds);
+        if (containment == DISJOINT) {
+            return;
+        }
+        for (UINT object : cell.Objects) {
+            if (containment == CONTAINS || TestFrustumBox(frustum, hash.Objects[object].Bounds) != DISJOINT) {
+                results.push_back(object);
+            }
+        }
+    });
+}
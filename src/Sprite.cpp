@@ -0,0 +1,27 @@
+#include "EchoEngineCore.h"
+#include "Sprite.h"
+using namespace DirectX;
+
+void GenerateSpriteVertices(const Sprite* sprites, UINT count, float viewportWidth, float viewportHeight, SpriteVertex* vertices) {
+    //Pixels from the top left to clip space: x * 2 / width - 1 and 1 - y * 2 / height, for both corners at once.
+    float scaleX = 2.0f / viewportWidth;
+    float scaleY = -2.0f / viewportHeight;
+    XMVECTOR scale = XMVectorSet(scaleX, scaleY, scaleX, scaleY);
+    XMVECTOR bias = XMVectorSet(-1.0f, 1.0f, -1.0f, 1.0f);
+
+    for (UINT i = 0; i < count; ++i, vertices += SPRITE_VERTICES) {
+        const Sprite& sprite = sprites[i];
+        XMVECTOR rect = XMVectorMultiplyAdd(XMLoadFloat4(&sprite.Rect), scale, bias);
+        XMVECTOR texCoords = XMLoadFloat4(&sprite.TexCoords);
+
+        //Position and texture coordinates are adjacent, so each corner is a single four-float store.
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertices[0].Position), XMVectorPermute<0, 1, 4, 5>(rect, texCoords));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertices[1].Position), XMVectorPermute<2, 1, 6, 5>(rect, texCoords));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertices[2].Position), XMVectorPermute<0, 3, 4, 7>(rect, texCoords));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertices[3].Position), XMVectorPermute<2, 3, 6, 7>(rect, texCoords));
+        vertices[0].Color = sprite.Color;
+        vertices[1].Color = sprite.Color;
+        vertices[2].Color = sprite.Color;
+        vertices[3].Color = sprite.Color;
+    }
+}
@@ -0,0 +1,291 @@
+#include "EchoEnginePCH.h"
+#include "SpriteBatch.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "RenderCountersD3D11.h"
+using namespace DirectX;
+
+namespace {
+
+const UINT SPRITE_INDICES = 6;
+//Sprites per job when a flush is split across the job system.
+const UINT SPRITE_BATCH_SIZE = 4096;
+
+template<class IndexType>
+void WriteSpriteIndices(UINT capacity, std::vector<BYTE>& indices) {
+    indices.resize(static_cast<size_t>(capacity) * SPRITE_INDICES * sizeof(IndexType));
+    IndexType* index = reinterpret_cast<IndexType*>(indices.data());
+    for (UINT i = 0; i < capacity; ++i, index += SPRITE_INDICES) {
+        IndexType first = static_cast<IndexType>(i * SPRITE_VERTICES);
+        index[0] = first;
+        index[1] = first + 1;
+        index[2] = first + 2;
+        index[3] = first + 2;
+        index[4] = first + 1;
+        index[5] = first + 3;
+    }
+}
+
+}
+
+bool CreateSpriteBatch(ID3D11Device* device, const void* vertexShaderBytecode, size_t vertexShaderSize, const void* pixelShaderBytecode,
+    size_t pixelShaderSize, SpriteBatch& batch, UINT capacity) {
+    assert(device);
+    ReleaseSpriteBatch(batch);
+
+    D3D11_BUFFER_DESC vertexBufferDesc;
+    ZeroMemory(&vertexBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vertexBufferDesc.ByteWidth = capacity * SPRITE_VERTICES * sizeof(SpriteVertex);
+    vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+    HRESULT hr = DeviceCreateBuffer(device, &vertexBufferDesc, nullptr, &batch.VertexBuffer);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    //16-bit indices while every vertex of the buffer can be reached with them.
+    std::vector<BYTE> indices;
+    if (capacity * SPRITE_VERTICES <= 0x10000) {
+        WriteSpriteIndices<uint16_t>(capacity, indices);
+        batch.IndexFormat = DXGI_FORMAT_R16_UINT;
+    }
+    else {
+        WriteSpriteIndices<uint32_t>(capacity, indices);
+        batch.IndexFormat = DXGI_FORMAT_R32_UINT;
+    }
+
+    D3D11_BUFFER_DESC indexBufferDesc;
+    ZeroMemory(&indexBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    indexBufferDesc.ByteWidth = static_cast<UINT>(indices.size());
+    indexBufferDesc.CPUAccessFlags = 0;
+    indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+
+    D3D11_SUBRESOURCE_DATA resourceData;
+    ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
+    resourceData.pSysMem = indices.data();
+
+    hr = DeviceCreateBuffer(device, &indexBufferDesc, &resourceData, &batch.IndexBuffer);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC vertexLayoutDesc[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(SpriteVertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(SpriteVertex, TexCoord), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(SpriteVertex, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+    hr = device->CreateInputLayout(vertexLayoutDesc, _countof(vertexLayoutDesc), vertexShaderBytecode, vertexShaderSize, &batch.InputLayout);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    hr = device->CreateVertexShader(vertexShaderBytecode, vertexShaderSize, nullptr, &batch.VertexShader);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+    hr = device->CreatePixelShader(pixelShaderBytecode, pixelShaderSize, nullptr, &batch.PixelShader);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    //Straight alpha blending over whatever was drawn before.
+    D3D11_BLEND_DESC blendDesc;
+    ZeroMemory(&blendDesc, sizeof(D3D11_BLEND_DESC));
+
+    blendDesc.RenderTarget[0].BlendEnable = TRUE;
+    blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+    hr = device->CreateBlendState(&blendDesc, &batch.BlendState);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    //Sprites go on top of the scene, so neither depth testing nor culling applies.
+    D3D11_DEPTH_STENCIL_DESC depthStencilDesc;
+    ZeroMemory(&depthStencilDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
+
+    depthStencilDesc.DepthEnable = FALSE;
+    depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    depthStencilDesc.StencilEnable = FALSE;
+
+    hr = device->CreateDepthStencilState(&depthStencilDesc, &batch.DepthStencilState);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    D3D11_RASTERIZER_DESC rasterizerDesc;
+    ZeroMemory(&rasterizerDesc, sizeof(D3D11_RASTERIZER_DESC));
+
+    rasterizerDesc.CullMode = D3D11_CULL_NONE;
+    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    rasterizerDesc.DepthClipEnable = TRUE;
+
+    hr = device->CreateRasterizerState(&rasterizerDesc, &batch.RasterizerState);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    D3D11_SAMPLER_DESC samplerDesc;
+    ZeroMemory(&samplerDesc, sizeof(D3D11_SAMPLER_DESC));
+
+    samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+    samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+    hr = device->CreateSamplerState(&samplerDesc, &batch.SamplerState);
+    if (FAILED(hr)) {
+        ReleaseSpriteBatch(batch);
+        return false;
+    }
+
+    batch.Capacity = capacity;
+    batch.Sprites.reserve(capacity);
+    batch.SortedSprites.reserve(capacity);
+    return true;
+}
+
+void ReleaseSpriteBatch(SpriteBatch& batch) {
+    SafeRelease(batch.VertexBuffer);
+    SafeRelease(batch.IndexBuffer);
+    SafeRelease(batch.InputLayout);
+    SafeRelease(batch.VertexShader);
+    SafeRelease(batch.PixelShader);
+    SafeRelease(batch.BlendState);
+    SafeRelease(batch.DepthStencilState);
+    SafeRelease(batch.RasterizerState);
+    SafeRelease(batch.SamplerState);
+    batch.IndexFormat = DXGI_FORMAT_UNKNOWN;
+    batch.Capacity = 0;
+    std::fill(batch.Atlases, batch.Atlases + SPRITE_BATCH_MAX_ATLASES, nullptr);
+    batch.Sprites.clear();
+    batch.SortedSprites.clear();
+    batch.DroppedSprites = 0;
+}
+
+void SetSpriteAtlas(SpriteBatch& batch, UINT atlas, ID3D11ShaderResourceView* view) {
+    assert(atlas < SPRITE_BATCH_MAX_ATLASES);
+    batch.Atlases[atlas] = view;
+}
+
+void DrawSprite(SpriteBatch& batch, const Sprite& sprite) {
+    if (batch.Sprites.size() >= batch.Capacity || sprite.Atlas >= SPRITE_BATCH_MAX_ATLASES) {
+        ++batch.DroppedSprites;
+        return;
+    }
+    batch.Sprites.push_back(sprite);
+}
+
+bool FlushSprites(ID3D11DeviceContext* deviceContext, SpriteBatch& batch, const D3D11_VIEWPORT& viewport, SpriteBatchStats& stats) {
+    PROFILE_ZONE("FlushSprites");
+    assert(deviceContext);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //Count the sprites of every atlas, then scatter them into their groups in queue order.
+    UINT counts[SPRITE_BATCH_MAX_ATLASES] = {};
+    for (const Sprite& sprite : batch.Sprites) {
+        ++counts[sprite.Atlas];
+    }
+    UINT spriteCount = 0;
+    for (UINT atlas = 0; atlas < SPRITE_BATCH_MAX_ATLASES; ++atlas) {
+        batch.AtlasStarts[atlas] = spriteCount;
+        if (batch.Atlases[atlas]) {
+            spriteCount += counts[atlas];
+        }
+        else {
+            batch.DroppedSprites += counts[atlas];
+        }
+    }
+    batch.AtlasStarts[SPRITE_BATCH_MAX_ATLASES] = spriteCount;
+
+    stats.DroppedSprites += batch.DroppedSprites;
+    batch.DroppedSprites = 0;
+    if (spriteCount == 0) {
+        batch.Sprites.clear();
+        return true;
+    }
+
+    UINT next[SPRITE_BATCH_MAX_ATLASES];
+    std::copy(batch.AtlasStarts, batch.AtlasStarts + SPRITE_BATCH_MAX_ATLASES, next);
+    batch.SortedSprites.resize(spriteCount);
+    for (const Sprite& sprite : batch.Sprites) {
+        if (batch.Atlases[sprite.Atlas]) {
+            batch.SortedSprites[next[sprite.Atlas]++] = sprite;
+        }
+    }
+    batch.Sprites.clear();
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = ContextMap(deviceContext, batch.VertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(hr)) {
+        return false;
+    }
+    SpriteVertex* vertices = static_cast<SpriteVertex*>(mappedResource.pData);
+    const Sprite* sortedSprites = batch.SortedSprites.data();
+    float viewportWidth = viewport.Width;
+    float viewportHeight = viewport.Height;
+    ParallelFor(spriteCount, SPRITE_BATCH_SIZE, [=](UINT begin, UINT end) {
+        GenerateSpriteVertices(sortedSprites + begin, end - begin, viewportWidth, viewportHeight, vertices + static_cast<size_t>(begin) * SPRITE_VERTICES);
+    });
+    ContextUnmap(deviceContext, batch.VertexBuffer, 0, static_cast<uint64_t>(spriteCount) * SPRITE_VERTICES * sizeof(SpriteVertex));
+    stats.GenerateTimeMs += ElapsedMs(start);
+    stats.Sprites += spriteCount;
+
+    UINT stride = sizeof(SpriteVertex);
+    UINT offset = 0;
+    ContextIASetVertexBuffers(deviceContext, 0, 1, &batch.VertexBuffer, &stride, &offset);
+    ContextIASetIndexBuffer(deviceContext, batch.IndexBuffer, batch.IndexFormat, 0);
+    ContextIASetInputLayout(deviceContext, batch.InputLayout);
+    ContextIASetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    ContextVSSetShader(deviceContext, batch.VertexShader);
+    ContextRSSetState(deviceContext, batch.RasterizerState);
+    ContextRSSetViewports(deviceContext, 1, &viewport);
+    ContextPSSetShader(deviceContext, batch.PixelShader);
+    ContextPSSetSamplers(deviceContext, 0, 1, &batch.SamplerState);
+    ContextOMSetBlendState(deviceContext, batch.BlendState, nullptr, 0xFFFFFFFF);
+    ContextOMSetDepthStencilState(deviceContext, batch.DepthStencilState, 0);
+
+    //One draw per atlas. The indices repeat the same quad pattern, so a group's first vertex is its base vertex.
+    for (UINT atlas = 0; atlas < SPRITE_BATCH_MAX_ATLASES; ++atlas) {
+        UINT first = batch.AtlasStarts[atlas];
+        UINT count = batch.AtlasStarts[atlas + 1] - first;
+        if (count == 0) {
+            continue;
+        }
+        ContextPSSetShaderResources(deviceContext, 0, 1, &batch.Atlases[atlas]);
+        ContextDrawIndexed(deviceContext, count * SPRITE_INDICES, 0, static_cast<INT>(first * SPRITE_VERTICES));
+        ++stats.Draws;
+    }
+
+    ContextOMSetBlendState(deviceContext, nullptr, nullptr, 0xFFFFFFFF);
+    return true;
+}
+
+double GetSpriteThroughputMQuads(const SpriteBatchStats& stats) {
+    if (stats.GenerateTimeMs <= 0.0) {
+        return 0.0;
+    }
+    return stats.Sprites / (stats.GenerateTimeMs * 1000.0);
+}
@@ -0,0 +1,215 @@
+#include "EchoEngineCore.h"
+#include "StaticBatch.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace {
+
+//Morton order cells per axis over the bounds of all object centers.
+const UINT STATIC_BATCH_GRID_BITS = 10;
+
+//Spread the low 10 bits of v so that they occupy every third bit.
+inline uint32_t SpreadBits(uint32_t v) {
+    uint32_t x = v & 0x3FF;
+    x = (x | x << 16) & 0x030000FF;
+    x = (x | x << 8) & 0x0300F00F;
+    x = (x | x << 4) & 0x030C30C3;
+    x = (x | x << 2) & 0x09249249;
+    return x;
+}
+
+uint32_t GetMortonCode(FXMVECTOR center, FXMVECTOR gridMin, FXMVECTOR gridScale) {
+    const float maxCell = static_cast<float>((1 << STATIC_BATCH_GRID_BITS) - 1);
+    XMVECTOR cell = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(center, gridMin), gridScale), XMVectorZero(), XMVectorReplicate(maxCell));
+    XMFLOAT3 cellCoords;
+    XMStoreFloat3(&cellCoords, cell);
+    return SpreadBits(static_cast<uint32_t>(cellCoords.x))
+        | SpreadBits(static_cast<uint32_t>(cellCoords.y)) << 1
+        | SpreadBits(static_cast<uint32_t>(cellCoords.z)) << 2;
+}
+
+//Transform the chunk's objects into world space and write its vertices and indices.
+void BuildChunk(StaticBatch& batch, StaticBatchChunk& chunk, const StaticMeshSource* sources, const StaticObject* objects, const UINT* order) {
+    std::vector<XMFLOAT3> positions(chunk.VertexCount);
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+
+    UINT vertex = 0;
+    uint16_t* indices = batch.Indices.data() + chunk.FirstIndex;
+    for (UINT i = 0; i < chunk.ObjectCount; ++i) {
+        const StaticObject& object = objects[order[i]];
+        const StaticMeshSource& source = sources[object.Source];
+        XMMATRIX world = XMLoadFloat4x4(&object.WorldMatrix);
+
+        for (UINT v = 0; v < source.VertexCount; ++v) {
+            XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&source.Positions[v]), world);
+            boundsMin = XMVectorMin(boundsMin, position);
+            boundsMax = XMVectorMax(boundsMax, position);
+            XMStoreFloat3(&positions[vertex + v], position);
+        }
+
+        //Mirroring transforms flip the winding, so swap two corners to keep front faces front facing.
+        bool mirrored = XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f;
+        for (UINT t = 0; t + 2 < source.IndexCount; t += 3) {
+            *indices++ = static_cast<uint16_t>(vertex + source.Indices[t]);
+            *indices++ = static_cast<uint16_t>(vertex + source.Indices[mirrored ? t + 2 : t + 1]);
+            *indices++ = static_cast<uint16_t>(vertex + source.Indices[mirrored ? t + 1 : t + 2]);
+        }
+        vertex += source.VertexCount;
+    }
+
+    BoundingBox::CreateFromPoints(chunk.Bounds, boundsMin, boundsMax);
+    XMVECTOR scale = XMVectorSubtract(boundsMax, boundsMin);
+    XMVECTOR bias = boundsMin;
+    if (batch.VertexFormat == MVF_PositionColor) {
+        scale = XMVectorSplatOne();
+        bias = XMVectorZero();
+    }
+    XMStoreFloat3(&chunk.PositionScale, scale);
+    XMStoreFloat3(&chunk.PositionBias, bias);
+    //Positions map to 0..1 inside the chunk bounds; flat axes have no scale and store 0.
+    XMVECTOR inverseScale = XMVectorSelect(XMVectorReciprocal(scale), XMVectorZero(), XMVectorLessOrEqual(scale, XMVectorZero()));
+
+    vertex = 0;
+    BYTE* vertices = batch.Vertices.data() + static_cast<size_t>(chunk.FirstVertex) * GetVertexFormatStride(batch.VertexFormat);
+    for (UINT i = 0; i < chunk.ObjectCount; ++i) {
+        const StaticMeshSource& source = sources[objects[order[i]].Source];
+        for (UINT v = 0; v < source.VertexCount; ++v, ++vertex) {
+            XMVECTOR color = source.Colors ? XMLoadFloat4(&source.Colors[v]) : XMVectorSplatOne();
+            if (batch.VertexFormat == MVF_PositionColor) {
+                VertexPosColor& output = reinterpret_cast<VertexPosColor*>(vertices)[vertex];
+                output.Position = positions[vertex];
+                XMStoreFloat3(&output.Color, color);
+            }
+            else {
+                VertexCompactPosColor& output = reinterpret_cast<VertexCompactPosColor*>(vertices)[vertex];
+                XMVECTOR position = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&positions[vertex]), bias), inverseScale);
+                XMStoreUShortN4(&output.Position, XMVectorSetW(position, 1.0f));
+                XMStoreUByteN4(&output.Color, color);
+            }
+        }
+    }
+}
+
+}
+
+bool BuildStaticBatch(StaticBatch& batch, MeshVertexFormat vertexFormat, const StaticMeshSource* sources, UINT sourceCount,
+    const StaticObject* objects, UINT objectCount, UINT chunkVertices, StaticBatchStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    batch.Chunks.clear();
+    batch.Vertices.clear();
+    batch.Indices.clear();
+    batch.VertexFormat = vertexFormat;
+    if (vertexFormat != MVF_PositionColor && vertexFormat != MVF_CompactPositionColor) {
+        return false;
+    }
+    chunkVertices = std::min<UINT>(chunkVertices, STATIC_BATCH_MAX_CHUNK_VERTICES);
+
+    //Mesh space bounds of every source, to place the objects.
+    std::vector<BoundingBox> sourceBounds(sourceCount);
+    for (UINT i = 0; i < sourceCount; ++i) {
+        const StaticMeshSource& source = sources[i];
+        if (source.VertexCount == 0 || source.VertexCount > chunkVertices || source.IndexCount == 0 || source.IndexCount % 3 != 0) {
+            return false;
+        }
+        BoundingBox::CreateFromPoints(sourceBounds[i], source.VertexCount, source.Positions, sizeof(XMFLOAT3));
+    }
+
+    std::vector<XMFLOAT3> centers(objectCount);
+    XMVECTOR centersMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR centersMax = XMVectorReplicate(-FLT_MAX);
+    for (UINT i = 0; i < objectCount; ++i) {
+        if (objects[i].Source >= sourceCount) {
+            return false;
+        }
+        BoundingBox worldBounds;
+        sourceBounds[objects[i].Source].Transform(worldBounds, XMLoadFloat4x4(&objects[i].WorldMatrix));
+        XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+        centersMin = XMVectorMin(centersMin, center);
+        centersMax = XMVectorMax(centersMax, center);
+        centers[i] = worldBounds.Center;
+    }
+
+    //Sort by material, then along a Morton curve so consecutive objects, and so every chunk, stay close together.
+    XMVECTOR extent = XMVectorSubtract(centersMax, centersMin);
+    XMVECTOR cells = XMVectorReplicate(static_cast<float>(1 << STATIC_BATCH_GRID_BITS));
+    XMVECTOR gridScale = XMVectorSelect(XMVectorDivide(cells, extent), XMVectorZero(), XMVectorLessOrEqual(extent, XMVectorZero()));
+    std::vector<uint64_t> keys(objectCount);
+    std::vector<UINT> order(objectCount);
+    for (UINT i = 0; i < objectCount; ++i) {
+        keys[i] = static_cast<uint64_t>(objects[i].Material) << 32 | GetMortonCode(XMLoadFloat3(&centers[i]), centersMin, gridScale);
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](UINT a, UINT b) {
+        return keys[a] < keys[b];
+    });
+
+    //Cut the sorted objects into chunks at material changes and when the next object would go over the budget.
+    std::vector<UINT> chunkFirstObjects;
+    UINT vertexCount = 0;
+    UINT indexCount = 0;
+    UINT materialCount = 0;
+    for (UINT i = 0; i < objectCount; ++i) {
+        const StaticObject& object = objects[order[i]];
+        const StaticMeshSource& source = sources[object.Source];
+        bool newMaterial = batch.Chunks.empty() || batch.Chunks.back().Material != object.Material;
+        if (newMaterial || batch.Chunks.back().VertexCount + source.VertexCount > chunkVertices) {
+            StaticBatchChunk chunk = {};
+            chunk.Material = object.Material;
+            chunk.FirstVertex = vertexCount;
+            chunk.FirstIndex = indexCount;
+            batch.Chunks.push_back(chunk);
+            chunkFirstObjects.push_back(i);
+            materialCount += newMaterial ? 1 : 0;
+        }
+        StaticBatchChunk& chunk = batch.Chunks.back();
+        ++chunk.ObjectCount;
+        chunk.VertexCount += source.VertexCount;
+        chunk.IndexCount += source.IndexCount;
+        vertexCount += source.VertexCount;
+        indexCount += source.IndexCount;
+    }
+
+    //Chunks write disjoint ranges, so they are built in parallel.
+    batch.Vertices.resize(static_cast<size_t>(vertexCount) * GetVertexFormatStride(vertexFormat));
+    batch.Indices.resize(indexCount);
+    ParallelFor(static_cast<UINT>(batch.Chunks.size()), 1, [&](UINT begin, UINT end) {
+        for (UINT i = begin; i < end; ++i) {
+            BuildChunk(batch, batch.Chunks[i], sources, objects, order.data() + chunkFirstObjects[i]);
+        }
+    });
+
+    if (stats) {
+        stats->Objects = objectCount;
+        stats->Materials = materialCount;
+        stats->Chunks = static_cast<UINT>(batch.Chunks.size());
+        stats->Vertices = vertexCount;
+        stats->Triangles = indexCount / 3;
+        stats->TimeMs = ElapsedMs(start);
+    }
+    return true;
+}
+
+void CullStaticBatch(const StaticBatch& batch, const Frustum& frustum, std::vector<UINT>& visibleChunks) {
+    PROFILE_ZONE("CullStaticBatch");
+    for (UINT i = 0; i < static_cast<UINT>(batch.Chunks.size()); ++i) {
+        if (TestFrustumBox(frustum, batch.Chunks[i].Bounds) != DISJOINT) {
+            visibleChunks.push_back(i);
+        }
+    }
+}
+
+XMMATRIX GetStaticChunkMatrix(const StaticBatchChunk& chunk) {
+    XMMATRIX scale = XMMatrixScaling(chunk.PositionScale.x, chunk.PositionScale.y, chunk.PositionScale.z);
+    return XMMatrixMultiply(scale, XMMatrixTranslation(chunk.PositionBias.x, chunk.PositionBias.y, chunk.PositionBias.z));
+}
+
+float GetStaticBatchDrawReductionPercent(const StaticBatchStats& stats) {
+    if (stats.Objects == 0) {
+        return 0.0f;
+    }
+    return 100.0f * (1.0f - static_cast<float>(stats.Chunks) / static_cast<float>(stats.Objects));
+}
@@ -0,0 +1,31 @@
+#include "EchoEnginePCH.h"
+#include "StaticBatch.h"
+#include "RenderCountersD3D11.h"
+
+bool UploadStaticBatch(ID3D11Device* device, ID3D11DeviceContext* deviceContext, GeometryBuffer& geometry, StaticBatch& batch) {
+    UINT stride = GetVertexFormatStride(batch.VertexFormat);
+    for (StaticBatchChunk& chunk : batch.Chunks) {
+        if (!AllocateGeometry(device, deviceContext, geometry, batch.VertexFormat, chunk.VertexCount, batch.Vertices.data() + static_cast<size_t>(chunk.FirstVertex) * stride,
+            sizeof(uint16_t), chunk.IndexCount, batch.Indices.data() + chunk.FirstIndex, chunk.Geometry)) {
+            return false;
+        }
+    }
+
+    //The arenas hold the only copy from now on.
+    std::vector<BYTE>().swap(batch.Vertices);
+    std::vector<uint16_t>().swap(batch.Indices);
+    return true;
+}
+
+void ReleaseStaticBatch(GeometryBuffer& geometry, StaticBatch& batch) {
+    for (StaticBatchChunk& chunk : batch.Chunks) {
+        FreeGeometry(geometry, chunk.Geometry);
+    }
+    batch.Chunks.clear();
+    batch.Vertices.clear();
+    batch.Indices.clear();
+}
+
+void DrawStaticBatchChunk(ID3D11DeviceContext* deviceContext, const GeometryBuffer& geometry, const StaticBatchChunk& chunk) {
+    ContextDrawIndexed(deviceContext, chunk.IndexCount, GetGeometryStartIndex(geometry, chunk.Geometry), static_cast<INT>(GetGeometryBaseVertex(geometry, chunk.Geometry)));
+}
@@ -0,0 +1,92 @@
+#include "EchoEnginePCH.h"
+#include "Texture.h"
+#include "RenderCountersD3D11.h"
+
+namespace {
+
+DXGI_FORMAT GetTextureDxgiFormat(TextureFormat format, bool srgb) {
+    switch (format) {
+    case TF_RGBA8:
+        return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+    case TF_BC1:
+        return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    case TF_BC3:
+        return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+    case TF_BC5:
+        return DXGI_FORMAT_BC5_UNORM;
+    case TF_BC7:
+        return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+bool CreateTextureResource(ID3D11Device* device, TextureFormat format, bool srgb, UINT width, UINT height, UINT mipCount, D3D11_USAGE usage,
+    const D3D11_SUBRESOURCE_DATA* levels, Texture& texture) {
+    assert(device);
+    ReleaseTexture(texture);
+    if (format >= NumTextureFormats || width == 0 || height == 0 || mipCount == 0 || mipCount > GetTextureMipCount(width, height)) {
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    ZeroMemory(&textureDesc, sizeof(D3D11_TEXTURE2D_DESC));
+    textureDesc.Width = width;
+    textureDesc.Height = height;
+    textureDesc.MipLevels = mipCount;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = GetTextureDxgiFormat(format, srgb);
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = usage;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = DeviceCreateTexture2D(device, &textureDesc, levels, &texture.Resource);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    ZeroMemory(&viewDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+    viewDesc.Format = textureDesc.Format;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    viewDesc.Texture2D.MostDetailedMip = 0;
+    viewDesc.Texture2D.MipLevels = mipCount;
+
+    hr = device->CreateShaderResourceView(texture.Resource, &viewDesc, &texture.View);
+    if (FAILED(hr)) {
+        SafeRelease(texture.Resource);
+        return false;
+    }
+
+    texture.Format = format;
+    texture.Width = width;
+    texture.Height = height;
+    texture.MipCount = mipCount;
+    return true;
+}
+
+}
+
+bool CreateTexture(ID3D11Device* device, const TextureSource& source, Texture& texture) {
+    //Levels in a texture source are already laid out the way D3D11_SUBRESOURCE_DATA expects.
+    D3D11_SUBRESOURCE_DATA levels[TEXTURE_MAX_MIPS];
+    UINT mipCount = std::min<UINT>(source.MipCount, TEXTURE_MAX_MIPS);
+    for (UINT i = 0; i < mipCount; ++i) {
+        levels[i].pSysMem = source.Mips[i];
+        levels[i].SysMemPitch = GetTextureRowPitch(source.Format, std::max<UINT>(source.Width >> i, 1));
+        levels[i].SysMemSlicePitch = 0;
+    }
+    return CreateTextureResource(device, source.Format, source.Srgb, source.Width, source.Height, source.MipCount, D3D11_USAGE_IMMUTABLE, levels, texture);
+}
+
+bool CreateEmptyTexture(ID3D11Device* device, TextureFormat format, bool srgb, UINT width, UINT height, UINT mipCount, Texture& texture) {
+    return CreateTextureResource(device, format, srgb, width, height, mipCount, D3D11_USAGE_DEFAULT, nullptr, texture);
+}
+
+void ReleaseTexture(Texture& texture) {
+    SafeRelease(texture.View);
+    SafeRelease(texture.Resource);
+    texture.Width = 0;
+    texture.Height = 0;
+    texture.MipCount = 0;
+}
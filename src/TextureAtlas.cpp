@@ -0,0 +1,120 @@
+#include "EchoEnginePCH.h"
+#include "TextureAtlas.h"
+using namespace DirectX;
+
+namespace {
+
+const UINT ATLAS_TEXEL_SIZE = 4;
+
+//Copy an image into its page with its edge texels repeated across the border.
+void CopyAtlasImage(const TextureImage& image, UINT border, UINT x, UINT y, TextureImage& page) {
+    UINT paddedWidth = image.Width + border * 2;
+    UINT paddedHeight = image.Height + border * 2;
+    for (UINT row = 0; row < paddedHeight; ++row) {
+        UINT sourceRow = static_cast<UINT>(std::min<int>(std::max<int>(static_cast<int>(row) - static_cast<int>(border), 0), image.Height - 1));
+        const BYTE* source = &image.Pixels[static_cast<size_t>(sourceRow) * image.Width * ATLAS_TEXEL_SIZE];
+        BYTE* destination = &page.Pixels[(static_cast<size_t>(y + row) * page.Width + x) * ATLAS_TEXEL_SIZE];
+
+        for (UINT i = 0; i < border; ++i) {
+            memcpy(destination + i * ATLAS_TEXEL_SIZE, source, ATLAS_TEXEL_SIZE);
+        }
+        memcpy(destination + border * ATLAS_TEXEL_SIZE, source, static_cast<size_t>(image.Width) * ATLAS_TEXEL_SIZE);
+        const BYTE* lastTexel = source + static_cast<size_t>(image.Width - 1) * ATLAS_TEXEL_SIZE;
+        for (UINT i = border + image.Width; i < paddedWidth; ++i) {
+            memcpy(destination + i * ATLAS_TEXEL_SIZE, lastTexel, ATLAS_TEXEL_SIZE);
+        }
+    }
+}
+
+}
+
+bool BuildTextureAtlas(const TextureImage* images, UINT imageCount, UINT pageSize, UINT border, TextureAtlas& atlas,
+    TextureAtlasStats* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    atlas.PageSize = pageSize;
+    atlas.Pages.clear();
+    atlas.Regions.assign(imageCount, AtlasRegion());
+
+    std::vector<PackedRect> rects(imageCount);
+    for (UINT i = 0; i < imageCount; ++i) {
+        const TextureImage& image = images[i];
+        if (image.Width == 0 || image.Height == 0 || image.Pixels.size() < static_cast<size_t>(image.Width) * image.Height * ATLAS_TEXEL_SIZE) {
+            return false;
+        }
+        rects[i].Width = image.Width + border * 2;
+        rects[i].Height = image.Height + border * 2;
+        if (rects[i].Width > pageSize || rects[i].Height > pageSize) {
+            return false;
+        }
+    }
+
+    //Fill one page with whatever still fits, then open the next for the rest.
+    std::vector<UINT> pending(imageCount);
+    for (UINT i = 0; i < imageCount; ++i) {
+        pending[i] = i;
+    }
+    RectPacker packer;
+    std::vector<PackedRect> pageRects;
+    while (!pending.empty()) {
+        UINT page = static_cast<UINT>(atlas.Pages.size());
+        InitRectPacker(packer, pageSize, pageSize);
+        pageRects.resize(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            pageRects[i] = rects[pending[i]];
+        }
+        PackRects(packer, pageRects.data(), static_cast<UINT>(pageRects.size()));
+
+        std::vector<UINT> remaining;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (!pageRects[i].Packed) {
+                remaining.push_back(pending[i]);
+                continue;
+            }
+            AtlasRegion& region = atlas.Regions[pending[i]];
+            region.Page = page;
+            region.X = pageRects[i].X + border;
+            region.Y = pageRects[i].Y + border;
+            region.Width = images[pending[i]].Width;
+            region.Height = images[pending[i]].Height;
+            float texelSize = 1.0f / static_cast<float>(pageSize);
+            region.TexCoords = XMFLOAT4(region.X * texelSize, region.Y * texelSize, (region.X + region.Width) * texelSize,
+                (region.Y + region.Height) * texelSize);
+        }
+
+        TextureImage pageImage;
+        pageImage.Width = pageSize;
+        pageImage.Height = pageSize;
+        atlas.Pages.push_back(pageImage);
+        pending.swap(remaining);
+    }
+    double packTimeMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    uint64_t imageTexels = 0;
+    for (TextureImage& page : atlas.Pages) {
+        page.Pixels.assign(static_cast<size_t>(pageSize) * pageSize * ATLAS_TEXEL_SIZE, 0);
+    }
+    for (UINT i = 0; i < imageCount; ++i) {
+        const AtlasRegion& region = atlas.Regions[i];
+        CopyAtlasImage(images[i], border, region.X - border, region.Y - border, atlas.Pages[region.Page]);
+        imageTexels += static_cast<uint64_t>(region.Width) * region.Height;
+    }
+
+    if (stats) {
+        stats->Images = imageCount;
+        stats->Pages = static_cast<UINT>(atlas.Pages.size());
+        stats->ImageTexels = imageTexels;
+        stats->PageTexels = static_cast<uint64_t>(pageSize) * pageSize * atlas.Pages.size();
+        stats->PackTimeMs = packTimeMs;
+        stats->CopyTimeMs = ElapsedMs(start);
+    }
+    return true;
+}
+
+float GetTextureAtlasOccupancyPercent(const TextureAtlasStats& stats) {
+    if (stats.PageTexels == 0) {
+        return 0.0f;
+    }
+    return 100.0f * static_cast<float>(stats.ImageTexels) / static_cast<float>(stats.PageTexels);
+}
@@ -0,0 +1,762 @@
+#include "EchoEngineCore.h"
+#include "TextureCooker.h"
+#include "AssetArchive.h"
+#include "JobSystem.h"
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace {
+
+const UINT BLOCK_TEXELS = 16;
+//Steps of the linear to sRGB table; fine enough that the darkest sRGB levels stay apart.
+const UINT LINEAR_TO_SRGB_STEPS = 0xFFFF;
+//Interpolation weights of BC7's 4-bit indices, out of 64.
+const UINT BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline float Dot3(FXMVECTOR a, FXMVECTOR b) {
+    return XMVectorGetX(XMVector3Dot(a, b));
+}
+
+inline float Dot4(FXMVECTOR a, FXMVECTOR b) {
+    return XMVectorGetX(XMVector4Dot(a, b));
+}
+
+inline BYTE RoundToByte(float value) {
+    return static_cast<BYTE>(std::min<float>(std::max<float>(value, 0.0f), 255.0f) + 0.5f);
+}
+
+struct SrgbTables
+{
+    float ToLinear[256];
+    BYTE FromLinear[LINEAR_TO_SRGB_STEPS + 1];
+
+    SrgbTables() {
+        for (UINT i = 0; i < 256; ++i) {
+            float srgb = i / 255.0f;
+            ToLinear[i] = srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+        }
+        for (UINT i = 0; i <= LINEAR_TO_SRGB_STEPS; ++i) {
+            float linear = static_cast<float>(i) / LINEAR_TO_SRGB_STEPS;
+            float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+            FromLinear[i] = RoundToByte(srgb * 255.0f);
+        }
+    }
+};
+
+//Built on first use; thread safe as a function local static.
+const SrgbTables& GetSrgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+//A level in the space its texels are filtered in: linear color, or normals in -1..1.
+struct FilterImage
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    std::vector<XMFLOAT4> Texels;
+};
+
+void DecodeFilterImage(const TextureImage& image, TextureUsage usage, FilterImage& filter) {
+    const SrgbTables& srgb = GetSrgbTables();
+    filter.Width = image.Width;
+    filter.Height = image.Height;
+    filter.Texels.resize(static_cast<size_t>(image.Width) * image.Height);
+
+    ParallelFor(image.Height, 16, [&](UINT begin, UINT end) {
+        for (size_t i = static_cast<size_t>(begin) * image.Width; i < static_cast<size_t>(end) * image.Width; ++i) {
+            const BYTE* texel = &image.Pixels[i * 4];
+            XMFLOAT4& result = filter.Texels[i];
+            if (usage == TU_Color) {
+                result = XMFLOAT4(srgb.ToLinear[texel[0]], srgb.ToLinear[texel[1]], srgb.ToLinear[texel[2]], texel[3] / 255.0f);
+            }
+            else if (usage == TU_NormalMap) {
+                result = XMFLOAT4(texel[0] / 127.5f - 1.0f, texel[1] / 127.5f - 1.0f, texel[2] / 127.5f - 1.0f, texel[3] / 255.0f);
+            }
+            else {
+                result = XMFLOAT4(texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f);
+            }
+        }
+    });
+}
+
+void EncodeFilterImage(const FilterImage& filter, TextureUsage usage, TextureImage& image) {
+    const SrgbTables& srgb = GetSrgbTables();
+    image.Width = filter.Width;
+    image.Height = filter.Height;
+    image.Pixels.resize(filter.Texels.size() * 4);
+
+    ParallelFor(filter.Height, 16, [&](UINT begin, UINT end) {
+        for (size_t i = static_cast<size_t>(begin) * filter.Width; i < static_cast<size_t>(end) * filter.Width; ++i) {
+            const XMFLOAT4& texel = filter.Texels[i];
+            BYTE* result = &image.Pixels[i * 4];
+            if (usage == TU_Color) {
+                result[0] = srgb.FromLinear[static_cast<UINT>(std::min<float>(std::max<float>(texel.x, 0.0f), 1.0f) * LINEAR_TO_SRGB_STEPS + 0.5f)];
+                result[1] = srgb.FromLinear[static_cast<UINT>(std::min<float>(std::max<float>(texel.y, 0.0f), 1.0f) * LINEAR_TO_SRGB_STEPS + 0.5f)];
+                result[2] = srgb.FromLinear[static_cast<UINT>(std::min<float>(std::max<float>(texel.z, 0.0f), 1.0f) * LINEAR_TO_SRGB_STEPS + 0.5f)];
+            }
+            else if (usage == TU_NormalMap) {
+                result[0] = RoundToByte((texel.x + 1.0f) * 127.5f);
+                result[1] = RoundToByte((texel.y + 1.0f) * 127.5f);
+                result[2] = RoundToByte((texel.z + 1.0f) * 127.5f);
+            }
+            else {
+                result[0] = RoundToByte(texel.x * 255.0f);
+                result[1] = RoundToByte(texel.y * 255.0f);
+                result[2] = RoundToByte(texel.z * 255.0f);
+            }
+            result[3] = RoundToByte(texel.w * 255.0f);
+        }
+    });
+}
+
+//2x2 box filter. An odd last row or column is averaged with itself.
+void DownsampleFilterImage(const FilterImage& source, TextureUsage usage, FilterImage& destination) {
+    destination.Width = std::max<UINT>(source.Width / 2, 1);
+    destination.Height = std::max<UINT>(source.Height / 2, 1);
+    destination.Texels.resize(static_cast<size_t>(destination.Width) * destination.Height);
+
+    ParallelFor(destination.Height, 16, [&](UINT begin, UINT end) {
+        for (UINT y = begin; y < end; ++y) {
+            const XMFLOAT4* row0 = &source.Texels[static_cast<size_t>(std::min<UINT>(y * 2, source.Height - 1)) * source.Width];
+            const XMFLOAT4* row1 = &source.Texels[static_cast<size_t>(std::min<UINT>(y * 2 + 1, source.Height - 1)) * source.Width];
+            for (UINT x = 0; x < destination.Width; ++x) {
+                UINT x0 = std::min<UINT>(x * 2, source.Width - 1);
+                UINT x1 = std::min<UINT>(x * 2 + 1, source.Width - 1);
+                XMVECTOR sum = XMVectorAdd(XMVectorAdd(XMLoadFloat4(&row0[x0]), XMLoadFloat4(&row0[x1])),
+                    XMVectorAdd(XMLoadFloat4(&row1[x0]), XMLoadFloat4(&row1[x1])));
+                XMVECTOR average = XMVectorScale(sum, 0.25f);
+                if (usage == TU_NormalMap) {
+                    //Averaged normals shorten; keep alpha as filtered.
+                    float lengthSq = Dot3(average, average);
+                    XMVECTOR normal = lengthSq > 1e-12f ? XMVectorScale(average, 1.0f / sqrtf(lengthSq)) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+                    average = XMVectorSetW(normal, XMVectorGetW(average));
+                }
+                XMStoreFloat4(&destination.Texels[static_cast<size_t>(y) * destination.Width + x], average);
+            }
+        }
+    });
+}
+
+//Texels of a block in 0..255, repeating the last row and column past the edges of the level.
+void LoadBlock(const TextureImage& level, UINT blockX, UINT blockY, XMVECTOR* texels) {
+    for (UINT y = 0; y < 4; ++y) {
+        UINT sourceY = std::min<UINT>(blockY * 4 + y, level.Height - 1);
+        const BYTE* row = &level.Pixels[static_cast<size_t>(sourceY) * level.Width * 4];
+        for (UINT x = 0; x < 4; ++x) {
+            UINT sourceX = std::min<UINT>(blockX * 4 + x, level.Width - 1);
+            texels[y * 4 + x] = XMVectorScale(XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(row + sourceX * 4)), 255.0f);
+        }
+    }
+}
+
+//Ends of the line through the texels along their principal axis, pulled in by insetFraction of its length.
+//Channels the caller zeroed take no part.
+void FitBlockLine(const XMVECTOR* texels, float insetFraction, XMVECTOR& high, XMVECTOR& low) {
+    XMVECTOR mean = XMVectorZero();
+    XMVECTOR minimum = texels[0];
+    XMVECTOR maximum = texels[0];
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        mean = XMVectorAdd(mean, texels[i]);
+        minimum = XMVectorMin(minimum, texels[i]);
+        maximum = XMVectorMax(maximum, texels[i]);
+    }
+    mean = XMVectorScale(mean, 1.0f / BLOCK_TEXELS);
+
+    //Rows of the covariance matrix.
+    XMVECTOR covariance[4] = { XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero() };
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        XMVECTOR offset = XMVectorSubtract(texels[i], mean);
+        covariance[0] = XMVectorMultiplyAdd(offset, XMVectorSplatX(offset), covariance[0]);
+        covariance[1] = XMVectorMultiplyAdd(offset, XMVectorSplatY(offset), covariance[1]);
+        covariance[2] = XMVectorMultiplyAdd(offset, XMVectorSplatZ(offset), covariance[2]);
+        covariance[3] = XMVectorMultiplyAdd(offset, XMVectorSplatW(offset), covariance[3]);
+    }
+
+    //Power iteration, starting from the diagonal of the bounding box. The axis is kept unit length so
+    //the products stay in range for high contrast blocks.
+    XMVECTOR axis = XMVectorSubtract(maximum, minimum);
+    float lengthSq = Dot4(axis, axis);
+    if (lengthSq < 1e-8f) {
+        high = mean;
+        low = mean;
+        return;
+    }
+    axis = XMVectorScale(axis, 1.0f / sqrtf(lengthSq));
+    for (UINT iteration = 0; iteration < 6; ++iteration) {
+        XMVECTOR next = XMVectorMultiply(covariance[0], XMVectorSplatX(axis));
+        next = XMVectorMultiplyAdd(covariance[1], XMVectorSplatY(axis), next);
+        next = XMVectorMultiplyAdd(covariance[2], XMVectorSplatZ(axis), next);
+        next = XMVectorMultiplyAdd(covariance[3], XMVectorSplatW(axis), next);
+        float nextLengthSq = Dot4(next, next);
+        if (nextLengthSq < 1e-8f) {
+            break;
+        }
+        axis = XMVectorScale(next, 1.0f / sqrtf(nextLengthSq));
+    }
+
+    float minimumT = FLT_MAX;
+    float maximumT = -FLT_MAX;
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        float t = Dot4(XMVectorSubtract(texels[i], mean), axis);
+        minimumT = std::min<float>(minimumT, t);
+        maximumT = std::max<float>(maximumT, t);
+    }
+    float inset = (maximumT - minimumT) * insetFraction;
+    high = XMVectorMultiplyAdd(axis, XMVectorReplicate(maximumT - inset), mean);
+    low = XMVectorMultiplyAdd(axis, XMVectorReplicate(minimumT + inset), mean);
+}
+
+//Endpoints that reproduce the texels best in the least squares sense, given each texel's weight of the first one.
+bool SolveEndpoints(const XMVECTOR* texels, const float* weights, XMVECTOR& first, XMVECTOR& second) {
+    float aa = 0.0f;
+    float bb = 0.0f;
+    float ab = 0.0f;
+    XMVECTOR ax = XMVectorZero();
+    XMVECTOR bx = XMVectorZero();
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        float a = weights[i];
+        float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        ax = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(a), ax);
+        bx = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(b), bx);
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f) {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    first = XMVectorScale(XMVectorSubtract(XMVectorScale(ax, bb), XMVectorScale(bx, ab)), inverse);
+    second = XMVectorScale(XMVectorSubtract(XMVectorScale(bx, aa), XMVectorScale(ax, ab)), inverse);
+    return true;
+}
+
+//BC1
+
+//Round to 5:6:5 and return the color the decoder expands it to.
+XMVECTOR QuantizeRgb565(FXMVECTOR color, uint16_t& packed) {
+    XMFLOAT4 value;
+    XMStoreFloat4(&value, XMVectorClamp(color, XMVectorZero(), XMVectorReplicate(255.0f)));
+    UINT r = static_cast<UINT>(value.x * (31.0f / 255.0f) + 0.5f);
+    UINT g = static_cast<UINT>(value.y * (63.0f / 255.0f) + 0.5f);
+    UINT b = static_cast<UINT>(value.z * (31.0f / 255.0f) + 0.5f);
+    packed = static_cast<uint16_t>(r << 11 | g << 5 | b);
+    return XMVectorSet(static_cast<float>(r << 3 | r >> 2), static_cast<float>(g << 2 | g >> 4), static_cast<float>(b << 3 | b >> 2), 0.0f);
+}
+
+//Nearest of the four colors of a BC1 block for every texel. Returns the squared error.
+float SelectBC1Indices(const XMVECTOR* colors, FXMVECTOR color0, FXMVECTOR color1, uint32_t& indices) {
+    XMVECTOR palette[4] = {
+        color0,
+        color1,
+        XMVectorLerp(color0, color1, 1.0f / 3.0f),
+        XMVectorLerp(color0, color1, 2.0f / 3.0f)
+    };
+
+    float error = 0.0f;
+    indices = 0;
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        UINT best = 0;
+        float bestDistance = FLT_MAX;
+        for (UINT p = 0; p < 4; ++p) {
+            XMVECTOR difference = XMVectorSubtract(colors[i], palette[p]);
+            float distance = Dot3(difference, difference);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= best << (i * 2);
+        error += bestDistance;
+    }
+    return error;
+}
+
+//Encode the RGB of the texels. Always uses the four color mode, which BC3 requires of its color block.
+void EncodeBC1Block(const XMVECTOR* texels, BYTE* block) {
+    XMVECTOR colors[BLOCK_TEXELS];
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        colors[i] = XMVectorSetW(texels[i], 0.0f);
+    }
+
+    XMVECTOR high, low;
+    FitBlockLine(colors, 1.0f / 16.0f, high, low);
+    uint16_t packed0, packed1;
+    XMVECTOR color0 = QuantizeRgb565(high, packed0);
+    XMVECTOR color1 = QuantizeRgb565(low, packed1);
+    uint32_t indices;
+    float error = SelectBC1Indices(colors, color0, color1, indices);
+
+    //Refit the endpoints to the indices once and keep the result if it is better.
+    static const float INDEX_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float weights[BLOCK_TEXELS];
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        weights[i] = INDEX_WEIGHTS[(indices >> (i * 2)) & 3];
+    }
+    if (error > 0.0f && SolveEndpoints(colors, weights, high, low)) {
+        uint16_t refined0, refined1;
+        XMVECTOR refinedColor0 = QuantizeRgb565(high, refined0);
+        XMVECTOR refinedColor1 = QuantizeRgb565(low, refined1);
+        uint32_t refinedIndices;
+        if (SelectBC1Indices(colors, refinedColor0, refinedColor1, refinedIndices) < error) {
+            packed0 = refined0;
+            packed1 = refined1;
+            indices = refinedIndices;
+        }
+    }
+
+    //The larger color goes first; swapping the endpoints swaps indices 0 with 1 and 2 with 3.
+    if (packed0 < packed1) {
+        std::swap(packed0, packed1);
+        indices ^= 0x55555555;
+    }
+    else if (packed0 == packed1) {
+        indices = 0;
+    }
+    memcpy(block, &packed0, 2);
+    memcpy(block + 2, &packed1, 2);
+    memcpy(block + 4, &indices, 4);
+}
+
+//BC4, one channel per block, used for BC3 alpha and both BC5 channels.
+
+void EncodeBC4Block(const float* values, BYTE* block) {
+    float minimum = values[0];
+    float maximum = values[0];
+    for (UINT i = 1; i < BLOCK_TEXELS; ++i) {
+        minimum = std::min<float>(minimum, values[i]);
+        maximum = std::max<float>(maximum, values[i]);
+    }
+
+    BYTE value0 = RoundToByte(maximum);
+    BYTE value1 = RoundToByte(minimum);
+    block[0] = value0;
+    block[1] = value1;
+    memset(block + 2, 0, 6);
+    if (value0 == value1) {
+        return;
+    }
+
+    //With value0 above value1 the block holds eight evenly spaced levels, indexed 1, 7, 6, ... 2, 0 from low to high.
+    float scale = 7.0f / (value0 - value1);
+    uint64_t indices = 0;
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        int level = static_cast<int>((values[i] - value1) * scale + 0.5f);
+        level = std::min<int>(std::max<int>(level, 0), 7);
+        uint64_t index = level == 7 ? 0 : level == 0 ? 1 : 8 - level;
+        indices |= index << (i * 3);
+    }
+    for (UINT i = 0; i < 6; ++i) {
+        block[2 + i] = static_cast<BYTE>(indices >> (i * 8));
+    }
+}
+
+void EncodeBC4Channel(const XMVECTOR* texels, UINT channel, BYTE* block) {
+    float values[BLOCK_TEXELS];
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        XMFLOAT4 texel;
+        XMStoreFloat4(&texel, texels[i]);
+        values[i] = (&texel.x)[channel];
+    }
+    EncodeBC4Block(values, block);
+}
+
+//BC7 mode 6
+
+//Round an endpoint to 7 bits per channel plus the shared low bit that fits it best.
+XMVECTOR QuantizeBC7Endpoint(FXMVECTOR value, UINT* quantized, UINT& pBit) {
+    XMFLOAT4 clamped;
+    XMStoreFloat4(&clamped, XMVectorClamp(value, XMVectorZero(), XMVectorReplicate(255.0f)));
+    const float* channels = &clamped.x;
+
+    float bestError = FLT_MAX;
+    for (UINT p = 0; p < 2; ++p) {
+        UINT candidate[4];
+        float error = 0.0f;
+        for (UINT c = 0; c < 4; ++c) {
+            candidate[c] = std::min<UINT>(static_cast<UINT>(std::max<float>(channels[c] - p, 0.0f) * 0.5f + 0.5f), 127);
+            float difference = static_cast<float>(candidate[c] << 1 | p) - channels[c];
+            error += difference * difference;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+    return XMVectorSet(static_cast<float>(quantized[0] << 1 | pBit), static_cast<float>(quantized[1] << 1 | pBit),
+        static_cast<float>(quantized[2] << 1 | pBit), static_cast<float>(quantized[3] << 1 | pBit));
+}
+
+//Nearest of the sixteen colors for every texel, searched around its projection on the line. Returns the squared error.
+float SelectBC7Indices(const XMVECTOR* texels, FXMVECTOR endpoint0, FXMVECTOR endpoint1, BYTE* indices) {
+    XMVECTOR palette[16];
+    for (UINT i = 0; i < 16; ++i) {
+        //The decoder rounds (e0 * (64 - w) + e1 * w + 32) / 64 down.
+        XMVECTOR value = XMVectorMultiplyAdd(endpoint1, XMVectorReplicate(static_cast<float>(BC7_WEIGHTS[i])),
+            XMVectorScale(endpoint0, static_cast<float>(64 - BC7_WEIGHTS[i])));
+        palette[i] = XMVectorFloor(XMVectorScale(XMVectorAdd(value, XMVectorReplicate(32.0f)), 1.0f / 64.0f));
+    }
+
+    XMVECTOR line = XMVectorSubtract(endpoint1, endpoint0);
+    float lineLengthSq = Dot4(line, line);
+    float scale = lineLengthSq > 0.0f ? 15.0f / lineLengthSq : 0.0f;
+
+    float error = 0.0f;
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        float t = Dot4(XMVectorSubtract(texels[i], endpoint0), line) * scale;
+        int guess = std::min<int>(std::max<int>(static_cast<int>(t + 0.5f), 0), 15);
+        int first = std::max<int>(guess - 1, 0);
+        int last = std::min<int>(guess + 1, 15);
+        UINT best = guess;
+        float bestDistance = FLT_MAX;
+        for (int p = first; p <= last; ++p) {
+            XMVECTOR difference = XMVectorSubtract(texels[i], palette[p]);
+            float distance = Dot4(difference, difference);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices[i] = static_cast<BYTE>(best);
+        error += bestDistance;
+    }
+    return error;
+}
+
+//Writes fields of a 128-bit block from the lowest bit up.
+struct BlockBitWriter
+{
+    uint64_t Bits[2] = { 0, 0 };
+    UINT Position = 0;
+
+    void Write(uint64_t value, UINT bitCount) {
+        for (UINT i = 0; i < bitCount; ++i, ++Position) {
+            Bits[Position / 64] |= ((value >> i) & 1) << (Position % 64);
+        }
+    }
+};
+
+void EncodeBC7Block(const XMVECTOR* texels, BYTE* block) {
+    XMVECTOR high, low;
+    FitBlockLine(texels, 1.0f / 32.0f, high, low);
+
+    UINT quantized[2][4];
+    UINT pBits[2];
+    XMVECTOR endpoint0 = QuantizeBC7Endpoint(high, quantized[0], pBits[0]);
+    XMVECTOR endpoint1 = QuantizeBC7Endpoint(low, quantized[1], pBits[1]);
+    BYTE indices[BLOCK_TEXELS];
+    float error = SelectBC7Indices(texels, endpoint0, endpoint1, indices);
+
+    //Refit the endpoints to the indices once and keep the result if it is better.
+    float weights[BLOCK_TEXELS];
+    for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+        weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+    }
+    if (error > 0.0f && SolveEndpoints(texels, weights, high, low)) {
+        UINT refinedQuantized[2][4];
+        UINT refinedPBits[2];
+        XMVECTOR refined0 = QuantizeBC7Endpoint(high, refinedQuantized[0], refinedPBits[0]);
+        XMVECTOR refined1 = QuantizeBC7Endpoint(low, refinedQuantized[1], refinedPBits[1]);
+        BYTE refinedIndices[BLOCK_TEXELS];
+        if (SelectBC7Indices(texels, refined0, refined1, refinedIndices) < error) {
+            memcpy(quantized, refinedQuantized, sizeof(quantized));
+            memcpy(pBits, refinedPBits, sizeof(pBits));
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    //The first texel's index is stored without its top bit, so it must be below 8. The weights are
+    //symmetric, so swapping the endpoints mirrors every index.
+    if (indices[0] >= 8) {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (UINT i = 0; i < BLOCK_TEXELS; ++i) {
+            indices[i] = static_cast<BYTE>(15 - indices[i]);
+        }
+    }
+
+    BlockBitWriter writer;
+    writer.Write(1 << 6, 7);
+    for (UINT c = 0; c < 4; ++c) {
+        writer.Write(quantized[0][c], 7);
+        writer.Write(quantized[1][c], 7);
+    }
+    writer.Write(pBits[0], 1);
+    writer.Write(pBits[1], 1);
+    writer.Write(indices[0], 3);
+    for (UINT i = 1; i < BLOCK_TEXELS; ++i) {
+        writer.Write(indices[i], 4);
+    }
+    memcpy(block, writer.Bits, 16);
+}
+
+void AddCookStats(TextureCookStats& total, const TextureCookStats& stats) {
+    total.MipCount += stats.MipCount;
+    total.Pixels += stats.Pixels;
+    total.UncompressedBytes += stats.UncompressedBytes;
+    total.CookedBytes += stats.CookedBytes;
+    total.MipTimeMs += stats.MipTimeMs;
+    total.EncodeTimeMs += stats.EncodeTimeMs;
+}
+
+}
+
+bool ParseTga(const BYTE* data, size_t size, TextureImage& image) {
+    const size_t HEADER_SIZE = 18;
+    if (size < HEADER_SIZE) {
+        return false;
+    }
+
+    UINT idLength = data[0];
+    UINT colorMapType = data[1];
+    UINT imageType = data[2];
+    UINT width = data[12] | data[13] << 8;
+    UINT height = data[14] | data[15] << 8;
+    UINT bitsPerTexel = data[16];
+    UINT descriptor = data[17];
+
+    //Types 2 and 10 are true color, 3 and 11 grayscale; 10 and 11 are run length encoded.
+    bool grayscale = imageType == 3 || imageType == 11;
+    bool runLength = imageType == 10 || imageType == 11;
+    if (colorMapType != 0 || (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11)
+        || width == 0 || height == 0 || width > TEXTURE_MAX_SIZE || height > TEXTURE_MAX_SIZE
+        || (grayscale ? bitsPerTexel != 8 : bitsPerTexel != 24 && bitsPerTexel != 32)
+        || size < HEADER_SIZE + idLength) {
+        return false;
+    }
+
+    size_t texelBytes = bitsPerTexel / 8;
+    size_t texelCount = static_cast<size_t>(width) * height;
+    const BYTE* source = data + HEADER_SIZE + idLength;
+    const BYTE* end = data + size;
+
+    image.Width = width;
+    image.Height = height;
+    image.Pixels.resize(texelCount * 4);
+    BYTE* destination = image.Pixels.data();
+
+    //Texels are stored BGR(A).
+    auto readTexel = [grayscale, bitsPerTexel](const BYTE* texel, BYTE* result) {
+        if (grayscale) {
+            result[0] = result[1] = result[2] = texel[0];
+            result[3] = 255;
+        }
+        else {
+            result[0] = texel[2];
+            result[1] = texel[1];
+            result[2] = texel[0];
+            result[3] = bitsPerTexel == 32 ? texel[3] : 255;
+        }
+    };
+
+    if (!runLength) {
+        if (static_cast<size_t>(end - source) < texelCount * texelBytes) {
+            return false;
+        }
+        for (size_t i = 0; i < texelCount; ++i, source += texelBytes) {
+            readTexel(source, destination + i * 4);
+        }
+    }
+    else {
+        for (size_t i = 0; i < texelCount;) {
+            if (source >= end) {
+                return false;
+            }
+            BYTE packet = *source++;
+            size_t count = (packet & 0x7F) + 1;
+            bool repeat = (packet & 0x80) != 0;
+            if (i + count > texelCount || static_cast<size_t>(end - source) < (repeat ? 1 : count) * texelBytes) {
+                return false;
+            }
+            for (size_t j = 0; j < count; ++j, ++i) {
+                readTexel(source, destination + i * 4);
+                if (!repeat) {
+                    source += texelBytes;
+                }
+            }
+            if (repeat) {
+                source += texelBytes;
+            }
+        }
+    }
+
+    //Rows are stored bottom up unless the descriptor says otherwise.
+    if (!(descriptor & 0x20)) {
+        size_t rowBytes = static_cast<size_t>(width) * 4;
+        for (UINT y = 0; y < height / 2; ++y) {
+            std::swap_ranges(destination + y * rowBytes, destination + (y + 1) * rowBytes, destination + (height - 1 - y) * rowBytes);
+        }
+    }
+    return true;
+}
+
+bool ImportTexture(const wchar_t* path, TextureImage& image) {
+    if (!HasExtension(path, L".tga")) {
+        return false;
+    }
+
+    std::vector<BYTE> data;
+    if (!ReadWholeFile(path, data)) {
+        return false;
+    }
+    return ParseTga(data.data(), data.size(), image);
+}
+
+void GenerateTextureMips(const TextureImage& image, TextureUsage usage, std::vector<TextureImage>& mips) {
+    mips.clear();
+    mips.push_back(image);
+
+    //Every level is filtered from the one above at full precision and only rounded to bytes for encoding.
+    FilterImage filter[2];
+    DecodeFilterImage(image, usage, filter[0]);
+    for (UINT level = 1; filter[(level - 1) & 1].Width > 1 || filter[(level - 1) & 1].Height > 1; ++level) {
+        const FilterImage& source = filter[(level - 1) & 1];
+        FilterImage& destination = filter[level & 1];
+        DownsampleFilterImage(source, usage, destination);
+        mips.push_back(TextureImage());
+        EncodeFilterImage(destination, usage, mips.back());
+    }
+}
+
+void EncodeTextureLevel(const TextureImage& level, TextureFormat format, std::vector<BYTE>& encoded) {
+    UINT rowPitch = GetTextureRowPitch(format, level.Width);
+    UINT rowCount = GetTextureRowCount(format, level.Height);
+    encoded.resize(static_cast<size_t>(rowPitch) * rowCount);
+    if (!IsBlockCompressed(format)) {
+        memcpy(encoded.data(), level.Pixels.data(), encoded.size());
+        return;
+    }
+
+    UINT blockBytes = GetTextureFormatBlockBytes(format);
+    UINT blocksWide = (level.Width + 3) / 4;
+    ParallelFor(rowCount, 1, [&](UINT begin, UINT end) {
+        XMVECTOR texels[BLOCK_TEXELS];
+        for (UINT blockY = begin; blockY < end; ++blockY) {
+            BYTE* block = encoded.data() + static_cast<size_t>(blockY) * rowPitch;
+            for (UINT blockX = 0; blockX < blocksWide; ++blockX, block += blockBytes) {
+                LoadBlock(level, blockX, blockY, texels);
+                switch (format) {
+                case TF_BC1:
+                    EncodeBC1Block(texels, block);
+                    break;
+                case TF_BC3:
+                    EncodeBC4Channel(texels, 3, block);
+                    EncodeBC1Block(texels, block + 8);
+                    break;
+                case TF_BC5:
+                    EncodeBC4Channel(texels, 0, block);
+                    EncodeBC4Channel(texels, 1, block + 8);
+                    break;
+                case TF_BC7:
+                    EncodeBC7Block(texels, block);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    });
+}
+
+bool CookTexture(const TextureImage& image, const TextureCookSettings& settings, CookedTexture& cooked, TextureCookStats* stats) {
+    if (settings.Format >= NumTextureFormats || image.Width == 0 || image.Height == 0
+        || image.Width > TEXTURE_MAX_SIZE || image.Height > TEXTURE_MAX_SIZE
+        || image.Pixels.size() != static_cast<size_t>(image.Width) * image.Height * 4) {
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<TextureImage> levels;
+    if (settings.GenerateMips) {
+        GenerateTextureMips(image, settings.Usage, levels);
+    }
+    else {
+        levels.push_back(image);
+    }
+    double mipTime = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    cooked.Format = settings.Format;
+    cooked.Srgb = settings.Usage == TU_Color && settings.Format != TF_BC5;
+    cooked.Width = image.Width;
+    cooked.Height = image.Height;
+    cooked.Mips.resize(levels.size());
+    uint64_t pixels = 0;
+    uint64_t cookedBytes = 0;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        EncodeTextureLevel(levels[i], settings.Format, cooked.Mips[i]);
+        pixels += static_cast<uint64_t>(levels[i].Width) * levels[i].Height;
+        cookedBytes += cooked.Mips[i].size();
+    }
+
+    if (stats) {
+        stats->MipCount = static_cast<UINT>(levels.size());
+        stats->Pixels = pixels;
+        stats->UncompressedBytes = pixels * 4;
+        stats->CookedBytes = cookedBytes;
+        stats->MipTimeMs = mipTime;
+        stats->EncodeTimeMs = ElapsedMs(start);
+    }
+    return true;
+}
+
+TextureSource GetCookedTextureSource(const CookedTexture& cooked) {
+    TextureSource source = {};
+    source.Format = cooked.Format;
+    source.Srgb = cooked.Srgb;
+    source.Width = cooked.Width;
+    source.Height = cooked.Height;
+    source.MipCount = static_cast<UINT>(std::min<size_t>(cooked.Mips.size(), TEXTURE_MAX_MIPS));
+    for (UINT i = 0; i < source.MipCount; ++i) {
+        source.Mips[i] = cooked.Mips[i].data();
+    }
+    return source;
+}
+
+double GetTextureEncodeThroughputMPixels(const TextureCookStats& stats) {
+    return stats.EncodeTimeMs > 0.0 ? stats.Pixels / (stats.EncodeTimeMs * 1000.0) : 0.0;
+}
+
+float GetTextureMemorySavedPercent(const TextureCookStats& stats) {
+    return stats.UncompressedBytes > 0 ? 100.0f * (1.0f - static_cast<float>(stats.CookedBytes) / stats.UncompressedBytes) : 0.0f;
+}
+
+bool CookTextureFile(const wchar_t* sourcePath, const wchar_t* outputPath, const TextureCookSettings& settings, TextureCookStats* stats) {
+    TextureImage image;
+    CookedTexture cooked;
+    if (!ImportTexture(sourcePath, image) || !CookTexture(image, settings, cooked, stats)) {
+        return false;
+    }
+    return WriteTextureFile(outputPath, GetCookedTextureSource(cooked));
+}
+
+bool CookTextureArchive(const wchar_t* archivePath, const TextureArchiveSource* sources, UINT sourceCount, TextureCookStats* stats) {
+    TextureCookStats total = {};
+    std::vector<std::vector<BYTE>> files(sourceCount);
+    std::vector<AssetArchiveSource> entries(sourceCount);
+    for (UINT i = 0; i < sourceCount; ++i) {
+        TextureImage image;
+        CookedTexture cooked;
+        TextureCookStats textureStats;
+        if (!ImportTexture(sources[i].SourcePath, image) || !CookTexture(image, sources[i].Settings, cooked, &textureStats)
+            || !BuildTextureFile(GetCookedTextureSource(cooked), files[i])) {
+            return false;
+        }
+        AddCookStats(total, textureStats);
+
+        //Block compressed levels rarely shrink much further; the archive stores entries that do not.
+        entries[i].Path = sources[i].ArchivePath;
+        entries[i].Data = files[i].data();
+        entries[i].Size = files[i].size();
+        entries[i].Compress = true;
+    }
+
+    if (stats) {
+        *stats = total;
+    }
+    return WriteAssetArchive(archivePath, entries.data(), sourceCount);
+}
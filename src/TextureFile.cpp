@@ -0,0 +1,155 @@
+#include "EchoEngineCore.h"
+#include "TextureFile.h"
+
+namespace {
+
+//Check the header and mip table of the file's bytes and point the texture file at them.
+bool ValidateTextureFile(TextureFile& textureFile) {
+    const MappedFile& file = textureFile.File;
+    const TextureFileHeader* header = reinterpret_cast<const TextureFileHeader*>(file.Data);
+    const TextureFileMip* mips = reinterpret_cast<const TextureFileMip*>(file.Data + sizeof(TextureFileHeader));
+    if (file.Size < sizeof(TextureFileHeader) || !IsTextureFileHeaderValid(*header, file.Size) || !IsTextureFileMipTableValid(*header, mips, file.Size)) {
+        CloseTextureFile(textureFile);
+        return false;
+    }
+
+    textureFile.Header = header;
+    textureFile.Mips = mips;
+    return true;
+}
+
+}
+
+bool IsBlockCompressed(TextureFormat format) {
+    return format != TF_RGBA8;
+}
+
+UINT GetTextureFormatBlockBytes(TextureFormat format) {
+    switch (format) {
+    case TF_RGBA8:
+        return 4;
+    case TF_BC1:
+        return 8;
+    case TF_BC3:
+    case TF_BC5:
+    case TF_BC7:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+UINT GetTextureMipCount(UINT width, UINT height) {
+    UINT mipCount = 1;
+    for (UINT size = std::max<UINT>(width, height); size > 1; size >>= 1) {
+        ++mipCount;
+    }
+    return mipCount;
+}
+
+UINT GetTextureRowPitch(TextureFormat format, UINT width) {
+    return (IsBlockCompressed(format) ? (width + 3) / 4 : width) * GetTextureFormatBlockBytes(format);
+}
+
+UINT GetTextureRowCount(TextureFormat format, UINT height) {
+    return IsBlockCompressed(format) ? (height + 3) / 4 : height;
+}
+
+bool IsTextureFileHeaderValid(const TextureFileHeader& header, uint64_t fileSize) {
+    return header.Magic == TEXTURE_FILE_MAGIC && header.Version == TEXTURE_FILE_VERSION && header.Format < NumTextureFormats
+        && header.Width != 0 && header.Height != 0 && header.Width <= TEXTURE_MAX_SIZE && header.Height <= TEXTURE_MAX_SIZE
+        && header.MipCount != 0 && header.MipCount <= GetTextureMipCount(header.Width, header.Height)
+        && fileSize >= sizeof(TextureFileHeader) && header.MipCount * sizeof(TextureFileMip) <= fileSize - sizeof(TextureFileHeader);
+}
+
+bool IsTextureFileMipTableValid(const TextureFileHeader& header, const TextureFileMip* mips, uint64_t fileSize) {
+    TextureFormat format = static_cast<TextureFormat>(header.Format);
+    for (UINT i = 0; i < header.MipCount; ++i) {
+        const TextureFileMip& mip = mips[i];
+        if (mip.Width != std::max<UINT>(header.Width >> i, 1) || mip.Height != std::max<UINT>(header.Height >> i, 1)
+            || mip.RowPitch != GetTextureRowPitch(format, mip.Width) || mip.RowCount != GetTextureRowCount(format, mip.Height)
+            || !IsFileRangeValid(fileSize, mip.DataOffset, static_cast<uint64_t>(mip.RowPitch) * mip.RowCount, TEXTURE_FILE_ALIGNMENT)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OpenTextureFile(TextureFile& textureFile, const wchar_t* path) {
+    CloseTextureFile(textureFile);
+
+    if (!OpenMappedFile(textureFile.File, path)) {
+        return false;
+    }
+    return ValidateTextureFile(textureFile);
+}
+
+bool OpenTextureFileFromMemory(TextureFile& textureFile, std::vector<BYTE>& data) {
+    CloseTextureFile(textureFile);
+
+    if (!OpenMemoryFile(textureFile.File, data)) {
+        return false;
+    }
+    return ValidateTextureFile(textureFile);
+}
+
+void CloseTextureFile(TextureFile& textureFile) {
+    CloseMappedFile(textureFile.File);
+    textureFile.Header = nullptr;
+    textureFile.Mips = nullptr;
+}
+
+const void* GetTextureMipData(const TextureFile& textureFile, UINT mip) {
+    return textureFile.File.Data + textureFile.Mips[mip].DataOffset;
+}
+
+uint64_t GetTextureMipSize(const TextureFile& textureFile, UINT mip) {
+    return static_cast<uint64_t>(textureFile.Mips[mip].RowPitch) * textureFile.Mips[mip].RowCount;
+}
+
+bool BuildTextureFile(const TextureSource& texture, std::vector<BYTE>& data) {
+    data.clear();
+    if (texture.Format >= NumTextureFormats || texture.Width == 0 || texture.Height == 0
+        || texture.Width > TEXTURE_MAX_SIZE || texture.Height > TEXTURE_MAX_SIZE
+        || texture.MipCount == 0 || texture.MipCount > GetTextureMipCount(texture.Width, texture.Height)) {
+        return false;
+    }
+
+    TextureFileHeader header = { TEXTURE_FILE_MAGIC, TEXTURE_FILE_VERSION, texture.Format, texture.Srgb ? TFF_Srgb : 0u,
+        texture.Width, texture.Height, texture.MipCount, 0 };
+
+    //Lay out the levels after the table.
+    TextureFileMip mips[TEXTURE_MAX_MIPS];
+    uint64_t offset = sizeof(TextureFileHeader) + sizeof(TextureFileMip) * static_cast<uint64_t>(texture.MipCount);
+    for (UINT i = 0; i < texture.MipCount; ++i) {
+        TextureFileMip& mip = mips[i];
+        mip.Width = std::max<UINT>(texture.Width >> i, 1);
+        mip.Height = std::max<UINT>(texture.Height >> i, 1);
+        mip.RowPitch = GetTextureRowPitch(texture.Format, mip.Width);
+        mip.RowCount = GetTextureRowCount(texture.Format, mip.Height);
+        mip.DataOffset = AlignFileOffset(offset, TEXTURE_FILE_ALIGNMENT);
+        offset = mip.DataOffset + static_cast<uint64_t>(mip.RowPitch) * mip.RowCount;
+    }
+
+    data.resize(static_cast<size_t>(offset));
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), mips, sizeof(TextureFileMip) * texture.MipCount);
+    for (UINT i = 0; i < texture.MipCount; ++i) {
+        memcpy(data.data() + mips[i].DataOffset, texture.Mips[i], static_cast<size_t>(mips[i].RowPitch) * mips[i].RowCount);
+    }
+    return true;
+}
+
+bool WriteTextureFile(const wchar_t* path, const TextureSource& texture) {
+    std::vector<BYTE> data;
+    if (!BuildTextureFile(texture, data)) {
+        return false;
+    }
+
+    FILE* file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
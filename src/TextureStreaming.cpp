@@ -0,0 +1,435 @@
+#include "EchoEngineCore.h"
+#include "TextureStreaming.h"
+#include "AssetLoader.h"
+#include "VirtualFileSystem.h"
+using namespace DirectX;
+
+namespace {
+
+//Handles are a slot index and the slot's generation, as with asset handles.
+const UINT STREAMED_TEXTURE_INDEX_BITS = 20;
+const uint32_t STREAMED_TEXTURE_INDEX_MASK = (1u << STREAMED_TEXTURE_INDEX_BITS) - 1;
+const uint32_t STREAMED_TEXTURE_GENERATION_MASK = 0xFFFFFFFF >> STREAMED_TEXTURE_INDEX_BITS;
+//Mip tails load ahead of any detail level.
+const int TEXTURE_TAIL_LOAD_PRIORITY = TEXTURE_MAX_MIPS + 1;
+//Closer than this the eye counts as touching the object.
+const float TEXTURE_MIP_MIN_DISTANCE = 1e-3f;
+
+struct StreamedTextureSlot
+{
+    std::wstring Path;
+    TextureFileHeader Header;
+    TextureFileMip Mips[TEXTURE_MAX_MIPS];
+    //Bytes of each level and every coarser one, with a zero past the last level.
+    uint64_t BytesFrom[TEXTURE_MAX_MIPS + 1];
+    UINT TailMip = 0;
+    //First level of Resident, or the mip count while nothing is.
+    UINT ResidentMip = 0;
+    Texture Resident;
+    //Finest level requested this frame, or the mip count if none was.
+    UINT RequestedMip = 0;
+    UINT LastRequestedMip = 0;
+    uint64_t LastRequestFrame = 0;
+    //Finest level wanted and the finest the budget leaves it.
+    UINT WantedMip = 0;
+    UINT TargetMip = 0;
+    //Load of the levels from LoadMip up to ResidentMip.
+    AssetHandle Load = ASSET_HANDLE_NONE;
+    UINT LoadMip = 0;
+    //A texture whose load failed keeps what it has and is not streamed further.
+    bool Failed = false;
+    bool InUse = false;
+    uint32_t Generation = 0;
+};
+
+TextureStreamingDevice g_StreamingDevice;
+std::vector<StreamedTextureSlot> g_StreamedTextures;
+std::vector<uint32_t> g_FreeStreamedTextures;
+uint64_t g_StreamingFrame = 0;
+TextureStreamingStats g_StreamingStats = { 0 };
+
+StreamedTextureSlot* GetStreamedTextureSlot(StreamedTexture texture) {
+    uint32_t index = texture & STREAMED_TEXTURE_INDEX_MASK;
+    if (texture == STREAMED_TEXTURE_NONE || index >= g_StreamedTextures.size()) {
+        return nullptr;
+    }
+    StreamedTextureSlot& slot = g_StreamedTextures[index];
+    return slot.InUse && slot.Generation == texture >> STREAMED_TEXTURE_INDEX_BITS ? &slot : nullptr;
+}
+
+inline uint64_t GetLevelBytes(const StreamedTextureSlot& slot, UINT mip) {
+    return slot.BytesFrom[mip] - slot.BytesFrom[mip + 1];
+}
+
+void CancelStreamedLoad(StreamedTextureSlot& slot) {
+    if (slot.Load != ASSET_HANDLE_NONE) {
+        ReleaseAsset(slot.Load);
+        slot.Load = ASSET_HANDLE_NONE;
+        --g_StreamingStats.PendingLoads;
+    }
+}
+
+//Swap the resident texture for one holding the levels from firstMip on: levels already resident are copied
+//on the GPU, the others are uploaded from data, which holds the file's bytes from the first level's offset.
+bool ReplaceResidentTexture(StreamedTextureSlot& slot, UINT firstMip, const BYTE* data) {
+    const TextureFileMip& first = slot.Mips[firstMip];
+    Texture replacement;
+    if (!g_StreamingDevice.CreateTexture(static_cast<TextureFormat>(slot.Header.Format), (slot.Header.Flags & TFF_Srgb) != 0,
+        first.Width, first.Height, slot.Header.MipCount - firstMip, replacement)) {
+        return false;
+    }
+
+    for (UINT mip = firstMip; mip < slot.Header.MipCount; ++mip) {
+        if (mip >= slot.ResidentMip) {
+            g_StreamingDevice.CopyMip(replacement, mip - firstMip, slot.Resident, mip - slot.ResidentMip);
+        }
+        else {
+            g_StreamingDevice.UploadMip(replacement, mip - firstMip, data + (slot.Mips[mip].DataOffset - first.DataOffset), slot.Mips[mip].RowPitch);
+        }
+    }
+
+    if (slot.ResidentMip < slot.Header.MipCount) {
+        g_StreamingDevice.ReleaseTexture(slot.Resident);
+    }
+    g_StreamingStats.ResidentBytes += slot.BytesFrom[firstMip] - slot.BytesFrom[slot.ResidentMip];
+    slot.Resident = replacement;
+    slot.ResidentMip = firstMip;
+    return true;
+}
+
+//Runs as the upload of a load, on the main thread.
+bool FinishStreamedLoad(StreamedTexture texture, UINT firstMip, UINT endMip, const std::vector<BYTE>& data) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    //Evicting or unregistering a texture cancels its load, so the levels around the load are as they were.
+    if (!slot || slot->ResidentMip != endMip) {
+        return false;
+    }
+    if (!ReplaceResidentTexture(*slot, firstMip, data.data())) {
+        return false;
+    }
+    g_StreamingStats.LevelsLoaded += endMip - firstMip;
+    g_StreamingStats.BytesLoaded += data.size();
+    return true;
+}
+
+//Read the levels from firstMip up to the resident ones as one range of the file.
+void QueueStreamedLoad(StreamedTexture texture, StreamedTextureSlot& slot, UINT firstMip, int priority) {
+    UINT endMip = slot.ResidentMip;
+    const TextureFileMip& last = slot.Mips[endMip - 1];
+    uint64_t offset = slot.Mips[firstMip].DataOffset;
+    uint64_t size = last.DataOffset + static_cast<uint64_t>(last.RowPitch) * last.RowCount - offset;
+
+    //The decode only hands the bytes over to the upload.
+    std::shared_ptr<std::vector<BYTE>> data = std::make_shared<std::vector<BYTE>>();
+    slot.Load = LoadAssetRange(slot.Path.c_str(), offset, size, priority,
+        [data](std::vector<BYTE>& bytes) {
+            data->swap(bytes);
+            return true;
+        },
+        [texture, firstMip, endMip, data](ID3D11Device*, ID3D11DeviceContext*) {
+            return FinishStreamedLoad(texture, firstMip, endMip, *data);
+        });
+    if (slot.Load != ASSET_HANDLE_NONE) {
+        slot.LoadMip = firstMip;
+        ++g_StreamingStats.PendingLoads;
+    }
+}
+
+//Drop the levels finer than the target. A load in flight ends where the old levels started, so it goes too.
+void EvictStreamedLevels(StreamedTextureSlot& slot) {
+    CancelStreamedLoad(slot);
+    UINT evicted = slot.TargetMip - slot.ResidentMip;
+    if (ReplaceResidentTexture(slot, slot.TargetMip, nullptr)) {
+        g_StreamingStats.LevelsEvicted += evicted;
+    }
+}
+
+//Largest wanted level first.
+struct TrimOrder
+{
+    bool operator()(const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) const {
+        return a.first < b.first;
+    }
+};
+
+}
+
+void InitTextureStreaming(const TextureStreamingDevice& device, uint64_t budgetBytes) {
+    assert(g_StreamedTextures.empty());
+    g_StreamingDevice = device;
+    g_StreamingFrame = 0;
+    g_StreamingStats = TextureStreamingStats();
+    g_StreamingStats.BudgetBytes = budgetBytes;
+}
+
+void ShutdownTextureStreaming() {
+    for (uint32_t i = 0; i < g_StreamedTextures.size(); ++i) {
+        StreamedTextureSlot& slot = g_StreamedTextures[i];
+        if (slot.InUse) {
+            UnregisterStreamedTexture(slot.Generation << STREAMED_TEXTURE_INDEX_BITS | i);
+        }
+    }
+    g_StreamedTextures.clear();
+    g_FreeStreamedTextures.clear();
+    g_StreamingDevice = TextureStreamingDevice();
+}
+
+void SetTextureStreamingBudget(uint64_t budgetBytes) {
+    g_StreamingStats.BudgetBytes = budgetBytes;
+}
+
+StreamedTexture RegisterStreamedTexture(const wchar_t* path) {
+    //The header and table are a few hundred bytes; reading them now lets the first update plan loads.
+    TextureFileHeader header;
+    TextureFileMip mips[TEXTURE_MAX_MIPS];
+    VfsFile file;
+    if (!VfsOpenFile(file, path, FA_Random)) {
+        return STREAMED_TEXTURE_NONE;
+    }
+    bool valid = file.Size >= sizeof(header) && VfsReadFile(file, 0, &header, sizeof(header)) && IsTextureFileHeaderValid(header, file.Size)
+        && VfsReadFile(file, sizeof(header), mips, header.MipCount * sizeof(TextureFileMip)) && IsTextureFileMipTableValid(header, mips, file.Size);
+    VfsCloseFile(file);
+    if (!valid) {
+        return STREAMED_TEXTURE_NONE;
+    }
+
+    uint32_t index;
+    if (!g_FreeStreamedTextures.empty()) {
+        index = g_FreeStreamedTextures.back();
+        g_FreeStreamedTextures.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(g_StreamedTextures.size());
+        if (index > STREAMED_TEXTURE_INDEX_MASK) {
+            return STREAMED_TEXTURE_NONE;
+        }
+        g_StreamedTextures.push_back(StreamedTextureSlot());
+    }
+
+    StreamedTextureSlot& slot = g_StreamedTextures[index];
+    slot.Path = path;
+    slot.Header = header;
+    memcpy(slot.Mips, mips, header.MipCount * sizeof(TextureFileMip));
+    slot.BytesFrom[header.MipCount] = 0;
+    for (UINT mip = header.MipCount; mip-- > 0;) {
+        slot.BytesFrom[mip] = slot.BytesFrom[mip + 1] + static_cast<uint64_t>(mips[mip].RowPitch) * mips[mip].RowCount;
+    }
+    //Files that stop short of 1x1 keep at least their last level.
+    slot.TailMip = 0;
+    while (slot.TailMip + 1 < header.MipCount && std::max<UINT>(mips[slot.TailMip].Width, mips[slot.TailMip].Height) > TEXTURE_STREAMING_TAIL_SIZE) {
+        ++slot.TailMip;
+    }
+    slot.ResidentMip = header.MipCount;
+    slot.Resident = Texture();
+    slot.RequestedMip = header.MipCount;
+    slot.LastRequestedMip = slot.TailMip;
+    slot.LastRequestFrame = 0;
+    slot.WantedMip = slot.TailMip;
+    slot.TargetMip = slot.TailMip;
+    slot.Load = ASSET_HANDLE_NONE;
+    slot.Failed = false;
+    slot.InUse = true;
+    ++g_StreamingStats.Textures;
+
+    StreamedTexture texture = slot.Generation << STREAMED_TEXTURE_INDEX_BITS | index;
+    QueueStreamedLoad(texture, slot, slot.TailMip, TEXTURE_TAIL_LOAD_PRIORITY);
+    return texture;
+}
+
+void UnregisterStreamedTexture(StreamedTexture texture) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    if (!slot) {
+        return;
+    }
+
+    CancelStreamedLoad(*slot);
+    if (slot->ResidentMip < slot->Header.MipCount) {
+        g_StreamingStats.ResidentBytes -= slot->BytesFrom[slot->ResidentMip];
+        g_StreamingDevice.ReleaseTexture(slot->Resident);
+    }
+    --g_StreamingStats.Textures;
+
+    slot->InUse = false;
+    slot->Generation = (slot->Generation + 1) & STREAMED_TEXTURE_GENERATION_MASK;
+    slot->Path.clear();
+    g_FreeStreamedTextures.push_back(texture & STREAMED_TEXTURE_INDEX_MASK);
+}
+
+ID3D11ShaderResourceView* GetStreamedTextureView(StreamedTexture texture) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    return slot && slot->ResidentMip < slot->Header.MipCount ? slot->Resident.View : nullptr;
+}
+
+UINT GetStreamedTextureResidentMip(StreamedTexture texture) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    return slot ? slot->ResidentMip : 0;
+}
+
+UINT ComputeTextureMip(UINT textureWidth, UINT textureHeight, float textureWorldSize, const BoundingBox& worldBounds, FXMVECTOR eyePosition, float projectionScale) {
+    //Measure at the nearest point of the box, where the texture is magnified the most.
+    XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+    XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+    XMVECTOR nearest = XMVectorClamp(eyePosition, XMVectorSubtract(center, extents), XMVectorAdd(center, extents));
+    float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(eyePosition, nearest)));
+    if (distance <= TEXTURE_MIP_MIN_DISTANCE || textureWorldSize <= 0.0f) {
+        return 0;
+    }
+
+    //Each level halves the texels; the level where one texel covers about a pixel is the one needed.
+    float texelsPerUnit = std::max<UINT>(textureWidth, textureHeight) / textureWorldSize;
+    float pixelsPerUnit = projectionScale / distance;
+    float texelsPerPixel = texelsPerUnit / pixelsPerUnit;
+    if (texelsPerPixel <= 1.0f) {
+        return 0;
+    }
+    UINT mip = static_cast<UINT>(log2f(texelsPerPixel));
+    return std::min<UINT>(mip, GetTextureMipCount(textureWidth, textureHeight) - 1);
+}
+
+void RequestStreamedTextureMip(StreamedTexture texture, UINT mip) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    if (slot) {
+        slot->RequestedMip = std::min<UINT>(slot->RequestedMip, mip);
+    }
+}
+
+void RequestStreamedTexture(StreamedTexture texture, float textureWorldSize, const BoundingBox& worldBounds, FXMVECTOR eyePosition, float projectionScale) {
+    StreamedTextureSlot* slot = GetStreamedTextureSlot(texture);
+    if (slot) {
+        UINT mip = ComputeTextureMip(slot->Header.Width, slot->Header.Height, textureWorldSize, worldBounds, eyePosition, projectionScale);
+        slot->RequestedMip = std::min<UINT>(slot->RequestedMip, mip);
+    }
+}
+
+void UpdateTextureStreaming() {
+    ++g_StreamingFrame;
+    uint64_t budget = g_StreamingStats.BudgetBytes;
+
+    //Retire finished loads and work out what every texture wants.
+    uint64_t requestedBytes = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> trimQueue;
+    for (uint32_t i = 0; i < g_StreamedTextures.size(); ++i) {
+        StreamedTextureSlot& slot = g_StreamedTextures[i];
+        if (!slot.InUse) {
+            continue;
+        }
+
+        if (slot.Load != ASSET_HANDLE_NONE) {
+            AssetState state = GetAssetState(slot.Load);
+            if (state == AS_Loaded || state == AS_Failed || state == AS_Cancelled) {
+                if (state != AS_Loaded) {
+                    slot.Failed = true;
+                    ++g_StreamingStats.FailedLoads;
+                }
+                CancelStreamedLoad(slot);
+            }
+        }
+
+        if (slot.RequestedMip < slot.Header.MipCount) {
+            slot.LastRequestedMip = slot.RequestedMip;
+            slot.LastRequestFrame = g_StreamingFrame;
+        }
+        slot.RequestedMip = slot.Header.MipCount;
+        bool recent = g_StreamingFrame - slot.LastRequestFrame < TEXTURE_STREAMING_KEEP_FRAMES;
+        slot.WantedMip = recent ? std::min<UINT>(slot.LastRequestedMip, slot.TailMip) : slot.TailMip;
+        slot.TargetMip = slot.WantedMip;
+        requestedBytes += slot.BytesFrom[slot.WantedMip];
+        if (slot.TargetMip < slot.TailMip) {
+            trimQueue.push_back(std::make_pair(GetLevelBytes(slot, slot.TargetMip), i));
+        }
+    }
+
+    //Over budget, give up the largest wanted level until the rest fits. Big levels go first, which
+    //evens out the detail of the textures rather than taking it all from a few.
+    uint64_t targetBytes = requestedBytes;
+    if (targetBytes > budget) {
+        ++g_StreamingStats.TrimmedFrames;
+        std::make_heap(trimQueue.begin(), trimQueue.end(), TrimOrder());
+        while (targetBytes > budget && !trimQueue.empty()) {
+            std::pop_heap(trimQueue.begin(), trimQueue.end(), TrimOrder());
+            StreamedTextureSlot& slot = g_StreamedTextures[trimQueue.back().second];
+            trimQueue.pop_back();
+            targetBytes -= GetLevelBytes(slot, slot.TargetMip);
+            ++slot.TargetMip;
+            if (slot.TargetMip < slot.TailMip) {
+                trimQueue.push_back(std::make_pair(GetLevelBytes(slot, slot.TargetMip), static_cast<uint32_t>(&slot - g_StreamedTextures.data())));
+                std::push_heap(trimQueue.begin(), trimQueue.end(), TrimOrder());
+            }
+        }
+    }
+
+    //Levels beyond the target stay resident as long as they and the loads fit in the budget. Past
+    //that, the textures requested longest ago lose them first.
+    uint64_t keptBytes = 0;
+    std::vector<uint32_t> evictable;
+    for (uint32_t i = 0; i < g_StreamedTextures.size(); ++i) {
+        StreamedTextureSlot& slot = g_StreamedTextures[i];
+        if (!slot.InUse) {
+            continue;
+        }
+        keptBytes += slot.BytesFrom[std::min<UINT>(slot.ResidentMip, slot.TargetMip)];
+        if (slot.ResidentMip < slot.TargetMip) {
+            evictable.push_back(i);
+        }
+    }
+    if (keptBytes > budget) {
+        std::sort(evictable.begin(), evictable.end(), [](uint32_t a, uint32_t b) {
+            return g_StreamedTextures[a].LastRequestFrame < g_StreamedTextures[b].LastRequestFrame;
+        });
+        for (uint32_t index : evictable) {
+            if (keptBytes <= budget) {
+                break;
+            }
+            StreamedTextureSlot& slot = g_StreamedTextures[index];
+            keptBytes -= slot.BytesFrom[slot.ResidentMip] - slot.BytesFrom[slot.TargetMip];
+            EvictStreamedLevels(slot);
+        }
+    }
+
+    //Queue the missing levels. A load that reaches finer than the target is dropped; one that falls short
+    //finishes first and the rest follows in a later update.
+    UINT residentTextures = 0;
+    for (uint32_t i = 0; i < g_StreamedTextures.size(); ++i) {
+        StreamedTextureSlot& slot = g_StreamedTextures[i];
+        if (!slot.InUse) {
+            continue;
+        }
+        StreamedTexture texture = slot.Generation << STREAMED_TEXTURE_INDEX_BITS | i;
+        bool tailResident = slot.ResidentMip < slot.Header.MipCount;
+        if (tailResident && slot.Load != ASSET_HANDLE_NONE && slot.LoadMip < slot.TargetMip) {
+            CancelStreamedLoad(slot);
+        }
+        if (tailResident && !slot.Failed && slot.TargetMip < slot.ResidentMip) {
+            //The more levels a texture misses, the sooner it loads.
+            int priority = static_cast<int>(slot.ResidentMip - slot.TargetMip);
+            if (slot.Load == ASSET_HANDLE_NONE) {
+                QueueStreamedLoad(texture, slot, slot.TargetMip, priority);
+            }
+            else {
+                SetAssetPriority(slot.Load, priority);
+            }
+        }
+        if (slot.ResidentMip <= slot.WantedMip) {
+            ++residentTextures;
+        }
+    }
+
+    g_StreamingStats.ResidentTextures = residentTextures;
+    g_StreamingStats.RequestedBytes = requestedBytes;
+    g_StreamingStats.TargetBytes = targetBytes;
+    if (g_StreamingStats.ResidentBytes > budget) {
+        ++g_StreamingStats.OverrunFrames;
+    }
+}
+
+void GetTextureStreamingStats(TextureStreamingStats& stats) {
+    stats = g_StreamingStats;
+}
+
+float GetTextureResidencyPercent(const TextureStreamingStats& stats) {
+    return stats.Textures > 0 ? 100.0f * stats.ResidentTextures / stats.Textures : 100.0f;
+}
+
+float GetTextureBudgetUsePercent(const TextureStreamingStats& stats) {
+    return stats.BudgetBytes > 0 ? 100.0f * static_cast<float>(stats.ResidentBytes) / stats.BudgetBytes : 0.0f;
+}
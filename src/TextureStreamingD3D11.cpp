@@ -0,0 +1,21 @@
+#include "EchoEnginePCH.h"
+#include "TextureStreaming.h"
+#include "RenderCountersD3D11.h"
+
+TextureStreamingDevice GetD3D11TextureStreamingDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext) {
+    TextureStreamingDevice streamingDevice;
+    streamingDevice.CreateTexture = [device](TextureFormat format, bool srgb, UINT width, UINT height, UINT mipCount, Texture& texture) {
+        return CreateEmptyTexture(device, format, srgb, width, height, mipCount, texture);
+    };
+    streamingDevice.UploadMip = [deviceContext](Texture& texture, UINT mip, const void* data, UINT rowPitch) {
+        UINT rows = GetTextureRowCount(texture.Format, std::max<UINT>(texture.Height >> mip, 1));
+        ContextUpdateSubresource(deviceContext, texture.Resource, mip, nullptr, data, rowPitch, 0, static_cast<uint64_t>(rowPitch) * rows);
+    };
+    streamingDevice.CopyMip = [deviceContext](Texture& destination, UINT destinationMip, const Texture& source, UINT sourceMip) {
+        ContextCopySubresourceRegion(deviceContext, destination.Resource, destinationMip, 0, 0, 0, source.Resource, sourceMip, nullptr);
+    };
+    streamingDevice.ReleaseTexture = [](Texture& texture) {
+        ReleaseTexture(texture);
+    };
+    return streamingDevice;
+}
@@ -0,0 +1,356 @@
+#include "EchoEngineCore.h"
+#include "VirtualFileSystem.h"
+#include "AssetArchive.h"
+
+enum VfsMountType {
+    VMT_Directory,
+    VMT_Archive,
+    VMT_Memory
+};
+
+struct VfsMountData
+{
+    VfsMount Id = VFS_MOUNT_NONE;
+    VfsMountType Type = VMT_Directory;
+    int Priority = 0;
+    // Lowercase with forward slashes, and a trailing slash unless it is the root. The whole path of a memory file.
+    std::wstring MountPoint;
+    // Ends with a slash.
+    std::wstring Directory;
+    AssetArchive Archive;
+    const BYTE* Data = nullptr;
+    uint64_t Size = 0;
+
+    ~VfsMountData() {
+        CloseAssetArchive(Archive);
+    }
+};
+
+namespace {
+
+typedef std::vector<std::shared_ptr<VfsMountData>> VfsMountList;
+
+//Highest priority first. Readers take a reference to the current list and search it without the lock;
+//mounting and unmounting replace the list.
+std::shared_ptr<const VfsMountList> g_Mounts = std::make_shared<VfsMountList>();
+std::mutex g_VfsMutex;
+VfsMount g_NextMount = 0;
+std::thread::id g_MainThread;
+
+std::atomic<UINT> g_Opens{ 0 };
+std::atomic<UINT> g_Misses{ 0 };
+std::atomic<uint64_t> g_BytesRead{ 0 };
+std::atomic<uint64_t> g_BlockedNs{ 0 };
+std::atomic<uint64_t> g_MainThreadBlockedNs{ 0 };
+//Totals at the end of the previous frame. Only touched by the main thread.
+VfsStats g_FrameStart = { 0 };
+
+//Adds the time until it goes out of scope to the blocked time of the calling thread.
+struct BlockedTimer
+{
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    ~BlockedTimer() {
+        uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count());
+        g_BlockedNs += elapsed;
+        if (std::this_thread::get_id() == g_MainThread) {
+            g_MainThreadBlockedNs += elapsed;
+        }
+    }
+};
+
+//Forward slashes, no leading "./" or slashes and no empty directories.
+std::wstring NormalizePath(const wchar_t* path) {
+    std::wstring result;
+    for (const wchar_t* c = path; *c; ++c) {
+        wchar_t character = *c == L'\\' ? L'/' : *c;
+        if (character == L'/' && (result.empty() || result.back() == L'/')) {
+            continue;
+        }
+        if (character == L'.' && result.empty() && (c[1] == L'/' || c[1] == L'\\')) {
+            ++c;
+            continue;
+        }
+        result.push_back(character);
+    }
+    return result;
+}
+
+std::wstring NormalizeMountPoint(const wchar_t* path, bool directory) {
+    std::wstring result = NormalizePath(path);
+    std::transform(result.begin(), result.end(), result.begin(), towlower);
+    if (directory && !result.empty() && result.back() != L'/') {
+        result.push_back(L'/');
+    }
+    return result;
+}
+
+//Whether the mount covers the path, and the path relative to the mount point if it does.
+bool MatchMount(const VfsMountData& mount, const std::wstring& path, std::wstring& relativePath) {
+    size_t length = mount.MountPoint.size();
+    if (mount.Type == VMT_Memory ? path.size() != length : path.size() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (static_cast<wchar_t>(towlower(path[i])) != mount.MountPoint[i]) {
+            return false;
+        }
+    }
+    relativePath.assign(path, length, std::wstring::npos);
+    return true;
+}
+
+std::shared_ptr<const VfsMountList> GetMounts() {
+    std::lock_guard<std::mutex> lock(g_VfsMutex);
+    return g_Mounts;
+}
+
+//Call function(mount, relativePath) for the mounts covering the path in priority order until one returns true.
+template<class Function>
+bool FindInMounts(const wchar_t* path, Function function) {
+    std::wstring virtualPath = NormalizePath(path);
+    std::shared_ptr<const VfsMountList> mounts = GetMounts();
+    std::wstring relativePath;
+    for (const std::shared_ptr<VfsMountData>& mount : *mounts) {
+        if (MatchMount(*mount, virtualPath, relativePath) && function(mount, relativePath)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OpenFromMount(const std::shared_ptr<VfsMountData>& mount, const std::wstring& relativePath, FileAccess access, VfsFile& file) {
+    switch (mount->Type) {
+    case VMT_Directory:
+        if (!OpenReadOnlyFile(file.Loose, (mount->Directory + relativePath).c_str(), access)) {
+            return false;
+        }
+        file.Size = file.Loose.Size;
+        break;
+    case VMT_Archive: {
+        UINT entry = FindAssetArchiveEntry(mount->Archive, relativePath.c_str());
+        if (entry == ASSET_ARCHIVE_ENTRY_NONE) {
+            return false;
+        }
+        const AssetArchiveEntry& archiveEntry = mount->Archive.Entries[entry];
+        file.Data = static_cast<const BYTE*>(GetAssetArchiveEntryData(mount->Archive, entry));
+        if (file.Data) {
+            AdviseMappedFile(mount->Archive.File, archiveEntry.DataOffset, archiveEntry.StoredSize, access);
+        }
+        else {
+            //The chunks are read once, front to back, whatever the caller does with the result.
+            AdviseMappedFile(mount->Archive.File, archiveEntry.DataOffset, archiveEntry.StoredSize, FA_Sequential);
+            if (!ReadAssetArchiveEntry(mount->Archive, entry, file.Memory)) {
+                return false;
+            }
+            file.Data = file.Memory.data();
+        }
+        file.Size = archiveEntry.Size;
+        break;
+    }
+    case VMT_Memory:
+        file.Data = mount->Data;
+        file.Size = mount->Size;
+        break;
+    }
+
+    file.Mount = mount;
+    return true;
+}
+
+VfsMount AddMount(const std::shared_ptr<VfsMountData>& mount) {
+    std::lock_guard<std::mutex> lock(g_VfsMutex);
+    mount->Id = g_NextMount++;
+
+    //A new mount goes in front of the older mounts of its priority.
+    std::shared_ptr<VfsMountList> mounts = std::make_shared<VfsMountList>(*g_Mounts);
+    auto position = std::find_if(mounts->begin(), mounts->end(),
+        [&mount](const std::shared_ptr<VfsMountData>& other) { return other->Priority <= mount->Priority; });
+    mounts->insert(position, mount);
+    g_Mounts = mounts;
+    return mount->Id;
+}
+
+}
+
+void InitVirtualFileSystem() {
+    g_MainThread = std::this_thread::get_id();
+    g_Opens = 0;
+    g_Misses = 0;
+    g_BytesRead = 0;
+    g_BlockedNs = 0;
+    g_MainThreadBlockedNs = 0;
+    g_FrameStart = VfsStats();
+}
+
+void ShutdownVirtualFileSystem() {
+    std::lock_guard<std::mutex> lock(g_VfsMutex);
+    g_Mounts = std::make_shared<VfsMountList>();
+}
+
+VfsMount MountDirectory(const wchar_t* mountPoint, const wchar_t* directory, int priority) {
+    std::shared_ptr<VfsMountData> mount = std::make_shared<VfsMountData>();
+    mount->Type = VMT_Directory;
+    mount->Priority = priority;
+    mount->MountPoint = NormalizeMountPoint(mountPoint, true);
+    mount->Directory = directory;
+    if (!mount->Directory.empty() && mount->Directory.back() != L'/' && mount->Directory.back() != L'\\') {
+        mount->Directory.push_back(L'/');
+    }
+    return AddMount(mount);
+}
+
+VfsMount MountArchive(const wchar_t* mountPoint, const wchar_t* archivePath, int priority) {
+    std::shared_ptr<VfsMountData> mount = std::make_shared<VfsMountData>();
+    mount->Type = VMT_Archive;
+    mount->Priority = priority;
+    mount->MountPoint = NormalizeMountPoint(mountPoint, true);
+    {
+        BlockedTimer timer;
+        if (!OpenAssetArchive(mount->Archive, archivePath)) {
+            return VFS_MOUNT_NONE;
+        }
+    }
+    return AddMount(mount);
+}
+
+VfsMount MountMemoryFile(const wchar_t* path, const void* data, uint64_t size, int priority) {
+    std::shared_ptr<VfsMountData> mount = std::make_shared<VfsMountData>();
+    mount->Type = VMT_Memory;
+    mount->Priority = priority;
+    mount->MountPoint = NormalizeMountPoint(path, false);
+    mount->Data = static_cast<const BYTE*>(data);
+    mount->Size = size;
+    return AddMount(mount);
+}
+
+void Unmount(VfsMount mount) {
+    std::lock_guard<std::mutex> lock(g_VfsMutex);
+    std::shared_ptr<VfsMountList> mounts = std::make_shared<VfsMountList>(*g_Mounts);
+    mounts->erase(std::remove_if(mounts->begin(), mounts->end(),
+        [mount](const std::shared_ptr<VfsMountData>& other) { return other->Id == mount; }), mounts->end());
+    g_Mounts = mounts;
+}
+
+bool VfsFileExists(const wchar_t* path) {
+    BlockedTimer timer;
+    return FindInMounts(path, [](const std::shared_ptr<VfsMountData>& mount, const std::wstring& relativePath) {
+        switch (mount->Type) {
+        case VMT_Directory:
+            return FileExists((mount->Directory + relativePath).c_str());
+        case VMT_Archive:
+            return FindAssetArchiveEntry(mount->Archive, relativePath.c_str()) != ASSET_ARCHIVE_ENTRY_NONE;
+        default:
+            return true;
+        }
+    });
+}
+
+bool VfsOpenFile(VfsFile& file, const wchar_t* path, FileAccess access) {
+    VfsCloseFile(file);
+
+    BlockedTimer timer;
+    bool opened = FindInMounts(path, [&file, access](const std::shared_ptr<VfsMountData>& mount, const std::wstring& relativePath) {
+        if (OpenFromMount(mount, relativePath, access, file)) {
+            return true;
+        }
+        VfsCloseFile(file);
+        return false;
+    });
+    ++(opened ? g_Opens : g_Misses);
+    return opened;
+}
+
+void VfsCloseFile(VfsFile& file) {
+    CloseReadOnlyFile(file.Loose);
+    std::vector<BYTE>().swap(file.Memory);
+    file.Data = nullptr;
+    file.Size = 0;
+    file.Mount.reset();
+}
+
+bool VfsReadFile(VfsFile& file, uint64_t offset, void* data, uint64_t size) {
+    if (offset > file.Size || size > file.Size - offset) {
+        return false;
+    }
+
+    BlockedTimer timer;
+    bool read = true;
+    if (file.Data) {
+        //Cold pages of an archive mapping are faulted in here.
+        memcpy(data, file.Data + offset, static_cast<size_t>(size));
+    }
+    else {
+        read = ReadFileAt(file.Loose, offset, data, size);
+    }
+    if (read) {
+        g_BytesRead += size;
+    }
+    return read;
+}
+
+bool VfsReadWholeFile(const wchar_t* path, std::vector<BYTE>& data) {
+    data.clear();
+
+    VfsFile file;
+    if (!VfsOpenFile(file, path, FA_Sequential)) {
+        return false;
+    }
+
+    bool read = true;
+    if (!file.Memory.empty()) {
+        //A decompressed archive entry is handed over instead of copied.
+        data.swap(file.Memory);
+        g_BytesRead += data.size();
+    }
+    else {
+        data.resize(static_cast<size_t>(file.Size));
+        read = VfsReadFile(file, 0, data.data(), data.size());
+    }
+    VfsCloseFile(file);
+
+    if (!read) {
+        data.clear();
+    }
+    return read;
+}
+
+void VfsPrefetch(const wchar_t* path) {
+    BlockedTimer timer;
+    FindInMounts(path, [](const std::shared_ptr<VfsMountData>& mount, const std::wstring& relativePath) {
+        switch (mount->Type) {
+        case VMT_Directory:
+            return PrefetchFile((mount->Directory + relativePath).c_str());
+        case VMT_Archive: {
+            UINT entry = FindAssetArchiveEntry(mount->Archive, relativePath.c_str());
+            if (entry == ASSET_ARCHIVE_ENTRY_NONE) {
+                return false;
+            }
+            const AssetArchiveEntry& archiveEntry = mount->Archive.Entries[entry];
+            PrefetchMappedFile(mount->Archive.File, archiveEntry.DataOffset, archiveEntry.StoredSize);
+            return true;
+        }
+        default:
+            return true;
+        }
+    });
+}
+
+void GetVfsStats(VfsStats& stats) {
+    stats.Opens = g_Opens;
+    stats.Misses = g_Misses;
+    stats.BytesRead = g_BytesRead;
+    stats.BlockedMs = g_BlockedNs * 1e-6;
+    stats.MainThreadBlockedMs = g_MainThreadBlockedNs * 1e-6;
+}
+
+void EndVfsFrame(VfsStats& frameStats) {
+    VfsStats totals;
+    GetVfsStats(totals);
+    frameStats.Opens = totals.Opens - g_FrameStart.Opens;
+    frameStats.Misses = totals.Misses - g_FrameStart.Misses;
+    frameStats.BytesRead = totals.BytesRead - g_FrameStart.BytesRead;
+    frameStats.BlockedMs = totals.BlockedMs - g_FrameStart.BlockedMs;
+    frameStats.MainThreadBlockedMs = totals.MainThreadBlockedMs - g_FrameStart.MainThreadBlockedMs;
+    g_FrameStart = totals;
+}
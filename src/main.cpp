@@ -1,4 +1,27 @@
 #include "EchoEnginePCH.h"
+#include "Scene.h"
+#include "Mesh.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+#include "MeshletD3D11.h"
+#include "MeshLod.h"
+#include "StaticBatch.h"
+#include "SceneRenderer.h"
+#include "AssetLoader.h"
+#include "VirtualFileSystem.h"
+#include "TextureStreaming.h"
+#include "TextureAtlas.h"
+#include "SpriteBatch.h"
+#include "GlyphCacheD3D11.h"
+#include "DebugDraw.h"
+#include "Profiler.h"
+#include "GpuTimer.h"
+#include "FrameStats.h"
+#include "VertexShader.h"
+#include "PixelShader.h"
+#include "SpriteVertexShader.h"
+#include "SpritePixelShader.h"
+#include "RenderCountersD3D11.h"
 using namespace DirectX;
 
 
@@ -31,8 +54,8 @@ D3D11_VIEWPORT g_Viewport = { 0 };
 
 // Vertex buffer data
 ID3D11InputLayout* g_d3dInputLayout = nullptr;
-ID3D11Buffer* g_d3dVertexBuffer = nullptr;
-ID3D11Buffer* g_d3dIndexBuffer = nullptr;
+//The vertex shader's bytecode stays around to create the input layout once the cube's vertex format is known.
+std::vector<BYTE> g_VertexShaderBytecode;
 
 // Shader Data
 ID3D11VertexShader* g_d3dVertexShader = nullptr;
@@ -53,34 +76,90 @@ XMMATRIX g_WorldMatrix;
 XMMATRIX g_ViewMatrix;
 XMMATRIX g_ProjectionMatrix;
 
-// Vertex data for a colored cube.
-struct VertexPosColor
-{
-    XMFLOAT3 Position;
-    XMFLOAT3 Color;
+// Scene Data
+Scene g_Scene;
+UINT g_CubeObject = 0;
+
+// Occlusion Culling
+OcclusionBuffer g_OcclusionBuffer;
+std::vector<Occluder> g_Occluders;
+
+// Mesh Data
+//The mesh file stays in memory while the app runs; the occluders read their triangles from it.
+MeshFile g_MeshFile;
+//The cube is read and decoded in the background; nothing that depends on it runs before g_CubeLoaded is set.
+AssetHandle g_CubeAsset = ASSET_HANDLE_NONE;
+bool g_CubeLoaded = false;
+//Vertex and index arenas shared by every mesh.
+GeometryBuffer g_GeometryBuffer;
+Mesh g_CubeMesh;
+std::vector<XMFLOAT3> g_CubePositions;
+
+// Meshlet Culling
+MeshletMesh g_CubeMeshlets;
+MeshletIndexStream g_MeshletIndexStream;
+
+// Level of Detail
+//Error of each of the cube's detail levels in mesh space; their meshlets are the ranges in g_CubeMeshlets.Lods.
+std::vector<float> g_CubeLodErrors;
+
+// Virtual File System
+//Opens, reads and time spent waiting on them during the previous frame.
+VfsStats g_VfsFrameStats = { 0 };
+
+// Texture Streaming
+//Residency, pending loads and budget use after the latest streaming update.
+TextureStreamingStats g_TextureStreamingStats = { 0 };
+
+// HUD
+//The overlay's images are packed into a single atlas at load and its text comes from the glyph cache, so the
+//whole overlay is one draw per atlas.
+enum HudImage {
+    HI_Panel,
+    HI_Marker,
+    NumHudImages
 };
-
-VertexPosColor g_Vertices[8] =
-{
-    { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) }, // 0
-    { XMFLOAT3(-1.0f,  1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) }, // 1
-    { XMFLOAT3(1.0f,  1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) }, // 2
-    { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) }, // 3
-    { XMFLOAT3(-1.0f, -1.0f,  1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) }, // 4
-    { XMFLOAT3(-1.0f,  1.0f,  1.0f), XMFLOAT3(0.0f, 1.0f, 1.0f) }, // 5
-    { XMFLOAT3(1.0f,  1.0f,  1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) }, // 6
-    { XMFLOAT3(1.0f, -1.0f,  1.0f), XMFLOAT3(1.0f, 0.0f, 1.0f) }  // 7
-};
-
-WORD g_Indices[36] =
-{
-    0, 1, 2, 0, 2, 3,
-    4, 6, 5, 4, 7, 6,
-    4, 5, 1, 4, 1, 0,
-    3, 2, 6, 3, 6, 7,
-    1, 5, 6, 1, 6, 2,
-    4, 0, 3, 4, 3, 7
+enum HudAtlas {
+    HA_Images,
+    HA_Text
 };
+SpriteBatch g_SpriteBatch;
+Texture g_HudAtlasTexture;
+std::vector<AtlasRegion> g_HudRegions;
+GlyphCache g_GlyphCache;
+SpriteBatchStats g_SpriteBatchStats = { 0 };
+
+// Debug Drawing
+//Bounds of what survives culling, drawn while F1 has debug drawing switched on.
+DebugDrawStats g_DebugDrawStats = { 0 };
+
+// Profiling
+//F2 captures the next frames' zones and writes them next to the executable as Chrome trace JSON.
+const UINT PROFILER_CAPTURE_FRAMES = 8;
+const wchar_t* PROFILER_TRACE_PATH = L"EchoEngineTrace.json";
+ProfilerStats g_ProfilerStats = { 0 };
+//Render passes timed on the GPU, read back a few frames late.
+GpuTimer g_GpuTimer;
+
+// Frame Statistics
+//Every frame since the start, written out on exit and whenever F3 is pressed.
+const wchar_t* FRAME_STATS_CSV_PATH = L"EchoEngineFrameStats.csv";
+const wchar_t* FRAME_STATS_JSON_PATH = L"EchoEngineFrameStats.json";
+FrameStats g_FrameStats;
+//Tallied as the current frame presents.
+double g_PresentMs = 0.0;
+//Draws, binds and uploads of the last finished frame, for the HUD and frame statistics.
+RenderCounters g_RenderCounters = { 0 };
+
+// Static Batching
+//The floor tiles never move, so they are merged into world space chunks once at load.
+StaticBatch g_StaticBatch;
+StaticBatchStats g_StaticBatchStats = { 0 };
+
+// Scene Submission
+//Culls the scene and draws what is left every frame once the cube has loaded, through the Direct3D calls of the device.
+SceneRenderer g_SceneRenderer;
+SceneRenderDevice g_SceneRenderDevice;
 
 // Forward Declarations
 
@@ -88,6 +167,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 template<class ShaderClass>
 ShaderClass* LoadShader(const std::wstring& fileName, const std::string& entryPoint, const std::string& profile);
 bool LoadContent();
+bool DecodeCube(std::vector<BYTE>& data);
+bool UploadCube(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+bool CreateHud();
 void UnloadContent();
 
 void Update(float deltaTime);
@@ -227,6 +309,20 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
             EndPaint(hwnd, &paintStruct);
         }
         break;
+    case WM_KEYDOWN:
+        {
+            if (wParam == VK_F1) {
+                SetDebugDrawEnabled(!IsDebugDrawEnabled());
+            }
+            else if (wParam == VK_F2) {
+                StartProfilerCapture(PROFILER_CAPTURE_FRAMES);
+            }
+            else if (wParam == VK_F3) {
+                WriteFrameStatsCsv(g_FrameStats, FRAME_STATS_CSV_PATH);
+                WriteFrameStatsJson(g_FrameStats, FRAME_STATS_JSON_PATH);
+            }
+        }
+        break;
     case WM_DESTROY: 
         { 
             PostQuitMessage(0);
@@ -247,12 +343,29 @@ int Run() {
     static const float targetFramerate = 30.0f;
     static const float maxTimeStep = 1.0f / targetFramerate;
 
+    //A frame lasts until the next one starts, so each is recorded at the start of the one after it.
+    std::chrono::steady_clock::time_point frameStart;
+    FrameSample frameSample = {};
+    bool firstFrame = true;
+
     while (msg.message != WM_QUIT) {
         if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
         else {
+            auto now = std::chrono::steady_clock::now();
+            BeginRenderCountersFrame(&g_RenderCounters);
+            if (!firstFrame) {
+                frameSample.FrameMs = std::chrono::duration<double, std::milli>(now - frameStart).count();
+                frameSample.Draws = g_RenderCounters.Draws;
+                frameSample.UploadBytes = g_RenderCounters.UploadBytes;
+                RecordFrame(g_FrameStats, frameSample);
+            }
+            firstFrame = false;
+            frameStart = now;
+            g_PresentMs = 0.0;
+
             DWORD currentTime = timeGetTime();
             float deltaTime = (currentTime - previousTime) / 1000.0f;
             previousTime = currentTime;
@@ -261,8 +374,30 @@ int Run() {
             the deltaTime value to explode.*/
             deltaTime = std::min<float>(deltaTime, maxTimeStep);
 
+            //The frame mark ends the previous frame's zones, so a finished capture is written before this frame starts.
+            if (ProfilerFrameMark()) {
+                WriteChromeTrace(PROFILER_TRACE_PATH, &g_ProfilerStats);
+            }
+
+            EndVfsFrame(g_VfsFrameStats);
+            //Streaming acts on the mip requests of the previous frame's draws; its loads upload with the other assets.
+            {
+                PROFILE_ZONE("UpdateTextureStreaming");
+                UpdateTextureStreaming();
+                GetTextureStreamingStats(g_TextureStreamingStats);
+            }
+            {
+                PROFILE_ZONE("UpdateAssetLoader");
+                UpdateAssetLoader(g_d3dDevice, g_d3dDeviceContext);
+            }
+            std::chrono::steady_clock::time_point updateStart = std::chrono::steady_clock::now();
             Update(deltaTime);
+            std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
             Render();
+
+            frameSample.UpdateMs = std::chrono::duration<double, std::milli>(renderStart - updateStart).count();
+            frameSample.RenderMs = ElapsedMs(renderStart) - g_PresentMs;
+            frameSample.PresentMs = g_PresentMs;
         }
     }
     return static_cast<int>(msg.wParam);
@@ -356,7 +491,7 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync) {
     depthStencilBufferDesc.SampleDesc.Quality = 0;
     depthStencilBufferDesc.Usage = D3D11_USAGE_DEFAULT;
 
-    hr = g_d3dDevice->CreateTexture2D(&depthStencilBufferDesc, nullptr, &g_d3dDepthStencilBuffer);
+    hr = DeviceCreateTexture2D(g_d3dDevice, &depthStencilBufferDesc, nullptr, &g_d3dDepthStencilBuffer);
     if (FAILED(hr))
     {
         return -1;
@@ -424,42 +559,6 @@ bool LoadContent() {
     //Shaders will be precompiled into the source code.
     assert(g_d3dDevice);
 
-    //Create and initialize the vertex buffer.
-    D3D11_BUFFER_DESC vertexBufferDesc;
-    ZeroMemory(&vertexBufferDesc, sizeof(D3D11_BUFFER_DESC));
-
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.ByteWidth = sizeof(VertexPosColor) * _countof(g_Vertices);
-    vertexBufferDesc.CPUAccessFlags = 0;
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-    D3D11_SUBRESOURCE_DATA resourceData;
-    ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
-
-    resourceData.pSysMem = g_Vertices;
-
-    HRESULT hr = g_d3dDevice->CreateBuffer(&vertexBufferDesc, &resourceData, &g_d3dVertexBuffer);
-    if (FAILED(hr)) {
-        return false;
-    }
-
-
-    //Create and initialize the index buffer.
-    D3D11_BUFFER_DESC indexBufferDesc;
-    ZeroMemory(&indexBufferDesc, sizeof(D3D11_BUFFER_DESC));
-
-    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    indexBufferDesc.ByteWidth = sizeof(WORD) * _countof(g_Indices);
-    indexBufferDesc.CPUAccessFlags = 0;
-    indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    resourceData.pSysMem = g_Indices;
-
-    hr = g_d3dDevice->CreateBuffer(&indexBufferDesc, &resourceData, &g_d3dIndexBuffer);
-    if (FAILED(hr)) {
-        return false;
-    }
-
-
     //Create the constant buffers for the variables defined in the vertex shader.
     D3D11_BUFFER_DESC constantBufferDesc;
     ZeroMemory(&constantBufferDesc, sizeof(D3D11_BUFFER_DESC));
@@ -469,73 +568,86 @@ bool LoadContent() {
     constantBufferDesc.CPUAccessFlags = 0;
     constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
 
-    hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Application]);
+    HRESULT hr = DeviceCreateBuffer(g_d3dDevice, &constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Application]);
     if (FAILED(hr)) {
         return false;
     }
-    hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Frame]);
+    hr = DeviceCreateBuffer(g_d3dDevice, &constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Frame]);
     if (FAILED(hr))
     {
         return false;
     }
-    hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Object]);
+    hr = DeviceCreateBuffer(g_d3dDevice, &constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Object]);
     if (FAILED(hr))
     {
         return false;
     }
 
-    //Load the compiled vertex shader.
-    ID3DBlob* vertexShaderBlob;
 #if _DEBUG
     LPCWSTR compiledVertexShaderObject = L"SimpleVertexShader_d.cso";
+    LPCWSTR compiledPixelShaderObject = L"SimplePixelShader_d.cso";
+    LPCWSTR compiledSpriteVertexShaderObject = L"SpriteVertexShader_d.cso";
+    LPCWSTR compiledSpritePixelShaderObject = L"SpritePixelShader_d.cso";
 #else
     LPCWSTR compiledVertexShaderObject = L"SimpleVertexShader.cso";
+    LPCWSTR compiledPixelShaderObject = L"SimplePixelShader.cso";
+    LPCWSTR compiledSpriteVertexShaderObject = L"SpriteVertexShader.cso";
+    LPCWSTR compiledSpritePixelShaderObject = L"SpritePixelShader.cso";
 #endif
 
-    hr = D3DReadFileToBlob(compiledVertexShaderObject, &vertexShaderBlob);
-    if (FAILED(hr)) {
+    //Loose files in the working directory override the packed archive, so edited content shows up without
+    //repacking. The shaders compiled into the executable are the last resort.
+    MountMemoryFile(compiledVertexShaderObject, g_vs, sizeof(g_vs), -1);
+    MountMemoryFile(compiledPixelShaderObject, g_ps, sizeof(g_ps), -1);
+    MountMemoryFile(compiledSpriteVertexShaderObject, g_spriteVs, sizeof(g_spriteVs), -1);
+    MountMemoryFile(compiledSpritePixelShaderObject, g_spritePs, sizeof(g_spritePs), -1);
+    MountArchive(L"", L"EchoEngine.epak", 0);
+    MountDirectory(L"", L".", 1);
+
+    //Load the compiled vertex shader.
+    if (!VfsReadWholeFile(compiledVertexShaderObject, g_VertexShaderBytecode)) {
         return false;
     }
 
-    hr = g_d3dDevice->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), nullptr, &g_d3dVertexShader);
+    hr = g_d3dDevice->CreateVertexShader(g_VertexShaderBytecode.data(), g_VertexShaderBytecode.size(), nullptr, &g_d3dVertexShader);
     if (FAILED(hr)) {
         return false;
     }
 
-    //Create the input layout for the vertex shader.
-    D3D11_INPUT_ELEMENT_DESC vertexLayoutDesc[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexPosColor, Position), D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexPosColor, Color), D3D11_INPUT_PER_VERTEX_DATA, 0}
-    };
-
-    hr = g_d3dDevice->CreateInputLayout(vertexLayoutDesc, _countof(vertexLayoutDesc), vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &g_d3dInputLayout);
-    if (FAILED(hr)) {
+    //Debug lines go through the same vertex shader with a layout of their own. They start switched off.
+    if (!InitDebugDraw(g_d3dDevice, g_VertexShaderBytecode.data(), g_VertexShaderBytecode.size())) {
         return false;
     }
+    SetDebugDrawEnabled(false);
 
-    SafeRelease(vertexShaderBlob);
-
+    //Without timestamp queries the backend comes back empty and frames simply go untimed.
+    InitGpuTimer(g_GpuTimer, CreateD3D11GpuTimerBackend(g_d3dDevice, g_d3dDeviceContext));
 
     //Load the compiled pixel shader.
-    ID3DBlob* pixelShaderBlob;
-
-#if _DEBUG
-    LPCWSTR compiledPixelShaderObject = L"SimplePixelShader_d.cso";
-#else
-    LPCWSTR compiledPixelShaderObject = L"SimplePixelShader.cso";
-#endif
-
-    hr = D3DReadFileToBlob(compiledPixelShaderObject, &pixelShaderBlob);
-    if (FAILED(hr)) {
+    std::vector<BYTE> pixelShaderBytecode;
+    if (!VfsReadWholeFile(compiledPixelShaderObject, pixelShaderBytecode)) {
         return false;
     }
 
-    hr = g_d3dDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, &g_d3dPixelShader);
+    hr = g_d3dDevice->CreatePixelShader(pixelShaderBytecode.data(), pixelShaderBytecode.size(), nullptr, &g_d3dPixelShader);
     if (FAILED(hr)) {
         return false;
     }
 
-    SafeRelease(pixelShaderBlob);
+    //Load the sprite shaders and create the batch the HUD draws with.
+    std::vector<BYTE> spriteVertexShaderBytecode;
+    std::vector<BYTE> spritePixelShaderBytecode;
+    if (!VfsReadWholeFile(compiledSpriteVertexShaderObject, spriteVertexShaderBytecode) ||
+        !VfsReadWholeFile(compiledSpritePixelShaderObject, spritePixelShaderBytecode)) {
+        return false;
+    }
+    if (!CreateSpriteBatch(g_d3dDevice, spriteVertexShaderBytecode.data(), spriteVertexShaderBytecode.size(), spritePixelShaderBytecode.data(),
+        spritePixelShaderBytecode.size(), g_SpriteBatch)) {
+        return false;
+    }
+    if (!CreateHud()) {
+        return false;
+    }
 
     //Setup the projection matrix.
     RECT clientRect;
@@ -546,8 +658,258 @@ bool LoadContent() {
     float clientHeight = static_cast<float>(clientRect.bottom - clientRect.top);
 
     g_ProjectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), clientWidth / clientHeight, 0.1f, 100.0f);
-    g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Application], 0, nullptr, &g_ProjectionMatrix, 0, 0);
+    ContextUpdateSubresource(g_d3dDeviceContext, g_d3dConstantBuffers[CB_Application], 0, nullptr, &g_ProjectionMatrix, 0, 0, sizeof(g_ProjectionMatrix));
+
+    //The scene and geometry arenas start out empty; the cube joins them when its upload runs.
+    InitScene(g_Scene, SI_BVH);
+    InitGeometryBuffer(g_GeometryBuffer);
+    InitOcclusionBuffer(g_OcclusionBuffer, OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+    InitTextureStreaming(GetD3D11TextureStreamingDevice(g_d3dDevice, g_d3dDeviceContext));
 
+    //Read the cube on an I/O thread and decode it on the job system so the first frames do not wait for it.
+    g_CubeAsset = LoadAsset(L"Cube.emesh", 0, DecodeCube, UploadCube);
+    return g_CubeAsset != ASSET_HANDLE_NONE;
+}
+
+//Runs on a job system worker: everything about the cube that needs no device. Everything is built into locals and
+//only published once every step succeeded, so a cube that fails to decode leaves no occluders or meshlets behind.
+bool DecodeCube(std::vector<BYTE>& data) {
+    MeshFile meshFile;
+    if (!OpenMeshFileFromMemory(meshFile, data)) {
+        return false;
+    }
+    if (meshFile.Header->MeshCount == 0) {
+        CloseMeshFile(meshFile);
+        return false;
+    }
+    const MeshFileEntry& cubeEntry = meshFile.Entries[0];
+
+    //The cube also serves as an occluder for everything behind it, one occluder per submesh.
+    //Moving the vectors and the mesh file into the globals keeps their buffers, so these pointers stay valid.
+    std::vector<XMFLOAT3> cubePositions(cubeEntry.VertexCount);
+    DecodeMeshPositions(meshFile, 0, cubePositions.data());
+    const BYTE* cubeIndices = static_cast<const BYTE*>(GetMeshIndexData(meshFile, 0));
+    const MeshFileSubmesh* cubeSubmeshes = GetMeshSubmeshes(meshFile, 0);
+    std::vector<Occluder> cubeOccluders;
+    for (UINT i = 0; i < cubeEntry.SubmeshCount; ++i) {
+        const MeshFileSubmesh& submesh = cubeSubmeshes[i];
+        Occluder cubeOccluder;
+        cubeOccluder.Positions = cubePositions.data() + submesh.BaseVertex;
+        cubeOccluder.PositionStride = sizeof(XMFLOAT3);
+        cubeOccluder.VertexCount = submesh.VertexCount;
+        cubeOccluder.Indices = cubeIndices + static_cast<size_t>(submesh.StartIndex) * cubeEntry.IndexSize;
+        cubeOccluder.IndexSize = cubeEntry.IndexSize;
+        cubeOccluder.IndexCount = submesh.IndexCount;
+        XMStoreFloat4x4(&cubeOccluder.WorldMatrix, XMMatrixIdentity());
+        cubeOccluders.push_back(cubeOccluder);
+    }
+
+    //Simplify the cube into a chain of detail levels. Every level indexes the cube's own vertex buffer.
+    std::vector<uint32_t> cubeMeshIndices(cubeEntry.IndexCount);
+    DecodeMeshIndices(meshFile, 0, cubeMeshIndices.data());
+    std::vector<XMFLOAT4> cubeColors(cubeEntry.VertexCount);
+    DecodeMeshColors(meshFile, 0, cubeColors.data());
+    SimplifyVertices cubeVertices = { cubePositions.data(), sizeof(XMFLOAT3), cubeColors.data(), sizeof(XMFLOAT4), MESH_LOD_COLOR_WEIGHT, cubeEntry.VertexCount };
+    std::vector<MeshLod> cubeLods;
+    BuildMeshLods(cubeLods, cubeMeshIndices.data(), cubeMeshIndices.size(), cubeVertices);
+
+    //Cluster every level into meshlets so off-screen and back facing parts are skipped every frame.
+    MeshletMesh cubeMeshlets;
+    std::vector<float> cubeLodErrors;
+    for (const MeshLod& lod : cubeLods) {
+        if (cubeLodErrors.empty()) {
+            BuildMeshlets(cubeMeshlets, lod.Indices.data(), lod.Indices.size(), cubePositions.data(), sizeof(XMFLOAT3), cubeEntry.VertexCount);
+        }
+        else {
+            AddMeshletLod(cubeMeshlets, lod.Indices.data(), lod.Indices.size(), cubePositions.data(), sizeof(XMFLOAT3));
+        }
+        cubeLodErrors.push_back(lod.Error);
+    }
+
+    //Tile a floor below the cube with flattened cubes in two alternating materials and batch them.
+    const int floorTiles = 48;
+    std::vector<StaticObject> floorObjects;
+    for (int z = 0; z < floorTiles; ++z) {
+        for (int x = 0; x < floorTiles; ++x) {
+            StaticObject tile;
+            tile.Source = 0;
+            tile.Material = (x + z) & 1;
+            XMMATRIX tileMatrix = XMMatrixMultiply(XMMatrixScaling(0.45f, 0.1f, 0.45f), XMMatrixTranslation(x - floorTiles * 0.5f, -3.0f, z - 5.0f));
+            XMStoreFloat4x4(&tile.WorldMatrix, tileMatrix);
+            floorObjects.push_back(tile);
+        }
+    }
+    StaticMeshSource cubeSource = { cubePositions.data(), cubeColors.data(), cubeEntry.VertexCount, cubeMeshIndices.data(), cubeEntry.IndexCount };
+    StaticBatch staticBatch;
+    StaticBatchStats staticBatchStats;
+    if (!BuildStaticBatch(staticBatch, static_cast<MeshVertexFormat>(cubeEntry.VertexFormat), &cubeSource, 1, floorObjects.data(),
+        static_cast<UINT>(floorObjects.size()), STATIC_BATCH_CHUNK_VERTICES, &staticBatchStats)) {
+        CloseMeshFile(meshFile);
+        return false;
+    }
+
+    CloseMeshFile(g_MeshFile);
+    g_MeshFile = std::move(meshFile);
+    g_CubePositions = std::move(cubePositions);
+    g_Occluders.insert(g_Occluders.end(), cubeOccluders.begin(), cubeOccluders.end());
+    g_CubeMeshlets = std::move(cubeMeshlets);
+    g_CubeLodErrors = std::move(cubeLodErrors);
+    g_StaticBatch = std::move(staticBatch);
+    g_StaticBatchStats = staticBatchStats;
+    return true;
+}
+
+//The scene's binds, uploads and draws as Direct3D 11 calls with the cube's pipeline.
+SceneRenderDevice CreateSceneRenderDevice() {
+    SceneRenderDevice device;
+    device.BindState = [](RenderBindPoint point) {
+        switch (point) {
+        case RBP_VertexBuffers:
+            BindGeometryVertexBuffer(g_d3dDeviceContext, g_GeometryBuffer, g_CubeMesh.VertexFormat);
+            break;
+        case RBP_InputLayout:
+            ContextIASetInputLayout(g_d3dDeviceContext, g_d3dInputLayout);
+            break;
+        case RBP_Topology:
+            ContextIASetPrimitiveTopology(g_d3dDeviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            break;
+        case RBP_VertexShader:
+            ContextVSSetShader(g_d3dDeviceContext, g_d3dVertexShader);
+            break;
+        case RBP_VSConstantBuffers:
+            ContextVSSetConstantBuffers(g_d3dDeviceContext, 0, NumConstantBuffers, g_d3dConstantBuffers);
+            break;
+        case RBP_Rasterizer:
+            ContextRSSetState(g_d3dDeviceContext, g_d3dRasterizerState);
+            break;
+        case RBP_Viewports:
+            ContextRSSetViewports(g_d3dDeviceContext, 1, &g_Viewport);
+            break;
+        case RBP_PixelShader:
+            ContextPSSetShader(g_d3dDeviceContext, g_d3dPixelShader);
+            break;
+        case RBP_RenderTargets:
+            ContextOMSetRenderTargets(g_d3dDeviceContext, 1, &g_d3dRenderTargetView, g_d3dDepthStencilView);
+            break;
+        case RBP_DepthStencil:
+            ContextOMSetDepthStencilState(g_d3dDeviceContext, g_d3dDepthStencilState, 1);
+            break;
+        default:
+            break;
+        }
+    };
+    device.BindGeometryIndices = [](UINT indexSize) {
+        BindGeometryIndexBuffer(g_d3dDeviceContext, g_GeometryBuffer, indexSize);
+    };
+    device.WriteMeshletIndices = [](const MeshletMesh& meshlets, const UINT* visibleMeshlets, UINT visibleCount, MeshletCullStats& stats) {
+        if (!UpdateMeshletIndexStream(g_d3dDevice, g_d3dDeviceContext, g_MeshletIndexStream, meshlets, visibleMeshlets, visibleCount, stats)) {
+            return false;
+        }
+        ContextIASetIndexBuffer(g_d3dDeviceContext, g_MeshletIndexStream.IndexBuffer, g_MeshletIndexStream.IndexFormat, 0);
+        return true;
+    };
+    device.UpdateViewMatrix = [](FXMMATRIX viewMatrix) {
+        XMMATRIX matrix = viewMatrix;
+        ContextUpdateSubresource(g_d3dDeviceContext, g_d3dConstantBuffers[CB_Frame], 0, nullptr, &matrix, 0, 0, sizeof(matrix));
+    };
+    device.UpdateObjectMatrix = [](FXMMATRIX objectMatrix) {
+        XMMATRIX matrix = objectMatrix;
+        ContextUpdateSubresource(g_d3dDeviceContext, g_d3dConstantBuffers[CB_Object], 0, nullptr, &matrix, 0, 0, sizeof(matrix));
+    };
+    //Meshlet indices are relative to the mesh, so the mesh's place in the vertex arena is the base vertex.
+    device.DrawMeshlets = [](UINT indexCount, UINT startIndex) {
+        ContextDrawIndexed(g_d3dDeviceContext, indexCount, startIndex, static_cast<INT>(GetGeometryBaseVertex(g_GeometryBuffer, g_CubeMesh.Geometry)));
+    };
+    device.DrawMesh = []() {
+        DrawMesh(g_d3dDeviceContext, g_GeometryBuffer, g_CubeMesh);
+    };
+    device.DrawStaticChunk = [](const StaticBatchChunk& chunk) {
+        DrawStaticBatchChunk(g_d3dDeviceContext, g_GeometryBuffer, chunk);
+    };
+    return device;
+}
+
+//Runs on the main thread: create the cube's GPU resources and let it into the scene.
+bool UploadCube(ID3D11Device* device, ID3D11DeviceContext* deviceContext) {
+    if (!CreateMesh(device, deviceContext, g_GeometryBuffer, g_MeshFile, 0, g_CubeMesh)) {
+        return false;
+    }
+
+    //Create the input layout matching the cube's vertex format.
+    if (!CreateMeshInputLayout(device, g_CubeMesh.VertexFormat, g_VertexShaderBytecode.data(), g_VertexShaderBytecode.size(), &g_d3dInputLayout)) {
+        return false;
+    }
+    std::vector<BYTE>().swap(g_VertexShaderBytecode);
+
+    if (!UploadStaticBatch(device, deviceContext, g_GeometryBuffer, g_StaticBatch)) {
+        return false;
+    }
+
+    //Register the cube with the scene so it goes through culling.
+    g_CubeObject = AddSceneObject(g_Scene, XMMatrixIdentity(), g_CubeMesh.Bounds);
+    UpdateScene(g_Scene);
+
+    g_SceneRenderer.Objects = &g_Scene;
+    g_SceneRenderer.OcclusionTarget = &g_OcclusionBuffer;
+    g_SceneRenderer.Occluders = g_Occluders.data();
+    g_SceneRenderer.OccluderCount = static_cast<UINT>(g_Occluders.size());
+    g_SceneRenderer.Meshlets = &g_CubeMeshlets;
+    g_SceneRenderer.LodErrors = g_CubeLodErrors.data();
+    g_SceneRenderer.MeshIndexSize = g_CubeMesh.Geometry.IndexSize;
+    g_SceneRenderer.PositionScale = g_CubeMesh.PositionScale;
+    g_SceneRenderer.PositionBias = g_CubeMesh.PositionBias;
+    g_SceneRenderer.Batch = &g_StaticBatch;
+    g_SceneRenderer.Timer = &g_GpuTimer;
+    g_SceneRenderDevice = CreateSceneRenderDevice();
+
+    g_CubeLoaded = true;
+    return true;
+}
+
+//Draw the HUD's images, pack them into an atlas and upload it.
+bool CreateHud() {
+    TextureImage images[NumHudImages];
+
+    //A plain white panel that sprites tint to any color.
+    TextureImage& panel = images[HI_Panel];
+    panel.Width = 8;
+    panel.Height = 8;
+    panel.Pixels.assign(panel.Width * panel.Height * 4, 255);
+
+    //A round marker with a soft edge.
+    TextureImage& marker = images[HI_Marker];
+    marker.Width = 16;
+    marker.Height = 16;
+    marker.Pixels.assign(marker.Width * marker.Height * 4, 255);
+    for (UINT y = 0; y < marker.Height; ++y) {
+        for (UINT x = 0; x < marker.Width; ++x) {
+            float distance = sqrtf((x - 7.5f) * (x - 7.5f) + (y - 7.5f) * (y - 7.5f));
+            marker.Pixels[(y * marker.Width + x) * 4 + 3] = static_cast<BYTE>(std::min<float>(std::max<float>(8.0f - distance, 0.0f), 1.0f) * 255.0f);
+        }
+    }
+
+    TextureAtlas atlas;
+    if (!BuildTextureAtlas(images, NumHudImages, 64, 2, atlas) || atlas.Pages.size() != 1) {
+        return false;
+    }
+    g_HudRegions = atlas.Regions;
+
+    TextureCookSettings cookSettings;
+    cookSettings.Format = TF_RGBA8;
+    cookSettings.GenerateMips = false;
+    CookedTexture cookedAtlas;
+    if (!CookTexture(atlas.Pages[0], cookSettings, cookedAtlas) || !CreateTexture(g_d3dDevice, GetCookedTextureSource(cookedAtlas), g_HudAtlasTexture)) {
+        return false;
+    }
+    SetSpriteAtlas(g_SpriteBatch, HA_Images, g_HudAtlasTexture.View);
+
+    //Text is rasterized by GDI as glyphs first show up.
+    GlyphFontMetrics fontMetrics;
+    GlyphRasterizer rasterizer = CreateGdiGlyphRasterizer(L"Consolas", 16, fontMetrics);
+    if (!rasterizer || !CreateGlyphCache(g_d3dDevice, GLYPH_CACHE_DEFAULT_SIZE, rasterizer, fontMetrics, g_GlyphCache)) {
+        return false;
+    }
+    SetSpriteAtlas(g_SpriteBatch, HA_Text, g_GlyphCache.Atlas.View);
     return true;
 }
 
@@ -555,9 +917,19 @@ void UnloadContent() {
     SafeRelease(g_d3dConstantBuffers[CB_Application]);
     SafeRelease(g_d3dConstantBuffers[CB_Frame]);
     SafeRelease(g_d3dConstantBuffers[CB_Object]);
-    SafeRelease(g_d3dIndexBuffer);
-    SafeRelease(g_d3dVertexBuffer);
+    ShutdownTextureStreaming();
+    ShutdownDebugDraw();
+    ReleaseGpuTimer(g_GpuTimer);
+    ReleaseSpriteBatch(g_SpriteBatch);
+    ReleaseGlyphCache(g_GlyphCache);
+    ReleaseTexture(g_HudAtlasTexture);
+    ReleaseMesh(g_GeometryBuffer, g_CubeMesh);
+    ReleaseStaticBatch(g_GeometryBuffer, g_StaticBatch);
+    ReleaseGeometryBuffer(g_GeometryBuffer);
+    ReleaseMeshletIndexStream(g_MeshletIndexStream);
+    CloseMeshFile(g_MeshFile);
     SafeRelease(g_d3dInputLayout);
+    std::vector<BYTE>().swap(g_VertexShaderBytecode);
     SafeRelease(g_d3dVertexShader);
     SafeRelease(g_d3dPixelShader);
 }
@@ -569,62 +941,139 @@ void Clear(const FLOAT clearColor[4], FLOAT clearDepth, UINT8 clearStencil) {
 }
 
 void Present(bool vSync) {
+    PROFILE_ZONE("Present");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     if (vSync) {
         g_d3dSwapChain->Present(1, 0);
     }
     else {
         g_d3dSwapChain->Present(0, 0);
     }
+    g_PresentMs += ElapsedMs(start);
 }
 
 void Update(float deltaTime) {
+    PROFILE_ZONE("Update");
+
     XMVECTOR eyePosition = XMVectorSet(0, 0, -10, 1);
     XMVECTOR focusPoint = XMVectorSet(0, 0, 0, 1);
     XMVECTOR upDirection = XMVectorSet(0, 1, 0, 0);
     g_ViewMatrix = XMMatrixLookAtLH(eyePosition, focusPoint, upDirection);
-    g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Frame], 0, nullptr, &g_ViewMatrix, 0, 0);
+
+    if (!g_CubeLoaded) {
+        return;
+    }
 
     static float angle = 0.0f;
     angle += 90.0f * deltaTime;
     XMVECTOR rotationAxis = XMVectorSet(0, 1, 1, 0);
 
     g_WorldMatrix = XMMatrixRotationAxis(rotationAxis, XMConvertToRadians(angle));
-    g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Object], 0, nullptr, &g_WorldMatrix, 0, 0);
+    SetSceneObjectTransform(g_Scene, g_CubeObject, g_WorldMatrix);
+    UpdateScene(g_Scene);
+    for (Occluder& occluder : g_Occluders) {
+        XMStoreFloat4x4(&occluder.WorldMatrix, g_WorldMatrix);
+    }
+}
+
+//Labelled bars in the top left corner for texture budget use, triangles saved by detail levels and objects rejected by occlusion.
+void DrawHud() {
+    PROFILE_ZONE("DrawHud");
+
+    BeginGlyphCacheFrame(g_GlyphCache);
+
+    const float barPercents[] = {
+        GetTextureBudgetUsePercent(g_TextureStreamingStats),
+        GetLodTriangleReductionPercent(g_SceneRenderer.LevelOfDetail),
+        GetOcclusionRejectedPercent(g_SceneRenderer.OcclusionCulling)
+    };
+    const char* barLabels[] = { "Texture budget", "LOD triangles saved", "Occluded" };
+    const XMVECTORF32 barColors[] = { Colors::Orange, Colors::LimeGreen, Colors::DeepSkyBlue };
+    const float barWidth = 200.0f;
+    const float barHeight = 12.0f;
+    const float barSpacing = 20.0f;
+    const float labelWidth = 240.0f;
+    //The render counters take one line of text under the bars.
+    const float countersTop = 16.0f + barSpacing * _countof(barPercents);
+
+    const AtlasRegion& panel = g_HudRegions[HI_Panel];
+    const AtlasRegion& marker = g_HudRegions[HI_Marker];
+    Sprite background = { XMFLOAT4(8.0f, 8.0f, 32.0f + barWidth + labelWidth, countersTop + barSpacing), panel.TexCoords,
+        PackColor(XMVectorSet(0.0f, 0.0f, 0.0f, 0.5f)), HA_Images };
+    DrawSprite(g_SpriteBatch, background);
+
+    for (UINT i = 0; i < _countof(barPercents); ++i) {
+        float top = 16.0f + barSpacing * i;
+        float right = 16.0f + barWidth * std::min<float>(barPercents[i], 100.0f) / 100.0f;
+        Sprite bar = { XMFLOAT4(16.0f, top, right, top + barHeight), panel.TexCoords, PackColor(barColors[i]), HA_Images };
+        DrawSprite(g_SpriteBatch, bar);
+        Sprite end = { XMFLOAT4(right - barHeight * 0.5f, top, right + barHeight * 0.5f, top + barHeight), marker.TexCoords,
+            PackColor(Colors::White), HA_Images };
+        DrawSprite(g_SpriteBatch, end);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s %.1f%%", barLabels[i], barPercents[i]);
+        DrawString(g_SpriteBatch, g_GlyphCache, HA_Text, 32.0f + barWidth, top + (barHeight - g_GlyphCache.Metrics.LineHeight) * 0.5f, label,
+            PackColor(Colors::White));
+    }
+
+    char counters[128];
+    snprintf(counters, sizeof(counters), "Draws %u  Triangles %llu  Binds %u (%.0f%% redundant)  Uploaded %.1f KB", g_RenderCounters.Draws,
+        static_cast<unsigned long long>(g_RenderCounters.Triangles), g_RenderCounters.StateBinds, GetRedundantStateBindPercent(g_RenderCounters),
+        g_RenderCounters.UploadBytes / 1024.0);
+    DrawString(g_SpriteBatch, g_GlyphCache, HA_Text, 16.0f, countersTop, counters, PackColor(Colors::White));
+
+    UploadGlyphCache(g_d3dDeviceContext, g_GlyphCache);
+    g_SpriteBatchStats = SpriteBatchStats();
+    FlushSprites(g_d3dDeviceContext, g_SpriteBatch, g_Viewport, g_SpriteBatchStats);
 }
 
 void Render() {
+    PROFILE_ZONE("Render");
     assert(g_d3dDevice);
     assert(g_d3dDeviceContext);
 
-    //Clear the screen.
-    Clear(Colors::CornflowerBlue, 1.0f, 0);
-
-    //Set up the input assembler stage.
-    const UINT vertexStride = sizeof(VertexPosColor);
-    const UINT offset = 0;
+    BeginGpuTimerFrame(g_GpuTimer);
 
-    g_d3dDeviceContext->IASetVertexBuffers(0, 1, &g_d3dVertexBuffer, &vertexStride, &offset);
-    g_d3dDeviceContext->IASetInputLayout(g_d3dInputLayout);
-    g_d3dDeviceContext->IASetIndexBuffer(g_d3dIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    g_d3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    //Clear the screen.
+    {
+        PROFILE_GPU_ZONE(g_GpuTimer, "Clear");
+        Clear(Colors::CornflowerBlue, 1.0f, 0);
+    }
 
-    //Set up the vertex shader stage.
-    g_d3dDeviceContext->VSSetShader(g_d3dVertexShader, nullptr, 0);
-    g_d3dDeviceContext->VSSetConstantBuffers(0, 3, g_d3dConstantBuffers);
+    //Until the cube has loaded there is nothing to draw.
+    if (!g_CubeLoaded) {
+        EndGpuTimerFrame(g_GpuTimer);
+        Present(g_EnableVSync);
+        return;
+    }
 
-    //Set up the rasterizer stage.
-    g_d3dDeviceContext->RSSetState(g_d3dRasterizerState);
-    g_d3dDeviceContext->RSSetViewports(1, &g_Viewport);
+    //Cull the scene and draw the objects and static chunks that are left.
+    SubmitScene(g_SceneRenderer, g_SceneRenderDevice, g_ViewMatrix, g_ProjectionMatrix, g_Viewport.Height);
 
-    //Set up the pixel shader stage.
-    g_d3dDeviceContext->PSSetShader(g_d3dPixelShader, nullptr, 0);
+#if DEBUG_DRAW_ENABLED
+    //Outline what culling let through: visible objects in green and visible static chunks in yellow. Debug lines are in world space.
+    if (IsDebugDrawEnabled()) {
+        for (UINT object : g_SceneRenderer.VisibleObjects) {
+            DebugDrawBox(g_Scene.WorldBounds[object], Colors::LimeGreen);
+        }
+        for (UINT chunk : g_SceneRenderer.VisibleChunks) {
+            DebugDrawBox(g_StaticBatch.Chunks[chunk].Bounds, Colors::Yellow);
+        }
+    }
+    XMMATRIX identityMatrix = XMMatrixIdentity();
+    ContextUpdateSubresource(g_d3dDeviceContext, g_d3dConstantBuffers[CB_Object], 0, nullptr, &identityMatrix, 0, 0, sizeof(identityMatrix));
+    UINT debugDrawPass = BeginGpuPass(g_GpuTimer, "DebugDraw");
+    FlushDebugDraw(g_d3dDevice, g_d3dDeviceContext, g_DebugDrawStats);
+    EndGpuPass(g_GpuTimer, debugDrawPass);
+#endif
 
-    //Set up the output merger stage.
-    g_d3dDeviceContext->OMSetRenderTargets(1, &g_d3dRenderTargetView, g_d3dDepthStencilView);
-    g_d3dDeviceContext->OMSetDepthStencilState(g_d3dDepthStencilState, 1);
+    //The HUD goes on top of everything else.
+    UINT hudPass = BeginGpuPass(g_GpuTimer, "HUD");
+    DrawHud();
+    EndGpuPass(g_GpuTimer, hudPass);
 
-    //Render the cube to the screen.
-    g_d3dDeviceContext->DrawIndexed(_countof(g_Indices), 0, 0);
+    EndGpuTimerFrame(g_GpuTimer);
     Present(g_EnableVSync);
 }
 
@@ -659,14 +1108,29 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, LPWSTR cmdLine,
         MessageBox(nullptr, TEXT("Failed to create DirectX device and swapchain."), TEXT("Error"), MB_OK);
         return -1;
     }
+
+    //The profiler comes first so the main thread takes the first track and the workers can name theirs.
+    InitProfiler();
+    SetProfilerThreadName("Main");
+
+    //Content decodes on the job system, so the workers and the loader start first.
+    InitJobSystem();
+    InitVirtualFileSystem();
+    InitAssetLoader();
     if (!LoadContent()) {
         MessageBox(nullptr, TEXT("Failed to load content."), TEXT("Error"), MB_OK);
     }
 
     int returnCode = Run();
+    WriteFrameStatsCsv(g_FrameStats, FRAME_STATS_CSV_PATH);
+    WriteFrameStatsJson(g_FrameStats, FRAME_STATS_JSON_PATH);
 
+    ShutdownAssetLoader();
     UnloadContent();
     Cleanup();
+    ShutdownVirtualFileSystem();
+    ShutdownJobSystem();
+    ShutdownProfiler();
 
     return returnCode;
 }
@@ -0,0 +1,226 @@
+#include "EchoEngineCore.h"
+#include "GpuTimer.h"
+#include "TestCommon.h"
+
+// The GPU timer against the software backend, which resolves every frame on
+// the next one, and against a scripted backend whose GPU finishes frames a set
+// number of frames behind the CPU, with timestamps from a clock that advances
+// by a fixed step at every write.
+
+namespace {
+
+//Ticks the scripted clock advances at every timestamp, at a million ticks a second.
+const uint64_t SCRIPTED_TICK_STEP = 100;
+const uint64_t SCRIPTED_FREQUENCY = 1000000;
+const double SCRIPTED_STEP_MS = 1000.0 * SCRIPTED_TICK_STEP / SCRIPTED_FREQUENCY;
+
+void Sleep(UINT microseconds) {
+    std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+}
+
+void TestSoftwareBackend() {
+    GpuTimer timer;
+    InitGpuTimer(timer, CreateSoftwareGpuTimerBackend());
+
+    //Outside a frame passes are not timed.
+    CHECK(BeginGpuPass(timer, "Outside") == GPU_TIMER_NO_PASS);
+
+    for (UINT frame = 0; frame < 3; ++frame) {
+        BeginGpuTimerFrame(timer);
+        //Each frame is resolved when the next one begins.
+        CHECK(timer.Stats.ResolvedFrames == frame);
+        {
+            GpuPassZone shadow(timer, "Shadow");
+            Sleep(300);
+        }
+        {
+            GpuPassZone scene(timer, "Scene");
+            GpuPassZone opaque(timer, "Opaque");
+            Sleep(500);
+        }
+        //Left open; the end of the frame closes it.
+        CHECK(BeginGpuPass(timer, "Unclosed") != GPU_TIMER_NO_PASS);
+        Sleep(100);
+        EndGpuTimerFrame(timer);
+    }
+    BeginGpuTimerFrame(timer);
+    EndGpuTimerFrame(timer);
+
+    CHECK(timer.Stats.ResolvedFrames == 3);
+    CHECK(timer.Stats.SkippedFrames == 0 && timer.Stats.DisjointFrames == 0 && timer.Stats.DroppedPasses == 0);
+    //A frame without passes resolves to no timings.
+    BeginGpuTimerFrame(timer);
+    CHECK(timer.Stats.ResolvedFrames == 4);
+    CHECK(timer.Timings.empty());
+    EndGpuTimerFrame(timer);
+
+    //Passes resolve in the order they began, nested ones one level deeper.
+    GpuTimer nested;
+    InitGpuTimer(nested, CreateSoftwareGpuTimerBackend());
+    BeginGpuTimerFrame(nested);
+    UINT shadow = BeginGpuPass(nested, "Shadow");
+    Sleep(300);
+    EndGpuPass(nested, shadow);
+    //Ending a pass twice changes nothing.
+    EndGpuPass(nested, shadow);
+    UINT scene = BeginGpuPass(nested, "Scene");
+    UINT opaque = BeginGpuPass(nested, "Opaque");
+    Sleep(500);
+    EndGpuPass(nested, opaque);
+    EndGpuPass(nested, scene);
+    BeginGpuPass(nested, "Unclosed");
+    Sleep(100);
+    EndGpuTimerFrame(nested);
+    BeginGpuTimerFrame(nested);
+
+    const char* names[] = { "Shadow", "Scene", "Opaque", "Unclosed" };
+    const UINT depths[] = { 0, 0, 1, 0 };
+    CHECK(nested.Timings.size() == _countof(names));
+    for (size_t i = 0; i < nested.Timings.size(); ++i) {
+        const GpuPassTiming& timing = nested.Timings[i];
+        CHECK(strcmp(timing.Name, names[i]) == 0 && timing.Depth == depths[i]);
+        CHECK(i == 0 || timing.StartMs >= nested.Timings[i - 1].StartMs);
+        CHECK(timing.StartMs + timing.DurationMs <= nested.Stats.FrameMs);
+    }
+    CHECK(GetGpuPassMs(nested, "Shadow") >= 0.3);
+    CHECK(GetGpuPassMs(nested, "Opaque") >= 0.5);
+    CHECK(GetGpuPassMs(nested, "Scene") >= GetGpuPassMs(nested, "Opaque"));
+    CHECK(GetGpuPassMs(nested, "Unclosed") >= 0.1);
+    CHECK(GetGpuPassMs(nested, "Missing") == 0.0);
+    CHECK(nested.Stats.FrameMs >= 0.9);
+    EndGpuTimerFrame(nested);
+
+    //Passes past the limit are dropped and counted, and the frame still resolves.
+    BeginGpuTimerFrame(nested);
+    for (UINT i = 0; i < GPU_TIMER_MAX_PASSES + 3; ++i) {
+        UINT pass = BeginGpuPass(nested, "Pass");
+        CHECK((pass == GPU_TIMER_NO_PASS) == (i >= GPU_TIMER_MAX_PASSES));
+        EndGpuPass(nested, pass);
+    }
+    EndGpuTimerFrame(nested);
+    BeginGpuTimerFrame(nested);
+    CHECK(nested.Stats.DroppedPasses == 3);
+    CHECK(nested.Timings.size() == GPU_TIMER_MAX_PASSES);
+    EndGpuTimerFrame(nested);
+
+    ReleaseGpuTimer(nested);
+    ReleaseGpuTimer(timer);
+}
+
+//A GPU that finishes the frames the test says it has. Slots remember the CPU frame they were opened in.
+struct ScriptedGpu
+{
+    UINT CpuFrame = 0;
+    // CPU frames before this one are finished.
+    UINT FinishedFrames = 0;
+    UINT DisjointFrame = GPU_TIMER_NO_PASS;
+    uint64_t Clock = 0;
+    UINT SlotFrames[GPU_TIMER_FRAME_LATENCY] = {};
+    uint64_t Timestamps[GPU_TIMER_FRAME_LATENCY][GPU_TIMER_MAX_TIMESTAMPS] = {};
+    UINT Reads = 0;
+};
+
+GpuTimerBackend CreateScriptedGpuTimerBackend(ScriptedGpu& gpu) {
+    GpuTimerBackend backend;
+    backend.BeginFrame = [&gpu](UINT slot) {
+        gpu.SlotFrames[slot] = gpu.CpuFrame;
+    };
+    backend.EndFrame = [](UINT) {};
+    backend.WriteTimestamp = [&gpu](UINT slot, UINT index) {
+        gpu.Clock += SCRIPTED_TICK_STEP;
+        gpu.Timestamps[slot][index] = gpu.Clock;
+    };
+    backend.ReadTimestamps = [&gpu](UINT slot, UINT count, uint64_t* timestamps, uint64_t& frequency) {
+        ++gpu.Reads;
+        if (gpu.SlotFrames[slot] >= gpu.FinishedFrames) {
+            return GTR_Pending;
+        }
+        if (gpu.SlotFrames[slot] == gpu.DisjointFrame) {
+            return GTR_Disjoint;
+        }
+        memcpy(timestamps, gpu.Timestamps[slot], count * sizeof(uint64_t));
+        frequency = SCRIPTED_FREQUENCY;
+        return GTR_Ready;
+    };
+    return backend;
+}
+
+//Run frames with one pass each, the GPU lag frames behind.
+void RunScriptedFrames(GpuTimer& timer, ScriptedGpu& gpu, UINT frames, UINT lag) {
+    for (UINT frame = 0; frame < frames; ++frame) {
+        gpu.FinishedFrames = gpu.CpuFrame >= lag ? gpu.CpuFrame - lag : 0;
+        BeginGpuTimerFrame(timer);
+        UINT pass = BeginGpuPass(timer, "Pass");
+        EndGpuPass(timer, pass);
+        EndGpuTimerFrame(timer);
+        ++gpu.CpuFrame;
+    }
+}
+
+void TestLatency() {
+    //Within the latency every frame is timed and resolves lag frames later, never waited on.
+    for (UINT lag = 1; lag < GPU_TIMER_FRAME_LATENCY; ++lag) {
+        ScriptedGpu gpu;
+        GpuTimer timer;
+        InitGpuTimer(timer, CreateScriptedGpuTimerBackend(gpu));
+        const UINT frames = 20;
+        RunScriptedFrames(timer, gpu, frames, lag);
+        CHECK(timer.Stats.SkippedFrames == 0);
+        //Frames before the last frame's begin minus the lag have resolved.
+        CHECK(timer.Stats.ResolvedFrames == frames - 1 - lag);
+        //Frame begin, pass begin, pass end, frame end.
+        CHECK(fabs(timer.Stats.FrameMs - 3 * SCRIPTED_STEP_MS) < 1e-9);
+        CHECK(timer.Timings.size() == 1 && fabs(timer.Timings[0].StartMs - SCRIPTED_STEP_MS) < 1e-9);
+        CHECK(fabs(GetGpuPassMs(timer, "Pass") - SCRIPTED_STEP_MS) < 1e-9);
+        ReleaseGpuTimer(timer);
+    }
+
+    //A GPU further behind than the latency leaves frames untimed rather than stalling, and the frames that are timed
+    //still resolve.
+    ScriptedGpu gpu;
+    GpuTimer timer;
+    InitGpuTimer(timer, CreateScriptedGpuTimerBackend(gpu));
+    const UINT frames = 40;
+    RunScriptedFrames(timer, gpu, frames, GPU_TIMER_FRAME_LATENCY + 2);
+    CHECK(timer.Stats.SkippedFrames > 0);
+    CHECK(timer.Stats.ResolvedFrames > 0);
+    CHECK(timer.Stats.SkippedFrames + timer.Stats.ResolvedFrames <= frames);
+    CHECK(fabs(timer.Stats.FrameMs - 3 * SCRIPTED_STEP_MS) < 1e-9);
+    //Each begin reads each pending slot at most once, oldest first, and stops at the first still pending.
+    CHECK(gpu.Reads <= frames * GPU_TIMER_FRAME_LATENCY);
+
+    //Once the GPU catches up, every frame is timed again.
+    UINT skipped = timer.Stats.SkippedFrames;
+    UINT resolved = timer.Stats.ResolvedFrames;
+    RunScriptedFrames(timer, gpu, frames, 0);
+    CHECK(timer.Stats.SkippedFrames == skipped);
+    CHECK(timer.Stats.ResolvedFrames > resolved);
+    ReleaseGpuTimer(timer);
+
+    //A disjoint frame is counted and dropped; the timings stay those of the frame before it.
+    ScriptedGpu disjointGpu;
+    disjointGpu.DisjointFrame = 5;
+    InitGpuTimer(timer, CreateScriptedGpuTimerBackend(disjointGpu));
+    RunScriptedFrames(timer, disjointGpu, 10, 1);
+    CHECK(timer.Stats.DisjointFrames == 1);
+    CHECK(timer.Stats.ResolvedFrames == 10 - 1 - 1 - 1);
+    CHECK(timer.Timings.size() == 1);
+    ReleaseGpuTimer(timer);
+
+    //Without a backend nothing is timed.
+    InitGpuTimer(timer, GpuTimerBackend());
+    BeginGpuTimerFrame(timer);
+    CHECK(BeginGpuPass(timer, "Pass") == GPU_TIMER_NO_PASS);
+    EndGpuTimerFrame(timer);
+    CHECK(timer.Stats.ResolvedFrames == 0 && timer.Stats.SkippedFrames == 0);
+    ReleaseGpuTimer(timer);
+}
+
+}
+
+int main() {
+    TestSoftwareBackend();
+    TestLatency();
+    printf("OK\n");
+    return 0;
+}
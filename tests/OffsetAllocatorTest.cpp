@@ -0,0 +1,206 @@
+#include "EchoEngineCore.h"
+#include "OffsetAllocator.h"
+#include "TestCommon.h"
+#include <random>
+
+// Random allocate, free, grow and defragment sequences against a model of the
+// memory the allocator hands out. Every element of the model holds the tag of
+// the allocation that owns it, so an allocation that overlaps a live one, or a
+// copy that misses part of one, shows up as a wrong tag. Usage:
+// OffsetAllocatorTest [seed] [operations]
+
+namespace {
+
+const uint32_t INITIAL_SIZE = 1 << 20;
+const uint32_t GROW_SIZE = 1 << 18;
+const uint32_t FREE_TAG = 0;
+//Operations between full checks of the allocator and the model.
+const int CHECK_INTERVAL = 997;
+
+struct LiveAllocation
+{
+    uint32_t Allocation;
+    uint32_t Tag;
+};
+
+void CheckRange(const std::vector<uint32_t>& memory, uint32_t offset, uint32_t size, uint32_t tag) {
+    CHECK(static_cast<uint64_t>(offset) + size <= memory.size());
+    for (uint32_t i = offset; i < offset + size; ++i) {
+        CHECK(memory[i] == tag);
+    }
+}
+
+void FillRange(std::vector<uint32_t>& memory, uint32_t offset, uint32_t size, uint32_t tag) {
+    std::fill(memory.begin() + offset, memory.begin() + offset + size, tag);
+}
+
+//Every live allocation still holds its own tag, and no two allocations share an element.
+void CheckLiveAllocations(const OffsetAllocator& allocator, const std::vector<LiveAllocation>& live, const std::vector<uint32_t>& memory) {
+    uint64_t liveSize = 0;
+    for (const LiveAllocation& allocation : live) {
+        uint32_t size = GetAllocationSize(allocator, allocation.Allocation);
+        CheckRange(memory, GetAllocationOffset(allocator, allocation.Allocation), size, allocation.Tag);
+        liveSize += size;
+    }
+    CHECK(liveSize == allocator.Size - allocator.FreeSize);
+    CHECK(static_cast<uint64_t>(std::count(memory.begin(), memory.end(), FREE_TAG)) == allocator.FreeSize);
+}
+
+//A range of any size must be allocatable when it is the whole free space.
+void TestExactSizes() {
+    const uint32_t sizes[] = { 1, 7, 8, 9, 100, 1000, 65535, 65536, 0x7FFFFFFF, 0xFFFFFFFF };
+    for (uint32_t size : sizes) {
+        OffsetAllocator allocator;
+        InitOffsetAllocator(allocator, size);
+        uint32_t allocation = AllocateOffset(allocator, size);
+        CHECK(allocation != OFFSET_ALLOCATION_NONE);
+        CHECK(GetAllocationOffset(allocator, allocation) == 0);
+        CHECK(AllocateOffset(allocator, 1) == OFFSET_ALLOCATION_NONE);
+        CHECK(ValidateOffsetAllocator(allocator));
+        FreeOffset(allocator, allocation);
+        CHECK(ValidateOffsetAllocator(allocator));
+        CHECK(allocator.FreeSize == size);
+    }
+}
+
+//Defragment, checking the moves are listed lowest first and that carrying the old memory over with the planned copies
+//leaves every allocation's contents at its new offset.
+void Defragment(OffsetAllocator& allocator, const std::vector<LiveAllocation>& live, std::vector<uint32_t>& memory, size_t& moveCount) {
+    std::vector<uint32_t> offsets(allocator.Nodes.size(), OFFSET_ALLOCATION_NONE);
+    for (const LiveAllocation& allocation : live) {
+        offsets[allocation.Allocation] = GetAllocationOffset(allocator, allocation.Allocation);
+    }
+
+    uint32_t usedSize = allocator.Size - allocator.FreeSize;
+    std::vector<OffsetAllocatorMove> moves;
+    DefragmentOffsetAllocator(allocator, moves);
+    CHECK(ValidateOffsetAllocator(allocator));
+    OffsetAllocatorReport report;
+    GetOffsetAllocatorReport(allocator, report);
+    CHECK(report.FreeRangeCount <= 1);
+    CHECK(report.LargestFreeRange == allocator.FreeSize);
+
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const OffsetAllocatorMove& move = moves[i];
+        CHECK(offsets[move.Allocation] == move.SourceOffset);
+        CHECK(GetAllocationOffset(allocator, move.Allocation) == move.DestinationOffset);
+        CHECK(GetAllocationSize(allocator, move.Allocation) == move.Size);
+        CHECK(move.DestinationOffset < move.SourceOffset);
+        if (i > 0) {
+            CHECK(moves[i - 1].SourceOffset + moves[i - 1].Size <= move.SourceOffset);
+            CHECK(moves[i - 1].DestinationOffset + moves[i - 1].Size == move.DestinationOffset);
+        }
+    }
+    //Allocations that did not move are all below the first one that did.
+    uint32_t firstMove = moves.empty() ? usedSize : moves[0].DestinationOffset;
+    for (const LiveAllocation& allocation : live) {
+        uint32_t offset = GetAllocationOffset(allocator, allocation.Allocation);
+        CHECK((offset == offsets[allocation.Allocation]) == (offset < firstMove));
+    }
+
+    std::vector<OffsetAllocatorCopy> copies;
+    GetDefragmentCopies(moves, usedSize, copies);
+    CHECK(copies.size() <= moves.size() + 1);
+    std::vector<uint32_t> packed(memory.size(), FREE_TAG);
+    uint32_t copiedSize = 0;
+    for (const OffsetAllocatorCopy& copy : copies) {
+        CHECK(static_cast<uint64_t>(copy.SourceOffset) + copy.Size <= memory.size());
+        CHECK(copy.DestinationOffset == copiedSize);
+        std::copy(memory.begin() + copy.SourceOffset, memory.begin() + copy.SourceOffset + copy.Size, packed.begin() + copy.DestinationOffset);
+        copiedSize += copy.Size;
+    }
+    CHECK(copiedSize == usedSize);
+    memory.swap(packed);
+    CheckLiveAllocations(allocator, live, memory);
+    moveCount += moves.size();
+}
+
+void TestRandomOperations(uint32_t seed, int operations) {
+    std::mt19937 random(seed);
+    OffsetAllocator allocator;
+    InitOffsetAllocator(allocator, INITIAL_SIZE);
+    std::vector<uint32_t> memory(INITIAL_SIZE, FREE_TAG);
+    std::vector<LiveAllocation> live;
+    uint32_t nextTag = FREE_TAG + 1;
+    size_t failedAllocations = 0;
+    size_t grows = 0;
+    size_t defragments = 0;
+    size_t moves = 0;
+
+    for (int operation = 0; operation < operations; ++operation) {
+        //Allocations and frees balance out, with a defragment every thousand operations or so.
+        uint32_t choice = random() % 1000;
+        if (choice < 500 || live.empty()) {
+            //Mostly small ranges with the odd large one.
+            uint32_t size = random() % 4 == 0 ? 1 + random() % 16384 : 1 + random() % 256;
+            uint32_t allocation = AllocateOffset(allocator, size);
+            if (allocation == OFFSET_ALLOCATION_NONE) {
+                //Allocation may only fail when no free range fits.
+                OffsetAllocatorReport report;
+                GetOffsetAllocatorReport(allocator, report);
+                CHECK(report.LargestFreeRange < size);
+                ++failedAllocations;
+                if (random() % 2) {
+                    //Growing keeps every offset, so the memory is carried over as a whole.
+                    GrowOffsetAllocator(allocator, allocator.Size + GROW_SIZE);
+                    memory.resize(allocator.Size, FREE_TAG);
+                    ++grows;
+                }
+                continue;
+            }
+            uint32_t offset = GetAllocationOffset(allocator, allocation);
+            CHECK(GetAllocationSize(allocator, allocation) == size);
+            //Only free memory may be handed out.
+            CheckRange(memory, offset, size, FREE_TAG);
+            LiveAllocation liveAllocation = { allocation, nextTag++ };
+            FillRange(memory, offset, size, liveAllocation.Tag);
+            live.push_back(liveAllocation);
+        }
+        else if (choice < 999) {
+            size_t index = random() % live.size();
+            LiveAllocation allocation = live[index];
+            live[index] = live.back();
+            live.pop_back();
+            uint32_t offset = GetAllocationOffset(allocator, allocation.Allocation);
+            uint32_t size = GetAllocationSize(allocator, allocation.Allocation);
+            CheckRange(memory, offset, size, allocation.Tag);
+            FillRange(memory, offset, size, FREE_TAG);
+            FreeOffset(allocator, allocation.Allocation);
+        }
+        else {
+            Defragment(allocator, live, memory, moves);
+            ++defragments;
+        }
+
+        if (operation % CHECK_INTERVAL == 0) {
+            CHECK(ValidateOffsetAllocator(allocator));
+            CheckLiveAllocations(allocator, live, memory);
+        }
+    }
+    CHECK(ValidateOffsetAllocator(allocator));
+    CheckLiveAllocations(allocator, live, memory);
+
+    //Freeing everything leaves one free range.
+    for (const LiveAllocation& allocation : live) {
+        FreeOffset(allocator, allocation.Allocation);
+    }
+    CHECK(ValidateOffsetAllocator(allocator));
+    OffsetAllocatorReport report;
+    GetOffsetAllocatorReport(allocator, report);
+    CHECK(report.AllocationCount == 0 && report.FreeRangeCount == 1 && report.FreeSize == allocator.Size);
+
+    printf("Seed %u, %d operations: %zu allocations live at the end, %zu failed, %zu grows to %u, %zu defragments moved %zu allocations.\n", seed,
+        operations, live.size(), failedAllocations, grows, allocator.Size, defragments, moves);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t seed = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 1;
+    int operations = argc > 2 ? atoi(argv[2]) : 200000;
+
+    TestExactSizes();
+    TestRandomOperations(seed, operations);
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Checks shared by the test executables.
+
+#include <cstdio>
+#include <cstdlib>
+
+// Print the failed condition with its file and line, and exit with 1.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
@@ -0,0 +1,296 @@
+#include "EchoEngineCore.h"
+#include "TextureStreaming.h"
+#include "TextureCooker.h"
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "VirtualFileSystem.h"
+#include "MeshLod.h"
+#include "TestCommon.h"
+#include <map>
+using namespace DirectX;
+
+// Texture streaming residency and eviction against a mock device that keeps
+// every texture's levels in memory. After every step each texture's resident
+// levels are compared with the file it streams from, and the memory the mock
+// holds with the streamer's resident bytes and its budget.
+
+namespace {
+
+const UINT TEST_TEXTURES = 20;
+const UINT TEST_TEXTURE_SIZE = 1024;
+const uint64_t TEST_BUDGET = 24ull << 20;
+//Mip of the largest level of the mip tail of a 1024x1024 texture.
+const UINT TEST_TAIL_MIP = 4;
+
+struct MockTexture
+{
+    TextureFormat Format;
+    std::vector<std::vector<BYTE>> Levels;
+    std::vector<UINT> RowPitches;
+};
+
+//Textures are told apart by the id stored in their resource and view pointers.
+std::map<uintptr_t, MockTexture> g_MockTextures;
+uintptr_t g_NextMockTexture = 1;
+uint64_t g_MockBytes = 0;
+uint64_t g_PeakMockBytes = 0;
+bool g_FailMockCreates = false;
+
+MockTexture& GetMockTexture(const Texture& texture) {
+    auto found = g_MockTextures.find(reinterpret_cast<uintptr_t>(texture.Resource));
+    CHECK(found != g_MockTextures.end());
+    return found->second;
+}
+
+TextureStreamingDevice GetMockTextureStreamingDevice() {
+    TextureStreamingDevice device;
+    device.CreateTexture = [](TextureFormat format, bool, UINT width, UINT height, UINT mipCount, Texture& texture) {
+        if (g_FailMockCreates) {
+            return false;
+        }
+        MockTexture mock;
+        mock.Format = format;
+        for (UINT mip = 0; mip < mipCount; ++mip) {
+            UINT rowPitch = GetTextureRowPitch(format, std::max<UINT>(width >> mip, 1));
+            UINT rowCount = GetTextureRowCount(format, std::max<UINT>(height >> mip, 1));
+            //Undefined contents, as a new Direct3D texture has.
+            mock.Levels.push_back(std::vector<BYTE>(static_cast<size_t>(rowPitch) * rowCount, 0xCD));
+            mock.RowPitches.push_back(rowPitch);
+            g_MockBytes += mock.Levels.back().size();
+        }
+        g_PeakMockBytes = std::max<uint64_t>(g_PeakMockBytes, g_MockBytes);
+
+        uintptr_t id = g_NextMockTexture++;
+        g_MockTextures[id] = mock;
+        texture.Resource = reinterpret_cast<ID3D11Texture2D*>(id);
+        texture.View = reinterpret_cast<ID3D11ShaderResourceView*>(id);
+        texture.Format = format;
+        texture.Width = width;
+        texture.Height = height;
+        texture.MipCount = mipCount;
+        return true;
+    };
+    device.UploadMip = [](Texture& texture, UINT mip, const void* data, UINT rowPitch) {
+        MockTexture& mock = GetMockTexture(texture);
+        CHECK(mip < mock.Levels.size() && rowPitch == mock.RowPitches[mip]);
+        memcpy(mock.Levels[mip].data(), data, mock.Levels[mip].size());
+    };
+    device.CopyMip = [](Texture& destination, UINT destinationMip, const Texture& source, UINT sourceMip) {
+        MockTexture& destinationMock = GetMockTexture(destination);
+        const MockTexture& sourceMock = GetMockTexture(source);
+        CHECK(destinationMip < destinationMock.Levels.size() && sourceMip < sourceMock.Levels.size());
+        CHECK(destinationMock.Format == sourceMock.Format && destinationMock.Levels[destinationMip].size() == sourceMock.Levels[sourceMip].size());
+        destinationMock.Levels[destinationMip] = sourceMock.Levels[sourceMip];
+    };
+    device.ReleaseTexture = [](Texture& texture) {
+        MockTexture& mock = GetMockTexture(texture);
+        for (const std::vector<BYTE>& level : mock.Levels) {
+            g_MockBytes -= level.size();
+        }
+        g_MockTextures.erase(reinterpret_cast<uintptr_t>(texture.Resource));
+        texture = Texture();
+    };
+    return device;
+}
+
+std::vector<std::vector<BYTE>> g_Files;
+
+std::wstring GetTestTexturePath(UINT index) {
+    return L"textures/" + std::to_wstring(index) + L".etex";
+}
+
+//Cook distinct textures, half RGBA8 and half BC1, one of them not square, and mount them in memory.
+void CreateTestTextures() {
+    for (UINT i = 0; i < TEST_TEXTURES; ++i) {
+        TextureImage image;
+        image.Width = TEST_TEXTURE_SIZE;
+        image.Height = i == 3 ? TEST_TEXTURE_SIZE / 2 : TEST_TEXTURE_SIZE;
+        image.Pixels.resize(image.Width * image.Height * 4);
+        for (size_t p = 0; p < image.Pixels.size(); ++p) {
+            image.Pixels[p] = static_cast<BYTE>(((p * 2654435761u) >> 13) + i);
+        }
+        TextureCookSettings settings;
+        settings.Format = i % 2 ? TF_BC1 : TF_RGBA8;
+        CookedTexture cooked;
+        CHECK(CookTexture(image, settings, cooked));
+        g_Files.push_back(std::vector<BYTE>());
+        CHECK(BuildTextureFile(GetCookedTextureSource(cooked), g_Files.back()));
+    }
+    for (UINT i = 0; i < TEST_TEXTURES; ++i) {
+        MountMemoryFile(GetTestTexturePath(i).c_str(), g_Files[i].data(), g_Files[i].size());
+    }
+}
+
+//The resident levels hold exactly the file's levels from the resident mip down.
+void CheckTexture(StreamedTexture texture, UINT fileIndex) {
+    std::vector<BYTE> data = g_Files[fileIndex];
+    TextureFile file;
+    CHECK(OpenTextureFileFromMemory(file, data));
+    UINT residentMip = GetStreamedTextureResidentMip(texture);
+    ID3D11ShaderResourceView* view = GetStreamedTextureView(texture);
+    if (residentMip == file.Header->MipCount) {
+        CHECK(!view);
+        return;
+    }
+    CHECK(view);
+    auto found = g_MockTextures.find(reinterpret_cast<uintptr_t>(view));
+    CHECK(found != g_MockTextures.end());
+    const MockTexture& mock = found->second;
+    CHECK(mock.Levels.size() == file.Header->MipCount - residentMip);
+    for (UINT mip = residentMip; mip < file.Header->MipCount; ++mip) {
+        CHECK(mock.Levels[mip - residentMip].size() == GetTextureMipSize(file, mip));
+        CHECK(memcmp(mock.Levels[mip - residentMip].data(), GetTextureMipData(file, mip), mock.Levels[mip - residentMip].size()) == 0);
+    }
+}
+
+void CheckTextures(const std::vector<StreamedTexture>& textures) {
+    for (UINT i = 0; i < textures.size(); ++i) {
+        CheckTexture(textures[i], i);
+    }
+    TextureStreamingStats stats;
+    GetTextureStreamingStats(stats);
+    CHECK(stats.ResidentBytes == g_MockBytes);
+}
+
+void RunFrame() {
+    UpdateTextureStreaming();
+    FlushAssetLoader(nullptr, nullptr);
+}
+
+void TestResidency() {
+    InitTextureStreaming(GetMockTextureStreamingDevice(), TEST_BUDGET);
+    std::vector<StreamedTexture> textures;
+    for (UINT i = 0; i < TEST_TEXTURES; ++i) {
+        textures.push_back(RegisterStreamedTexture(GetTestTexturePath(i).c_str()));
+        CHECK(textures.back() != STREAMED_TEXTURE_NONE);
+    }
+    CHECK(RegisterStreamedTexture(L"textures/missing.etex") == STREAMED_TEXTURE_NONE);
+
+    //Registering queues the mip tails, and nothing more is resident until something is requested.
+    TextureStreamingStats stats;
+    GetTextureStreamingStats(stats);
+    CHECK(stats.Textures == TEST_TEXTURES && stats.PendingLoads == TEST_TEXTURES);
+    RunFrame();
+    for (StreamedTexture texture : textures) {
+        CHECK(GetStreamedTextureResidentMip(texture) == TEST_TAIL_MIP);
+    }
+    CheckTextures(textures);
+    GetTextureStreamingStats(stats);
+    uint64_t tailBytes = stats.ResidentBytes;
+
+    //Three textures at full detail.
+    for (UINT frame = 0; frame < 2; ++frame) {
+        for (UINT i = 0; i < 3; ++i) {
+            RequestStreamedTextureMip(textures[i], 0);
+        }
+        RunFrame();
+    }
+    for (UINT i = 0; i < TEST_TEXTURES; ++i) {
+        CHECK(GetStreamedTextureResidentMip(textures[i]) == (i < 3 ? 0 : TEST_TAIL_MIP));
+    }
+    CheckTextures(textures);
+    GetTextureStreamingStats(stats);
+    CHECK(stats.ResidentTextures == TEST_TEXTURES);
+
+    //Every texture at full detail asks for more than the budget: the requests are trimmed and the budget holds, even
+    //at the peak of a frame's replacements.
+    for (UINT frame = 0; frame < 3; ++frame) {
+        for (StreamedTexture texture : textures) {
+            RequestStreamedTextureMip(texture, 0);
+        }
+        RunFrame();
+    }
+    CheckTextures(textures);
+    GetTextureStreamingStats(stats);
+    CHECK(stats.RequestedBytes > TEST_BUDGET);
+    CHECK(stats.TargetBytes <= TEST_BUDGET && stats.ResidentBytes <= TEST_BUDGET);
+    CHECK(stats.TrimmedFrames == 3 && stats.OverrunFrames == 0);
+    CHECK(g_PeakMockBytes <= TEST_BUDGET);
+    printf("Every texture at mip 0: %.1f MB requested, %.1f MB resident, %.1f MB peak, %u levels evicted.\n", stats.RequestedBytes / 1048576.0,
+        stats.ResidentBytes / 1048576.0, g_PeakMockBytes / 1048576.0, stats.LevelsEvicted);
+
+    //Once only one texture is wanted it reaches full detail, evicting others' levels as the budget needs.
+    UINT evicted = stats.LevelsEvicted;
+    for (UINT frame = 0; frame < TEXTURE_STREAMING_KEEP_FRAMES + 2; ++frame) {
+        RequestStreamedTextureMip(textures[7], 0);
+        RunFrame();
+    }
+    CheckTextures(textures);
+    GetTextureStreamingStats(stats);
+    CHECK(GetStreamedTextureResidentMip(textures[7]) == 0);
+    CHECK(stats.ResidentBytes <= TEST_BUDGET && stats.OverrunFrames == 0);
+    CHECK(stats.LevelsEvicted >= evicted);
+
+    //The mip picked from an object's distance is what streams in.
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    float projectionScale = GetLodProjectionScale(projection, 720.0f);
+    BoundingBox bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+    CHECK(ComputeTextureMip(TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, 1.0f, bounds, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), projectionScale) == 0);
+    CHECK(ComputeTextureMip(TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, 1.0f, bounds, XMVectorSet(0.0f, 0.0f, -1e6f, 1.0f), projectionScale) == 10);
+    UINT nearMip = ComputeTextureMip(TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, 1.0f, bounds, XMVectorSet(0.0f, 0.0f, -1.0f, 1.0f), projectionScale);
+    UINT farMip = ComputeTextureMip(TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, 1.0f, bounds, XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f), projectionScale);
+    CHECK(nearMip < farMip);
+    for (UINT frame = 0; frame < 2; ++frame) {
+        RequestStreamedTexture(textures[8], 1.0f, bounds, XMVectorSet(0.0f, 0.0f, -5.0f, 1.0f), projectionScale);
+        RunFrame();
+    }
+    CHECK(GetStreamedTextureResidentMip(textures[8]) <= ComputeTextureMip(TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, 1.0f, bounds,
+        XMVectorSet(0.0f, 0.0f, -5.0f, 1.0f), projectionScale));
+    CheckTextures(textures);
+
+    //A budget below the mip tails is overrun and reported, but the tails stay.
+    SetTextureStreamingBudget(tailBytes / 2);
+    for (UINT frame = 0; frame < 2; ++frame) {
+        RunFrame();
+    }
+    GetTextureStreamingStats(stats);
+    CHECK(stats.OverrunFrames >= 1 && stats.ResidentBytes == tailBytes);
+    for (StreamedTexture texture : textures) {
+        CHECK(GetStreamedTextureResidentMip(texture) == TEST_TAIL_MIP);
+    }
+    CheckTextures(textures);
+
+    //Unregistering a texture cancels its loads in flight.
+    SetTextureStreamingBudget(TEST_BUDGET);
+    RequestStreamedTextureMip(textures[1], 0);
+    UpdateTextureStreaming();
+    GetTextureStreamingStats(stats);
+    CHECK(stats.PendingLoads > 0);
+    UnregisterStreamedTexture(textures[1]);
+    RunFrame();
+    UpdateTextureStreaming();
+    GetTextureStreamingStats(stats);
+    CHECK(stats.PendingLoads == 0 && stats.Textures == TEST_TEXTURES - 1);
+    CHECK(GetStreamedTextureView(textures[1]) == nullptr);
+
+    //A level the device fails to create counts as a failed load and leaves the resident levels alone.
+    g_FailMockCreates = true;
+    RequestStreamedTextureMip(textures[2], 1);
+    RunFrame();
+    RunFrame();
+    g_FailMockCreates = false;
+    GetTextureStreamingStats(stats);
+    CHECK(stats.FailedLoads == 1);
+    CHECK(GetStreamedTextureResidentMip(textures[2]) == TEST_TAIL_MIP);
+    CheckTexture(textures[2], 2);
+
+    ShutdownTextureStreaming();
+    CHECK(g_MockTextures.empty() && g_MockBytes == 0);
+}
+
+}
+
+int main() {
+    InitJobSystem();
+    InitVirtualFileSystem();
+    InitAssetLoader();
+
+    CreateTestTextures();
+    TestResidency();
+
+    ShutdownAssetLoader();
+    ShutdownVirtualFileSystem();
+    ShutdownJobSystem();
+    printf("OK\n");
+    return 0;
+}